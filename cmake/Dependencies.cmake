@@ -60,6 +60,7 @@ if(USE_LEVELDB)
   find_package(Snappy REQUIRED)
   include_directories(SYSTEM ${Snappy_INCLUDE_DIR})
   list(APPEND Caffe_LINKER_LIBS ${Snappy_LIBRARIES})
+  add_definitions(-DUSE_SNAPPY)
 endif()
 
 # ---[ CUDA
@@ -100,6 +101,7 @@ if(NOT APPLE)
     find_package(OpenBLAS REQUIRED)
     include_directories(SYSTEM ${OpenBLAS_INCLUDE_DIR})
     list(APPEND Caffe_LINKER_LIBS ${OpenBLAS_LIB})
+    add_definitions(-DUSE_OPENBLAS)
   elseif(BLAS STREQUAL "MKL" OR BLAS STREQUAL "mkl")
     find_package(MKL REQUIRED)
     include_directories(SYSTEM ${MKL_INCLUDE_DIR})
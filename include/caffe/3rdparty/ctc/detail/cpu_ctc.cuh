@@ -5,12 +5,15 @@
 #include <limits>
 #include <algorithm>
 #include <numeric>
+#include <thread>
+#include <vector>
 #define CTC_DISABLE_OMP   // added by xmf
 #if !defined(CTC_DISABLE_OMP) && !defined(APPLE)
 #include <omp.h>
 #endif
 
 #include "ctc_helper.h"
+#include "caffe/util/thread_pool.hpp"
 
 
 template<typename ProbT>
@@ -23,6 +26,9 @@ public:
             num_threads_(num_threads), workspace_(workspace),
             blank_label_(blank_label) {
 #if defined(CTC_DISABLE_OMP) || defined(APPLE)
+        if (num_threads <= 0) {
+            num_threads_ = std::max(1u, std::thread::hardware_concurrency());
+        }
 #else
         if (num_threads > 0) {
             omp_set_num_threads(num_threads);
@@ -79,6 +85,12 @@ private:
     void softmax(const ProbT* const activations, ProbT* probs,
                  const int* const input_lengths);
 
+    // Calls f(mb) for every minibatch entry. Entries are independent, so
+    // they are spread over at most num_threads_ threads of the Caffe CPU
+    // thread pool (the OpenMP pragmas being disabled).
+    template<typename F>
+    void for_each_minibatch(const F& f) const;
+
     std::tuple<ProbT, bool>
             cost_and_grad_kernel(ProbT *grad, const ProbT* const probs,
                                  const int* const labels, int T, int L,
@@ -159,12 +171,25 @@ int CpuCTC<ProbT>::CpuCTC_metadata::setup_labels(const int* const labels,
     return repeats;
 }
 
+template<typename ProbT>
+template<typename F>
+void CpuCTC<ProbT>::for_each_minibatch(const F& f) const {
+    // Single sequences, which the pool balances, unless fewer threads than
+    // the pool's are asked for: then one chunk per thread.
+    const int num_threads = std::max(1, std::min(num_threads_, minibatch_));
+    const int grain = num_threads_ >= caffe::Caffe::cpu_threads() ? 1 :
+        (minibatch_ + num_threads - 1) / num_threads;
+    caffe::parallel_for(minibatch_, [&f](int begin, int end) {
+        for (int mb = begin; mb < end; ++mb)
+            f(mb);
+    }, grain);
+}
+
 template<typename ProbT>
 void
 CpuCTC<ProbT>::softmax(const ProbT* const activations, ProbT* probs,
                        const int* const input_lengths) {
-//#pragma omp parallel for
-    for (int mb = 0; mb < minibatch_; ++mb) {
+    for_each_minibatch([&](int mb) {
         for(int c = 0; c < input_lengths[mb]; ++c) {
             int col_offset = (mb + minibatch_ * c) * alphabet_size_;
             ProbT max_activation = -std::numeric_limits<ProbT>::infinity();
@@ -181,7 +206,7 @@ CpuCTC<ProbT>::softmax(const ProbT* const activations, ProbT* probs,
                 probs[r + col_offset] /= denom;
             }
         }
-    }
+    });
 }
 
 template<typename ProbT>
@@ -415,8 +440,11 @@ CpuCTC<ProbT>::cost_and_grad(const ProbT* const activations,
 
     softmax(activations, probs, input_lengths);
 
-//#pragma omp parallel for
-    for (int mb = 0; mb < minibatch_; ++mb) {
+    std::vector<int> label_offsets(minibatch_, 0);
+    std::partial_sum(label_lengths, label_lengths + minibatch_ - 1,
+                     label_offsets.begin() + 1);
+
+    for_each_minibatch([&](int mb) {
         const int T = input_lengths[mb]; // Length of utterance (time)
         const int L = label_lengths[mb]; // Number of labels in transcription
 
@@ -425,10 +453,10 @@ CpuCTC<ProbT>::cost_and_grad(const ProbT* const activations,
         std::tie(costs[mb], mb_status) =
                 cost_and_grad_kernel(grads + mb * alphabet_size_,
                                      probs + mb * alphabet_size_,
-                                     flat_labels + std::accumulate(label_lengths, label_lengths + mb, 0),
+                                     flat_labels + label_offsets[mb],
                                      T, L, mb,
                                      bytes_used + mb * per_minibatch_bytes);
-    }
+    });
 
     return CTC_STATUS_SUCCESS;
 }
@@ -473,15 +501,18 @@ ctcStatus_t CpuCTC<ProbT>::score_forward(const ProbT* const activations,
 
     softmax(activations, probs, input_lengths);
 
-//#pragma omp parallel for
-    for (int mb = 0; mb < minibatch_; ++mb) {
+    std::vector<int> label_offsets(minibatch_, 0);
+    std::partial_sum(label_lengths, label_lengths + minibatch_ - 1,
+                     label_offsets.begin() + 1);
+
+    for_each_minibatch([&](int mb) {
         const int T = input_lengths[mb]; // Length of utterance (time)
         const int L = label_lengths[mb]; // Number of labels in transcription
         const int S = 2*L + 1; // Number of labels with blanks
 
         CpuCTC_metadata ctcm(L, S, T, mb, alphabet_size_, workspace_,
                              bytes_used + mb * per_minibatch_bytes, blank_label_,
-                             flat_labels + std::accumulate(label_lengths, label_lengths + mb, 0));
+                             flat_labels + label_offsets[mb]);
 
 
         if (L + ctcm.repeats > T)
@@ -492,7 +523,7 @@ ctcStatus_t CpuCTC<ProbT>::score_forward(const ProbT* const activations,
                                         ctcm.alphas);
         }
 
-    }
+    });
 
     return CTC_STATUS_SUCCESS;
 }
@@ -2,6 +2,7 @@
 #define CAFFE_BLOB_HPP_
 
 #include <algorithm>
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -24,7 +25,8 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0), compressed_(false),
+         half_precision_(FP32), layout_(NCHW) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
@@ -52,6 +54,7 @@ class Blob {
    */
   virtual void Reshape(const vector<int>& shape);
   void Reshape(const BlobShape& shape);
+  /// @brief Reshapes to the shape of other, and takes its layout.
   virtual void ReshapeLike(const Blob& other);
   inline string shape_string() const {
     ostringstream stream;
@@ -210,6 +213,7 @@ class Blob {
 
   inline const shared_ptr<SyncedMemory>& data() const {
     CHECK(data_);
+    if (compressed_) { RestoreData(); }
     return data_;
   }
 
@@ -246,9 +250,50 @@ class Blob {
   virtual Dtype* mutable_gpu_diff();
   virtual void Update();
   virtual void FromProto(const BlobProto& proto, bool reshape = true);
-  virtual void ToProto(BlobProto* proto, bool write_diff = false) const;
+  /// @brief Writes the blob, in 16 bits if precision is FP16 or BF16.
+  virtual void ToProto(BlobProto* proto, bool write_diff = false,
+      const Precision precision = FP32) const;
   //>>>>>>> sparse_pr
 
+  /**
+   * @brief Keeps the data in FP16 or BF16 only, freeing the Dtype copy.
+   *
+   * Kernels that can compute from 16 bit weights read half_data(). Any other
+   * access to the data converts it back to Dtype, so this only saves memory
+   * while such kernels are the sole readers. The data is no longer shared
+   * with blobs that shared it before.
+   *
+   * Converting back is safe from concurrent const accessors, e.g. several
+   * InferenceContext%s sharing the params. The 16 bit copy then lives on
+   * until the blob is next modified, as other threads may still read it.
+   */
+  void CompressData(const Precision precision);
+  /// @brief The data left by CompressData, or NULL if it is held in Dtype.
+  inline const uint16_t* half_data() const {
+    return compressed_ ?
+        static_cast<const uint16_t*>(half_data_->cpu_data()) : NULL;
+  }
+  inline Precision data_precision() const {
+    return compressed_ ? half_precision_ : FP32;
+  }
+  /**
+   * @brief The data in Dtype for reading it out, e.g. to serialize it.
+   *
+   * Compressed data is converted into buffer and the blob stays compressed;
+   * otherwise this is cpu_data() and buffer is left alone.
+   */
+  const Dtype* cpu_data_uncompressed(vector<Dtype>* buffer) const;
+
+  /**
+   * @brief The memory order of a 4-D blob.
+   *
+   * The shape stays N x C x H x W in either layout; only the order of the
+   * values changes. offset() and data_at() assume NCHW, and most layers
+   * only take NCHW bottoms: Net::Init inserts Layout layers for them.
+   */
+  inline Layout layout() const { return layout_; }
+  inline void set_layout(const Layout layout) { layout_ = layout; }
+
   /// @brief Compute the sum of absolute values (L1 norm) of the data.
   virtual Dtype asum_data() const;
   /// @brief Compute the sum of absolute values (L1 norm) of the diff.
@@ -281,6 +326,17 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   virtual void ShareDiff(const Blob& other);
+  /**
+   * @brief Makes data_ and diff_ views of the count() values of other's from
+   *        offset on, so that Concat and Slice can keep contiguous parts of
+   *        a blob without copies.
+   *
+   * Writes through either blob are seen by both. A Reshape to more values
+   * than the view holds allocates fresh memory again.
+   */
+  void ShareView(const Blob& other, const int offset);
+  /// @brief Whether ShareView(other, offset) is in effect at this shape.
+  bool IsViewOf(const Blob& other, const int offset) const;
 
   virtual bool ShapeEquals(const BlobProto& other);
 
@@ -291,6 +347,22 @@ class Blob {
   vector<int> shape_;
   int count_;
   int capacity_;
+  /// The 16 bit data left by CompressData.
+  shared_ptr<SyncedMemory> half_data_;
+  /// Whether data_ is freed and half_data_ holds the data.
+  mutable std::atomic<bool> compressed_;
+  Precision half_precision_;
+  Layout layout_;
+
+  /// Converts half_data_ back into data_, once across threads.
+  void RestoreData() const;
+  /// Drops half_data_ when data_ is about to change.
+  void DropHalfData() {
+    compressed_ = false;
+    half_data_.reset();
+  }
+  void ToHalfProto(BlobProto* proto, bool write_diff,
+      const Precision precision) const;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
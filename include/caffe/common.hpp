@@ -77,6 +77,8 @@ namespace cv { class Mat; }
 
 namespace caffe {
 
+class ThreadPool;
+
 // We will use the boost shared_ptr instead of the new C++11 one mainly
 // because cuda does not work (at least now) well with C++11 features.
 using boost::shared_ptr;
@@ -172,6 +174,15 @@ class Caffe {
   inline static void set_solver_count(int val) { Get().solver_count_ = val; }
   inline static bool root_solver() { return Get().root_solver_; }
   inline static void set_root_solver(bool val) { Get().root_solver_ = val; }
+  // The pool of CPU threads behind parallel_for (see util/thread_pool.hpp).
+  // Unlike the other settings of this class, it is shared by all threads of
+  // the process.
+  static ThreadPool& thread_pool();
+  // Sets the number of CPU threads used by parallel_for, and by the BLAS
+  // library when it can be told (MKL, OpenBLAS), so that the two do not
+  // oversubscribe the cores. 0 picks the number of hardware threads.
+  static void set_cpu_threads(int num_threads);
+  static int cpu_threads();
 
  protected:
 #ifndef CPU_ONLY
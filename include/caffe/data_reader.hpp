@@ -11,6 +11,7 @@
 #include "caffe/internal_thread.hpp"
 #include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
+#include "caffe/util/sample_cache.hpp"
 
 namespace caffe {
 
@@ -21,6 +22,11 @@ namespace caffe {
  * databases are read sequentially, and that each solver accesses a different
  * subset of the database. Data is distributed to solvers in a round-robin
  * way to keep parallel training deterministic.
+ * With DataParameter num_shards > 1, a source only reads its shard_index-th
+ * contiguous range of the records, seeking to it by key; with shuffle_shard,
+ * it reads that range in blocks whose order is reshuffled every epoch, and
+ * with shuffle, in a random order of its records. With cache_mb > 0, it keeps
+ * the records it parsed, and decoded if possible, in memory.
  */
 template<class TDatum>
 class DataReader {
@@ -57,8 +63,29 @@ class DataReader {
    protected:
     void InternalThreadEntry();
     void read_one(db::Cursor* cursor, QueuePair* qp);
+    // Indexes the first key of each block of this reader's shard, and moves
+    // the cursor to the first block to read.
+    void init_shard(db::DB* db, db::Cursor* cursor);
+    // Moves the cursor to the next block, starting a new epoch after the
+    // last one.
+    void next_block(db::Cursor* cursor);
+    // Hints the database that block_order_[b] will be read soon.
+    void prefetch_block(int b);
+    void log_cache();
 
     const LayerParameter param_;
+    // Empty when the whole database is read in order.
+    vector<string> block_keys_;
+    vector<int> block_sizes_;
+    vector<int> block_order_;
+    int block_;     // index in block_order_ of the block being read
+    int in_block_;  // records read from that block
+    int epoch_;
+    // Seeks ahead of the reading cursor when reading records in random order.
+    shared_ptr<db::Cursor> lookahead_;
+    // Records by key, with cache_mb > 0.
+    shared_ptr<SampleCache<TDatum> > cache_;
+    bool cache_decoded_;
     BlockingQueue<shared_ptr<QueuePair> > new_queue_pairs_;
 
     friend class DataReader<TDatum>;
@@ -72,7 +99,8 @@ class DataReader {
   // model several times in parallel with the same instance of the lib.
   static inline string source_key(const LayerParameter& param) {
     int tid = idhasher_(std::this_thread::get_id());
-    return std::to_string(tid) + ":" + param.name() + ":" + param.data_param().source();
+    return std::to_string(tid) + ":" + param.name() + ":" + param.data_param().source()
+        + ":" + std::to_string(param.data_param().shard_index());
   }
 
   const shared_ptr<QueuePair> queue_pair_;
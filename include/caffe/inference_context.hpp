@@ -0,0 +1,85 @@
+#ifndef CAFFE_INFERENCE_CONTEXT_HPP_
+#define CAFFE_INFERENCE_CONTEXT_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A trained net whose weights are shared, read-only, by any number of
+ *        InferenceContext%s.
+ *
+ * The model is built in the TEST phase and records the Caffe mode (and
+ * device) current at construction; its contexts run with that mode on
+ * whatever thread calls them. The weights are synchronized up front so that
+ * concurrent reads never move them between host and device.
+ */
+template <typename Dtype>
+class InferenceModel {
+ public:
+  explicit InferenceModel(const NetParameter& param);
+  /// @brief Loads the definition and its trained weights from files.
+  InferenceModel(const string& param_file, const string& trained_file);
+
+  /// @brief The net holding the shared weights; do not run it concurrently
+  ///        with the contexts, nor modify its parameters.
+  inline const Net<Dtype>& net() const { return *net_; }
+  inline const NetParameter& param() const { return param_; }
+  inline Caffe::Brew mode() const { return mode_; }
+  inline int device() const { return device_; }
+
+ protected:
+  void Init(const string& trained_file);
+
+  NetParameter param_;
+  shared_ptr<Net<Dtype> > net_;
+  Caffe::Brew mode_;
+  int device_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceModel);
+};
+
+/**
+ * @brief A per-thread workspace for running an InferenceModel.
+ *
+ * A context owns its activations and layer buffers only; the parameter
+ * blobs are those of the model. One context must not be used by two threads
+ * at once, but contexts of the same model may run concurrently, each with
+ * its own input shapes (e.g. batch size).
+ */
+template <typename Dtype>
+class InferenceContext {
+ public:
+  explicit InferenceContext(const InferenceModel<Dtype>& model);
+
+  inline Net<Dtype>& net() { return *net_; }
+  inline const vector<Blob<Dtype>*>& input_blobs() const {
+    return net_->input_blobs();
+  }
+  inline const vector<Blob<Dtype>*>& output_blobs() const {
+    return net_->output_blobs();
+  }
+
+  /**
+   * @brief Runs the net on the current input shapes, on the calling thread,
+   *        in the mode and on the device of the model.
+   */
+  const vector<Blob<Dtype>*>& Forward(Dtype* loss = NULL);
+
+ protected:
+  shared_ptr<Net<Dtype> > net_;
+  Caffe::Brew mode_;
+  int device_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceContext);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_CONTEXT_HPP_
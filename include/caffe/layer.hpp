@@ -191,7 +191,8 @@ class Layer {
   /**
    * @brief Writes the layer parameter to a protocol buffer
    */
-  virtual void ToProto(LayerParameter* param, bool write_diff = false);
+  virtual void ToProto(LayerParameter* param, bool write_diff = false,
+      const Precision precision = FP32);
 
   /**
    * @brief Returns the scalar loss associated with a top blob at a given index.
@@ -294,6 +295,37 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Return whether the layer computes from its param_id-th blob while
+   *        it is held in 16 bits by Blob::CompressData.
+   *
+   * Only such parameters follow their storage_precision; the others would be
+   * converted back to Dtype by their first use.
+   */
+  virtual inline bool AllowHalfStorage(const int param_id) const {
+    return false;
+  }
+
+  /**
+   * @brief Rebuilds what the layer derives from its parameters for its
+   *        forward pass, e.g. int8 weights, after the parameters changed.
+   *
+   * Net calls it once its parameters are initialized, loaded or shared (see
+   * Net::PrepareParams). source, if not NULL, is a prepared layer of the
+   * same type and parameters, whose derived data may be shared instead.
+   */
+  virtual void PrepareParams(const Layer<Dtype>* source) {}
+
+  /**
+   * @brief Lets the layer alias its bottoms and tops with Blob::ShareView
+   *        instead of copying between them, for layers that can.
+   *
+   * Off by default. Net::Init turns it on unless a later layer computes in
+   * place on one of those blobs: that would overwrite data which the other
+   * side of the alias still reads in Backward.
+   */
+  virtual inline void SetShareViews(const bool share_views) {}
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
@@ -316,6 +348,24 @@ class Layer {
     param_propagate_down_[param_id] = value;
   }
 
+  /**
+   * @brief Returns the sorted rows (indices along axis 0) of the param blob
+   *        at index param_id whose diff may be nonzero, or NULL if the whole
+   *        diff has to be treated as dense.
+   *
+   * Layers producing row-sparse parameter gradients (e.g. EmbedLayer) can
+   * override this so that the Net and the solver only touch those rows.
+   * The rest of the diff is guaranteed to be zero.
+   */
+  virtual const vector<int>* sparse_param_rows(const int param_id) const {
+    return NULL;
+  }
+  /**
+   * @brief Notifies the layer that the diff of the param blob at index
+   *        param_id has been zeroed, so it can restart tracking its rows.
+   */
+  virtual void ClearSparseParamRows(const int param_id) {}
+
   inline Phase phase() { return phase_; }
 
 
@@ -506,12 +556,13 @@ inline void Layer<Dtype>::Backward(const vector<Blob<Dtype>*>& top,
 
 // Serialize LayerParameter to protocol buffer
 template <typename Dtype>
-void Layer<Dtype>::ToProto(LayerParameter* param, bool write_diff) {
+void Layer<Dtype>::ToProto(LayerParameter* param, bool write_diff,
+    const Precision precision) {
   param->Clear();
   param->CopyFrom(layer_param_);
   param->clear_blobs();
   for (int i = 0; i < blobs_.size(); ++i) {
-    blobs_[i]->ToProto(param->add_blobs(), write_diff);
+    blobs_[i]->ToProto(param->add_blobs(), write_diff, precision);
   }
 }
 
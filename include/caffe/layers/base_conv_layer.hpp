@@ -7,6 +7,8 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/int8_gemm.hpp"
+#include "caffe/util/sparse_gemm.hpp"
 
 namespace caffe {
 
@@ -23,6 +25,9 @@ class BaseConvolutionLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+  /// Quantizes the weights of an int8 forward, or builds the CSR of a
+  /// sparse one.
+  virtual void PrepareParams(const Layer<Dtype>* source);
 
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
@@ -35,6 +40,8 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
+  /// The int8 counterpart of forward_cpu_gemm and forward_cpu_bias.
+  void forward_cpu_int8(const Dtype* input, Dtype* output);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
@@ -92,6 +99,12 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// Whether the TEST phase CPU forward runs in int8 (quantization_param).
+  bool use_int8_;
+  QuantizedGemm<Dtype> int8_gemm_;
+  /// Whether the TEST phase CPU forward may use sparse weights (sparse_param).
+  bool use_sparse_;
+  SparseGemm<Dtype> sparse_gemm_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -30,6 +30,13 @@ class ConvolutionDepthwiseLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  /// Forward_cpu and Backward_cpu for NHWC blobs, along the channels.
+  void Forward_cpu_nhwc(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  void Backward_cpu_nhwc(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  /// Fills tap_weight_ with the weights as kernel_h x kernel_w x channels.
+  void TapWeights();
   unsigned int kernel_h_ = 1;//initialization par caffe protofile
   unsigned int kernel_w_ = 1;
   unsigned int stride_h_ = 1;
@@ -42,6 +49,7 @@ class ConvolutionDepthwiseLayer : public Layer<Dtype> {
   Blob<Dtype> weight_multiplier_;
   Blob<Dtype> bias_buffer_;
   Blob<Dtype> bias_multiplier_;
+  Blob<Dtype> tap_weight_;
 };
 
 }  // namespace caffe
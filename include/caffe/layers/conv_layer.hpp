@@ -77,6 +77,10 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual inline bool reverse_dimensions() { return false; }
   virtual void compute_output_shape();
+  /// The 1x1 convolution of NHWC blobs, as a GEMM over all their pixels.
+  void Forward_cpu_nhwc(const Blob<Dtype>* bottom, Blob<Dtype>* top);
+  void Backward_cpu_nhwc(const Blob<Dtype>* top, const bool propagate_down,
+      Blob<Dtype>* bottom);
 };
 
 }  // namespace caffe
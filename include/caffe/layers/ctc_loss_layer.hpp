@@ -45,6 +45,10 @@ class CtcLossLayer : public LossLayer<Dtype> {
   int total_label_length_;
   int alphabet_size_;
   int blank_label_;
+  int num_threads_;
+  /// per-sequence costs and warp-ctc scratch, reused across iterations
+  vector<Dtype> costs_;
+  vector<char> workspace_;
 };
 }  // namespace caffe
 #endif  // CAFFE_CTC_LOSS_LAYER_HPP_
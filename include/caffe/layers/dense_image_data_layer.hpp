@@ -12,6 +12,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/async_image_reader.hpp"
 
 
 namespace caffe {
@@ -51,6 +52,7 @@ class DenseImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
   std::mt19937 rg_;
   std::uniform_int_distribution<int> rd_;
   int one_hot_nclasses_;
+  shared_ptr<AsyncImageReader> reader_;
 };
 
 
@@ -1,6 +1,7 @@
 #ifndef CAFFE_EMBED_LAYER_HPP_
 #define CAFFE_EMBED_LAYER_HPP_
 
+#include <utility>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -20,7 +21,7 @@ template <typename Dtype>
 class EmbedLayer : public Layer<Dtype> {
  public:
   explicit EmbedLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), sparse_rows_valid_(false) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -30,6 +31,10 @@ class EmbedLayer : public Layer<Dtype> {
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
+  /// @brief With sparse_gradient, the rows of the weights hit by Backward_cpu.
+  virtual const vector<int>* sparse_param_rows(const int param_id) const;
+  virtual void ClearSparseParamRows(const int param_id);
+
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -45,6 +50,14 @@ class EmbedLayer : public Layer<Dtype> {
   int N_;
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
+
+  bool sparse_gradient_;
+  /// Sorted, unique weight rows accumulated into since the weight diff was
+  /// last cleared; only valid once the rest of the diff is known to be zero.
+  vector<int> sparse_rows_;
+  bool sparse_rows_valid_;
+  /// (index, position) of each input, sorted to accumulate duplicates at once.
+  vector<std::pair<int, int> > sorted_indices_;
 };
 
 }  // namespace caffe
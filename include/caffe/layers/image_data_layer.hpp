@@ -1,6 +1,9 @@
 #ifndef CAFFE_IMAGE_DATA_LAYER_HPP_
 #define CAFFE_IMAGE_DATA_LAYER_HPP_
 
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
 #include <string>
 #include <utility>
 #include <vector>
@@ -11,6 +14,8 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/async_image_reader.hpp"
+#include "caffe/util/sample_cache.hpp"
 
 namespace caffe {
 
@@ -43,6 +48,9 @@ class ImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
   const std::string* source_;
   std::ifstream infile_;
   std::mutex batch_mutex_;
+  // Decoded images by path, with cache_mb > 0; shared, never modified.
+  shared_ptr<SampleCache<cv::Mat> > cache_;
+  shared_ptr<AsyncImageReader> reader_;
 };
 
 
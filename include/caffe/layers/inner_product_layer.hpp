@@ -6,6 +6,8 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/int8_gemm.hpp"
+#include "caffe/util/sparse_gemm.hpp"
 
 namespace caffe {
 
@@ -24,10 +26,18 @@ class InnerProductLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+  /// Quantizes the weights of an int8 forward, or builds the CSR of a
+  /// sparse one.
+  virtual void PrepareParams(const Layer<Dtype>* source);
 
   virtual inline const char* type() const { return "InnerProduct"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  /// The CPU forward reads 16 bit weights as they are, unless in int8 or
+  /// sparse.
+  virtual inline bool AllowHalfStorage(const int param_id) const {
+    return param_id == 0 && !use_int8_ && !use_sparse_;
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -45,6 +55,12 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+  /// Whether the TEST phase CPU forward runs in int8 (quantization_param).
+  bool use_int8_;
+  QuantizedGemm<Dtype> int8_gemm_;
+  /// Whether the TEST phase CPU forward may use sparse weights (sparse_param).
+  bool use_sparse_;
+  SparseGemm<Dtype> sparse_gemm_;
 };
 
 }  // namespace caffe
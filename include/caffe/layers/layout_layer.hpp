@@ -0,0 +1,48 @@
+#ifndef CAFFE_LAYOUT_LAYER_HPP_
+#define CAFFE_LAYOUT_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Converts a 4-D blob between the NCHW and NHWC layouts
+ *        (see Blob::layout()); the shape is left as it is.
+ *
+ * The top takes layout_param.layout, and the bottom must be in the other
+ * layout. Net::Init inserts these layers between the layers that compute in
+ * NHWC and those that need NCHW when NetParameter.layout is NHWC.
+ */
+template <typename Dtype>
+class LayoutLayer : public Layer<Dtype> {
+ public:
+  explicit LayoutLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "Layout"; }
+  virtual inline int ExactNumBottomBlobs() const { return 1; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Moves x in layout from into the other layout.
+  void Convert(const Layout from, const Dtype* x, Dtype* y) const;
+
+  int num_;
+  int channels_;
+  int spatial_dim_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_LAYOUT_LAYER_HPP_
@@ -19,12 +19,16 @@ template <typename Dtype>
 class SliceLayer : public Layer<Dtype> {
  public:
   explicit SliceLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), share_views_(false) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
+  virtual inline void SetShareViews(const bool share_views) {
+    share_views_ = share_views;
+  }
+
   virtual inline const char* type() const { return "Slice"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
@@ -42,6 +46,9 @@ class SliceLayer : public Layer<Dtype> {
   int count_;
   int num_slices_;
   int slice_size_;
+  bool share_views_;
+  /// Contiguous tops are views of the bottom.
+  bool use_views_;
   int slice_axis_;
   vector<int> slice_point_;
 };
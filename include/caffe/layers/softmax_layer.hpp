@@ -45,7 +45,8 @@ class SoftmaxLayer : public Layer<Dtype> {
   Blob<Dtype> sum_multiplier_;
   /// scale is an intermediate Blob to hold temporary results.
   Blob<Dtype> scale_;
-  /// copy of input in order to cool it down   for calibration
+  /// copy of input in order to cool it down for calibration (GPU only; the
+  /// CPU kernel folds the temperature in)
   Blob<Dtype> cooled_bottom_;
 
 };
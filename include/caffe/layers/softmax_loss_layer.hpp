@@ -116,6 +116,11 @@ class SoftmaxWithLossLayer : public LossLayer<Dtype> {
   LossParameter_NormalizationMode normalization_;
 
   int softmax_axis_, outer_num_, inner_num_;
+  /// 1 / temperature of the softmax, applied by the fused CPU forward.
+  Dtype softmax_scale_;
+  /// Per-position log normalizers from the fused CPU forward, from which the
+  /// loss is read off without taking the log of the probabilities.
+  Blob<Dtype> log_norm_;
 };
 
 }  // namespace caffe
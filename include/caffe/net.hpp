@@ -27,6 +27,17 @@ class Net {
   explicit Net(const string& param_file, Phase phase,
       const int level = 0, const vector<string>* stages = NULL,
       const Net* root_net = NULL);
+  /**
+   * @brief Builds a net whose layers reuse the parameter blobs of the
+   *        same-named layers of weights_net instead of allocating and
+   *        initializing their own.
+   *
+   * Only activations and layer-internal buffers are allocated, which makes
+   * this the cheap way to get an extra execution context for a trained net
+   * (see InferenceContext). The weights must not be modified while any of
+   * the nets sharing them is running.
+   */
+  Net(const NetParameter& param, const Net& weights_net);
   virtual ~Net() {}
 
   /// @brief Initialize a network with a NetParameter.
@@ -115,10 +126,30 @@ class Net {
   void CopyTrainedLayersFrom(const string& trained_filename);
   void CopyTrainedLayersFromBinaryProto(const string& trained_filename);
   void CopyTrainedLayersFromHDF5(const string& trained_filename);
-  /// @brief Writes the net to a proto.
-  void ToProto(NetParameter* param, bool write_diff = false) const;
+  /**
+   * @brief In the TEST phase, moves the parameters whose ParamSpec asks for
+   *        FP16 or BF16 storage_precision to 16 bit storage (see
+   *        Blob::CompressData). Called once trained layers are copied.
+   *
+   * Parameters shared between layers, and those their layer cannot compute
+   * from in 16 bits (Layer::AllowHalfStorage), stay in Dtype.
+   */
+  void CompressParams();
+  /**
+   * @brief Has every layer rebuild what it derives from its parameters (see
+   *        Layer::PrepareParams). Called once the parameters are initialized,
+   *        loaded or shared.
+   *
+   * @param source a prepared net sharing the parameters of this one: its
+   *        same-named layers may share what they derived.
+   */
+  void PrepareParams(const Net* source = NULL);
+  /// @brief Writes the net to a proto, with weights in the given precision.
+  void ToProto(NetParameter* param, bool write_diff = false,
+      const Precision precision = FP32) const;
   /// @brief Writes the net to an HDF5 file.
-  void ToHDF5(const string& filename, bool write_diff = false) const;
+  void ToHDF5(const string& filename, bool write_diff = false,
+      const Precision precision = FP32) const;
 
   /// @brief returns the network name.
   inline const string& name() const { return name_; }
@@ -190,6 +221,12 @@ class Net {
   inline const vector<bool>& has_params_decay() const {
     return has_params_decay_;
   }
+  /**
+   * @brief returns the rows of learnable_params()[param_id] whose diff may be
+   *        nonzero when its gradient is row-sparse (CPU mode only), or NULL
+   *        when the diff is dense.
+   */
+  const vector<int>* learnable_param_sparse_rows(const int param_id) const;
   const map<string, int>& param_names_index() const {
     return param_names_index_;
   }
@@ -243,6 +280,12 @@ class Net {
   /// @brief Append a new parameter blob to the net.
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
+  /// @brief Whether a later layer computes in place on a bottom or top of
+  ///        layer_id (see Layer::SetShareViews).
+  static bool InPlaceAfter(const NetParameter& param, const int layer_id);
+
+  /// @brief Helper for attaching the parameters of weights_net_ to a layer.
+  void ShareLayerParams(const int layer_id, const bool before_setup);
 
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
@@ -298,6 +341,9 @@ class Net {
    * and learnable_params_[learnable_param_ids_[i]] gives its owner.
    */
   vector<int> learnable_param_ids_;
+  /// (layer id, param id) of the owner of each of learnable_params_, or
+  /// (-1, -1) if the param is shared and its gradient must stay dense.
+  vector<pair<int, int> > learnable_param_layer_indices_;
   /// the learning rate multipliers for learnable_params_
   vector<float> params_lr_;
   vector<bool> has_params_lr_;
@@ -310,6 +356,8 @@ class Net {
   bool debug_info_;
   /// The root net that actually holds the shared layers in data parallelism
   const Net* const root_net_;
+  /// The net whose parameter blobs the layers of this net reuse, if any
+  const Net* const weights_net_;
   DISABLE_COPY_AND_ASSIGN(Net);
 };
 
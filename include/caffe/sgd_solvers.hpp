@@ -32,6 +32,18 @@ class SGDSolver : public Solver<Dtype> {
   virtual void Regularize(int param_id);
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
   virtual void ClipGradients();
+  /**
+   * @brief Whether the CPU updates of this solver only need the rows of a
+   *        row-sparse gradient (see Layer::sparse_param_rows). Rows without
+   *        gradient then keep their history untouched ("lazy" update).
+   */
+  virtual inline bool SupportsSparseRows() const { return true; }
+  /**
+   * @brief Returns the [offset, offset + count) spans of the learnable param
+   *        param_id that a CPU update has to visit: the whole blob, or the
+   *        rows reported by a layer with a row-sparse gradient.
+   */
+  const vector<pair<int, int> >& UpdateSpans(int param_id);
   virtual void SnapshotSolverState(const string& model_filename);
   virtual void SnapshotSolverStateToBinaryProto(const string& model_filename);
   virtual void SnapshotSolverStateToHDF5(const string& model_filename);
@@ -42,6 +54,8 @@ class SGDSolver : public Solver<Dtype> {
   // temp maintains other information that might be needed in computation
   //   of gradients/updates and is not needed in snapshots
   vector<shared_ptr<Blob<Dtype> > > history_, update_, temp_;
+  // scratch for UpdateSpans
+  vector<pair<int, int> > spans_;
 
   // loss history for 'plateau' LR policy (should be stored in snapshots)
   Dtype minimum_loss_;
@@ -65,6 +79,7 @@ class NesterovSolver : public SGDSolver<Dtype> {
   virtual inline const char* type() const { return "Nesterov"; }
 
  protected:
+  virtual inline bool SupportsSparseRows() const { return false; }
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
 
   DISABLE_COPY_AND_ASSIGN(NesterovSolver);
@@ -100,6 +115,7 @@ class RMSPropSolver : public SGDSolver<Dtype> {
   virtual inline const char* type() const { return "RMSProp"; }
 
  protected:
+  virtual inline bool SupportsSparseRows() const { return false; }
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
@@ -123,6 +139,7 @@ class AdaDeltaSolver : public SGDSolver<Dtype> {
   virtual inline const char* type() const { return "AdaDelta"; }
 
  protected:
+  virtual inline bool SupportsSparseRows() const { return false; }
   void AdaDeltaPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
 
@@ -124,7 +124,8 @@ class SparseBlob : public Blob<Dtype> {
 
   virtual void Update();
   virtual void FromProto(const BlobProto& proto, bool reshape = true);
-  virtual void ToProto(BlobProto* proto, bool write_diff = false) const;
+  virtual void ToProto(BlobProto* proto, bool write_diff = false,
+      const Precision precision = FP32) const;
 
  protected:
   shared_ptr<SyncedMemory> indices_;
@@ -54,6 +54,13 @@ class SyncedMemory {
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
         own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
         gpu_device_(-1) {}
+  /**
+   * @brief A view of size bytes of parent from byte offset on: reads and
+   *        writes, on the CPU and the GPU alike, go to the parent's memory,
+   *        which the view keeps alive. Setting the data detaches it.
+   */
+  SyncedMemory(const shared_ptr<SyncedMemory>& parent, size_t offset,
+      size_t size);
   ~SyncedMemory();
   const void* cpu_data();
   // if size if -1 the size is not changed
@@ -64,8 +71,12 @@ class SyncedMemory {
   void* mutable_cpu_data();
   void* mutable_gpu_data();
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
-  SyncedHead head() { return head_; }
+  SyncedHead head() { return parent_ ? parent_->head() : head_; }
   size_t size() { return size_; }
+  /// The memory this is a view of, or NULL.
+  inline const shared_ptr<SyncedMemory>& parent() const { return parent_; }
+  /// The byte offset of a view into its parent.
+  inline size_t offset() const { return offset_; }
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -75,6 +86,7 @@ class SyncedMemory {
   void to_cpu();
   void to_gpu();
   void clear_data();
+  void detach();
   void* cpu_ptr_;
   void* gpu_ptr_;
   int size_ = -1;
@@ -83,6 +95,8 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int gpu_device_;
+  shared_ptr<SyncedMemory> parent_;
+  size_t offset_ = 0;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
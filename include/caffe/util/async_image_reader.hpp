@@ -0,0 +1,69 @@
+#ifndef CAFFE_UTIL_ASYNC_IMAGE_READER_HPP_
+#define CAFFE_UTIL_ASYNC_IMAGE_READER_HPP_
+
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
+#include <boost/function.hpp>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/ordered_pipeline.hpp"
+
+namespace caffe {
+
+#ifdef USE_OPENCV
+/**
+ * @brief Reads and decodes the images of a batch on a pool of threads, for the
+ *        image data layers, which otherwise wait on one file at a time on
+ *        their prefetch thread.
+ *
+ * The reader owns its threads: they start with it and read every batch
+ * passed to Read, which must not be called concurrently. Each thread asks
+ * the kernel to read ahead the file a few items past its own, so that on
+ * network filesystems the reads of the batch are in flight together while
+ * earlier images are decoded. Images come back in request order.
+ */
+class AsyncImageReader {
+ public:
+  /// @brief The arguments of ReadImageToCVMat for one image.
+  struct Request {
+    Request() : height(0), width(0), is_color(true),
+        nearest_neighbour_interp(false) {}
+    string filename;
+    int height;
+    int width;
+    bool is_color;
+    bool nearest_neighbour_interp;
+  };
+
+  /// @param num_threads reader threads; 0 for one per core
+  explicit AsyncImageReader(int num_threads);
+
+  inline int num_threads() const { return pipeline_.num_workers(); }
+
+  /**
+   * @brief Reads the images of requests, and calls consume(i, image) on the
+   *        calling thread in increasing i. image has no data if it could not
+   *        be read.
+   */
+  void Read(const vector<Request>& requests,
+      const boost::function<void(int, const cv::Mat&)>& consume);
+  /// @brief Reads the images of requests into images.
+  void Read(const vector<Request>& requests, vector<cv::Mat>* images);
+
+  /// @brief Asks the kernel to start reading filename in the background.
+  static void ReadAhead(const string& filename);
+
+ protected:
+  OrderedPipeline pipeline_;
+
+  DISABLE_COPY_AND_ASSIGN(AsyncImageReader);
+};
+#endif  // USE_OPENCV
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ASYNC_IMAGE_READER_HPP_
@@ -8,17 +8,22 @@
 
 namespace caffe { namespace db {
 
-enum Mode { READ, WRITE, NEW };
+// READ_RANDOM is READ for records that are read in random order.
+enum Mode { READ, WRITE, NEW, READ_RANDOM };
 
 class Cursor {
  public:
   Cursor() { }
   virtual ~Cursor() { }
   virtual void SeekToFirst() = 0;
+  // Moves to the first key not less than key.
+  virtual void Seek(const string& key) = 0;
   virtual void Next() = 0;
   virtual string key() = 0;
   virtual string value() = 0;
   virtual bool valid() = 0;
+  // Hints that the current value will be read soon, e.g. by another cursor.
+  virtual void WillNeed() { }
   
   DISABLE_COPY_AND_ASSIGN(Cursor);
 };
@@ -0,0 +1,47 @@
+#ifndef CAFFE_UTIL_ELTWISE_HPP_
+#define CAFFE_UTIL_ELTWISE_HPP_
+
+namespace caffe {
+
+// Single pass N-ary elementwise operations over the count values of the n
+// arrays x[0], ..., x[n - 1]. Each works through cache-sized blocks, reading
+// every input once and writing y once, and the blocks are spread over
+// Caffe::thread_pool(). y may alias any of the inputs.
+
+// y = sum_j coeff[j] * x[j]; a NULL coeff means all ones.
+template <typename Dtype>
+void eltwise_sum_cpu(const int count, const int n, const Dtype* const* x,
+    const Dtype* coeff, Dtype* y);
+
+// y = prod_j x[j].
+template <typename Dtype>
+void eltwise_prod_cpu(const int count, const int n, const Dtype* const* x,
+    Dtype* y);
+
+// y = max_j x[j], and mask, if not NULL, the index j of the maximum. As in
+// EltwiseLayer, a tie between the first two inputs goes to the second and
+// later ties to the earlier input.
+template <typename Dtype>
+void eltwise_max_cpu(const int count, const int n, const Dtype* const* x,
+    Dtype* y, int* mask);
+
+// Broadcasting over the middle axis of (outer_num, dim, inner_num) arrays:
+//   y[i, d, k] = scale[d] * x[i, d, k] + bias[d] + addend[i, d, k],
+// where a NULL scale, bias or addend drops its term. y may alias x or addend.
+// This is Scale, Bias and Axpy forward without any multiplier blob.
+template <typename Dtype>
+void broadcast_axpby_cpu(const int outer_num, const int dim,
+    const int inner_num, const Dtype* scale, const Dtype* x,
+    const Dtype* bias, const Dtype* addend, Dtype* y);
+
+// The matching reduction, for their parameter gradients:
+//   y[d] = beta * y[d] + sum_{i, k} x[i, d, k] * w[i, d, k],
+// where a NULL w counts as all ones.
+template <typename Dtype>
+void broadcast_reduce_cpu(const int outer_num, const int dim,
+    const int inner_num, const Dtype* x, const Dtype* w, const Dtype beta,
+    Dtype* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ELTWISE_HPP_
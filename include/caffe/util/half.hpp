@@ -0,0 +1,37 @@
+#ifndef CAFFE_UTIL_HALF_H_
+#define CAFFE_UTIL_HALF_H_
+
+#include <stdint.h>
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Conversions between Dtype and the 16 bit storage formats of Precision:
+// IEEE half (FP16) and bfloat16 (BF16), rounding to the nearest even value.
+// Values past the FP16 range become infinities; NaN stays NaN. double goes
+// through float on the way down. FP16 uses the F16C instructions when the
+// CPU has them, and large arrays are split over Caffe::thread_pool().
+template <typename Dtype>
+void caffe_cpu_to_half(const int n, const Dtype* x, uint16_t* y,
+    const Precision precision);
+
+template <typename Dtype>
+void caffe_cpu_from_half(const int n, const uint16_t* x, Dtype* y,
+    const Precision precision);
+
+// C = A * op(B) for the M x K matrix A and 16 bit B, which is N x K when
+// TransB is CblasTrans and K x N otherwise. B is converted to Dtype a panel
+// of columns of C at a time, so that the full Dtype weights never exist.
+template <typename Dtype>
+void caffe_cpu_gemm_half(const CBLAS_TRANSPOSE TransB, const int M,
+    const int N, const int K, const Dtype* A, const uint16_t* B,
+    const Precision precision, Dtype* C);
+
+// The instruction set used for FP16 conversions, e.g. "f16c".
+const char* half_isa();
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HALF_H_
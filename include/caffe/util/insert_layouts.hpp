@@ -0,0 +1,18 @@
+#ifndef CAFFE_UTIL_INSERT_LAYOUTS_HPP_
+#define CAFFE_UTIL_INSERT_LAYOUTS_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy a NetParameter whose layout is NHWC, renaming the blobs that layers
+// compute in NHWC, and adding LayoutLayers wherever a layer needs a blob in
+// the other layout. 1x1 Convolution and ConvolutionDepthwise work in NHWC,
+// element-wise layers in either layout, and any other layer in NCHW. The
+// outputs of the net are left in NCHW under their own names.
+void InsertLayoutTransforms(const NetParameter& param,
+    NetParameter* param_layout);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_INSERT_LAYOUTS_HPP_
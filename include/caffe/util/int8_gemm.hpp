@@ -0,0 +1,88 @@
+#ifndef CAFFE_UTIL_INT8_GEMM_H_
+#define CAFFE_UTIL_INT8_GEMM_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief The int8 inference GEMM of a Convolution or InnerProduct layer:
+ *        y = W x + bias with W quantized per row (output channel) to
+ *        symmetric s8 and x quantized to u8.
+ *
+ * The input range comes from calibration (see tools/calibrate_int8.cpp).
+ * Inputs that are never negative, e.g. after a ReLU, use the whole u8 range;
+ * otherwise they are stored with a zero point of 128, which is corrected
+ * with the per-row weight sums. Products accumulate exactly in int32 using
+ * the AVX-512 VNNI u8s8 dot product instruction when the CPU has it, AVX2
+ * multiply-adds of the values widened to 16 bits otherwise, and a plain
+ * loop on other CPUs.
+ *
+ * The quantized weights are immutable once built, and may be shared by the
+ * QuantizedGemm of other layers with the same parameters.
+ */
+template <typename Dtype>
+class QuantizedGemm {
+ public:
+  QuantizedGemm();
+
+  /**
+   * @brief Reads a layer's QuantizationParameter, and returns whether its
+   *        forward should run in int8: only calibrated, enabled layers in
+   *        the TEST phase do.
+   */
+  bool SetUp(const LayerParameter& param);
+  /// Sets the u8 quantization of x from the calibrated range of the input.
+  void SetInputRange(const float input_min, const float input_max);
+  /**
+   * @brief Quantizes a rows x cols weight matrix, or cols x rows when
+   *        transposed, one s8 scale per row.
+   */
+  void QuantizeWeights(const int rows, const int cols, const Dtype* weights,
+      const bool transposed);
+  /// Uses the quantized weights of other instead of quantizing them again.
+  inline void ShareWeights(const QuantizedGemm& other) {
+    weights_ = other.weights_;
+  }
+  inline bool has_weights() const { return weights_ != NULL; }
+
+  /**
+   * @brief Computes rows [row_begin, row_begin + rows) of W x + bias for the
+   *        cols x n matrix x (n x cols when x_transposed), writing element
+   *        (m, j) to y[m * y_row_stride + j * y_col_stride]. bias, if not
+   *        NULL, points at the bias of row row_begin.
+   */
+  void Forward(const int row_begin, const int rows, const int n,
+      const Dtype* x, const bool x_transposed, const Dtype* bias, Dtype* y,
+      const int y_row_stride, const int y_col_stride);
+
+ private:
+  struct Weights {
+    int rows;
+    int cols;
+    /// cols rounded up to the four values one dot product instruction takes.
+    int padded_cols;
+    std::vector<int8_t> values;
+    std::vector<float> scale;
+    std::vector<int32_t> row_sum;
+  };
+
+  void PackInput(const int n, const Dtype* x, const bool x_transposed);
+
+  shared_ptr<const Weights> weights_;
+  float input_scale_;
+  int zero_point_;
+  std::vector<uint8_t> packed_x_;
+  std::vector<int32_t> acc_;
+};
+
+/// The instruction set used by QuantizedGemm, e.g. "avx512vnni".
+const char* int8_gemm_isa();
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_INT8_GEMM_H_
@@ -194,6 +194,12 @@ inline bool ReadImageToDatum(const string& filename, const int label,
 bool DecodeDatumNative(Datum* datum);
 bool DecodeDatum(Datum* datum, bool is_color);
 
+// Compresses the raw bytes of datum in place; false if datum is encoded,
+// already compressed or holds float_data, or without snappy.
+bool CompressDatum(Datum* datum);
+// Restores the raw bytes of a compressed datum; false if it was not.
+bool DecompressDatum(Datum* datum);
+
 
 void GetImageSize(const string& filename, int* height, int* width);
 
@@ -85,6 +85,10 @@ Dtype caffe_nextafter(const Dtype b);
 template <typename Dtype>
 void caffe_rng_uniform(const int n, const Dtype a, const Dtype b, Dtype* r);
 
+// Sets the number of threads of the BLAS library, when it can be told
+// (MKL, OpenBLAS); a no-op otherwise. See Caffe::set_cpu_threads.
+void caffe_set_blas_threads(const int num_threads);
+
 template <typename Dtype>
 void caffe_rng_gaussian(const int n, const Dtype mu, const Dtype sigma,
                         Dtype* r);
@@ -104,6 +108,13 @@ void caffe_log(const int n, const Dtype* a, Dtype* y);
 template <typename Dtype>
 void caffe_abs(const int n, const Dtype* a, Dtype* y);
 
+template <typename Dtype>
+void caffe_tanh(const int n, const Dtype* a, Dtype* y);
+
+// y[i] = 1 / (1 + exp(-a[i]))
+template <typename Dtype>
+void caffe_sigmoid(const int n, const Dtype* a, Dtype* y);
+
 template <typename Dtype>
 Dtype caffe_cpu_dot(const int n, const Dtype* x, const Dtype* y);
 
@@ -152,6 +163,20 @@ DEFINE_CAFFE_CPU_UNARY_FUNC(fabs, y[i] = std::fabs(x[i]));
 template <typename Dtype>
 void caffe_cpu_scale(const int n, const Dtype alpha, const Dtype *x, Dtype* y);
 
+// Transposes each of the batch rows x cols matrices of x into the cols x rows
+// matrices of y, by cache sized tiles spread over Caffe::thread_pool().
+template <typename Dtype>
+void caffe_cpu_transpose(const int batch, const int rows, const int cols,
+    const Dtype* x, Dtype* y);
+
+// Permutes the axes of x into y: y is the num_axes dimensional array of
+// shape y_shape, and its element (i_0, ..., i_n) is x[sum_j i_j x_strides[j]].
+// Batched 2D transposes go to caffe_cpu_transpose; other orders are copied a
+// row of y at a time, spread over Caffe::thread_pool().
+template <typename Dtype>
+void caffe_cpu_permute(const int num_axes, const int* y_shape,
+    const int* x_strides, const Dtype* x, Dtype* y);
+
 #ifndef CPU_ONLY  // GPU
 
 // Decaf gpu gemm provides an interface that is almost the same as the cpu
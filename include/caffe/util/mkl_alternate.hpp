@@ -17,6 +17,8 @@ extern "C" {
 
 #include <math.h>
 
+#include "caffe/util/simd_math.hpp"
+
 // Functions that caffe uses but are not present if MKL is not linked.
 
 // A simple way to define the vsl unary functions. The operation should
@@ -39,29 +41,44 @@ extern "C" {
 
 DEFINE_VSL_UNARY_FUNC(Sqr, y[i] = a[i] * a[i])
 DEFINE_VSL_UNARY_FUNC(Sqrt, y[i] = sqrt(a[i]))
-DEFINE_VSL_UNARY_FUNC(Exp, y[i] = exp(a[i]))
-DEFINE_VSL_UNARY_FUNC(Ln, y[i] = log(a[i]))
 DEFINE_VSL_UNARY_FUNC(Abs, y[i] = fabs(a[i]))
 
-// A simple way to define the vsl unary functions with singular parameter b.
-// The operation should be in the form e.g. y[i] = pow(a[i], b)
-#define DEFINE_VSL_UNARY_FUNC_WITH_PARAM(name, operation) \
+// The same, with the single precision version handed to a vectorized
+// implementation (see simd_math.hpp).
+#define DEFINE_VSL_UNARY_FUNC_SIMD(name, operation, simd_function) \
   template<typename Dtype> \
-  void v##name(const int n, const Dtype* __restrict__ a, const Dtype b, \
+  void v##name(const int n, const Dtype* __restrict__ a, \
              Dtype* __restrict__ y) { \
     CHECK_GT(n, 0); CHECK(a); CHECK(y); \
     for (int i = 0; i < n; ++i) { operation; } \
   } \
   inline void vs##name( \
-    const int n, const float* a, const float b, float* y) { \
-    v##name<float>(n, a, b, y); \
+    const int n, const float* a, float* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    caffe::simd_function(n, a, y); \
   } \
   inline void vd##name( \
-      const int n, const double* a, const float b, double* y) { \
-    v##name<double>(n, a, b, y); \
+      const int n, const double* a, double* y) { \
+    v##name<double>(n, a, y); \
   }
 
-DEFINE_VSL_UNARY_FUNC_WITH_PARAM(Powx, y[i] = pow(a[i], b));
+DEFINE_VSL_UNARY_FUNC_SIMD(Exp, y[i] = exp(a[i]), simd_exp)
+DEFINE_VSL_UNARY_FUNC_SIMD(Ln, y[i] = log(a[i]), simd_log)
+
+// y[i] = pow(a[i], b), vectorized in single precision as well.
+template<typename Dtype>
+void vPowx(const int n, const Dtype* __restrict__ a, const Dtype b,
+           Dtype* __restrict__ y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  for (int i = 0; i < n; ++i) { y[i] = pow(a[i], b); }
+}
+inline void vsPowx(const int n, const float* a, const float b, float* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  caffe::simd_powx(n, a, b, y);
+}
+inline void vdPowx(const int n, const double* a, const float b, double* y) {
+  vPowx<double>(n, a, b, y);
+}
 
 // A simple way to define the vsl binary functions. The operation should
 // be in the form e.g. y[i] = a[i] + b[i]
@@ -0,0 +1,60 @@
+#ifndef CAFFE_UTIL_ORDERED_PIPELINE_HPP_
+#define CAFFE_UTIL_ORDERED_PIPELINE_HPP_
+
+#include <boost/function.hpp>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Runs an expensive per-item stage on worker threads and a cheap,
+ *        ordered stage on the calling thread: the shape of the dataset tools,
+ *        which decode images in parallel but must write them in list order.
+ *
+ * Items are handed out in increasing order, at most window() of them ahead
+ * of the item being consumed. Each item gets a slot in [0, window()) that the
+ * caller uses to index storage of its own for the item's results; a slot is
+ * reused only once its item has been consumed.
+ *
+ * The workers start with the pipeline and serve every Run until it is
+ * destroyed, so a pipeline run once per batch costs no thread creation.
+ * Runs of one pipeline must not overlap.
+ */
+class OrderedPipeline {
+ public:
+  /**
+   * @param num_workers worker threads; 0 for one per core
+   * @param window items in flight; 0 for a few per worker
+   */
+  OrderedPipeline(int num_workers, int window);
+  ~OrderedPipeline();
+
+  inline int num_workers() const { return num_workers_; }
+  inline int window() const { return window_; }
+
+  /**
+   * @brief Calls process(i, slot) for every i in [0, n) on the workers, and
+   *        consume(i, slot) on the calling thread in increasing i once
+   *        process(i, slot) has returned. The first exception thrown by
+   *        either stage stops the pipeline and is rethrown here.
+   */
+  void Run(int n, const boost::function<void(int, int)>& process,
+      const boost::function<void(int, int)>& consume);
+
+ protected:
+  // boost/thread.hpp stays out of headers, see blocking_queue.hpp.
+  class sync;
+
+  void WorkerEntry();
+
+  int num_workers_;
+  int window_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(OrderedPipeline);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ORDERED_PIPELINE_HPP_
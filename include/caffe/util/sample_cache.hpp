@@ -0,0 +1,52 @@
+#ifndef CAFFE_UTIL_SAMPLE_CACHE_HPP_
+#define CAFFE_UTIL_SAMPLE_CACHE_HPP_
+
+#include <map>
+#include <string>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Keeps decoded samples in memory, keyed by record id, up to a budget
+ *        of bytes, so that the epochs after the first one of a dataset that
+ *        fits in RAM skip reading and decoding it.
+ *
+ * Samples are cached before any random augmentation. Once the budget is
+ * reached, new samples are not cached: on a dataset read in a loop, evicting
+ * old samples for new ones would only replace hits by misses.
+ */
+template <typename T>
+class SampleCache {
+ public:
+  explicit SampleCache(size_t capacity_bytes);
+
+  /// @brief Copies the sample cached for key to value, if any.
+  bool Get(const string& key, T* value);
+  /// @brief Caches value, which holds bytes bytes, unless over the budget.
+  void Put(const string& key, const T& value, size_t bytes);
+
+  size_t size() const;
+  size_t bytes() const;
+  inline size_t capacity_bytes() const { return capacity_bytes_; }
+  /// @brief Describes the content and the hit rate since the last call.
+  string Stats();
+
+ protected:
+  // boost/thread.hpp stays out of headers, see blocking_queue.hpp.
+  class sync;
+
+  const size_t capacity_bytes_;
+  size_t bytes_;
+  std::map<string, T> samples_;
+  int64_t hits_;
+  int64_t lookups_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(SampleCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SAMPLE_CACHE_HPP_
@@ -0,0 +1,29 @@
+#ifndef CAFFE_UTIL_SIMD_MATH_H_
+#define CAFFE_UTIL_SIMD_MATH_H_
+
+namespace caffe {
+
+// Vectorized single precision transcendentals, used in place of the libm
+// loops of mkl_alternate.hpp when MKL is not available. Each call picks the
+// widest instruction set the CPU supports (AVX-512, AVX2+FMA, then SSE2 or
+// NEON) and splits large arrays over Caffe::thread_pool().
+//
+// Accuracy relative to the correctly rounded result, over the whole float
+// range including denormals, infinities and NaN:
+//   simd_exp, simd_log, simd_tanh:  within 2 ulp
+//   simd_sigmoid:                   within 3 ulp
+//   simd_powx:                      within 2 ulp * (1 + |b * log(|a|)|)
+// simd_powx computes b in {0, 1, 2, -1} directly, and follows pow() for
+// negative a (NaN unless b is an integer).
+void simd_exp(const int n, const float* a, float* y);
+void simd_log(const int n, const float* a, float* y);
+void simd_powx(const int n, const float* a, const float b, float* y);
+void simd_tanh(const int n, const float* a, float* y);
+void simd_sigmoid(const int n, const float* a, float* y);
+
+// The instruction set used by the functions above, e.g. "avx2".
+const char* simd_math_isa();
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SIMD_MATH_H_
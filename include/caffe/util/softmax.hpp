@@ -0,0 +1,28 @@
+#ifndef CAFFE_UTIL_SOFTMAX_HPP_
+#define CAFFE_UTIL_SOFTMAX_HPP_
+
+namespace caffe {
+
+// Fused CPU softmax over the middle axis of an (outer_num, channels,
+// inner_num) array: y = softmax(scale * x). Each softmax is computed in
+// cache-sized blocks of inner positions (max, exp and sum, normalize) and
+// the blocks are spread over Caffe::thread_pool(). x and y may alias.
+//
+// log_norm, if not NULL, receives outer_num * inner_num log normalizers,
+// so that
+// log(y[i, c, k]) = scale * x[i, c, k] - log_norm[i * inner_num + k].
+template <typename Dtype>
+void softmax_cpu(const int outer_num, const int channels, const int inner_num,
+    const Dtype scale, const Dtype* x, Dtype* y, Dtype* log_norm = 0);
+
+// The matching gradient: bottom_diff = y * (top_diff - dot(top_diff, y)),
+// with the dot product taken over channels. top_diff and bottom_diff may
+// alias.
+template <typename Dtype>
+void softmax_backward_cpu(const int outer_num, const int channels,
+    const int inner_num, const Dtype* y, const Dtype* top_diff,
+    Dtype* bottom_diff);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SOFTMAX_HPP_
@@ -0,0 +1,76 @@
+#ifndef CAFFE_UTIL_SPARSE_GEMM_H_
+#define CAFFE_UTIL_SPARSE_GEMM_H_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief The pruned weight GEMM of a Convolution or InnerProduct layer:
+ *        y = W x with the nonzeros of W held in CSR and multiplied by
+ *        caffe_cpu_csr_gemm.
+ *
+ * The CSR is built from the zeros of the weights whenever they are loaded
+ * (Layer::PrepareParams); weights with more nonzeros than the layer's
+ * density threshold are left to the dense GEMM, which is faster on them.
+ * A built CSR is immutable, and may be shared by the SparseGemm of other
+ * layers with the same parameters.
+ */
+template <typename Dtype>
+class SparseGemm {
+ public:
+  SparseGemm();
+
+  /**
+   * @brief Reads a layer's SparseParameter, and returns whether its forward
+   *        may run sparse: only enabled layers in the TEST phase do.
+   */
+  bool SetUp(const LayerParameter& param);
+  /**
+   * @brief Converts a rows x cols weight matrix, or cols x rows when
+   *        transposed, to CSR, and returns whether it is sparse enough to
+   *        multiply that way.
+   */
+  bool Build(const int rows, const int cols, const Dtype* weights,
+      const bool transposed);
+  /// Uses the CSR built by other instead of building it again.
+  inline void ShareWeights(const SparseGemm& other) {
+    csr_ = other.csr_;
+  }
+  inline bool has_weights() const { return csr_ != NULL; }
+  /// Whether Build found the weights sparse enough.
+  inline bool sparse() const { return csr_ && csr_->sparse; }
+  /// The fraction of nonzero weights found by Build.
+  inline float density() const { return csr_ ? csr_->density : 1.f; }
+
+  /**
+   * @brief Computes rows [row_begin, row_begin + rows) of W x for the
+   *        cols x n matrix x into the rows x n matrix y, or, when transposed,
+   *        for the n x cols matrix x into the n x rows matrix y.
+   */
+  void Forward(const int row_begin, const int rows, const int n,
+      const Dtype* x, const bool transposed, Dtype* y) const;
+
+ private:
+  struct Csr {
+    int rows;
+    int cols;
+    bool sparse;
+    float density;
+    std::vector<Dtype> values;
+    std::vector<int> indices;
+    std::vector<int> ptr;
+  };
+
+  std::string name_;
+  float density_threshold_;
+  shared_ptr<const Csr> csr_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SPARSE_GEMM_H_
@@ -0,0 +1,91 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+#include <algorithm>
+
+#include "caffe/common.hpp"
+
+/**
+ Forward declare boost::mutex and boost::unique_lock instead of including
+ boost/thread.hpp to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost {
+class mutex;
+template <typename Mutex> class unique_lock;
+}
+
+namespace caffe {
+
+/**
+ * @brief A pool of CPU worker threads running data-parallel loops.
+ *
+ * One pool is shared by the whole process (see Caffe::thread_pool()), so that
+ * several nets running in the same process do not oversubscribe the cores.
+ * Each ParallelFor call splits its range into chunks that idle workers and
+ * the calling thread claim one at a time, so concurrent calls from different
+ * threads share the workers instead of queueing behind each other.
+ *
+ * Loop bodies run on threads with a default Caffe context: they must not rely
+ * on Caffe::mode() or the Caffe RNG, and should not call multithreaded BLAS.
+ * A ParallelFor issued from inside a body runs serially on that thread.
+ */
+class ThreadPool {
+ public:
+  /// @param num_threads total number of threads, the calling one included
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  inline int num_threads() const { return num_threads_; }
+  /// @brief Restarts the workers; must not race with a running ParallelFor.
+  void Resize(int num_threads);
+
+  /**
+   * @brief Calls body(begin, end) on disjoint chunks covering [0, n) and
+   *        returns once all of them are done. Chunks hold at least grain
+   *        items. The first exception thrown by a body is rethrown here.
+   */
+  void ParallelFor(int n, int grain,
+      const boost::function<void(int, int)>& body);
+
+ protected:
+  struct Job;
+  class sync;
+
+  void StartWorkers();
+  void StopWorkers();
+  void WorkerEntry();
+  // Runs chunks of job until none is left unclaimed. Called and returns with
+  // lock held; job must not be accessed once its last chunk is done.
+  void RunChunks(Job* job, boost::unique_lock<boost::mutex>* lock);
+
+  int num_threads_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+/// Values a parallel chunk should process at least: below this, threading a
+/// loop costs more than it saves.
+const int kParallelGrain = 1 << 15;
+
+/**
+ * @brief The grain for a loop whose items each process item_size values, so
+ *        that chunks process about kParallelGrain values.
+ */
+inline int parallel_grain(int item_size) {
+  return std::max(1, kParallelGrain / std::max(item_size, 1));
+}
+
+/**
+ * @brief Runs body(begin, end) over chunks of [0, n) on the process-wide
+ *        Caffe::thread_pool(); see ThreadPool::ParallelFor.
+ */
+inline void parallel_for(int n, const boost::function<void(int, int)>& body,
+    int grain = 1) {
+  Caffe::thread_pool().ParallelFor(n, grain, body);
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
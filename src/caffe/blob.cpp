@@ -1,15 +1,99 @@
+#include <boost/thread/mutex.hpp>
 #include <climits>
 #include <vector>
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
+#include "caffe/util/half.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include <iostream>
 
 namespace caffe {
 
+namespace {
+
+boost::mutex restore_mutex;
+
+// 16 bit storage only applies to the floating point blobs.
+template <typename Dtype>
+void BlobToHalf(const int n, const Dtype* x, uint16_t* y,
+    const Precision precision) {
+  LOG(FATAL) << "16 bit storage needs a float or double blob.";
+}
+
+template <>
+void BlobToHalf<float>(const int n, const float* x, uint16_t* y,
+    const Precision precision) {
+  caffe_cpu_to_half(n, x, y, precision);
+}
+
+template <>
+void BlobToHalf<double>(const int n, const double* x, uint16_t* y,
+    const Precision precision) {
+  caffe_cpu_to_half(n, x, y, precision);
+}
+
+template <typename Dtype>
+void BlobFromHalf(const int n, const uint16_t* x, Dtype* y,
+    const Precision precision) {
+  LOG(FATAL) << "16 bit storage needs a float or double blob.";
+}
+
+template <>
+void BlobFromHalf<float>(const int n, const uint16_t* x, float* y,
+    const Precision precision) {
+  caffe_cpu_from_half(n, x, y, precision);
+}
+
+template <>
+void BlobFromHalf<double>(const int n, const uint16_t* x, double* y,
+    const Precision precision) {
+  caffe_cpu_from_half(n, x, y, precision);
+}
+
+// Converts n 16 bit values into buffer and returns it.
+template <typename Dtype>
+const Dtype* DecodeHalf(const int n, const uint16_t* x,
+    const Precision precision, vector<Dtype>* buffer) {
+  LOG(FATAL) << "16 bit storage needs a float or double blob.";
+  return NULL;
+}
+
+template <>
+const float* DecodeHalf<float>(const int n, const uint16_t* x,
+    const Precision precision, vector<float>* buffer) {
+  buffer->resize(n);
+  caffe_cpu_from_half(n, x, buffer->data(), precision);
+  return buffer->data();
+}
+
+template <>
+const double* DecodeHalf<double>(const int n, const uint16_t* x,
+    const Precision precision, vector<double>* buffer) {
+  buffer->resize(n);
+  caffe_cpu_from_half(n, x, buffer->data(), precision);
+  return buffer->data();
+}
+
+template <typename Dtype>
+void WriteHalf(const int n, const Dtype* x, const Precision precision,
+    string* bytes) {
+  bytes->resize(n * sizeof(uint16_t));
+  BlobToHalf(n, x, reinterpret_cast<uint16_t*>(&(*bytes)[0]), precision);
+}
+
+template <typename Dtype>
+void ReadHalf(const int n, const string& bytes, const Precision precision,
+    Dtype* x) {
+  CHECK_EQ(n * sizeof(uint16_t), bytes.size());
+  BlobFromHalf(n, reinterpret_cast<const uint16_t*>(bytes.data()), x,
+      precision);
+}
+
+}  // namespace
+
 template <typename Dtype>
 void Blob<Dtype>::Reshape(const int num, const int channels, const int height,
     const int width) {
@@ -42,6 +126,7 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
     capacity_ = count_;
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
     diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    DropHalfData();
   }
 }
 
@@ -58,20 +143,21 @@ void Blob<Dtype>::Reshape(const BlobShape& shape) {
 template <typename Dtype>
 void Blob<Dtype>::ReshapeLike(const Blob<Dtype>& other) {
   Reshape(other.shape());
+  layout_ = other.layout();
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), compressed_(false), half_precision_(FP32), layout_(NCHW) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), compressed_(false), half_precision_(FP32), layout_(NCHW) {
   Reshape(shape);
 }
 
@@ -84,24 +170,28 @@ const int* Blob<Dtype>::gpu_shape() const {
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_data() const {
   CHECK(data_);
+  if (compressed_) { RestoreData(); }
   return (const Dtype*)data_->cpu_data();
 }
 
 template <typename Dtype>
 void Blob<Dtype>::set_cpu_data(Dtype* data) {
   CHECK(data);
+  DropHalfData();
   data_->set_cpu_data(data);
 }
 
 template <typename Dtype>
 const Dtype* Blob<Dtype>::gpu_data() const {
   CHECK(data_);
+  if (compressed_) { RestoreData(); }
   return (const Dtype*)data_->gpu_data();
 }
 
 template <typename Dtype>
 void Blob<Dtype>::set_gpu_data(Dtype* data) {
   CHECK(data);
+  DropHalfData();
   this->data_->set_gpu_data(data);
 }
 
@@ -121,12 +211,14 @@ template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_cpu_data() {
   //  std::cerr << "data_=" << data_ << std::endl;
   CHECK(data_);
+  if (compressed_) { RestoreData(); }
   return static_cast<Dtype*>(data_->mutable_cpu_data());
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_gpu_data() {
   CHECK(data_);
+  if (compressed_) { RestoreData(); }
   return static_cast<Dtype*>(data_->mutable_gpu_data());
 }
 
@@ -146,6 +238,7 @@ template <typename Dtype>
 void Blob<Dtype>::ShareData(const Blob& other) {
   CHECK_EQ(count_, other.count());
   data_ = other.data();
+  DropHalfData();
 }
 
 template <typename Dtype>
@@ -154,6 +247,64 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::ShareView(const Blob& other, const int offset) {
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset + count_, other.count());
+  data_.reset(new SyncedMemory(other.data(), offset * sizeof(Dtype),
+      count_ * sizeof(Dtype)));
+  diff_.reset(new SyncedMemory(other.diff(), offset * sizeof(Dtype),
+      count_ * sizeof(Dtype)));
+  DropHalfData();
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+bool Blob<Dtype>::IsViewOf(const Blob& other, const int offset) const {
+  const size_t bytes = count_ * sizeof(Dtype);
+  return data_ && diff_ && data_->parent() == other.data_ &&
+      diff_->parent() == other.diff_ &&
+      data_->offset() == offset * sizeof(Dtype) && data_->size() == bytes &&
+      diff_->offset() == offset * sizeof(Dtype) && diff_->size() == bytes;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::CompressData(const Precision precision) {
+  CHECK(data_);
+  if (precision == FP32) {
+    cpu_data();
+    return;
+  }
+  if (data_precision() == precision) { return; }
+  shared_ptr<SyncedMemory> half_data(
+      new SyncedMemory(count_ * sizeof(uint16_t)));
+  BlobToHalf(count_, cpu_data(), static_cast<uint16_t*>(
+      half_data->mutable_cpu_data()), precision);
+  half_data_ = half_data;
+  half_precision_ = precision;
+  compressed_ = true;
+  // Nothing is allocated until the data is next read.
+  data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+}
+
+template <typename Dtype>
+const Dtype* Blob<Dtype>::cpu_data_uncompressed(vector<Dtype>* buffer) const {
+  // Read the precision first, as the data may be restored meanwhile.
+  const Precision precision = data_precision();
+  const uint16_t* half = half_data();
+  return half ? DecodeHalf(count_, half, precision, buffer) : cpu_data();
+}
+
+template <typename Dtype>
+void Blob<Dtype>::RestoreData() const {
+  // Restoring happens once per compressed blob: one lock for all of them.
+  boost::mutex::scoped_lock lock(restore_mutex);
+  if (!compressed_) { return; }
+  BlobFromHalf(count_, static_cast<const uint16_t*>(half_data_->cpu_data()),
+      static_cast<Dtype*>(data_->mutable_cpu_data()), half_precision_);
+  compressed_ = false;
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
 // Blob<int> or Blob<unsigned int>.
@@ -163,6 +314,7 @@ template <> void Blob<bool>::Update() { CAFFE1_NOT_IMPLEMENTED; }
 
 template <typename Dtype>
 void Blob<Dtype>::Update() {
+  if (compressed_) { RestoreData(); }
   // We will perform update based on where the data is located.
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
@@ -206,6 +358,7 @@ template <> bool Blob<bool>::asum_data() const {
 template <typename Dtype>
 Dtype Blob<Dtype>::asum_data() const {
   if (!data_) { return 0; }
+  if (compressed_) { RestoreData(); }
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
     return caffe_cpu_asum(count_, cpu_data());
@@ -290,6 +443,7 @@ Dtype Blob<Dtype>::sumsq_data() const {
   Dtype sumsq;
   const Dtype* data;
   if (!data_) { return 0; }
+  if (compressed_) { RestoreData(); }
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
     data = cpu_data();
@@ -372,6 +526,7 @@ template <typename Dtype>
 void Blob<Dtype>::scale_data(Dtype scale_factor) {
   Dtype* data;
   if (!data_) { return; }
+  if (compressed_) { RestoreData(); }
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
     data = mutable_cpu_data();
@@ -515,6 +670,14 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
   }
   // copy data
   Dtype* data_vec = mutable_cpu_data();
+  if (proto.precision() != FP32) {
+    ReadHalf(count_, proto.half_data(), proto.precision(), data_vec);
+    if (proto.has_half_diff()) {
+      ReadHalf(count_, proto.half_diff(), proto.precision(),
+          mutable_cpu_diff());
+    }
+    return;
+  }
   if (proto.double_data_size() > 0) {
     CHECK_EQ(count_, proto.double_data_size());
     for (int i = 0; i < count_; ++i) {
@@ -541,15 +704,42 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
   }
 }
 
+template <typename Dtype>
+void Blob<Dtype>::ToHalfProto(BlobProto* proto, bool write_diff,
+    const Precision precision) const {
+  proto->set_precision(precision);
+  if (data_precision() == precision) {
+    // Compressed data is written as is, without restoring it.
+    proto->set_half_data(half_data(), count_ * sizeof(uint16_t));
+  } else {
+    vector<Dtype> buffer;
+    WriteHalf(count_, cpu_data_uncompressed(&buffer), precision,
+        proto->mutable_half_data());
+  }
+  if (write_diff) {
+    WriteHalf(count_, cpu_diff(), precision, proto->mutable_half_diff());
+  }
+}
+
 template <>
-void Blob<double>::ToProto(BlobProto* proto, bool write_diff) const {
+void Blob<double>::ToProto(BlobProto* proto, bool write_diff,
+    const Precision precision) const {
   proto->clear_shape();
   for (int i = 0; i < shape_.size(); ++i) {
     proto->mutable_shape()->add_dim(shape_[i]);
   }
   proto->clear_double_data();
   proto->clear_double_diff();
-  const double* data_vec = cpu_data();
+  proto->clear_precision();
+  proto->clear_half_data();
+  proto->clear_half_diff();
+  if (precision != FP32) {
+    ToHalfProto(proto, write_diff, precision);
+    return;
+  }
+  // Compressed params are written without restoring them.
+  vector<double> buffer;
+  const double* data_vec = cpu_data_uncompressed(&buffer);
   for (int i = 0; i < count_; ++i) {
     proto->add_double_data(data_vec[i]);
   }
@@ -562,14 +752,24 @@ void Blob<double>::ToProto(BlobProto* proto, bool write_diff) const {
 }
 
 template <>
-void Blob<float>::ToProto(BlobProto* proto, bool write_diff) const {
+void Blob<float>::ToProto(BlobProto* proto, bool write_diff,
+    const Precision precision) const {
   proto->clear_shape();
   for (int i = 0; i < shape_.size(); ++i) {
     proto->mutable_shape()->add_dim(shape_[i]);
   }
   proto->clear_data();
   proto->clear_diff();
-  const float* data_vec = cpu_data();
+  proto->clear_precision();
+  proto->clear_half_data();
+  proto->clear_half_diff();
+  if (precision != FP32) {
+    ToHalfProto(proto, write_diff, precision);
+    return;
+  }
+  // Compressed params are written without restoring them.
+  vector<float> buffer;
+  const float* data_vec = cpu_data_uncompressed(&buffer);
   for (int i = 0; i < count_; ++i) {
     proto->add_data(data_vec[i]);
   }
@@ -582,17 +782,20 @@ void Blob<float>::ToProto(BlobProto* proto, bool write_diff) const {
 }
 
 template<>
-void Blob<int>::ToProto(BlobProto* proto, bool write_diff) const
+void Blob<int>::ToProto(BlobProto* proto, bool write_diff,
+    const Precision precision) const
 {  
 }
 
 template<>
-void Blob<unsigned int>::ToProto(BlobProto* proto, bool write_diff) const
+void Blob<unsigned int>::ToProto(BlobProto* proto, bool write_diff,
+    const Precision precision) const
 {  
 }
 
 template<>
-void Blob<bool>::ToProto(BlobProto* proto, bool write_diff) const
+void Blob<bool>::ToProto(BlobProto* proto, bool write_diff,
+    const Precision precision) const
 {  
 }
 
@@ -1,10 +1,13 @@
 #include <boost/thread.hpp>
+#include <atomic>
 #include <cmath>
 #include <cstdio>
 #include <ctime>
 
 #include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -18,6 +21,52 @@ Caffe& Caffe::Get() {
   return *(thread_instance_.get());
 }
 
+// The CPU thread pool is process-wide, unlike the thread local context. It
+// is created once and only resized after, so that once thread_pool_ptr_ is
+// set, hot loops read it without taking the mutex.
+static boost::mutex thread_pool_mutex_;
+static shared_ptr<ThreadPool> thread_pool_;
+static std::atomic<ThreadPool*> thread_pool_ptr_(NULL);
+
+// Creates the pool with num_threads threads if there is none yet; called
+// with thread_pool_mutex_ held.
+static ThreadPool* CreateThreadPool(int num_threads) {
+  if (!thread_pool_) {
+    thread_pool_.reset(new ThreadPool(num_threads));
+    thread_pool_ptr_.store(thread_pool_.get(), std::memory_order_release);
+  }
+  return thread_pool_.get();
+}
+
+static int default_cpu_threads() {
+  return std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+}
+
+ThreadPool& Caffe::thread_pool() {
+  ThreadPool* pool = thread_pool_ptr_.load(std::memory_order_acquire);
+  if (!pool) {
+    boost::mutex::scoped_lock lock(thread_pool_mutex_);
+    pool = CreateThreadPool(default_cpu_threads());
+  }
+  return *pool;
+}
+
+void Caffe::set_cpu_threads(int num_threads) {
+  CHECK_GE(num_threads, 0) << "The number of CPU threads can't be negative.";
+  if (num_threads == 0) {
+    num_threads = default_cpu_threads();
+  }
+  {
+    boost::mutex::scoped_lock lock(thread_pool_mutex_);
+    CreateThreadPool(num_threads)->Resize(num_threads);
+  }
+  caffe_set_blas_threads(num_threads);
+}
+
+int Caffe::cpu_threads() {
+  return thread_pool().num_threads();
+}
+
 // random seeding
 int64_t cluster_seedgen(void) {
   int64_t s, seed, pid;
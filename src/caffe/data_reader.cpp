@@ -1,4 +1,9 @@
 #include <boost/thread.hpp>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
 #include <map>
 #include <string>
 #include <vector>
@@ -9,11 +14,172 @@
 #include "caffe/layers/annotated_data_layer.hpp"
 #include "caffe/layers/data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
 using boost::weak_ptr;
 
+// Compressed records are restored on the reader thread, ahead of the layers.
+static void DecompressRecord(Datum* datum) {
+  DecompressDatum(datum);
+}
+
+static void DecompressRecord(AnnotatedDatum* anno_datum) {
+  DecompressDatum(anno_datum->mutable_datum());
+}
+
+static void DecompressRecord(SparseDatum* sparse_datum) {
+}
+
+// The memory held by a decoded record, 0 if unknown.
+static size_t RecordBytes(const Datum& datum) {
+  return datum.data().size() + datum.float_data_size() * sizeof(float);
+}
+
+static size_t RecordBytes(const AnnotatedDatum& anno_datum) {
+  return RecordBytes(anno_datum.datum());
+}
+
+static size_t RecordBytes(const SparseDatum& sparse_datum) {
+  return 0;
+}
+
+// Whether DataTransformer transforms a decoded Datum the same way as the
+// encoded one: the raw Datum path only crops, mirrors, subtracts the mean
+// and scales. force_color and force_gray only apply to encoded records.
+static bool TransformsRawDatum(const TransformationParameter& param) {
+  return !param.has_resize_param() && !param.has_noise_param() &&
+      !param.has_distort_param() && !param.has_geometry_param() &&
+      !param.has_expand_param() && !param.rotate() && !param.crop_h() &&
+      !param.crop_w() && !param.untransformed_top() &&
+      !param.force_color() && !param.force_gray();
+}
+
+// Decodes a record before it is cached. Annotated records stay encoded for
+// their distortions.
+static void DecodeRecord(Datum* datum) {
+#ifdef USE_OPENCV
+  DecodeDatumNative(datum);
+#endif  // USE_OPENCV
+}
+
+static void DecodeRecord(AnnotatedDatum* anno_datum) {
+}
+
+static void DecodeRecord(SparseDatum* sparse_datum) {
+}
+
+// Records read ahead of the cursor when reading in random order.
+static const int kLookahead = 16;
+
+// The key index file: a magic number, a header with the number of keys and
+// the first and last of them, then each key. Strings are stored as their
+// size then their bytes. The header tells an index left by a rewritten
+// database, or built for another source, from a current one.
+static const uint32_t kKeyIndexMagic = 0x5844494b;  // "KIDX"
+
+static bool ReadIndexString(std::istream* file, int64_t file_size,
+    string* s) {
+  uint32_t size;
+  if (!file->read(reinterpret_cast<char*>(&size), sizeof(size)) ||
+      size > file_size - static_cast<int64_t>(file->tellg())) {
+    return false;
+  }
+  s->resize(size);
+  return size == 0 || file->read(&(*s)[0], size);
+}
+
+static void WriteIndexString(std::ostream* file, const string& s) {
+  const uint32_t size = s.size();
+  file->write(reinterpret_cast<const char*>(&size), sizeof(size));
+  file->write(s.data(), size);
+}
+
+// Reads the keys of filename if they are those of the database of cursor,
+// which holds db_count records, or an unknown number if db_count < 0.
+static bool ReadKeyIndex(const string& filename, int db_count,
+    db::Cursor* cursor, vector<string>* keys) {
+  std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+  const int64_t file_size = file.tellg();
+  file.seekg(0);
+  uint32_t magic, count;
+  string first, last;
+  if (!file.read(reinterpret_cast<char*>(&magic), sizeof(magic)) ||
+      magic != kKeyIndexMagic ||
+      !file.read(reinterpret_cast<char*>(&count), sizeof(count)) ||
+      !ReadIndexString(&file, file_size, &first) ||
+      !ReadIndexString(&file, file_size, &last)) {
+    LOG(WARNING) << "Ignoring the invalid key index " << filename;
+    return false;
+  }
+  // Every key takes at least its size, which bounds count in a corrupt file.
+  const int64_t remaining = file_size - static_cast<int64_t>(file.tellg());
+  if (count == 0 || count > remaining / sizeof(uint32_t)) {
+    LOG(WARNING) << "Ignoring the invalid key index " << filename;
+    return false;
+  }
+  // The database must still begin with first and end with last.
+  bool current = db_count < 0 || count == static_cast<uint32_t>(db_count);
+  if (current) {
+    cursor->SeekToFirst();
+    current = cursor->valid() && cursor->key() == first;
+  }
+  if (current) {
+    cursor->Seek(last);
+    current = cursor->valid() && cursor->key() == last;
+  }
+  if (current) {
+    cursor->Next();
+    current = !cursor->valid();
+  }
+  if (!current) {
+    LOG(INFO) << "The key index " << filename << " is out of date";
+    return false;
+  }
+  keys->resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!ReadIndexString(&file, file_size, &(*keys)[i])) {
+      LOG(WARNING) << "Ignoring the truncated key index " << filename;
+      return false;
+    }
+  }
+  return keys->front() == first && keys->back() == last;
+}
+
+static void WriteKeyIndex(const string& filename, const vector<string>& keys) {
+  if (keys.empty()) {
+    return;
+  }
+  // Written aside then renamed, as several readers may build it at once.
+  std::ostringstream tmp_name;
+  tmp_name << filename << ".tmp" << getpid() << "_" << keys.size();
+  {
+    std::ofstream file(tmp_name.str().c_str(), std::ios::binary);
+    const uint32_t count = keys.size();
+    file.write(reinterpret_cast<const char*>(&kKeyIndexMagic),
+        sizeof(kKeyIndexMagic));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    WriteIndexString(&file, keys.front());
+    WriteIndexString(&file, keys.back());
+    for (uint32_t i = 0; i < count; ++i) {
+      WriteIndexString(&file, keys[i]);
+    }
+    if (!file) {
+      LOG(WARNING) << "Failed to write key index " << filename;
+      return;
+    }
+  }
+  if (rename(tmp_name.str().c_str(), filename.c_str()) != 0) {
+    LOG(WARNING) << "Failed to write key index " << filename;
+    remove(tmp_name.str().c_str());
+  }
+}
+
 template<>
 map<const string, weak_ptr<DataReader<Datum>::Body> > DataReader<Datum>::bodies_ = {};
 template<>
@@ -77,7 +243,19 @@ DataReader<TDatum>::QueuePair::~QueuePair() {
 template<class TDatum>
 DataReader<TDatum>::Body::Body(const LayerParameter& param)
     : param_(param),
+      block_(0),
+      in_block_(0),
+      epoch_(0),
+      cache_decoded_(false),
       new_queue_pairs_() {
+  const int cache_mb = param_.data_param().cache_mb();
+  if (cache_mb > 0) {
+    cache_.reset(new SampleCache<TDatum>(static_cast<size_t>(cache_mb) << 20));
+    cache_decoded_ = TransformsRawDatum(param_.transform_param());
+    LOG(INFO) << "Caching up to " << cache_mb << " MB of "
+        << (cache_decoded_ ? "decoded" : "parsed") << " records of "
+        << param_.data_param().source();
+  }
   StartInternalThread();
 }
 
@@ -91,8 +269,10 @@ template<class TDatum>
 void DataReader<TDatum>::Body::InternalThreadEntry() {
   shared_ptr<db::DB> db(db::GetDB(param_.data_param().backend()));
   //std::cerr << "\nopening db\n";
-  db->Open(param_.data_param().source(), db::READ);
+  db->Open(param_.data_param().source(),
+      param_.data_param().shuffle() ? db::READ_RANDOM : db::READ);
   shared_ptr<db::Cursor> cursor(db->NewCursor());
+  init_shard(db.get(), cursor.get());
   vector<shared_ptr<QueuePair> > qps;
   try {
     int solver_count = param_.phase() == TRAIN ? Caffe::solver_count() : 1;
@@ -127,15 +307,148 @@ void DataReader<TDatum>::Body::InternalThreadEntry() {
 template<class TDatum>
 void DataReader<TDatum>::Body::read_one(db::Cursor* cursor, QueuePair* qp) {
   TDatum* datum = qp->free_.pop();
-  // TODO deserialize in-place instead of copy?
-  datum->ParseFromString(cursor->value());
+  if (!cache_ || !cache_->Get(cursor->key(), datum)) {
+    // TODO deserialize in-place instead of copy?
+    const string value = cursor->value();
+    datum->ParseFromString(value);
+    DecompressRecord(datum);
+    if (cache_) {
+      if (cache_decoded_) {
+        DecodeRecord(datum);
+      }
+      cache_->Put(cursor->key(), *datum,
+          std::max(value.size(), RecordBytes(*datum)));
+    }
+  }
   qp->full_.push(datum);
 
   // go to the next iter
   cursor->Next();
-  if (!cursor->valid()) {
+  if (!block_keys_.empty()) {
+    if (++in_block_ == block_sizes_[block_order_[block_]]) {
+      next_block(cursor);
+    }
+  } else if (!cursor->valid()) {
     DLOG(INFO) << "Restarting data prefetching from start.";
     cursor->SeekToFirst();
+    log_cache();
+  }
+}
+
+template<class TDatum>
+void DataReader<TDatum>::Body::log_cache() {
+  if (cache_) {
+    LOG(INFO) << "Sample cache of " << param_.data_param().source() << ": "
+        << cache_->Stats();
+  }
+}
+
+template<class TDatum>
+void DataReader<TDatum>::Body::init_shard(db::DB* db, db::Cursor* cursor) {
+  const DataParameter& data_param = param_.data_param();
+  const int num_shards = data_param.num_shards();
+  const int shard_index = data_param.shard_index();
+  CHECK_GT(num_shards, 0);
+  CHECK_LT(shard_index, num_shards) << "shard_index out of range";
+  if (num_shards == 1 && !data_param.shuffle_shard() &&
+      !data_param.shuffle()) {
+    return;
+  }
+  int count = db->Count();
+  vector<string> keys;
+  const string& index_file = data_param.key_index();
+  if (!index_file.empty()) {
+    if (ReadKeyIndex(index_file, count, cursor, &keys)) {
+      LOG(INFO) << "Read the keys of " << data_param.source() << " from "
+          << index_file;
+    } else {
+      keys.clear();
+      for (cursor->SeekToFirst(); cursor->valid(); cursor->Next()) {
+        keys.push_back(cursor->key());
+      }
+      LOG(INFO) << "Writing the keys of " << data_param.source() << " to "
+          << index_file;
+      WriteKeyIndex(index_file, keys);
+    }
+    count = keys.size();
+  } else if (count < 0) {
+    // The backend does not keep a count: scan the keys once.
+    for (count = 0; cursor->valid(); cursor->Next()) {
+      ++count;
+    }
+  }
+  const int begin = static_cast<int64_t>(count) * shard_index / num_shards;
+  const int end = static_cast<int64_t>(count) * (shard_index + 1) / num_shards;
+  CHECK_LT(begin, end) << "Shard " << shard_index << " of " << num_shards
+      << " of " << data_param.source() << " is empty, it only has " << count
+      << " records";
+  int block_size = end - begin;
+  if (data_param.shuffle()) {
+    block_size = 1;
+    lookahead_.reset(db->NewCursor());
+  } else if (data_param.shuffle_shard()) {
+    block_size = data_param.shard_block_size();
+  }
+  CHECK_GT(block_size, 0);
+  if (!keys.empty()) {
+    for (int i = begin; i < end; i += block_size) {
+      block_keys_.push_back(keys[i]);
+      block_sizes_.push_back(std::min(block_size, end - i));
+    }
+  } else {
+    // Only the keys are read, the values stay on disk.
+    cursor->SeekToFirst();
+    for (int i = 0; i < end; ++i, cursor->Next()) {
+      CHECK(cursor->valid()) << data_param.source() << " has less than "
+          << count << " records";
+      if (i >= begin && (i - begin) % block_size == 0) {
+        block_keys_.push_back(cursor->key());
+        block_sizes_.push_back(std::min(block_size, end - i));
+      }
+    }
+  }
+  for (int b = 0; b < block_keys_.size(); ++b) {
+    block_order_.push_back(b);
+  }
+  LOG(INFO) << "Reading records [" << begin << ", " << end << ") of "
+      << data_param.source() << " in " << block_keys_.size() << " block(s)";
+  epoch_ = -1;
+  block_ = block_order_.size() - 1;
+  next_block(cursor);
+}
+
+template<class TDatum>
+void DataReader<TDatum>::Body::next_block(db::Cursor* cursor) {
+  const DataParameter& data_param = param_.data_param();
+  if (++block_ == block_order_.size()) {
+    block_ = 0;
+    if (++epoch_ > 0) {  // not on the first pass of init_shard
+      log_cache();
+    }
+    if (data_param.shuffle_shard() || data_param.shuffle()) {
+      // Seeded by shard and epoch only, for deterministic runs.
+      rng_t rng(data_param.shard_index() * 1000003 + epoch_);
+      shuffle(block_order_.begin(), block_order_.end(), &rng);
+    }
+    if (lookahead_) {
+      for (int b = 1; b < kLookahead; ++b) {
+        prefetch_block(b);
+      }
+    }
+  }
+  if (lookahead_) {
+    prefetch_block(block_ + kLookahead);
+  }
+  cursor->Seek(block_keys_[block_order_[block_]]);
+  in_block_ = 0;
+}
+
+template<class TDatum>
+void DataReader<TDatum>::Body::prefetch_block(int b) {
+  // The order of the next epoch is not known yet.
+  if (b < block_order_.size()) {
+    lookahead_->Seek(block_keys_[block_order_[b]]);
+    lookahead_->WillNeed();
   }
 }
 
@@ -12,6 +12,25 @@
 
 namespace caffe {
 
+// y = (x - mean) * scale over a plane, with mean either a plane or a value.
+template <typename Dtype, typename T>
+static void TransformPlane(const int n, const T* x, const Dtype* mean_plane,
+    const Dtype mean_value, const Dtype scale, Dtype* y) {
+  if (mean_plane) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = (static_cast<Dtype>(x[i]) - mean_plane[i]) * scale;
+    }
+  } else if (mean_value != Dtype(0)) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = (static_cast<Dtype>(x[i]) - mean_value) * scale;
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      y[i] = static_cast<Dtype>(x[i]) * scale;
+    }
+  }
+}
+
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
@@ -51,6 +70,12 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
                                        Dtype* transformed_data,
                                        NormalizedBBox* crop_bbox,
                                        bool* do_mirror) {
+  if (datum.compressed()) {
+    Datum raw_datum(datum);
+    DecompressDatum(&raw_datum);
+    Transform(raw_datum, transformed_data, crop_bbox, do_mirror);
+    return;
+  }
   const string& data = datum.data();
   const int datum_channels = datum.channels();
   const int datum_height = datum.height();
@@ -109,6 +134,23 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   crop_bbox->set_xmax(Dtype(w_off + width) / datum_width);
   crop_bbox->set_ymax(Dtype(h_off + height) / datum_height);
 
+  if (!crop_size && !*do_mirror) {
+    // The whole datum, in order: convert it plane by plane.
+    const int dim = datum_height * datum_width;
+    for (int c = 0; c < datum_channels; ++c) {
+      const Dtype* mean_plane = has_mean_file ? mean + c * dim : NULL;
+      const Dtype mean_value = has_mean_values ? mean_values_[c] : Dtype(0);
+      if (has_uint8) {
+        TransformPlane(dim, reinterpret_cast<const uint8_t*>(data.data()) +
+            c * dim, mean_plane, mean_value, scale, transformed_data + c * dim);
+      } else {
+        TransformPlane(dim, datum.float_data().data() + c * dim, mean_plane,
+            mean_value, scale, transformed_data + c * dim);
+      }
+    }
+    return;
+  }
+
   Dtype datum_element;
   int top_index, data_index;
   for (int c = 0; c < datum_channels; ++c) {
@@ -0,0 +1,75 @@
+#include <string>
+#include <vector>
+
+#include "caffe/inference_context.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+InferenceModel<Dtype>::InferenceModel(const NetParameter& param)
+    : param_(param) {
+  Init("");
+}
+
+template <typename Dtype>
+InferenceModel<Dtype>::InferenceModel(const string& param_file,
+    const string& trained_file) {
+  ReadNetParamsFromTextFileOrDie(param_file, &param_);
+  Init(trained_file);
+}
+
+template <typename Dtype>
+void InferenceModel<Dtype>::Init(const string& trained_file) {
+  param_.mutable_state()->set_phase(TEST);
+  mode_ = Caffe::mode();
+  device_ = -1;
+#ifndef CPU_ONLY
+  if (mode_ == Caffe::GPU) {
+    CUDA_CHECK(cudaGetDevice(&device_));
+  }
+#endif
+  net_.reset(new Net<Dtype>(param_));
+  if (!trained_file.empty()) {
+    net_->CopyTrainedLayersFrom(trained_file);
+  }
+  // Leave every parameter with an up-to-date copy wherever it may be read,
+  // so that concurrent contexts only ever read its memory.
+  // Parameters left in 16 bits by Net::CompressParams are only read as such.
+  net_->CompressParams();
+  const vector<shared_ptr<Blob<Dtype> > >& params = net_->params();
+  for (int i = 0; i < params.size(); ++i) {
+    if (mode_ == Caffe::CPU && params[i]->data_precision() != FP32) {
+      continue;
+    }
+    params[i]->cpu_data();
+#ifndef CPU_ONLY
+    if (mode_ == Caffe::GPU) {
+      params[i]->gpu_data();
+    }
+#endif
+  }
+}
+
+template <typename Dtype>
+InferenceContext<Dtype>::InferenceContext(const InferenceModel<Dtype>& model)
+    : mode_(model.mode()), device_(model.device()) {
+  net_.reset(new Net<Dtype>(model.param(), model.net()));
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& InferenceContext<Dtype>::Forward(Dtype* loss) {
+  // The Caffe context is per thread: adopt the model's on each call.
+  Caffe::set_mode(mode_);
+#ifndef CPU_ONLY
+  if (mode_ == Caffe::GPU) {
+    Caffe::SetDevice(device_);
+  }
+#endif
+  return net_->Forward(loss);
+}
+
+INSTANTIATE_CLASS(InferenceModel);
+INSTANTIATE_CLASS(InferenceContext);
+
+}  // namespace caffe
@@ -181,6 +181,29 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  use_int8_ = int8_gemm_.SetUp(this->layer_param_);
+  use_sparse_ = sparse_gemm_.SetUp(this->layer_param_);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::PrepareParams(const Layer<Dtype>* source) {
+  const BaseConvolutionLayer* conv_source =
+      dynamic_cast<const BaseConvolutionLayer*>(source);
+  if (use_int8_) {
+    if (conv_source && conv_source->int8_gemm_.has_weights()) {
+      int8_gemm_.ShareWeights(conv_source->int8_gemm_);
+    } else {
+      int8_gemm_.QuantizeWeights(conv_out_channels_, kernel_dim_,
+          this->blobs_[0]->cpu_data(), false);
+    }
+  } else if (use_sparse_) {
+    if (conv_source && conv_source->sparse_gemm_.has_weights()) {
+      sparse_gemm_.ShareWeights(conv_source->sparse_gemm_);
+    } else {
+      sparse_gemm_.Build(conv_out_channels_, kernel_dim_,
+          this->blobs_[0]->cpu_data(), false);
+    }
+  }
 }
 
 template <typename Dtype>
@@ -208,6 +231,13 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
   for (int top_id = 0; top_id < top.size(); ++top_id) {
     top[top_id]->Reshape(top_shape);
+    top[top_id]->set_layout(bottom[0]->layout());
+  }
+  if (bottom[0]->layout() == NHWC) {
+    // A plain GEMM over the pixels (see ConvolutionLayer).
+    CHECK(!reverse_dimensions() && is_1x1_ && group_ == 1 &&
+        num_spatial_axes_ == 2 && channel_axis_ == 1 && !use_int8_)
+        << "Only 1x1 2-D convolutions without groups compute in NHWC.";
   }
   if (reverse_dimensions()) {
     conv_out_spatial_dim_ = bottom[0]->count(first_spatial_axis);
@@ -265,6 +295,12 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     col_buff = col_buffer_.cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
+    if (use_sparse_ && sparse_gemm_.sparse()) {
+      const int rows = conv_out_channels_ / group_;
+      sparse_gemm_.Forward(rows * g, rows, conv_out_spatial_dim_,
+          col_buff + col_offset_ * g, false, output + output_offset_ * g);
+      continue;
+    }
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
         group_, conv_out_spatial_dim_, kernel_dim_,
         (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
@@ -272,6 +308,23 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_int8(const Dtype* input,
+    Dtype* output) {
+  const Dtype* col_buff = input;
+  if (!is_1x1_) {
+    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+    col_buff = col_buffer_.cpu_data();
+  }
+  const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  const int rows = conv_out_channels_ / group_;
+  for (int g = 0; g < group_; ++g) {
+    int8_gemm_.Forward(rows * g, rows, conv_out_spatial_dim_,
+        col_buff + col_offset_ * g, false, bias ? bias + rows * g : NULL,
+        output + output_offset_ * g, conv_out_spatial_dim_, 1);
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
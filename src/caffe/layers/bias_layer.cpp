@@ -2,6 +2,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/bias_layer.hpp"
+#include "caffe/util/eltwise.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -62,10 +63,8 @@ void BiasLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (bottom[0] != top[0]) {
     top[0]->ReshapeLike(*bottom[0]);
   }
+  // Only the GPU backward needs the ones; it fills them on first use.
   bias_multiplier_.Reshape(vector<int>(1, inner_dim_));
-  if (bias_multiplier_.cpu_data()[inner_dim_ - 1] != Dtype(1)) {
-    caffe_set(inner_dim_, Dtype(1), bias_multiplier_.mutable_cpu_data());
-  }
 }
 
 template <typename Dtype>
@@ -74,16 +73,8 @@ void BiasLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bias_data =
       ((bottom.size() > 1) ? bottom[1] : this->blobs_[0].get())->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  if (bottom[0] != top[0]) {
-    const Dtype* bottom_data = bottom[0]->cpu_data();
-    caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  }
-  for (int n = 0; n < outer_dim_; ++n) {
-    caffe_cpu_gemm(CblasNoTrans, CblasNoTrans, bias_dim_,
-        inner_dim_, 1, Dtype(1), bias_data,
-        bias_multiplier_.cpu_data(), Dtype(1), top_data);
-    top_data += dim_;
-  }
+  broadcast_axpby_cpu<Dtype>(outer_dim_, bias_dim_, inner_dim_, NULL,
+      bottom[0]->cpu_data(), bias_data, NULL, top_data);
 }
 
 template <typename Dtype>
@@ -101,13 +92,8 @@ void BiasLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bias_diff = (bias_param ? this->blobs_[0].get() : bottom[1])
         ->mutable_cpu_diff();
-    bool accum = bias_param;
-    for (int n = 0; n < outer_dim_; ++n) {
-      caffe_cpu_gemv(CblasNoTrans, bias_dim_, inner_dim_, Dtype(1),
-          top_diff, bias_multiplier_.cpu_data(), Dtype(accum), bias_diff);
-      top_diff += dim_;
-      accum = true;
-    }
+    broadcast_reduce_cpu<Dtype>(outer_dim_, bias_dim_, inner_dim_, top_diff,
+        NULL, bias_param, bias_diff);
   }
 }
 
@@ -44,6 +44,9 @@ void BiasLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->gpu_diff();
     Dtype* bias_diff = (bias_param ? this->blobs_[0].get() : bottom[1])
         ->mutable_gpu_diff();
+    if (bias_multiplier_.cpu_data()[inner_dim_ - 1] != Dtype(1)) {
+      caffe_set(inner_dim_, Dtype(1), bias_multiplier_.mutable_cpu_data());
+    }
     bool accum = bias_param;
     for (int n = 0; n < outer_dim_; ++n) {
       caffe_gpu_gemv(CblasNoTrans, bias_dim_, inner_dim_, Dtype(1),
@@ -32,6 +32,7 @@ void ConcatLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   // Initialize with the first blob.
   vector<int> top_shape = bottom[0]->shape();
   num_concats_ = bottom[0]->count(0, concat_axis_);
+  use_views_ = share_views_ && num_concats_ == 1;
   concat_input_size_ = bottom[0]->count(concat_axis_ + 1);
   int bottom_count_sum = bottom[0]->count();
   for (int i = 1; i < bottom.size(); ++i) {
@@ -61,15 +62,23 @@ void ConcatLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int offset_concat_axis = 0;
   const int top_concat_axis = top[0]->shape(concat_axis_);
   for (int i = 0; i < bottom.size(); ++i) {
-    const Dtype* bottom_data = bottom[i]->cpu_data();
     const int bottom_concat_axis = bottom[i]->shape(concat_axis_);
+    const int offset = offset_concat_axis * concat_input_size_;
+    offset_concat_axis += bottom_concat_axis;
+    // Already written in place by its producer.
+    if (use_views_ && bottom[i]->IsViewOf(*top[0], offset)) {
+      continue;
+    }
+    const Dtype* bottom_data = bottom[i]->cpu_data();
     for (int n = 0; n < num_concats_; ++n) {
       caffe_copy(bottom_concat_axis * concat_input_size_,
           bottom_data + n * bottom_concat_axis * concat_input_size_,
-          top_data + (n * top_concat_axis + offset_concat_axis)
-              * concat_input_size_);
+          top_data + n * top_concat_axis * concat_input_size_ + offset);
+    }
+    if (use_views_) {
+      // A contiguous slot: from the next pass on the producer writes there.
+      bottom[i]->ShareView(*top[0], offset);
     }
-    offset_concat_axis += bottom_concat_axis;
   }
 }
 
@@ -82,15 +91,18 @@ void ConcatLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const int top_concat_axis = top[0]->shape(concat_axis_);
   for (int i = 0; i < bottom.size(); ++i) {
     const int bottom_concat_axis = bottom[i]->shape(concat_axis_);
-    if (propagate_down[i]) {
-      Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
-      for (int n = 0; n < num_concats_; ++n) {
-        caffe_copy(bottom_concat_axis * concat_input_size_, top_diff +
-            (n * top_concat_axis + offset_concat_axis) * concat_input_size_,
-            bottom_diff + n * bottom_concat_axis * concat_input_size_);
-      }
-    }
+    const int offset = offset_concat_axis * concat_input_size_;
     offset_concat_axis += bottom_concat_axis;
+    if (!propagate_down[i] ||
+        (use_views_ && bottom[i]->IsViewOf(*top[0], offset))) {
+      continue;
+    }
+    Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
+    for (int n = 0; n < num_concats_; ++n) {
+      caffe_copy(bottom_concat_axis * concat_input_size_,
+          top_diff + n * top_concat_axis * concat_input_size_ + offset,
+          bottom_diff + n * bottom_concat_axis * concat_input_size_);
+    }
   }
 }
 
@@ -3,6 +3,7 @@
 #include "caffe/filler.hpp"
 #include "caffe/layers/conv_dw_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -85,6 +86,11 @@ void ConvolutionDepthwiseLayer<Dtype>::LayerSetUp(
     }
   }
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  // im2col and a one row int8 GEMM per channel are slower than the direct
+  // float kernel: a calibrated depthwise convolution stays in float.
+  LOG_IF(INFO, this->layer_param_.has_quantization_param() &&
+      Caffe::root_solver()) << this->layer_param_.name()
+      << " ignores its quantization_param: depthwise runs in float";
 }
 
 template <typename Dtype>
@@ -98,6 +104,7 @@ void ConvolutionDepthwiseLayer<Dtype>::Reshape(
   top_shape.push_back((bottom[0]->width() + 2 * pad_w_
         - (dilation_w_ * (kernel_w_ - 1) + 1)) / stride_w_ + 1);
   top[0]->Reshape(top_shape);
+  top[0]->set_layout(bottom[0]->layout());
   vector<int> weight_buffer_shape;
   weight_buffer_shape.push_back(bottom[0]->channels());
   weight_buffer_shape.push_back(kernel_h_);
@@ -133,6 +140,10 @@ void ConvolutionDepthwiseLayer<Dtype>::Reshape(
 template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Forward_cpu(
       const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (bottom[0]->layout() == NHWC) {
+    Forward_cpu_nhwc(bottom, top);
+    return;
+  }
   const int num = top[0]->num();
   const int channels = top[0]->channels();
   const int top_height = top[0]->height();
@@ -188,6 +199,10 @@ template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Backward_cpu(
       const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
       const vector<Blob<Dtype>*>& bottom) {
+  if (bottom[0]->layout() == NHWC) {
+    Backward_cpu_nhwc(top, propagate_down, bottom);
+    return;
+  }
   const int num = top[0]->num();
   const int channels = top[0]->channels();
   const int top_height = top[0]->height();
@@ -270,6 +285,134 @@ void ConvolutionDepthwiseLayer<Dtype>::Backward_cpu(
   }
 }
 
+template <typename Dtype>
+void ConvolutionDepthwiseLayer<Dtype>::TapWeights() {
+  const int channels = this->blobs_[0]->num();
+  const int kernel_dim = kernel_h_ * kernel_w_;
+  tap_weight_.Reshape(vector<int>(1, kernel_dim * channels));
+  caffe_cpu_transpose(1, channels, kernel_dim, this->blobs_[0]->cpu_data(),
+      tap_weight_.mutable_cpu_data());
+}
+
+template <typename Dtype>
+void ConvolutionDepthwiseLayer<Dtype>::Forward_cpu_nhwc(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const int channels = top[0]->channels();
+  const int top_height = top[0]->height();
+  const int top_width = top[0]->width();
+  const int bottom_height = bottom[0]->height();
+  const int bottom_width = bottom[0]->width();
+  // Each kernel tap reads the contiguous channels of a pixel, with the
+  // weights of that tap for all channels.
+  TapWeights();
+  const Dtype* weight_data = tap_weight_.cpu_data();
+  const Dtype* bias_data = this->layer_param_.convolution_param().bias_term() ?
+      this->blobs_[1]->cpu_data() : NULL;
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  parallel_for(top[0]->num() * top_height, [&](int begin, int end) {
+    for (int row = begin; row < end; ++row) {
+      const int n = row / top_height;
+      const int h = row % top_height;
+      for (int w = 0; w < top_width; ++w) {
+        Dtype* top_pixel = top_data + (row * top_width + w) * channels;
+        for (int c = 0; c < channels; ++c) {
+          top_pixel[c] = bias_data ? bias_data[c] : Dtype(0);
+        }
+        for (int kh = 0; kh < kernel_h_; ++kh) {
+          const int h_in = h * (int)stride_h_ - (int)pad_h_
+              + kh * (int)dilation_h_;
+          if (h_in < 0 || h_in >= bottom_height) { continue; }
+          for (int kw = 0; kw < kernel_w_; ++kw) {
+            const int w_in = w * (int)stride_w_ - (int)pad_w_
+                + kw * (int)dilation_w_;
+            if (w_in < 0 || w_in >= bottom_width) { continue; }
+            const Dtype* bottom_pixel = bottom_data
+                + ((n * bottom_height + h_in) * bottom_width + w_in) * channels;
+            const Dtype* tap = weight_data + (kh * kernel_w_ + kw) * channels;
+            for (int c = 0; c < channels; ++c) {
+              top_pixel[c] += tap[c] * bottom_pixel[c];
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
+template <typename Dtype>
+void ConvolutionDepthwiseLayer<Dtype>::Backward_cpu_nhwc(
+      const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+      const vector<Blob<Dtype>*>& bottom) {
+  const int num = top[0]->num();
+  const int channels = top[0]->channels();
+  const int top_height = top[0]->height();
+  const int top_width = top[0]->width();
+  const int bottom_height = bottom[0]->height();
+  const int bottom_width = bottom[0]->width();
+  const int kernel_dim = kernel_h_ * kernel_w_;
+  const Dtype* top_diff = top[0]->cpu_diff();
+  if (this->layer_param_.convolution_param().bias_term()
+        && this->param_propagate_down_[1]) {
+    Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
+    for (int i = 0; i < top[0]->count(); i += channels) {
+      for (int c = 0; c < channels; ++c) {
+        bias_diff[c] += top_diff[i + c];
+      }
+    }
+  }
+  if (!this->param_propagate_down_[0] && !propagate_down[0]) { return; }
+  TapWeights();
+  const Dtype* weight_data = tap_weight_.cpu_data();
+  // The weight gradient is summed by tap too, then added to the weight diff.
+  Dtype* tap_diff = tap_weight_.mutable_cpu_diff();
+  caffe_set(tap_weight_.count(), Dtype(0), tap_diff);
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* bottom_diff = propagate_down[0] ? bottom[0]->mutable_cpu_diff() : NULL;
+  if (bottom_diff) {
+    caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+  }
+  for (int n = 0; n < num; ++n) {
+    for (int h = 0; h < top_height; ++h) {
+      for (int w = 0; w < top_width; ++w) {
+        const Dtype* top_pixel = top_diff
+            + ((n * top_height + h) * top_width + w) * channels;
+        for (int kh = 0; kh < kernel_h_; ++kh) {
+          const int h_in = h * (int)stride_h_ - (int)pad_h_
+              + kh * (int)dilation_h_;
+          if (h_in < 0 || h_in >= bottom_height) { continue; }
+          for (int kw = 0; kw < kernel_w_; ++kw) {
+            const int w_in = w * (int)stride_w_ - (int)pad_w_
+                + kw * (int)dilation_w_;
+            if (w_in < 0 || w_in >= bottom_width) { continue; }
+            const int offset =
+                ((n * bottom_height + h_in) * bottom_width + w_in) * channels;
+            const int tap = (kh * kernel_w_ + kw) * channels;
+            if (this->param_propagate_down_[0]) {
+              for (int c = 0; c < channels; ++c) {
+                tap_diff[tap + c] += bottom_data[offset + c] * top_pixel[c];
+              }
+            }
+            if (bottom_diff) {
+              for (int c = 0; c < channels; ++c) {
+                bottom_diff[offset + c] += weight_data[tap + c] * top_pixel[c];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  if (this->param_propagate_down_[0]) {
+    Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+    for (int c = 0; c < channels; ++c) {
+      for (int k = 0; k < kernel_dim; ++k) {
+        weight_diff[c * kernel_dim + k] += tap_diff[k * channels + c];
+      }
+    }
+  }
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(ConvolutionDepthwiseLayer);
 #endif
@@ -49,6 +49,11 @@ __global__ void ConvolutionDepthwiseBiasForward(const int nthreads,
 template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Forward_gpu(
       const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (bottom[0]->layout() == NHWC) {
+    // Only set up by CPU mode nets.
+    Forward_cpu(bottom, top);
+    return;
+  }
   const Dtype* bottom_data = bottom[0]->gpu_data();
   Dtype* top_data = top[0]->mutable_gpu_data();
   const Dtype* weight_data = this->blobs_[0]->gpu_data();
@@ -161,6 +166,10 @@ template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Backward_gpu(
       const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
       const vector<Blob<Dtype>*>& bottom) {
+  if (bottom[0]->layout() == NHWC) {
+    Backward_cpu(top, propagate_down, bottom);
+    return;
+  }
   const Dtype* top_diff = top[0]->gpu_diff();
   const int bottom_count = bottom[0]->count();
   const int num = top[0]->num();
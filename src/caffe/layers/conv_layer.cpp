@@ -26,9 +26,18 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* weight = this->blobs_[0]->cpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
+    if (bottom[i]->layout() == NHWC) {
+      Forward_cpu_nhwc(bottom[i], top[i]);
+      continue;
+    }
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < this->num_; ++n) {
+      if (this->use_int8_) {
+        this->forward_cpu_int8(bottom_data + n * this->bottom_dim_,
+            top_data + n * this->top_dim_);
+        continue;
+      }
       this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
           top_data + n * this->top_dim_);
       if (this->bias_term_) {
@@ -45,6 +54,10 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
+    if (bottom[i]->layout() == NHWC) {
+      Backward_cpu_nhwc(top[i], propagate_down[i], bottom[i]);
+      continue;
+    }
     const Dtype* top_diff = top[i]->cpu_diff();
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
@@ -72,6 +85,52 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::Forward_cpu_nhwc(const Blob<Dtype>* bottom,
+    Blob<Dtype>* top) {
+  // The pixels are the rows of a (N H W) x C matrix: no im2col is needed.
+  const int pixels = this->num_ * this->out_spatial_dim_;
+  Dtype* top_data = top->mutable_cpu_data();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, pixels, this->num_output_,
+      this->channels_, (Dtype)1., bottom->cpu_data(),
+      this->blobs_[0]->cpu_data(), (Dtype)0., top_data);
+  if (this->bias_term_) {
+    const Dtype* bias = this->blobs_[1]->cpu_data();
+    for (int i = 0; i < pixels; ++i) {
+      Dtype* top_pixel = top_data + i * this->num_output_;
+      for (int j = 0; j < this->num_output_; ++j) {
+        top_pixel[j] += bias[j];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::Backward_cpu_nhwc(const Blob<Dtype>* top,
+    const bool propagate_down, Blob<Dtype>* bottom) {
+  const int pixels = this->num_ * this->out_spatial_dim_;
+  const Dtype* top_diff = top->cpu_diff();
+  if (this->bias_term_ && this->param_propagate_down_[1]) {
+    Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
+    for (int i = 0; i < pixels; ++i) {
+      const Dtype* top_pixel = top_diff + i * this->num_output_;
+      for (int j = 0; j < this->num_output_; ++j) {
+        bias_diff[j] += top_pixel[j];
+      }
+    }
+  }
+  if (this->param_propagate_down_[0]) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, this->num_output_,
+        this->channels_, pixels, (Dtype)1., top_diff, bottom->cpu_data(),
+        (Dtype)1., this->blobs_[0]->mutable_cpu_diff());
+  }
+  if (propagate_down) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, pixels, this->channels_,
+        this->num_output_, (Dtype)1., top_diff, this->blobs_[0]->cpu_data(),
+        (Dtype)0., bottom->mutable_cpu_diff());
+  }
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(ConvolutionLayer);
 #endif
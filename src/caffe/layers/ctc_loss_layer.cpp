@@ -9,6 +9,11 @@ void CtcLossLayer<Dtype>::LayerSetUp(
   CtcLossParameter param = this->layer_param_.ctc_loss_param();
   blank_label_ = param.blank_label();
   alphabet_size_ = param.alphabet_size();
+  num_threads_ = param.num_threads();
+  if (num_threads_ == 0) {
+    // follow the process-wide CPU thread setting
+    num_threads_ = Caffe::cpu_threads();
+  }
   CHECK_GT(alphabet_size_, 0) << "The size of alphabeta should be greater than 0.";
   int mini_batch = bottom[0]->shape()[1];
   //int label_length = param.label_length();
@@ -62,30 +67,31 @@ void CtcLossLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
     auto options = ctcOptions{};
     options.loc = CTC_CPU;
-    options.num_threads = 1;
+    options.num_threads = num_threads_;
     options.blank_label = blank_label_;
     int mini_batch = bottom[0]->shape(1);
     int alphabet_size = alphabet_size_;
 
     const Dtype* const activations = bottom[0]->cpu_data();
     Dtype* gradients = bottom[0]->mutable_cpu_diff();
-    Dtype* cost = new Dtype[mini_batch];
+    costs_.resize(mini_batch);
     FlattenLabels(bottom[1]);
     size_t size_bytes;
     CHECK_CTC_STATUS(get_workspace_size(label_lengths_.data(),
                     input_lengths_.data(), alphabet_size,
                     mini_batch, options, &size_bytes));
-    char* workspace = new char[size_bytes];
+    // Only grows, so steady-state iterations do not allocate.
+    if (workspace_.size() < size_bytes) {
+      workspace_.resize(size_bytes);
+    }
 
     CHECK_CTC_STATUS(compute_ctc_loss(activations, gradients,
                      flat_labels_.data(),
                      label_lengths_.data(), input_lengths_.data(),
-                     alphabet_size, mini_batch, cost,
-                     workspace, options));
-    Dtype loss = std::accumulate(cost, cost + mini_batch, Dtype(0));
+                     alphabet_size, mini_batch, costs_.data(),
+                     workspace_.data(), options));
+    Dtype loss = std::accumulate(costs_.begin(), costs_.end(), Dtype(0));
     top[0]->mutable_cpu_data()[0] = loss / mini_batch;
-    delete[] cost;
-    delete[] workspace;
 }
 
 template <>
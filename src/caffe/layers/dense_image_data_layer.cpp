@@ -44,6 +44,8 @@ void DenseImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bott
   const bool is_color  = this->layer_param_.dense_image_data_param().is_color();
   string root_folder = this->layer_param_.dense_image_data_param().root_folder();
   one_hot_nclasses_ = this->layer_param_.dense_image_data_param().one_hot_nclasses();
+  reader_.reset(new AsyncImageReader(
+      this->layer_param_.dense_image_data_param().read_threads()));
 
   CHECK((new_height == 0 && new_width == 0) ||
       (new_height > 0 && new_width > 0)) << "Current implementation requires "
@@ -203,21 +205,51 @@ void DenseImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   }
   Dtype* prefetch_data = batch->data_.mutable_cpu_data();
   Dtype* prefetch_label = batch->label_.mutable_cpu_data();
-  // datum scales
+  // Read the images and labels of the batch together: image 2 * item_id and
+  // label 2 * item_id + 1.
+  timer.Start();
   const int lines_size = lines_.size();
+  vector<AsyncImageReader::Request> requests(2 * batch_size);
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    CHECK_GT(lines_size, lines_id_);
+    AsyncImageReader::Request& image = requests[2 * item_id];
+    image.filename = root_folder + lines_[lines_id_].first;
+    image.height = new_height;
+    image.width = new_width;
+    image.is_color = is_color;
+    AsyncImageReader::Request& label = requests[2 * item_id + 1];
+    label.filename = root_folder + lines_[lines_id_].second;
+    label.height = new_height;
+    label.width = new_width;
+    label.is_color = false;
+    label.nearest_neighbour_interp = true;
+    // go to the next iter
+    lines_id_++;
+    if (lines_id_ >= lines_size) {
+      // We have reached the end. Restart from the first.
+      DLOG(INFO) << "Restarting data prefetching from start.";
+      lines_id_ = 0;
+      if (this->layer_param_.dense_image_data_param().shuffle()) {
+        ShuffleImages();
+      }
+    }
+  }
+  vector<cv::Mat> cv_imgs;
+  reader_->Read(requests, &cv_imgs);
+  read_time += timer.MicroSeconds();
+
+  // datum scales
   for (int item_id = 0; item_id < batch_size; ++item_id) {
     // get a blob
     timer.Start();
-    CHECK_GT(lines_size, lines_id_);
-    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-        new_height, new_width, is_color);
-    CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
+    cv::Mat cv_img = cv_imgs[2 * item_id];
+    CHECK(cv_img.data) << "Could not load " << requests[2 * item_id].filename;
     cv::Mat cv_lab;
     if (one_hot_nclasses_ == 0)
       {
-        cv_lab = ReadImageToCVMat(root_folder + lines_[lines_id_].second,
-                                  new_height, new_width, false, true);
-        CHECK(cv_lab.data) << "Could not load " << lines_[lines_id_].second;
+        cv_lab = cv_imgs[2 * item_id + 1];
+        CHECK(cv_lab.data) << "Could not load "
+            << requests[2 * item_id + 1].filename;
         read_time += timer.MicroSeconds();
         timer.Start();
         // Apply random horizontal mirror of images
@@ -232,9 +264,9 @@ void DenseImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
       }
     else
       {
-        cv::Mat cv_lab_orig = ReadImageToCVMat(root_folder + lines_[lines_id_].second,
-                                               new_height, new_width, false, true);
-        CHECK(cv_lab_orig.data) << "Could not load " << lines_[lines_id_].second;
+        const cv::Mat& cv_lab_orig = cv_imgs[2 * item_id + 1];
+        CHECK(cv_lab_orig.data) << "Could not load "
+            << requests[2 * item_id + 1].filename;
         cv_lab = cv::Mat(cv_lab_orig.rows,cv_lab_orig.cols,
                          CV_MAKETYPE(cv_lab_orig.depth(),(one_hot_nclasses_)));
 				cv::Mat cv_chan;
@@ -293,17 +325,6 @@ void DenseImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
         << "FIXME: Any stochastic transformation will break layer due to "
         << "the need to transform input and label images in the same way";
     trans_time += timer.MicroSeconds();
-
-    // go to the next iter
-    lines_id_++;
-    if (lines_id_ >= lines_size) {
-      // We have reached the end. Restart from the first.
-      DLOG(INFO) << "Restarting data prefetching from start.";
-      lines_id_ = 0;
-      if (this->layer_param_.dense_image_data_param().shuffle()) {
-        ShuffleImages();
-      }
-    }
   }
   batch_timer.Stop();
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
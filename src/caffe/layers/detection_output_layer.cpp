@@ -9,6 +9,7 @@
 #include "boost/foreach.hpp"
 
 #include "caffe/layers/detection_output_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -236,18 +237,18 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
 		    &all_decode_bboxes);
   }
 
-  int num_kept = 0;
-  vector<map<int, vector<int> > > all_indices;
-  for (int i = 0; i < num; ++i) {
-    const LabelBBox& decode_bboxes = all_decode_bboxes[i];
-    const map<int, vector<float> >& conf_scores = all_conf_scores[i];
-    map<int, vector<int> > indices;
-    int num_det = 0;
-    for (int c = 0; c < num_classes_; ++c) {
+  // NMS of each class of each image, independent of the others.
+  vector<vector<int> > class_indices(num * num_classes_);
+  parallel_for(num * num_classes_, [&](int begin, int end) {
+    for (int k = begin; k < end; ++k) {
+      const int i = k / num_classes_;
+      const int c = k % num_classes_;
       if (c == background_label_id_) {
         // Ignore background class.
         continue;
       }
+      const LabelBBox& decode_bboxes = all_decode_bboxes[i];
+      const map<int, vector<float> >& conf_scores = all_conf_scores[i];
       if (conf_scores.find(c) == conf_scores.end()) {
         // Something bad happened if there are no predictions for current label.
         LOG(ERROR) << "Could not find confidence predictions for label " << c;
@@ -264,9 +265,24 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
       const vector<NormalizedBBox>& bboxes = decode_bboxes.find(label)->second;
       if (!soft_nms_)
 	ApplyNMSFast(bboxes, scores, confidence_threshold_, nms_threshold_, eta_,
-		     top_k_, &(indices[c]));
+		     top_k_, &class_indices[k]);
       else ApplySoftNMSFast(bboxes, scores, confidence_threshold_, nms_threshold_, eta_, theta_,
-			    top_k_, &(indices[c]));
+			    top_k_, &class_indices[k]);
+    }
+  });
+
+  int num_kept = 0;
+  vector<map<int, vector<int> > > all_indices;
+  for (int i = 0; i < num; ++i) {
+    const map<int, vector<float> >& conf_scores = all_conf_scores[i];
+    map<int, vector<int> > indices;
+    int num_det = 0;
+    for (int c = 0; c < num_classes_; ++c) {
+      if (c == background_label_id_ ||
+          conf_scores.find(c) == conf_scores.end()) {
+        continue;
+      }
+      indices[c].swap(class_indices[i * num_classes_ + c]);
       num_det += indices[c].size();
     }
     if (keep_top_k_ > -1 && num_det > keep_top_k_) {
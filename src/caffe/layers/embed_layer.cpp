@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <utility>
 #include <vector>
 
 #include "caffe/filler.hpp"
@@ -14,6 +16,7 @@ void EmbedLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   K_ = this->layer_param_.embed_param().input_dim();
   CHECK_GT(K_, 0) << "EmbedLayer input_dim must be positive.";
   bias_term_ = this->layer_param_.embed_param().bias_term();
+  sparse_gradient_ = this->layer_param_.embed_param().sparse_gradient();
   // Check if we need to set up the weights
   if (this->blobs_.size() > 0) {
     LOG(INFO) << "Skipping parameter initialization";
@@ -92,13 +95,43 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     // Gradient with respect to weight
     Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
     int index;
-    for (int n = 0; n < M_; ++n) {
-      index = static_cast<int>(bottom_data[n]);
-      DCHECK_GE(index, 0);
-      DCHECK_LT(index, K_);
-      DCHECK_EQ(static_cast<Dtype>(index), bottom_data[n])
-          << "non-integer input";
-      caffe_axpy(N_, Dtype(1), top_diff + n * N_, weight_diff + index * N_);
+    if (!sparse_gradient_) {
+      for (int n = 0; n < M_; ++n) {
+        index = static_cast<int>(bottom_data[n]);
+        DCHECK_GE(index, 0);
+        DCHECK_LT(index, K_);
+        DCHECK_EQ(static_cast<Dtype>(index), bottom_data[n])
+            << "non-integer input";
+        caffe_axpy(N_, Dtype(1), top_diff + n * N_, weight_diff + index * N_);
+      }
+    } else {
+      // Group the inputs by index so that each weight row is visited once,
+      // and record the rows for the solver.
+      sorted_indices_.resize(M_);
+      for (int n = 0; n < M_; ++n) {
+        index = static_cast<int>(bottom_data[n]);
+        DCHECK_GE(index, 0);
+        DCHECK_LT(index, K_);
+        DCHECK_EQ(static_cast<Dtype>(index), bottom_data[n])
+            << "non-integer input";
+        sorted_indices_[n] = std::make_pair(index, n);
+      }
+      std::sort(sorted_indices_.begin(), sorted_indices_.end());
+      const int num_rows = sparse_rows_.size();
+      for (int i = 0; i < M_; ) {
+        index = sorted_indices_[i].first;
+        Dtype* row_diff = weight_diff + index * N_;
+        for (; i < M_ && sorted_indices_[i].first == index; ++i) {
+          caffe_axpy(N_, Dtype(1), top_diff + sorted_indices_[i].second * N_,
+              row_diff);
+        }
+        sparse_rows_.push_back(index);
+      }
+      // Merge with the rows of previous passes (iter_size > 1).
+      std::inplace_merge(sparse_rows_.begin(), sparse_rows_.begin() + num_rows,
+          sparse_rows_.end());
+      sparse_rows_.erase(std::unique(sparse_rows_.begin(), sparse_rows_.end()),
+          sparse_rows_.end());
     }
   }
   if (bias_term_ && this->param_propagate_down_[1]) {
@@ -109,6 +142,22 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+const vector<int>* EmbedLayer<Dtype>::sparse_param_rows(
+    const int param_id) const {
+  if (!sparse_gradient_ || param_id != 0 || !sparse_rows_valid_) {
+    return NULL;
+  }
+  return &sparse_rows_;
+}
+
+template <typename Dtype>
+void EmbedLayer<Dtype>::ClearSparseParamRows(const int param_id) {
+  if (param_id != 0) { return; }
+  sparse_rows_.clear();
+  sparse_rows_valid_ = true;
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(EmbedLayer);
 #endif
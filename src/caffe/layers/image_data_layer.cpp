@@ -67,6 +67,13 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     this->prefetch_[i].data_.Reshape(top_shape_);
   }
   top[0]->Reshape(top_shape_);
+  const int cache_mb = this->layer_param_.image_data_param().cache_mb();
+  if (cache_mb > 0) {
+    cache_.reset(new SampleCache<cv::Mat>(static_cast<size_t>(cache_mb) << 20));
+    LOG(INFO) << "Caching up to " << cache_mb << " MB of decoded images";
+  }
+  reader_.reset(new AsyncImageReader(
+      this->layer_param_.image_data_param().read_threads()));
 
   LOG(INFO) << "output data size: " << top[0]->num() << ","
       << top[0]->channels() << "," << top[0]->height() << ","
@@ -131,18 +138,41 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
     ShuffleImages();
     }*/
   
+  // Read the images missing from the cache together.
+  timer.Start();
+  vector<cv::Mat> cv_imgs(lines_batch.size());
+  vector<AsyncImageReader::Request> requests;
+  vector<int> requested;
+  for (size_t item_id = 0; item_id < lines_batch.size(); ++item_id) {
+    const string path = root_folder + lines_batch[item_id].first;
+    if (!cache_ || !cache_->Get(path, &cv_imgs[item_id])) {
+      AsyncImageReader::Request request;
+      request.filename = path;
+      request.height = new_height;
+      request.width = new_width;
+      request.is_color = is_color;
+      requests.push_back(request);
+      requested.push_back(item_id);
+    }
+  }
+  reader_->Read(requests, [&](int i, const cv::Mat& cv_img) {
+    cv_imgs[requested[i]] = cv_img;
+    if (cache_ && cv_img.data) {
+      cache_->Put(requests[i].filename, cv_img,
+          cv_img.total() * cv_img.elemSize());
+    }
+  });
+  read_time += timer.MicroSeconds();
+
   // datum scales
   for (size_t item_id = 0; item_id < lines_batch.size(); ++item_id) {
     // get a blob
-    timer.Start();
-    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_batch[item_id].first,
-        new_height, new_width, is_color);
+    const cv::Mat& cv_img = cv_imgs[item_id];
     if (!cv_img.data)
       {
         LOG(WARNING) << "failed loading = " << lines_batch[item_id].first;// << std::endl;
         continue;
       }
-    read_time += timer.MicroSeconds();
     timer.Start();
     // Apply transformations (mirror, crop...) to the image
     int offset = batch->data_.offset(item_id);
@@ -163,6 +193,9 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
 	// We have reached the end. Restart from the first.
 	DLOG(INFO) << "Restarting data prefetching from start.";
 	lines_id_ = 0;
+	if (cache_) {
+	  LOG(INFO) << "Sample cache of " << *source_ << ": " << cache_->Stats();
+	}
       }
     }
   }
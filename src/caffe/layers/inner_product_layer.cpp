@@ -2,6 +2,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/half.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -52,6 +53,28 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }  // parameter initialization
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  use_int8_ = int8_gemm_.SetUp(this->layer_param_);
+  use_sparse_ = sparse_gemm_.SetUp(this->layer_param_);
+}
+
+template <typename Dtype>
+void InnerProductLayer<Dtype>::PrepareParams(const Layer<Dtype>* source) {
+  const InnerProductLayer* ip_source =
+      dynamic_cast<const InnerProductLayer*>(source);
+  if (use_int8_) {
+    if (ip_source && ip_source->int8_gemm_.has_weights()) {
+      int8_gemm_.ShareWeights(ip_source->int8_gemm_);
+    } else {
+      int8_gemm_.QuantizeWeights(N_, K_, this->blobs_[0]->cpu_data(),
+          transpose_);
+    }
+  } else if (use_sparse_) {
+    if (ip_source && ip_source->sparse_gemm_.has_weights()) {
+      sparse_gemm_.ShareWeights(ip_source->sparse_gemm_);
+    } else {
+      sparse_gemm_.Build(N_, K_, this->blobs_[0]->cpu_data(), transpose_);
+    }
+  }
 }
 
 template <typename Dtype>
@@ -85,10 +108,25 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  if (use_int8_) {
+    int8_gemm_.Forward(0, N_, M_, bottom_data, true,
+        bias_term_ ? this->blobs_[1]->cpu_data() : NULL, top_data, 1, N_);
+    return;
+  }
+  // Weights kept in 16 bits by Net::CompressParams. Another context sharing
+  // them may convert them back meanwhile: read the precision first.
+  const Precision precision = this->blobs_[0]->data_precision();
+  const uint16_t* half_weights = this->blobs_[0]->half_data();
+  if (use_sparse_ && sparse_gemm_.sparse()) {
+    sparse_gemm_.Forward(0, N_, M_, bottom_data, true, top_data);
+  } else if (half_weights) {
+    caffe_cpu_gemm_half<Dtype>(transpose_ ? CblasNoTrans : CblasTrans,
+        M_, N_, K_, bottom_data, half_weights, precision, top_data);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans,
+        transpose_ ? CblasNoTrans : CblasTrans, M_, N_, K_, (Dtype)1.,
+        bottom_data, this->blobs_[0]->cpu_data(), (Dtype)0., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
@@ -0,0 +1,53 @@
+#include <vector>
+
+#include "caffe/layers/layout_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void LayoutLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  CHECK_NE(top[0], bottom[0]) << this->type() << " Layer does not "
+      "allow in-place computation.";
+  CHECK_EQ(4, bottom[0]->num_axes()) << "Layout takes 4-D blobs.";
+  const Layout layout = this->layer_param_.layout_param().layout();
+  CHECK_NE(layout, bottom[0]->layout())
+      << "The bottom of " << this->layer_param_.name() << " is already in "
+      << Layout_Name(layout);
+  num_ = bottom[0]->num();
+  channels_ = bottom[0]->channels();
+  spatial_dim_ = bottom[0]->count(2);
+  top[0]->Reshape(bottom[0]->shape());
+  top[0]->set_layout(layout);
+}
+
+template <typename Dtype>
+void LayoutLayer<Dtype>::Convert(const Layout from, const Dtype* x,
+    Dtype* y) const {
+  if (from == NCHW) {
+    // Each image is a C x HW matrix to transpose.
+    caffe_cpu_transpose(num_, channels_, spatial_dim_, x, y);
+  } else {
+    caffe_cpu_transpose(num_, spatial_dim_, channels_, x, y);
+  }
+}
+
+template <typename Dtype>
+void LayoutLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  Convert(bottom[0]->layout(), bottom[0]->cpu_data(),
+      top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void LayoutLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) { return; }
+  Convert(top[0]->layout(), top[0]->cpu_diff(), bottom[0]->mutable_cpu_diff());
+}
+
+INSTANTIATE_CLASS(LayoutLayer);
+REGISTER_LAYER_CLASS(Layout);
+
+}  // namespace caffe
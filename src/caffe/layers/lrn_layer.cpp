@@ -1,10 +1,184 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// Spatial positions per block: the rows of a block stay in cache while the
+// channel window slides down them.
+const int kBlockInner = 512;
+
+// Cross channel LRN of a (channels, n) block whose rows are stride apart,
+// keeping the sum of squares over the window in sum as it slides over the
+// channels.
+template <typename Dtype>
+void CrossChannelForwardBlock(const int channels, const int n,
+    const int stride, const int pre_pad, const Dtype k,
+    const Dtype alpha_over_size, const Dtype beta, const Dtype* x,
+    Dtype* scale, Dtype* y, Dtype* sum) {
+  caffe_set(n, Dtype(0), sum);
+  for (int c = 0; c < std::min(pre_pad, channels); ++c) {
+    const Dtype* x_row = x + c * stride;
+    for (int i = 0; i < n; ++i) {
+      sum[i] += x_row[i] * x_row[i];
+    }
+  }
+  for (int c = 0; c < channels; ++c) {
+    // The window of channel c is [c - pre_pad, c + pre_pad].
+    if (c + pre_pad < channels) {
+      const Dtype* head = x + (c + pre_pad) * stride;
+      for (int i = 0; i < n; ++i) {
+        sum[i] += head[i] * head[i];
+      }
+    }
+    if (c - pre_pad > 0) {
+      const Dtype* tail = x + (c - pre_pad - 1) * stride;
+      for (int i = 0; i < n; ++i) {
+        sum[i] -= tail[i] * tail[i];
+      }
+    }
+    Dtype* scale_row = scale + c * stride;
+    for (int i = 0; i < n; ++i) {
+      scale_row[i] = k + alpha_over_size * sum[i];
+    }
+    const Dtype* x_row = x + c * stride;
+    Dtype* y_row = y + c * stride;
+    caffe_powx(n, scale_row, -beta, y_row);
+    for (int i = 0; i < n; ++i) {
+      y_row[i] *= x_row[i];
+    }
+  }
+}
+
+// The bottom diff of a block, with the window sum of top_diff * y / scale
+// kept in accum_ratio.
+template <typename Dtype>
+void CrossChannelBackwardBlock(const int channels, const int n,
+    const int stride, const int pre_pad, const Dtype beta,
+    const Dtype cache_ratio, const Dtype* x, const Dtype* y,
+    const Dtype* scale, const Dtype* top_diff, Dtype* bottom_diff,
+    Dtype* accum_ratio) {
+  caffe_set(n, Dtype(0), accum_ratio);
+  for (int c = 0; c < std::min(pre_pad, channels); ++c) {
+    const int row = c * stride;
+    for (int i = 0; i < n; ++i) {
+      accum_ratio[i] += top_diff[row + i] * y[row + i] / scale[row + i];
+    }
+  }
+  for (int c = 0; c < channels; ++c) {
+    if (c + pre_pad < channels) {
+      const int head = (c + pre_pad) * stride;
+      for (int i = 0; i < n; ++i) {
+        accum_ratio[i] +=
+            top_diff[head + i] * y[head + i] / scale[head + i];
+      }
+    }
+    if (c - pre_pad > 0) {
+      const int tail = (c - pre_pad - 1) * stride;
+      for (int i = 0; i < n; ++i) {
+        accum_ratio[i] -=
+            top_diff[tail + i] * y[tail + i] / scale[tail + i];
+      }
+    }
+    const int row = c * stride;
+    Dtype* diff_row = bottom_diff + row;
+    caffe_powx(n, scale + row, -beta, diff_row);
+    for (int i = 0; i < n; ++i) {
+      diff_row[i] = diff_row[i] * top_diff[row + i]
+          - cache_ratio * x[row + i] * accum_ratio[i];
+    }
+  }
+}
+
+// Sums x over the size x size window around each position of a height x
+// width plane, clipped at the borders: a running sum along each row into
+// row_sum, then a running sum of the row_sum rows down the plane.
+template <typename Dtype>
+void WithinChannelWindowSum(const int height, const int width,
+    const int pre_pad, const Dtype* x, Dtype* row_sum, Dtype* sum) {
+  for (int h = 0; h < height; ++h) {
+    const Dtype* x_row = x + h * width;
+    Dtype* row_sum_row = row_sum + h * width;
+    Dtype running = 0;
+    for (int w = 0; w < std::min(pre_pad, width); ++w) {
+      running += x_row[w];
+    }
+    for (int w = 0; w < width; ++w) {
+      if (w + pre_pad < width) { running += x_row[w + pre_pad]; }
+      if (w - pre_pad > 0) { running -= x_row[w - pre_pad - 1]; }
+      row_sum_row[w] = running;
+    }
+  }
+  for (int h = 0; h < height; ++h) {
+    Dtype* sum_row = sum + h * width;
+    if (h == 0) {
+      caffe_set(width, Dtype(0), sum_row);
+      for (int r = 0; r < std::min(pre_pad, height); ++r) {
+        caffe_axpy(width, Dtype(1), row_sum + r * width, sum_row);
+      }
+    } else {
+      caffe_copy(width, sum_row - width, sum_row);
+    }
+    if (h + pre_pad < height) {
+      caffe_axpy(width, Dtype(1), row_sum + (h + pre_pad) * width, sum_row);
+    }
+    if (h - pre_pad > 0) {
+      caffe_axpy(width, Dtype(-1), row_sum + (h - pre_pad - 1) * width,
+          sum_row);
+    }
+  }
+}
+
+// Within channel LRN of one plane of n = height * width values. As the
+// pooling chain on the GPU, the window sum is averaged over size * size
+// whatever the borders clip, and k is not used.
+template <typename Dtype>
+void WithinChannelForwardPlane(const int height, const int width,
+    const int pre_pad, const Dtype alpha_over_area, const Dtype beta,
+    const Dtype* x, Dtype* scale, Dtype* y, Dtype* work) {
+  const int n = height * width;
+  Dtype* squares = work;
+  for (int i = 0; i < n; ++i) {
+    squares[i] = x[i] * x[i];
+  }
+  WithinChannelWindowSum(height, width, pre_pad, squares, work + n, scale);
+  for (int i = 0; i < n; ++i) {
+    scale[i] = 1 + alpha_over_area * scale[i];
+  }
+  caffe_powx(n, scale, -beta, y);
+  for (int i = 0; i < n; ++i) {
+    y[i] *= x[i];
+  }
+}
+
+// The bottom diff of a plane, with the window sum of top_diff * y / scale.
+template <typename Dtype>
+void WithinChannelBackwardPlane(const int height, const int width,
+    const int pre_pad, const Dtype beta, const Dtype cache_ratio,
+    const Dtype* x, const Dtype* y, const Dtype* scale,
+    const Dtype* top_diff, Dtype* bottom_diff, Dtype* work) {
+  const int n = height * width;
+  Dtype* ratio = work;
+  for (int i = 0; i < n; ++i) {
+    ratio[i] = top_diff[i] * y[i] / scale[i];
+  }
+  Dtype* accum_ratio = work + 2 * n;
+  WithinChannelWindowSum(height, width, pre_pad, ratio, work + n,
+      accum_ratio);
+  caffe_powx(n, scale, -beta, bottom_diff);
+  for (int i = 0; i < n; ++i) {
+    bottom_diff[i] = bottom_diff[i] * top_diff[i]
+        - cache_ratio * x[i] * accum_ratio[i];
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void LRNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -80,6 +254,7 @@ void LRNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     scale_.Reshape(num_, channels_, height_, width_);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
+    scale_.Reshape(num_, channels_, height_, width_);
     split_layer_->Reshape(bottom, split_top_vec_);
     square_layer_->Reshape(square_bottom_vec_, square_top_vec_);
     pool_layer_->Reshape(square_top_vec_, pool_top_vec_);
@@ -97,7 +272,7 @@ void LRNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     CrossChannelForward_cpu(bottom, top);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
-    WithinChannelForward(bottom, top);
+    WithinChannelForward_cpu(bottom, top);
     break;
   default:
     LOG(ERROR) << "Unknown normalization region.";
@@ -111,45 +286,41 @@ void LRNLayer<Dtype>::CrossChannelForward_cpu(
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
-  }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
-  Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
-  for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
+  const int inner_num = height_ * width_;
+  if (num_ == 0 || channels_ == 0 || inner_num == 0) { return; }
+  const int block = std::min(inner_num, kBlockInner);
+  const int blocks = (inner_num + block - 1) / block;
+  const int dim = channels_ * inner_num;
+  parallel_for(num_ * blocks, [&](int begin, int end) {
+    vector<Dtype> sum(block);
+    for (int i = begin; i < end; ++i) {
+      const int k = (i % blocks) * block;
+      const int offset = (i / blocks) * dim + k;
+      CrossChannelForwardBlock(channels_, std::min(block, inner_num - k),
+          inner_num, pre_pad_, k_, alpha_ / size_, beta_,
+          bottom_data + offset, scale_data + offset, top_data + offset,
+          &sum[0]);
     }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
-    }
-  }
+  }, parallel_grain(channels_ * block));
+}
 
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelForward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  Dtype* scale_data = scale_.mutable_cpu_data();
+  const int inner_num = height_ * width_;
+  if (inner_num == 0) { return; }
+  parallel_for(num_ * channels_, [&](int begin, int end) {
+    vector<Dtype> work(2 * inner_num);
+    for (int i = begin; i < end; ++i) {
+      const int offset = i * inner_num;
+      WithinChannelForwardPlane(height_, width_, pre_pad_,
+          alpha_ / (size_ * size_), beta_, bottom_data + offset,
+          scale_data + offset, top_data + offset, &work[0]);
+    }
+  }, parallel_grain(inner_num));
 }
 
 template <typename Dtype>
@@ -170,7 +341,7 @@ void LRNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     CrossChannelBackward_cpu(top, propagate_down, bottom);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
-    WithinChannelBackward(top, propagate_down, bottom);
+    WithinChannelBackward_cpu(top, propagate_down, bottom);
     break;
   default:
     LOG(ERROR) << "Unknown normalization region.";
@@ -182,55 +353,52 @@ template <typename Dtype>
 void LRNLayer<Dtype>::CrossChannelBackward_cpu(
     const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) { return; }
   const Dtype* top_diff = top[0]->cpu_diff();
   const Dtype* top_data = top[0]->cpu_data();
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const Dtype* scale_data = scale_.cpu_data();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  Blob<Dtype> padded_ratio(1, channels_ + size_ - 1, height_, width_);
-  Blob<Dtype> accum_ratio(1, 1, height_, width_);
-  Dtype* padded_ratio_data = padded_ratio.mutable_cpu_data();
-  Dtype* accum_ratio_data = accum_ratio.mutable_cpu_data();
-  // We hack a little bit by using the diff() to store an additional result
-  Dtype* accum_ratio_times_bottom = accum_ratio.mutable_cpu_diff();
-  caffe_set(padded_ratio.count(), Dtype(0), padded_ratio_data);
-  Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
-
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, bottom_diff);
-  caffe_mul<Dtype>(scale_.count(), top_diff, bottom_diff, bottom_diff);
-
-  // go through individual data
-  int inverse_pre_pad = size_ - (size_ + 1) / 2;
-  for (int n = 0; n < num_; ++n) {
-    int block_offset = scale_.offset(n);
-    // first, compute diff_i * y_i / s_i
-    caffe_mul<Dtype>(channels_ * height_ * width_,
-        top_diff + block_offset, top_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    caffe_div<Dtype>(channels_ * height_ * width_,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad),
-        scale_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    // Now, compute the accumulated ratios and the bottom diff
-    caffe_set(accum_ratio.count(), Dtype(0), accum_ratio_data);
-    for (int c = 0; c < size_ - 1; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
+  const int inner_num = height_ * width_;
+  if (num_ == 0 || channels_ == 0 || inner_num == 0) { return; }
+  const int block = std::min(inner_num, kBlockInner);
+  const int blocks = (inner_num + block - 1) / block;
+  const int dim = channels_ * inner_num;
+  parallel_for(num_ * blocks, [&](int begin, int end) {
+    vector<Dtype> accum_ratio(block);
+    for (int i = begin; i < end; ++i) {
+      const int k = (i % blocks) * block;
+      const int offset = (i / blocks) * dim + k;
+      CrossChannelBackwardBlock(channels_, std::min(block, inner_num - k),
+          inner_num, pre_pad_, beta_, Dtype(2. * alpha_ * beta_ / size_),
+          bottom_data + offset, top_data + offset, scale_data + offset,
+          top_diff + offset, bottom_diff + offset, &accum_ratio[0]);
     }
-    for (int c = 0; c < channels_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c + size_ - 1),
-          accum_ratio_data);
-      // compute bottom diff
-      caffe_mul<Dtype>(height_ * width_,
-          bottom_data + top[0]->offset(n, c),
-          accum_ratio_data, accum_ratio_times_bottom);
-      caffe_axpy<Dtype>(height_ * width_, -cache_ratio_value,
-          accum_ratio_times_bottom, bottom_diff + top[0]->offset(n, c));
-      caffe_axpy<Dtype>(height_ * width_, -1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
+  }, parallel_grain(channels_ * block));
+}
+
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelBackward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) { return; }
+  const Dtype* top_diff = top[0]->cpu_diff();
+  const Dtype* top_data = top[0]->cpu_data();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* scale_data = scale_.cpu_data();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  const int inner_num = height_ * width_;
+  if (inner_num == 0) { return; }
+  parallel_for(num_ * channels_, [&](int begin, int end) {
+    vector<Dtype> work(3 * inner_num);
+    for (int i = begin; i < end; ++i) {
+      const int offset = i * inner_num;
+      WithinChannelBackwardPlane(height_, width_, pre_pad_, beta_,
+          Dtype(2. * alpha_ * beta_ / (size_ * size_)), bottom_data + offset,
+          top_data + offset, scale_data + offset, top_diff + offset,
+          bottom_diff + offset, &work[0]);
     }
-  }
+  }, parallel_grain(inner_num));
 }
 
 template <typename Dtype>
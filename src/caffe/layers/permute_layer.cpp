@@ -9,20 +9,25 @@ template <typename Dtype>
 void Permute(const int count, Dtype* bottom_data, const bool forward,
     const int* permute_order, const int* old_steps, const int* new_steps,
     const int num_axes, Dtype* top_data) {
-    for (int i = 0; i < count; ++i) {
-      int old_idx = 0;
-      int idx = i;
-      for (int j = 0; j < num_axes; ++j) {
-        int order = permute_order[j];
-        old_idx += (idx / new_steps[j]) * old_steps[order];
-        idx %= new_steps[j];
-      }
-      if (forward) {
-        top_data[i] = bottom_data[old_idx];
-      } else {
-        bottom_data[old_idx] = top_data[i];
-      }
-    }
+  if (count == 0) { return; }
+  // Top axis j is bottom axis permute_order[j]: forward gathers the top
+  // along the bottom's steps, backward gathers the bottom along the top's.
+  vector<int> top_shape(num_axes), bottom_steps(num_axes);
+  vector<int> bottom_shape(num_axes), top_steps(num_axes);
+  for (int j = 0; j < num_axes; ++j) {
+    const int order = permute_order[j];
+    top_shape[j] = (j == 0 ? count : new_steps[j - 1]) / new_steps[j];
+    bottom_steps[j] = old_steps[order];
+    bottom_shape[order] = top_shape[j];
+    top_steps[order] = new_steps[j];
+  }
+  if (forward) {
+    caffe_cpu_permute(num_axes, &top_shape[0], &bottom_steps[0],
+        static_cast<const Dtype*>(bottom_data), top_data);
+  } else {
+    caffe_cpu_permute(num_axes, &bottom_shape[0], &top_steps[0],
+        static_cast<const Dtype*>(top_data), bottom_data);
+  }
 }
 
 template <typename Dtype>
@@ -4,6 +4,7 @@
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -121,9 +122,11 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (top.size() > 1) {
     top[1]->ReshapeLike(*top[0]);
   }
-  // If max pooling, we will initialize the vector index part.
+  // If max pooling, we will initialize the vector index part. It is only
+  // kept for Backward in training.
   if (this->layer_param_.pooling_param().pool() ==
-      PoolingParameter_PoolMethod_MAX && top.size() == 1) {
+      PoolingParameter_PoolMethod_MAX && top.size() == 1 &&
+      this->phase_ == TRAIN) {
     max_idx_.Reshape(bottom[0]->num(), channels_, pooled_height_,
         pooled_width_);
   }
@@ -135,101 +138,270 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
-// TODO(Yangqing): Is there a faster way to do pooling in the channel-first
-// case?
+namespace {
+
+struct PoolShape {
+  int height, width;
+  int pooled_height, pooled_width;
+  int kernel_h, kernel_w;
+  int stride_h, stride_w;
+  int pad_h, pad_w;
+};
+
+// Stands for the mask of max pooling when nobody reads it.
+struct NoMask {};
+
+template <typename Mask>
+inline void SetMask(Mask* mask, const int i, const int index) {
+  mask[i] = static_cast<Mask>(index);
+}
+
+inline void SetMask(NoMask* mask, const int i, const int index) {}
+
+// The window of output (ph, pw), clipped to the image, and the size that
+// average pooling divides by, which counts the padding.
+inline int PoolWindow(const PoolShape& s, const int ph, const int pw,
+    int* hstart, int* hend, int* wstart, int* wend) {
+  *hstart = ph * s.stride_h - s.pad_h;
+  *wstart = pw * s.stride_w - s.pad_w;
+  *hend = min(*hstart + s.kernel_h, s.height + s.pad_h);
+  *wend = min(*wstart + s.kernel_w, s.width + s.pad_w);
+  const int pool_size = (*hend - *hstart) * (*wend - *wstart);
+  *hstart = max(*hstart, 0);
+  *wstart = max(*wstart, 0);
+  *hend = min(*hend, s.height);
+  *wend = min(*wend, s.width);
+  return pool_size;
+}
+
+template <typename Dtype, typename Mask>
+inline void MaxPoolAt(const Dtype* bottom, const PoolShape& s, const int ph,
+    const int pw, Dtype* top, Mask* mask) {
+  int hstart, hend, wstart, wend;
+  PoolWindow(s, ph, pw, &hstart, &hend, &wstart, &wend);
+  Dtype best = -FLT_MAX;
+  int best_index = -1;
+  for (int h = hstart; h < hend; ++h) {
+    for (int w = wstart; w < wend; ++w) {
+      const int index = h * s.width + w;
+      if (bottom[index] > best) {
+        best = bottom[index];
+        best_index = index;
+      }
+    }
+  }
+  const int pool_index = ph * s.pooled_width + pw;
+  top[pool_index] = best;
+  SetMask(mask, pool_index, best_index);
+}
+
+template <typename Dtype>
+inline void AvePoolAt(const Dtype* bottom, const PoolShape& s, const int ph,
+    const int pw, Dtype* top) {
+  int hstart, hend, wstart, wend;
+  const int pool_size = PoolWindow(s, ph, pw, &hstart, &hend, &wstart, &wend);
+  Dtype sum = 0;
+  for (int h = hstart; h < hend; ++h) {
+    for (int w = wstart; w < wend; ++w) {
+      sum += bottom[h * s.width + w];
+    }
+  }
+  top[ph * s.pooled_width + pw] = sum / pool_size;
+}
+
+// The outputs [*begin, *end) of an axis whose windows are inside the image.
+inline void InsideRange(const int size, const int pooled, const int kernel,
+    const int stride, const int pad, int* begin, int* end) {
+  *begin = min(pooled, (pad + stride - 1) / stride);
+  *end = size + pad >= kernel ?
+      max(*begin, min(pooled, (size + pad - kernel) / stride + 1)) : *begin;
+}
+
+// The pooling of one channel, for any window.
+template <typename Dtype, typename Mask>
+void MaxPoolPlane(const Dtype* bottom, const PoolShape& s, Dtype* top,
+    Mask* mask) {
+  for (int ph = 0; ph < s.pooled_height; ++ph) {
+    for (int pw = 0; pw < s.pooled_width; ++pw) {
+      MaxPoolAt(bottom, s, ph, pw, top, mask);
+    }
+  }
+}
+
+template <typename Dtype, typename Mask>
+void AvePoolPlane(const Dtype* bottom, const PoolShape& s, Dtype* top,
+    Mask* mask) {
+  for (int ph = 0; ph < s.pooled_height; ++ph) {
+    for (int pw = 0; pw < s.pooled_width; ++pw) {
+      AvePoolAt(bottom, s, ph, pw, top);
+    }
+  }
+}
+
+// The pooling of one channel with a K x K window and stride S. Windows
+// inside the image take the unrolled, branch free loop; the others the
+// clipped one.
+template <typename Dtype, typename Mask, int K, int S>
+void MaxPoolPlaneFixed(const Dtype* bottom, const PoolShape& s, Dtype* top,
+    Mask* mask) {
+  int ph_begin, ph_end, pw_begin, pw_end;
+  InsideRange(s.height, s.pooled_height, K, S, s.pad_h, &ph_begin, &ph_end);
+  InsideRange(s.width, s.pooled_width, K, S, s.pad_w, &pw_begin, &pw_end);
+  for (int ph = 0; ph < s.pooled_height; ++ph) {
+    if (ph < ph_begin || ph >= ph_end) {
+      for (int pw = 0; pw < s.pooled_width; ++pw) {
+        MaxPoolAt(bottom, s, ph, pw, top, mask);
+      }
+      continue;
+    }
+    for (int pw = 0; pw < pw_begin; ++pw) {
+      MaxPoolAt(bottom, s, ph, pw, top, mask);
+    }
+    const int hstart = ph * S - s.pad_h;
+    for (int pw = pw_begin; pw < pw_end; ++pw) {
+      const int wstart = pw * S - s.pad_w;
+      const Dtype* window = bottom + hstart * s.width + wstart;
+      Dtype best = -FLT_MAX;
+      int best_index = -1;
+      for (int kh = 0; kh < K; ++kh) {
+        for (int kw = 0; kw < K; ++kw) {
+          const Dtype value = window[kh * s.width + kw];
+          const bool larger = value > best;
+          best = larger ? value : best;
+          best_index = larger ? (hstart + kh) * s.width + wstart + kw :
+              best_index;
+        }
+      }
+      top[ph * s.pooled_width + pw] = best;
+      SetMask(mask, ph * s.pooled_width + pw, best_index);
+    }
+    for (int pw = pw_end; pw < s.pooled_width; ++pw) {
+      MaxPoolAt(bottom, s, ph, pw, top, mask);
+    }
+  }
+}
+
+template <typename Dtype, typename Mask, int K, int S>
+void AvePoolPlaneFixed(const Dtype* bottom, const PoolShape& s, Dtype* top,
+    Mask* mask) {
+  int ph_begin, ph_end, pw_begin, pw_end;
+  InsideRange(s.height, s.pooled_height, K, S, s.pad_h, &ph_begin, &ph_end);
+  InsideRange(s.width, s.pooled_width, K, S, s.pad_w, &pw_begin, &pw_end);
+  const Dtype scale = Dtype(1) / (K * K);
+  for (int ph = 0; ph < s.pooled_height; ++ph) {
+    if (ph < ph_begin || ph >= ph_end) {
+      for (int pw = 0; pw < s.pooled_width; ++pw) {
+        AvePoolAt(bottom, s, ph, pw, top);
+      }
+      continue;
+    }
+    for (int pw = 0; pw < pw_begin; ++pw) {
+      AvePoolAt(bottom, s, ph, pw, top);
+    }
+    const Dtype* row = bottom + (ph * S - s.pad_h) * s.width - s.pad_w;
+    for (int pw = pw_begin; pw < pw_end; ++pw) {
+      const Dtype* window = row + pw * S;
+      Dtype sum = 0;
+      for (int kh = 0; kh < K; ++kh) {
+        for (int kw = 0; kw < K; ++kw) {
+          sum += window[kh * s.width + kw];
+        }
+      }
+      top[ph * s.pooled_width + pw] = sum * scale;
+    }
+    for (int pw = pw_end; pw < s.pooled_width; ++pw) {
+      AvePoolAt(bottom, s, ph, pw, top);
+    }
+  }
+}
+
+// The pooling of a whole unpadded channel into one value.
+template <typename Dtype, typename Mask>
+void MaxPoolPlaneGlobal(const Dtype* bottom, const PoolShape& s, Dtype* top,
+    Mask* mask) {
+  Dtype best = -FLT_MAX;
+  int best_index = -1;
+  for (int i = 0; i < s.height * s.width; ++i) {
+    const bool larger = bottom[i] > best;
+    best = larger ? bottom[i] : best;
+    best_index = larger ? i : best_index;
+  }
+  top[0] = best;
+  SetMask(mask, 0, best_index);
+}
+
+template <typename Dtype, typename Mask>
+void AvePoolPlaneGlobal(const Dtype* bottom, const PoolShape& s, Dtype* top,
+    Mask* mask) {
+  Dtype sum = 0;
+  for (int i = 0; i < s.height * s.width; ++i) {
+    sum += bottom[i];
+  }
+  top[0] = sum / (s.height * s.width);
+}
+
+// Pools each of planes channels, spread over Caffe::thread_pool().
+template <typename Dtype, typename Mask>
+void PoolPlanes(const bool max_pool, const PoolShape& s, const int planes,
+    const Dtype* bottom, Dtype* top, Mask* mask) {
+  typedef void (*PlaneFunction)(const Dtype*, const PoolShape&, Dtype*,
+      Mask*);
+  const bool global = s.pooled_height == 1 && s.pooled_width == 1 &&
+      s.kernel_h == s.height && s.kernel_w == s.width && !s.pad_h && !s.pad_w;
+  const bool square = s.kernel_h == s.kernel_w && s.stride_h == s.stride_w;
+  PlaneFunction pool;
+  if (global) {
+    pool = max_pool ? &MaxPoolPlaneGlobal<Dtype, Mask> :
+        &AvePoolPlaneGlobal<Dtype, Mask>;
+  } else if (square && s.kernel_h == 2 && s.stride_h == 2) {
+    pool = max_pool ? &MaxPoolPlaneFixed<Dtype, Mask, 2, 2> :
+        &AvePoolPlaneFixed<Dtype, Mask, 2, 2>;
+  } else if (square && s.kernel_h == 3 && s.stride_h == 2) {
+    pool = max_pool ? &MaxPoolPlaneFixed<Dtype, Mask, 3, 2> :
+        &AvePoolPlaneFixed<Dtype, Mask, 3, 2>;
+  } else {
+    pool = max_pool ? &MaxPoolPlane<Dtype, Mask> : &AvePoolPlane<Dtype, Mask>;
+  }
+  const int bottom_dim = s.height * s.width;
+  const int top_dim = s.pooled_height * s.pooled_width;
+  parallel_for(planes, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      pool(bottom + static_cast<size_t>(i) * bottom_dim, s,
+          top + static_cast<size_t>(i) * top_dim,
+          mask ? mask + static_cast<size_t>(i) * top_dim : NULL);
+    }
+  }, parallel_grain(bottom_dim));
+}
+
+}  // namespace
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
-  // We'll output the mask to top[1] if it's of size >1.
-  const bool use_top_mask = top.size() > 1;
-  int* mask = NULL;  // suppress warnings about uninitialized variables
-  Dtype* top_mask = NULL;
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more code.
+  const int planes = bottom[0]->num() * channels_;
+  const PoolShape shape = { height_, width_, pooled_height_,
+      pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_, pad_h_,
+      pad_w_ };
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // Initialize
-    if (use_top_mask) {
-      top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
+    // We'll output the mask to top[1] if it's of size >1, and keep it for
+    // Backward in training.
+    if (top.size() > 1) {
+      PoolPlanes(true, shape, planes, bottom_data, top_data,
+          top[1]->mutable_cpu_data());
+    } else if (this->phase_ == TRAIN) {
+      PoolPlanes(true, shape, planes, bottom_data, top_data,
+          max_idx_.mutable_cpu_data());
     } else {
-      mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
-    }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
-              }
-            }
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
+      PoolPlanes(true, shape, planes, bottom_data, top_data,
+          static_cast<NoMask*>(NULL));
     }
     break;
   case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
-            }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-      }
-    }
+    PoolPlanes(false, shape, planes, bottom_data, top_data,
+        static_cast<NoMask*>(NULL));
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     CAFFE1_NOT_IMPLEMENTED;
@@ -260,6 +432,17 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
     } else {
+      if (this->phase_ != TRAIN) {
+        // Forward only keeps the mask in training: find the maxima again.
+        const PoolShape shape = { height_, width_, pooled_height_,
+            pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_,
+            pad_h_, pad_w_ };
+        vector<Dtype> pooled(top[0]->count());
+        max_idx_.Reshape(top[0]->shape());
+        PoolPlanes(true, shape, top[0]->num() * channels_,
+            bottom[0]->cpu_data(), pooled.data(),
+            max_idx_.mutable_cpu_data());
+      }
       mask = max_idx_.cpu_data();
     }
     for (int n = 0; n < top[0]->num(); ++n) {
@@ -194,6 +194,8 @@ void PoolingLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     if (use_top_mask) {
       top_mask = top[1]->mutable_gpu_data();
     } else {
+      // Reshape only allocates it in the TRAIN phase.
+      max_idx_.Reshape(top[0]->shape());
       mask = max_idx_.mutable_gpu_data();
     }
     // NOLINT_NEXT_LINE(whitespace/operators)
@@ -4,6 +4,7 @@
 #include "caffe/filler.hpp"
 #include "caffe/layer_factory.hpp"
 #include "caffe/layers/scale_layer.hpp"
+#include "caffe/util/eltwise.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -101,12 +102,9 @@ void ScaleLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   } else {
     top[0]->ReshapeLike(*bottom[0]);
   }
+  // Only the GPU backward needs these; it fills the ones on first use.
   sum_result_.Reshape(vector<int>(1, outer_dim_ * scale_dim_));
-  const int sum_mult_size = std::max(outer_dim_, inner_dim_);
-  sum_multiplier_.Reshape(vector<int>(1, sum_mult_size));
-  if (sum_multiplier_.cpu_data()[sum_mult_size - 1] != Dtype(1)) {
-    caffe_set(sum_mult_size, Dtype(1), sum_multiplier_.mutable_cpu_data());
-  }
+  sum_multiplier_.Reshape(vector<int>(1, std::max(outer_dim_, inner_dim_)));
   if (bias_layer_) {
     bias_bottom_vec_[0] = top[0];
     bias_layer_->Reshape(bias_bottom_vec_, top);
@@ -127,18 +125,13 @@ void ScaleLayer<Dtype>::Forward_cpu(
   }
   const Dtype* scale_data =
       ((bottom.size() > 1) ? bottom[1] : this->blobs_[0].get())->cpu_data();
+  // The bias, if any, shares the scale's broadcast and is added in the same
+  // pass; bias_layer_ is only kept for Backward.
+  const Dtype* bias_data = bias_layer_ ?
+      this->blobs_[bias_param_id_]->cpu_data() : NULL;
   Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int n = 0; n < outer_dim_; ++n) {
-    for (int d = 0; d < scale_dim_; ++d) {
-      const Dtype factor = scale_data[d];
-      caffe_cpu_scale(inner_dim_, factor, bottom_data, top_data);
-      bottom_data += inner_dim_;
-      top_data += inner_dim_;
-    }
-  }
-  if (bias_layer_) {
-    bias_layer_->Forward(bias_bottom_vec_, top);
-  }
+  broadcast_axpby_cpu<Dtype>(outer_dim_, scale_dim_, inner_dim_, scale_data,
+      bottom_data, bias_data, NULL, top_data);
 }
 
 template <typename Dtype>
@@ -155,65 +148,14 @@ void ScaleLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     const bool in_place = (bottom[0] == top[0]);
     const Dtype* bottom_data = (in_place ? &temp_ : bottom[0])->cpu_data();
-    // Hack: store big eltwise product in bottom[0] diff, except in the special
-    // case where this layer itself does the eltwise product, in which case we
-    // can store it directly in the scale diff, and we're done.
-    // If we're computing in-place (and not doing eltwise computation), this
-    // hack doesn't work and we store the product in temp_.
-    const bool is_eltwise = (bottom[0]->count() == scale->count());
-    Dtype* product = (is_eltwise ? scale->mutable_cpu_diff() :
-        (in_place ? temp_.mutable_cpu_data() : bottom[0]->mutable_cpu_diff()));
-    caffe_mul(top[0]->count(), top_diff, bottom_data, product);
-    if (!is_eltwise) {
-      Dtype* sum_result = NULL;
-      if (inner_dim_ == 1) {
-        sum_result = product;
-      } else if (sum_result_.count() == 1) {
-        const Dtype* sum_mult = sum_multiplier_.cpu_data();
-        Dtype* scale_diff = scale->mutable_cpu_diff();
-        if (scale_param) {
-          Dtype result = caffe_cpu_dot(inner_dim_, product, sum_mult);
-          *scale_diff += result;
-        } else {
-          *scale_diff = caffe_cpu_dot(inner_dim_, product, sum_mult);
-        }
-      } else {
-        const Dtype* sum_mult = sum_multiplier_.cpu_data();
-        sum_result = (outer_dim_ == 1) ?
-            scale->mutable_cpu_diff() : sum_result_.mutable_cpu_data();
-        caffe_cpu_gemv(CblasNoTrans, sum_result_.count(), inner_dim_,
-                       Dtype(1), product, sum_mult, Dtype(0), sum_result);
-      }
-      if (outer_dim_ != 1) {
-        const Dtype* sum_mult = sum_multiplier_.cpu_data();
-        Dtype* scale_diff = scale->mutable_cpu_diff();
-        if (scale_dim_ == 1) {
-          if (scale_param) {
-            Dtype result = caffe_cpu_dot(outer_dim_, sum_mult, sum_result);
-            *scale_diff += result;
-          } else {
-            *scale_diff = caffe_cpu_dot(outer_dim_, sum_mult, sum_result);
-          }
-        } else {
-          caffe_cpu_gemv(CblasTrans, outer_dim_, scale_dim_,
-                         Dtype(1), sum_result, sum_mult, Dtype(scale_param),
-                         scale_diff);
-        }
-      }
-    }
+    // The products are summed as they are formed: no eltwise product blob.
+    broadcast_reduce_cpu<Dtype>(outer_dim_, scale_dim_, inner_dim_, top_diff,
+        bottom_data, scale_param, scale->mutable_cpu_diff());
   }
   if (propagate_down[0]) {
-    const Dtype* top_diff = top[0]->cpu_diff();
-    const Dtype* scale_data = scale->cpu_data();
-    Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    for (int n = 0; n < outer_dim_; ++n) {
-      for (int d = 0; d < scale_dim_; ++d) {
-        const Dtype factor = scale_data[d];
-        caffe_cpu_scale(inner_dim_, factor, top_diff, bottom_diff);
-        bottom_diff += inner_dim_;
-        top_diff += inner_dim_;
-      }
-    }
+    broadcast_axpby_cpu<Dtype>(outer_dim_, scale_dim_, inner_dim_,
+        scale->cpu_data(), top[0]->cpu_diff(), NULL, NULL,
+        bottom[0]->mutable_cpu_diff());
   }
 }
 
@@ -79,6 +79,11 @@ void ScaleLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
         (in_place ? temp_.mutable_gpu_data() : bottom[0]->mutable_gpu_diff()));
     caffe_gpu_mul(top[0]->count(), top_diff, bottom_data, product);
     if (!is_eltwise) {
+      const int sum_mult_size = sum_multiplier_.count();
+      if (sum_multiplier_.cpu_data()[sum_mult_size - 1] != Dtype(1)) {
+        caffe_set(sum_mult_size, Dtype(1),
+            sum_multiplier_.mutable_cpu_data());
+      }
       Dtype* sum_result = NULL;
       if (inner_dim_ == 1) {
         sum_result = product;
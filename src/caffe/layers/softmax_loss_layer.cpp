@@ -4,6 +4,7 @@
 
 #include "caffe/layers/softmax_loss_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/softmax.hpp"
 
 namespace caffe {
 
@@ -33,6 +34,10 @@ void SoftmaxWithLossLayer<Dtype>::LayerSetUp(
   } else {
     normalization_ = this->layer_param_.loss_param().normalization();
   }
+  const SoftmaxParameter& temperature_param =
+      this->layer_param_.softmax_param();
+  softmax_scale_ = temperature_param.has_scaling_temperature() ?
+      Dtype(1) / temperature_param.scaling_temperature() : Dtype(1);
 }
 
 template <typename Dtype>
@@ -49,6 +54,7 @@ void SoftmaxWithLossLayer<Dtype>::Reshape(
       << "e.g., if softmax axis == 1 and prediction shape is (N, C, H, W), "
       << "label count (number of labels) must be N*H*W, "
       << "with integer values in {0, 1, ..., C-1}.";
+  log_norm_.Reshape(vector<int>(1, outer_num_ * inner_num_));
   if (top.size() >= 2) {
     // softmax output
     top[1]->ReshapeLike(*bottom[0]);
@@ -58,10 +64,15 @@ void SoftmaxWithLossLayer<Dtype>::Reshape(
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  // The forward pass computes the softmax prob values.
-  softmax_layer_->Forward(softmax_bottom_vec_, softmax_top_vec_);
-  const Dtype* prob_data = prob_.cpu_data();
+  // The forward pass computes the softmax prob values in one fused pass.
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  softmax_cpu(outer_num_, bottom[0]->shape(softmax_axis_), inner_num_,
+      softmax_scale_, bottom_data, prob_.mutable_cpu_data(),
+      log_norm_.mutable_cpu_data());
+  const Dtype* log_norm = log_norm_.cpu_data();
   const Dtype* label = bottom[1]->cpu_data();
+  // -log(FLT_MIN), the largest loss a single prediction contributes.
+  const Dtype max_loss = -log(Dtype(FLT_MIN));
   int dim = prob_.count() / outer_num_;
   int count = 0;
   Dtype loss = 0;
@@ -73,8 +84,9 @@ void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
       }
       DCHECK_GE(label_value, 0);
       DCHECK_LT(label_value, prob_.shape(softmax_axis_));
-      loss -= log(std::max(prob_data[i * dim + label_value * inner_num_ + j],
-                           Dtype(FLT_MIN)));
+      // -log(prob) = log_norm - scale * x
+      loss += std::min(log_norm[i * inner_num_ + j] - softmax_scale_ *
+          bottom_data[i * dim + label_value * inner_num_ + j], max_loss);
       ++count;
     }
   }
@@ -95,11 +107,20 @@ void SoftmaxWithLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
   if (propagate_down[0]) {
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    const Dtype* prob_data = prob_.cpu_data();
-    caffe_copy(prob_.count(), prob_data, bottom_diff);
     const Dtype* label = bottom[1]->cpu_data();
     int dim = prob_.count() / outer_num_;
     int count = 0;
+    for (int i = 0; i < outer_num_ * inner_num_; ++i) {
+      if (!has_ignore_label_ || static_cast<int>(label[i]) != ignore_label_) {
+        ++count;
+      }
+    }
+    // Scale gradient: the copy of the probabilities and the scaling are
+    // fused into one pass, the labels are then subtracted in place.
+    Dtype normalizer = LossLayer<Dtype>::GetNormalizer(
+        normalization_, outer_num_, inner_num_, count);
+    Dtype loss_weight = top[0]->cpu_diff()[0] / normalizer;
+    caffe_cpu_scale(prob_.count(), loss_weight, prob_.cpu_data(), bottom_diff);
     for (int i = 0; i < outer_num_; ++i) {
       for (int j = 0; j < inner_num_; ++j) {
         const int label_value = static_cast<int>(label[i * inner_num_ + j]);
@@ -108,16 +129,10 @@ void SoftmaxWithLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
             bottom_diff[i * dim + c * inner_num_ + j] = 0;
           }
         } else {
-          bottom_diff[i * dim + label_value * inner_num_ + j] -= 1;
-          ++count;
+          bottom_diff[i * dim + label_value * inner_num_ + j] -= loss_weight;
         }
       }
     }
-    // Scale gradient
-    Dtype normalizer = LossLayer<Dtype>::GetNormalizer(
-        normalization_, outer_num_, inner_num_, count);
-    Dtype loss_weight = top[0]->cpu_diff()[0] / normalizer;
-    caffe_scal(prob_.count(), loss_weight, bottom_diff);
   }
 }
 
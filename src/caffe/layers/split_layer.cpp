@@ -1,10 +1,20 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/split_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// Values of the bottom diff summed over all the tops at a time, small enough
+// to stay in L1 between the tops.
+const int kSumBlock = 2048;
+
+}  // namespace
+
 template <typename Dtype>
 void SplitLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -38,14 +48,25 @@ void SplitLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     caffe_copy(count_, top[0]->cpu_diff(), bottom[0]->mutable_cpu_diff());
     return;
   }
-  caffe_add(count_, top[0]->cpu_diff(), top[1]->cpu_diff(),
-            bottom[0]->mutable_cpu_diff());
-  // Add remaining top blob diffs.
-  for (int i = 2; i < top.size(); ++i) {
-    const Dtype* top_diff = top[i]->cpu_diff();
-    Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    caffe_axpy(count_, Dtype(1.), top_diff, bottom_diff);
+  // One pass over the bottom diff, a block at a time, rather than one per
+  // top.
+  vector<const Dtype*> top_diff(top.size());
+  for (int i = 0; i < top.size(); ++i) {
+    top_diff[i] = top[i]->cpu_diff();
   }
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  const int count = count_;
+  parallel_for((count + kSumBlock - 1) / kSumBlock, [&](int begin, int end) {
+    for (int b = begin; b < end; ++b) {
+      const int offset = b * kSumBlock;
+      const int n = std::min(kSumBlock, count - offset);
+      caffe_add(n, top_diff[0] + offset, top_diff[1] + offset,
+          bottom_diff + offset);
+      for (int i = 2; i < top_diff.size(); ++i) {
+        caffe_axpy(n, Dtype(1.), top_diff[i] + offset, bottom_diff + offset);
+      }
+    }
+  }, parallel_grain(kSumBlock * static_cast<int>(top.size())));
 }
 
 
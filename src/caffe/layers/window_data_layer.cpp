@@ -63,6 +63,8 @@ void WindowDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       << this->layer_param_.window_data_param().root_folder();
 
   cache_images_ = this->layer_param_.window_data_param().cache_images();
+  reader_.reset(new AsyncImageReader(
+      this->layer_param_.window_data_param().read_threads()));
   string root_folder = this->layer_param_.window_data_param().root_folder();
 
   const bool prefetch_needs_rand =
@@ -264,21 +266,41 @@ void WindowDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
       * fg_fraction);
   const int num_samples[2] = { batch_size - num_fg, num_fg };
 
-  int item_id = 0;
   CHECK_GT(fg_windows_.size(), 0);
   CHECK_GT(bg_windows_.size(), 0);
 
-  // sample from bg set then fg set
+  // sample the windows from bg set then fg set, then read their images
+  // together
+  timer.Start();
+  vector<vector<float> > windows;
+  vector<bool> mirrors;
   for (int is_fg = 0; is_fg < 2; ++is_fg) {
     for (int dummy = 0; dummy < num_samples[is_fg]; ++dummy) {
-      // sample a window
-      timer.Start();
       const unsigned int rand_index = PrefetchRand();
-      vector<float> window = (is_fg) ?
+      windows.push_back((is_fg) ?
           fg_windows_[rand_index % fg_windows_.size()] :
-          bg_windows_[rand_index % bg_windows_.size()];
+          bg_windows_[rand_index % bg_windows_.size()]);
+      mirrors.push_back(mirror && PrefetchRand() % 2);
+    }
+  }
+  vector<cv::Mat> cv_imgs;
+  if (!this->cache_images_) {
+    vector<AsyncImageReader::Request> requests(windows.size());
+    for (int i = 0; i < windows.size(); ++i) {
+      const int index = windows[i][WindowDataLayer<Dtype>::IMAGE_INDEX];
+      requests[i].filename = image_database_[index].first;
+    }
+    reader_->Read(requests, &cv_imgs);
+  }
+  read_time += timer.MicroSeconds();
 
-      bool do_mirror = mirror && PrefetchRand() % 2;
+  int item_id = 0;
+  for (int is_fg = 0; is_fg < 2; ++is_fg) {
+    for (int dummy = 0; dummy < num_samples[is_fg]; ++dummy) {
+      // get the sampled window
+      timer.Start();
+      const vector<float>& window = windows[item_id];
+      bool do_mirror = mirrors[item_id];
 
       // load the image containing the window
       pair<std::string, vector<int> > image =
@@ -290,7 +312,7 @@ void WindowDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
           image_database_cache_[window[WindowDataLayer<Dtype>::IMAGE_INDEX]];
         cv_img = DecodeDatumToCVMat(image_cached.second, true);
       } else {
-        cv_img = cv::imread(image.first, CV_LOAD_IMAGE_COLOR);
+        cv_img = cv_imgs[item_id];
         if (!cv_img.data) {
           LOG(ERROR) << "Could not open or find file " << image.first;
           return;
@@ -15,6 +15,7 @@
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/insert_layouts.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/upgrade_proto.hpp"
@@ -25,7 +26,13 @@ namespace caffe {
 
 template <typename Dtype>
 Net<Dtype>::Net(const NetParameter& param, const Net* root_net)
-    : root_net_(root_net) {
+    : root_net_(root_net), weights_net_(NULL) {
+  Init(param);
+}
+
+template <typename Dtype>
+Net<Dtype>::Net(const NetParameter& param, const Net& weights_net)
+    : root_net_(NULL), weights_net_(&weights_net) {
   Init(param);
 }
 
@@ -33,7 +40,7 @@ template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase,
     const int level, const vector<string>* stages,
     const Net* root_net)
-    : root_net_(root_net) {
+    : root_net_(root_net), weights_net_(NULL) {
   NetParameter param;
   ReadNetParamsFromTextFileOrDie(param_file, &param);
   // Set phase, stages and level
@@ -62,9 +69,19 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
 #ifdef DEBUG
   LOG_IF(INFO, Caffe::root_solver()) << filtered_param.DebugString();
 #endif
-  // Create a copy of filtered_param with splits added where necessary.
+  // Convert activations between the layouts that layers compute in.
+  NetParameter layout_param;
+  if (filtered_param.layout() == NHWC && Caffe::mode() == Caffe::CPU) {
+    InsertLayoutTransforms(filtered_param, &layout_param);
+  } else {
+    LOG_IF(INFO, filtered_param.layout() != NCHW && Caffe::root_solver())
+        << "Layout " << Layout_Name(filtered_param.layout())
+        << " is for CPU mode only; computing in NCHW";
+    layout_param.CopyFrom(filtered_param);
+  }
+  // Create a copy of layout_param with splits added where necessary.
   NetParameter param;
-  InsertSplits(filtered_param, &param);
+  InsertSplits(layout_param, &param);
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
   map<string, int> blob_name_to_idx;
@@ -99,6 +116,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       layers_[layer_id]->SetShared(true);
     } else {
       layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
+      layers_[layer_id]->SetShareViews(!InPlaceAfter(param, layer_id));
     }
     layer_names_.push_back(layer_param.name());
     LOG_IF(INFO, Caffe::root_solver())
@@ -148,6 +166,10 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
             << this_top[top_id]->shape_string() <<  ") for shared layer "
             << layer_param.name();
       }
+    } else if (weights_net_) {
+      ShareLayerParams(layer_id, true);
+      layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+      ShareLayerParams(layer_id, false);
     } else {
       layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
     }
@@ -283,6 +305,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  PrepareParams(weights_net_);
   debug_info_ = param.debug_info();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
@@ -383,6 +406,28 @@ bool Net<Dtype>::StateMeetsRule(const NetState& state,
   return true;
 }
 
+// Helper for Net::Init: whether a layer after layer_id computes in place on
+// one of its bottoms or tops.
+template <typename Dtype>
+bool Net<Dtype>::InPlaceAfter(const NetParameter& param, const int layer_id) {
+  const LayerParameter& layer_param = param.layer(layer_id);
+  set<string> blob_names(layer_param.bottom().begin(),
+      layer_param.bottom().end());
+  blob_names.insert(layer_param.top().begin(), layer_param.top().end());
+  for (int i = layer_id + 1; i < param.layer_size(); ++i) {
+    const LayerParameter& later_param = param.layer(i);
+    for (int j = 0; j < later_param.top_size(); ++j) {
+      const string& name = later_param.top(j);
+      if (blob_names.count(name) &&
+          std::find(later_param.bottom().begin(), later_param.bottom().end(),
+              name) != later_param.bottom().end()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 // Helper for Net::Init: add a new top blob to the net.
 template <typename Dtype>
 void Net<Dtype>::AppendTop(const NetParameter& param, const int layer_id,
@@ -486,6 +531,7 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
     const int learnable_param_id = learnable_params_.size();
     learnable_params_.push_back(params_[net_param_id].get());
     learnable_param_ids_.push_back(learnable_param_id);
+    learnable_param_layer_indices_.push_back(make_pair(layer_id, param_id));
     has_params_lr_.push_back(param_spec->has_lr_mult());
     has_params_decay_.push_back(param_spec->has_decay_mult());
     params_lr_.push_back(param_spec->lr_mult());
@@ -532,6 +578,9 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
     }
     const int learnable_param_id = learnable_param_ids_[owner_net_param_id];
     learnable_param_ids_.push_back(learnable_param_id);
+    // Sharers accumulate into the same diff, so the owner's rows are not
+    // enough to describe it.
+    learnable_param_layer_indices_[learnable_param_id] = make_pair(-1, -1);
     if (param_spec->has_lr_mult()) {
       if (has_params_lr_[learnable_param_id]) {
         CHECK_EQ(param_spec->lr_mult(), params_lr_[learnable_param_id])
@@ -692,6 +741,42 @@ void Net<Dtype>::UpdateDebugInfo(const int param_id) {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::ShareLayerParams(const int layer_id, const bool before_setup) {
+  const string& layer_name = layer_names_[layer_id];
+  if (!weights_net_->has_layer(layer_name)) {
+    LOG_IF(INFO, before_setup && Caffe::root_solver())
+        << "No shared weights for layer " << layer_name;
+    return;
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& source_blobs =
+      weights_net_->layer_by_name(layer_name)->blobs();
+  vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+      layers_[layer_id]->blobs();
+  if (before_setup) {
+    // Layers skip parameter initialization when their blobs are already
+    // present, as they do for blobs stored in the LayerParameter.
+    if (!source_blobs.empty()) {
+      target_blobs = source_blobs;
+    }
+    return;
+  }
+  CHECK_EQ(target_blobs.size(), source_blobs.size())
+      << "Incompatible number of blobs for layer " << layer_name;
+  for (int j = 0; j < target_blobs.size(); ++j) {
+    if (target_blobs[j] == source_blobs[j]) { continue; }
+    // The layer replaced the blob during setup: share its data instead.
+    if (target_blobs[j]->shape() != source_blobs[j]->shape()) {
+      LOG(ERROR) << "Cannot share param " << j << " weights from layer '"
+          << layer_name << "'; shape mismatch.  Source param shape is "
+          << source_blobs[j]->shape_string() << "; target param shape is "
+          << target_blobs[j]->shape_string();
+      LOG(FATAL) << "fatal error";
+    }
+    target_blobs[j]->ShareData(*source_blobs[j]);
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
   int num_source_layers = other->layers().size();
@@ -728,6 +813,7 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
       target_blobs[j]->ShareData(*source_blob);
     }
   }
+  PrepareParams();
 }
 
 template <typename Dtype>
@@ -806,6 +892,8 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
     }
   }
+  PrepareParams();
+  CompressParams();
 }
 
 template <typename Dtype>
@@ -876,6 +964,8 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string& trained_filename) {
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
+  PrepareParams();
+  CompressParams();
 #else
   LOG(FATAL) << "CopyTrainedLayersFromHDF5 requires hdf5;"
              << " compile with USE_HDF5.";
@@ -883,19 +973,61 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string& trained_filename) {
 }
 
 template <typename Dtype>
-void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
+void Net<Dtype>::PrepareParams(const Net* source) {
+  for (int i = 0; i < layers_.size(); ++i) {
+    const Layer<Dtype>* source_layer = NULL;
+    if (source && source->has_layer(layer_names_[i])) {
+      source_layer = source->layer_by_name(layer_names_[i]).get();
+    }
+    layers_[i]->PrepareParams(source_layer);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CompressParams() {
+  if (phase_ != TEST) { return; }
+  vector<bool> shared(params_.size(), false);
+  for (int i = 0; i < params_.size(); ++i) {
+    if (param_owners_[i] != -1) {
+      shared[i] = shared[param_owners_[i]] = true;
+    }
+  }
+  for (int i = 0; i < params_.size(); ++i) {
+    const int layer_id = param_layer_indices_[i].first;
+    const int param_id = param_layer_indices_[i].second;
+    const LayerParameter& layer_param = layers_[layer_id]->layer_param();
+    if (layer_param.param_size() <= param_id) { continue; }
+    const Precision precision =
+        layer_param.param(param_id).storage_precision();
+    if (precision == FP32 || params_[i]->data_precision() == precision) {
+      continue;
+    }
+    if (shared[i] || !layers_[layer_id]->AllowHalfStorage(param_id)) {
+      LOG_IF(INFO, Caffe::root_solver()) << "Keeping "
+          << layer_names_[layer_id] << " param " << param_id
+          << " in full precision";
+      continue;
+    }
+    params_[i]->CompressData(precision);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::ToProto(NetParameter* param, bool write_diff,
+    const Precision precision) const {
   param->Clear();
   param->set_name(name_);
   // Add bottom and top
   DLOG(INFO) << "Serializing " << layers_.size() << " layers";
   for (int i = 0; i < layers_.size(); ++i) {
     LayerParameter* layer_param = param->add_layer();
-    layers_[i]->ToProto(layer_param, write_diff);
+    layers_[i]->ToProto(layer_param, write_diff, precision);
   }
 }
 
 template <typename Dtype>
-void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
+void Net<Dtype>::ToHDF5(const string& filename, bool write_diff,
+    const Precision precision) const {
 // This code is taken from https://github.com/sh1r0/caffe-android-lib
 #ifdef USE_HDF5
   hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
@@ -933,12 +1065,12 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
       if (param_owners_[net_param_id] == -1) {
         // Only save params that own themselves
         hdf5_save_nd_dataset<Dtype>(layer_data_hid, dataset_name.str(),
-            *params_[net_param_id]);
+            *params_[net_param_id], false, precision);
       }
       if (write_diff) {
         // Write diffs regardless of weight-sharing
         hdf5_save_nd_dataset<Dtype>(layer_diff_hid, dataset_name.str(),
-            *params_[net_param_id], true);
+            *params_[net_param_id], true, precision);
       }
     }
     H5Gclose(layer_data_hid);
@@ -957,10 +1089,32 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
 #endif  // USE_HDF5
 }
 
+template <typename Dtype>
+const vector<int>* Net<Dtype>::learnable_param_sparse_rows(
+    const int param_id) const {
+  if (Caffe::mode() != Caffe::CPU) { return NULL; }
+  const pair<int, int>& index = learnable_param_layer_indices_[param_id];
+  if (index.first < 0) { return NULL; }
+  return layers_[index.first]->sparse_param_rows(index.second);
+}
+
 template <typename Dtype>
 void Net<Dtype>::Update() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
-    learnable_params_[i]->Update();
+    const vector<int>* rows = learnable_param_sparse_rows(i);
+    if (rows) {
+      // Only the listed rows carry a nonzero update.
+      Blob<Dtype>* blob = learnable_params_[i];
+      const int width = blob->count(1);
+      const Dtype* diff = blob->cpu_diff();
+      Dtype* data = blob->mutable_cpu_data();
+      for (int r = 0; r < rows->size(); ++r) {
+        const int offset = (*rows)[r] * width;
+        caffe_axpy<Dtype>(width, Dtype(-1), diff + offset, data + offset);
+      }
+    } else {
+      learnable_params_[i]->Update();
+    }
   }
 }
 
@@ -968,10 +1122,19 @@ template <typename Dtype>
 void Net<Dtype>::ClearParamDiffs() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
     Blob<Dtype>* blob = learnable_params_[i];
+    const vector<int>* rows = learnable_param_sparse_rows(i);
     switch (Caffe::mode()) {
     case Caffe::CPU:
-      caffe_set(blob->count(), static_cast<Dtype>(0),
-                blob->mutable_cpu_diff());
+      if (rows) {
+        const int width = blob->count(1);
+        Dtype* diff = blob->mutable_cpu_diff();
+        for (int r = 0; r < rows->size(); ++r) {
+          caffe_set(width, static_cast<Dtype>(0), diff + (*rows)[r] * width);
+        }
+      } else {
+        caffe_set(blob->count(), static_cast<Dtype>(0),
+                  blob->mutable_cpu_diff());
+      }
       break;
     case Caffe::GPU:
 #ifndef CPU_ONLY
@@ -982,6 +1145,10 @@ void Net<Dtype>::ClearParamDiffs() {
 #endif
       break;
     }
+    const pair<int, int>& index = learnable_param_layer_indices_[i];
+    if (index.first >= 0) {
+      layers_[index.first]->ClearSparseParamRows(index.second);
+    }
   }
 }
 
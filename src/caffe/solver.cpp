@@ -591,7 +591,8 @@ string Solver<Dtype>::SnapshotToBinaryProto() {
   string model_filename = SnapshotFilename(".caffemodel");
   LOG(INFO) << "Snapshotting to binary proto file " << model_filename;
   NetParameter net_param;
-  net_->ToProto(&net_param, param_.snapshot_diff());
+  net_->ToProto(&net_param, param_.snapshot_diff(),
+      param_.snapshot_precision());
   WriteProtoToBinaryFile(net_param, model_filename);
   return model_filename;
 }
@@ -600,7 +601,8 @@ template <typename Dtype>
 string Solver<Dtype>::SnapshotToHDF5() {
   string model_filename = SnapshotFilename(".caffemodel.h5");
   LOG(INFO) << "Snapshotting to HDF5 file " << model_filename;
-  net_->ToHDF5(model_filename, param_.snapshot_diff());
+  net_->ToHDF5(model_filename, param_.snapshot_diff(),
+      param_.snapshot_precision());
   return model_filename;
 }
 
@@ -44,56 +44,49 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   const int t = this->iter_ + 1;
   const Dtype correction = std::sqrt(Dtype(1) - pow(beta2, t)) /
       (Dtype(1.) - pow(beta1, t));
-  const int N = net_params[param_id]->count();
   const Dtype eps_hat = this->param_.delta();
 
   switch (Caffe::mode()) {
     case Caffe::CPU: {
-    // update m <- \beta_1 m_{t-1} + (1-\beta_1)g_t
-    caffe_cpu_axpby(N, Dtype(1)-beta1,
-        net_params[param_id]->cpu_diff(), beta1,
-        val_m->mutable_cpu_data());
+    // With a row-sparse gradient only the touched rows are visited, so the
+    // moments of the other rows are left as they are (lazy Adam).
+    const vector<pair<int, int> >& spans = this->UpdateSpans(param_id);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* m = val_m->mutable_cpu_data();
+    Dtype* v = val_v->mutable_cpu_data();
+    Dtype* tmp = val_t->mutable_cpu_data();
+    Dtype* v_t = amsgrad ? val_v_t->mutable_cpu_data() : NULL;
+    for (int i = 0; i < spans.size(); ++i) {
+      const int offset = spans[i].first;
+      const int n = spans[i].second;
+      // update m <- \beta_1 m_{t-1} + (1-\beta_1)g_t
+      caffe_cpu_axpby(n, Dtype(1)-beta1, diff + offset, beta1, m + offset);
 
-    // update v <- \beta_2 m_{t-1} + (1-\beta_2)g_t^2
-    caffe_mul(N,
-        net_params[param_id]->cpu_diff(),
-        net_params[param_id]->cpu_diff(),
-    val_t->mutable_cpu_data());
+      // update v <- \beta_2 m_{t-1} + (1-\beta_2)g_t^2
+      caffe_mul(n, diff + offset, diff + offset, tmp + offset);
 
-    if (amsgrad)
-      for (int k=0;k<N;k++)
-	{
-	  val_v_t->mutable_cpu_data()[k] = val_v->cpu_data()[k];
-	}
-    
-    caffe_cpu_axpby(N, Dtype(1)-beta2,
-        val_t->cpu_data(), beta2,
-        val_v->mutable_cpu_data());
+      if (amsgrad)
+        caffe_copy(n, v + offset, v_t + offset);
 
-    if (amsgrad)
-      for (int k=0;k<N;k++)
-	{
-	  val_v->mutable_cpu_data()[k] = std::max(val_v_t->cpu_data()[k],
-						  val_v->cpu_data()[k]);
-	}
-    
-    // set update
-    caffe_powx(N,
-        val_v->cpu_data(), Dtype(0.5),
-        val_t->mutable_cpu_data());
-    caffe_add_scalar(N, eps_hat, val_t->mutable_cpu_data());
-    caffe_div(N,
-        val_m->cpu_data(),
-        val_t->cpu_data(),
-        val_t->mutable_cpu_data());
+      caffe_cpu_axpby(n, Dtype(1)-beta2, tmp + offset, beta2, v + offset);
 
-    caffe_cpu_scale(N, local_rate*correction,
-        val_t->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
+      if (amsgrad)
+        for (int k = offset; k < offset + n; ++k) {
+          v[k] = std::max(v_t[k], v[k]);
+        }
+
+      // set update
+      caffe_powx(n, v + offset, Dtype(0.5), tmp + offset);
+      caffe_add_scalar(n, eps_hat, tmp + offset);
+      caffe_div(n, m + offset, tmp + offset, tmp + offset);
+
+      caffe_cpu_scale(n, local_rate*correction, tmp + offset, diff + offset);
+    }
     break;
   }
   case Caffe::GPU: {
 #ifndef CPU_ONLY
+    const int N = net_params[param_id]->count();
     adam_update_gpu(N, net_params[param_id]->mutable_gpu_diff(),
         val_m->mutable_gpu_data(), val_v->mutable_gpu_data(), beta1, beta2,
 		    eps_hat, local_rate*correction, amsgrad);
@@ -147,9 +147,20 @@ void SGDSolver<Dtype>::ClipGradients() {
   const Dtype clip_gradients = this->param_.clip_gradients();
   if (clip_gradients < 0) { return; }
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  // The rows missing from a row-sparse gradient have a zero diff: only the
+  // listed ones contribute to the norm and need scaling.
   Dtype sumsq_diff = 0;
   for (int i = 0; i < net_params.size(); ++i) {
-    sumsq_diff += net_params[i]->sumsq_diff();
+    if (this->net_->learnable_param_sparse_rows(i)) {
+      const vector<pair<int, int> >& spans = UpdateSpans(i);
+      const Dtype* diff = net_params[i]->cpu_diff();
+      for (int j = 0; j < spans.size(); ++j) {
+        sumsq_diff += caffe_cpu_dot(spans[j].second, diff + spans[j].first,
+            diff + spans[j].first);
+      }
+    } else {
+      sumsq_diff += net_params[i]->sumsq_diff();
+    }
   }
   const Dtype l2norm_diff = std::sqrt(sumsq_diff);
   if (l2norm_diff > clip_gradients) {
@@ -158,7 +169,15 @@ void SGDSolver<Dtype>::ClipGradients() {
         << l2norm_diff << " > " << clip_gradients << ") "
         << "by scale factor " << scale_factor;
     for (int i = 0; i < net_params.size(); ++i) {
-      net_params[i]->scale_diff(scale_factor);
+      if (this->net_->learnable_param_sparse_rows(i)) {
+        const vector<pair<int, int> >& spans = UpdateSpans(i);
+        Dtype* diff = net_params[i]->mutable_cpu_diff();
+        for (int j = 0; j < spans.size(); ++j) {
+          caffe_scal(spans[j].second, scale_factor, diff + spans[j].first);
+        }
+      } else {
+        net_params[i]->scale_diff(scale_factor);
+      }
     }
   }
 }
@@ -173,6 +192,10 @@ void SGDSolver<Dtype>::ApplyUpdate(const bool &log) {
   ClipGradients();
   for (int param_id = 0; param_id < this->net_->learnable_params().size();
        ++param_id) {
+    CHECK(SupportsSparseRows() ||
+          !this->net_->learnable_param_sparse_rows(param_id))
+        << type() << " solver does not support row-sparse gradients "
+        << "(sparse_gradient); use SGD, AdaGrad or Adam.";
     Normalize(param_id);
     Regularize(param_id);
     ComputeUpdateValue(param_id, rate);
@@ -180,6 +203,29 @@ void SGDSolver<Dtype>::ApplyUpdate(const bool &log) {
   this->net_->Update();
 }
 
+template <typename Dtype>
+const vector<pair<int, int> >& SGDSolver<Dtype>::UpdateSpans(int param_id) {
+  const Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const vector<int>* rows = this->net_->learnable_param_sparse_rows(param_id);
+  spans_.clear();
+  if (!rows) {
+    spans_.push_back(make_pair(0, param->count()));
+    return spans_;
+  }
+  // Coalesce consecutive rows into a single span.
+  const int width = param->count(1);
+  for (int i = 0; i < rows->size(); ++i) {
+    const int offset = (*rows)[i] * width;
+    if (!spans_.empty() &&
+        spans_.back().first + spans_.back().second == offset) {
+      spans_.back().second += width;
+    } else {
+      spans_.push_back(make_pair(offset, width));
+    }
+  }
+  return spans_;
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::Normalize(int param_id) {
   if (this->param_.iter_size() == 1) { return; }
@@ -188,8 +234,11 @@ void SGDSolver<Dtype>::Normalize(int param_id) {
   const Dtype accum_normalization = Dtype(1.) / this->param_.iter_size();
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    caffe_scal(net_params[param_id]->count(), accum_normalization,
-        net_params[param_id]->mutable_cpu_diff());
+    const vector<pair<int, int> >& spans = UpdateSpans(param_id);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    for (int i = 0; i < spans.size(); ++i) {
+      caffe_scal(spans[i].second, accum_normalization, diff + spans[i].first);
+    }
     break;
   }
   case Caffe::GPU: {
@@ -217,20 +266,23 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
   switch (Caffe::mode()) {
   case Caffe::CPU: {
     if (local_decay) {
+      const vector<pair<int, int> >& spans = UpdateSpans(param_id);
+      const Dtype* data = net_params[param_id]->cpu_data();
+      Dtype* diff = net_params[param_id]->mutable_cpu_diff();
       if (regularization_type == "L2") {
         // add weight decay
-        caffe_axpy(net_params[param_id]->count(),
-            local_decay,
-            net_params[param_id]->cpu_data(),
-            net_params[param_id]->mutable_cpu_diff());
+        for (int i = 0; i < spans.size(); ++i) {
+          caffe_axpy(spans[i].second, local_decay, data + spans[i].first,
+              diff + spans[i].first);
+        }
       } else if (regularization_type == "L1") {
-        caffe_cpu_sign(net_params[param_id]->count(),
-            net_params[param_id]->cpu_data(),
-            temp_[param_id]->mutable_cpu_data());
-        caffe_axpy(net_params[param_id]->count(),
-            local_decay,
-            temp_[param_id]->cpu_data(),
-            net_params[param_id]->mutable_cpu_diff());
+        Dtype* temp = temp_[param_id]->mutable_cpu_data();
+        for (int i = 0; i < spans.size(); ++i) {
+          caffe_cpu_sign(spans[i].second, data + spans[i].first,
+              temp + spans[i].first);
+          caffe_axpy(spans[i].second, local_decay, temp + spans[i].first,
+              diff + spans[i].first);
+        }
       } else {
         LOG(FATAL) << "Unknown regularization type: " << regularization_type;
       }
@@ -283,12 +335,15 @@ void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   // Compute the update to history, then copy it to the parameter diff.
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    caffe_cpu_axpby(net_params[param_id]->count(), local_rate,
-              net_params[param_id]->cpu_diff(), momentum,
-              history_[param_id]->mutable_cpu_data());
-    caffe_copy(net_params[param_id]->count(),
-        history_[param_id]->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
+    const vector<pair<int, int> >& spans = UpdateSpans(param_id);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* history = history_[param_id]->mutable_cpu_data();
+    for (int i = 0; i < spans.size(); ++i) {
+      const int offset = spans[i].first;
+      caffe_cpu_axpby(spans[i].second, local_rate, diff + offset, momentum,
+          history + offset);
+      caffe_copy(spans[i].second, history + offset, diff + offset);
+    }
     break;
   }
   case Caffe::GPU: {
@@ -64,6 +64,7 @@ void SparseBlob<Dtype>::ReshapeLike(const Blob<Dtype>& other) {
   } else {
     Reshape(other.shape());
   }
+  this->layout_ = other.layout();
 }
 
 template<typename Dtype>
@@ -266,7 +267,8 @@ void SparseBlob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
 }
 
 template<typename Dtype>
-void SparseBlob<Dtype>::ToProto(BlobProto* proto, bool write_diff) const {
+void SparseBlob<Dtype>::ToProto(BlobProto* proto, bool write_diff,
+    const Precision precision) const {
   LOG(FATAL)<< "ToProto is not supported";
   return;
 }
@@ -4,6 +4,15 @@
 
 namespace caffe {
 
+SyncedMemory::SyncedMemory(const shared_ptr<SyncedMemory>& parent,
+    size_t offset, size_t size)
+    : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
+      own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
+      gpu_device_(-1), parent_(parent), offset_(offset) {
+  CHECK(parent_);
+  CHECK_LE(offset + size, parent_->size());
+}
+
 SyncedMemory::~SyncedMemory() {
   if (cpu_ptr_ && own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
@@ -91,13 +100,24 @@ void SyncedMemory::clear_data() {
   head_ = UNINITIALIZED;
 }
 
+void SyncedMemory::detach() {
+  // The view's contents stay with the parent.
+  parent_.reset();
+  offset_ = 0;
+  head_ = UNINITIALIZED;
+}
+
 const void* SyncedMemory::cpu_data() {
+  if (parent_) {
+    return static_cast<const char*>(parent_->cpu_data()) + offset_;
+  }
   to_cpu();
   return (const void*)cpu_ptr_;
 }
 
 void SyncedMemory::set_cpu_data(void* data, int size) {
   CHECK(data);
+  if (parent_) { detach(); }
   /*<<<<<<< HEAD*/
   /*if (own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
@@ -117,6 +137,9 @@ void SyncedMemory::set_cpu_data(void* data, int size) {
 
 const void* SyncedMemory::gpu_data() {
 #ifndef CPU_ONLY
+  if (parent_) {
+    return static_cast<const char*>(parent_->gpu_data()) + offset_;
+  }
   to_gpu();
   return (const void*)gpu_ptr_;
 #else
@@ -148,6 +171,7 @@ const void* SyncedMemory::gpu_data() {
   void SyncedMemory::set_gpu_data(void* data, int size) {
 #ifndef CPU_ONLY
   CHECK(data);
+  if (parent_) { detach(); }
   if (size != -1 && size_ != size) {
     clear_data();
     size_ = size;
@@ -189,6 +213,9 @@ const void* SyncedMemory::gpu_data() {
 }*/
 
 void* SyncedMemory::mutable_cpu_data() {
+  if (parent_) {
+    return static_cast<char*>(parent_->mutable_cpu_data()) + offset_;
+  }
   to_cpu();
   head_ = HEAD_AT_CPU;
   return cpu_ptr_;
@@ -196,6 +223,9 @@ void* SyncedMemory::mutable_cpu_data() {
 
 void* SyncedMemory::mutable_gpu_data() {
 #ifndef CPU_ONLY
+  if (parent_) {
+    return static_cast<char*>(parent_->mutable_gpu_data()) + offset_;
+  }
   to_gpu();
   head_ = HEAD_AT_GPU;
   return gpu_ptr_;
@@ -207,6 +237,7 @@ void* SyncedMemory::mutable_gpu_data() {
 
 #ifndef CPU_ONLY
 void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
+  CHECK(!parent_) << "Views are pushed with their parent.";
   CHECK(head_ == HEAD_AT_CPU);
   if (gpu_ptr_ == NULL) {
     CAFFE1_CUDA_CHECK(cudaGetDevice(&gpu_device_));
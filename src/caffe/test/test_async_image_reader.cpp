@@ -0,0 +1,49 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/async_image_reader.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class AsyncImageReaderTest : public ::testing::Test {};
+
+TEST_F(AsyncImageReaderTest, TestReadInOrder) {
+  const string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+  // Images of different sizes, and a file that does not exist, so that the
+  // order of the results can be told apart.
+  vector<AsyncImageReader::Request> requests(20);
+  for (int i = 0; i < requests.size(); ++i) {
+    requests[i].filename = i == 13 ? filename + ".missing" : filename;
+    requests[i].height = 10 + i;
+    requests[i].width = 20 + i;
+    requests[i].is_color = i % 2;
+  }
+  AsyncImageReader reader(3);
+  EXPECT_EQ(3, reader.num_threads());
+  vector<cv::Mat> images;
+  reader.Read(requests, &images);
+  ASSERT_EQ(requests.size(), images.size());
+  for (int i = 0; i < requests.size(); ++i) {
+    if (i == 13) {
+      EXPECT_FALSE(images[i].data);
+      continue;
+    }
+    cv::Mat expected = ReadImageToCVMat(filename, 10 + i, 20 + i, i % 2);
+    ASSERT_EQ(expected.rows, images[i].rows);
+    ASSERT_EQ(expected.cols, images[i].cols);
+    ASSERT_EQ(expected.channels(), images[i].channels());
+    EXPECT_EQ(0, cv::norm(expected, images[i], cv::NORM_L1));
+  }
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
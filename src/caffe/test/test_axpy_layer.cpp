@@ -0,0 +1,121 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/axpy_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class AxpyLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  AxpyLayerTest()
+      : blob_bottom_a_(new Blob<Dtype>(2, 3, 1, 1)),
+        blob_bottom_x_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_bottom_y_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_a_);
+    filler.Fill(this->blob_bottom_x_);
+    filler.Fill(this->blob_bottom_y_);
+    blob_bottom_vec_.push_back(blob_bottom_a_);
+    blob_bottom_vec_.push_back(blob_bottom_x_);
+    blob_bottom_vec_.push_back(blob_bottom_y_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~AxpyLayerTest() {
+    delete blob_bottom_a_;
+    delete blob_bottom_x_;
+    delete blob_bottom_y_;
+    delete blob_top_;
+  }
+
+  Blob<Dtype>* const blob_bottom_a_;
+  Blob<Dtype>* const blob_bottom_x_;
+  Blob<Dtype>* const blob_bottom_y_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(AxpyLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(AxpyLayerTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  AxpyLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(this->blob_bottom_x_->shape(), this->blob_top_->shape());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 3; ++c) {
+      const Dtype a = this->blob_bottom_a_->data_at(n, c, 0, 0);
+      for (int h = 0; h < 4; ++h) {
+        for (int w = 0; w < 5; ++w) {
+          EXPECT_NEAR(a * this->blob_bottom_x_->data_at(n, c, h, w) +
+              this->blob_bottom_y_->data_at(n, c, h, w),
+              this->blob_top_->data_at(n, c, h, w), 1e-5);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(AxpyLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  AxpyLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(AxpyLayerTest, TestBackwardPropagateDownSubset) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  AxpyLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_top_);
+  caffe_copy(this->blob_top_->count(), this->blob_top_->cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  // Bottoms that are not propagated to keep their diff.
+  const Dtype kUntouched = 42;
+  for (int i = 0; i < 3; ++i) {
+    caffe_set(this->blob_bottom_vec_[i]->count(), kUntouched,
+        this->blob_bottom_vec_[i]->mutable_cpu_diff());
+  }
+  vector<bool> propagate_down(3, false);
+  propagate_down[0] = true;
+  propagate_down[2] = true;
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  const Dtype* top_diff = this->blob_top_->cpu_diff();
+  for (int i = 0; i < this->blob_bottom_x_->count(); ++i) {
+    EXPECT_EQ(kUntouched, this->blob_bottom_x_->cpu_diff()[i]);
+    EXPECT_EQ(top_diff[i], this->blob_bottom_y_->cpu_diff()[i]);
+  }
+  // da = sum over the plane of dF * X
+  const int spatial_dim = this->blob_bottom_x_->count(2);
+  for (int p = 0; p < this->blob_bottom_a_->count(); ++p) {
+    Dtype expected = 0;
+    for (int k = 0; k < spatial_dim; ++k) {
+      expected += top_diff[p * spatial_dim + k] *
+          this->blob_bottom_x_->cpu_data()[p * spatial_dim + k];
+    }
+    EXPECT_NEAR(expected, this->blob_bottom_a_->cpu_diff()[p], 1e-4);
+  }
+}
+
+}  // namespace caffe
@@ -55,6 +55,24 @@ TYPED_TEST(BlobSimpleTest, TestReshape) {
   EXPECT_EQ(this->blob_->count(), 120);
 }
 
+TYPED_TEST(BlobSimpleTest, TestShareView) {
+  Blob<TypeParam> view(1, 3, 4, 5);
+  view.ShareView(*this->blob_preshaped_, 60);
+  EXPECT_TRUE(view.IsViewOf(*this->blob_preshaped_, 60));
+  EXPECT_FALSE(view.IsViewOf(*this->blob_preshaped_, 0));
+  view.mutable_cpu_data()[1] = 7;
+  view.mutable_cpu_diff()[2] = 8;
+  EXPECT_EQ(7, this->blob_preshaped_->cpu_data()[61]);
+  EXPECT_EQ(8, this->blob_preshaped_->cpu_diff()[62]);
+  this->blob_preshaped_->mutable_cpu_data()[119] = 9;
+  EXPECT_EQ(9, view.cpu_data()[59]);
+  // Growing the view gives it memory of its own.
+  view.Reshape(2, 3, 4, 5);
+  EXPECT_FALSE(view.IsViewOf(*this->blob_preshaped_, 60));
+  view.mutable_cpu_data()[1] = 0;
+  EXPECT_EQ(7, this->blob_preshaped_->cpu_data()[61]);
+}
+
 TYPED_TEST(BlobSimpleTest, TestReshapeZero) {
   vector<int> shape(2);
   shape[0] = 0;
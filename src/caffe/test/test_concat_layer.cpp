@@ -140,6 +140,38 @@ TYPED_TEST(ConcatLayerTest, TestForwardNum) {
   }
 }
 
+TYPED_TEST(ConcatLayerTest, TestForwardNumInPlace) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_concat_param()->set_axis(0);
+  ConcatLayer<Dtype> layer(layer_param);
+  layer.SetShareViews(true);
+  layer.SetUp(this->blob_bottom_vec_1_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_1_, this->blob_top_vec_);
+  // The bottoms now live in their slots of the top.
+  EXPECT_TRUE(this->blob_bottom_0_->IsViewOf(*this->blob_top_, 0));
+  EXPECT_TRUE(this->blob_bottom_2_->IsViewOf(*this->blob_top_,
+      this->blob_bottom_0_->count()));
+  EXPECT_EQ(1, this->blob_bottom_0_->data_at(1, 2, 3, 4));
+  EXPECT_EQ(3, this->blob_bottom_2_->data_at(4, 2, 3, 4));
+  // What a producer writes there is the output of the next forward.
+  this->blob_bottom_2_->mutable_cpu_data()[5] = 7;
+  layer.Forward(this->blob_bottom_vec_1_, this->blob_top_vec_);
+  EXPECT_EQ(7, this->blob_top_->cpu_data()[this->blob_bottom_0_->count() + 5]);
+  EXPECT_EQ(1, this->blob_top_->data_at(1, 2, 3, 4));
+  // Strided slots still copy.
+  layer_param.mutable_concat_param()->set_axis(1);
+  ConcatLayer<Dtype> channel_layer(layer_param);
+  channel_layer.SetShareViews(true);
+  Blob<Dtype> channel_top;
+  vector<Blob<Dtype>*> channel_top_vec(1, &channel_top);
+  channel_layer.SetUp(this->blob_bottom_vec_0_, channel_top_vec);
+  channel_layer.Forward(this->blob_bottom_vec_0_, channel_top_vec);
+  EXPECT_FALSE(this->blob_bottom_1_->IsViewOf(channel_top,
+      this->blob_bottom_0_->count(1)));
+  EXPECT_EQ(2, channel_top.data_at(1, 3, 0, 0));
+}
+
 TYPED_TEST(ConcatLayerTest, TestForwardChannels) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -1,4 +1,7 @@
 #ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+
+#include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
 
@@ -107,6 +110,244 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  void TestReadShard() {
+    LayerParameter param;
+    param.set_phase(TEST);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(3);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    // The second of two shards of 5 records holds records 2 to 4.
+    data_param->set_num_shards(2);
+    data_param->set_shard_index(1);
+
+    DataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int iter = 0; iter < 10; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(2 + i, blob_top_label_->cpu_data()[i]);
+        EXPECT_EQ(2 + i, blob_top_data_->cpu_data()[i * 24]);
+      }
+    }
+  }
+
+  void TestReadShuffledShard() {
+    LayerParameter param;
+    param.set_phase(TEST);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    // Blocks {0, 1}, {2, 3} and {4}, one epoch per batch.
+    data_param->set_shuffle_shard(true);
+    data_param->set_shard_block_size(2);
+
+    DataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int iter = 0; iter < 10; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      const Dtype* label = blob_top_label_->cpu_data();
+      vector<int> seen(5, 0);
+      for (int i = 0; i < 5; ++i) {
+        const int l = static_cast<int>(label[i]);
+        ASSERT_GE(l, 0);
+        ASSERT_LT(l, 5);
+        ++seen[l];
+        if (l % 2 == 0 && l < 4) {
+          ASSERT_LT(i, 4);
+          EXPECT_EQ(l + 1, label[i + 1]);
+        }
+      }
+      for (int l = 0; l < 5; ++l) {
+        EXPECT_EQ(1, seen[l]);
+      }
+    }
+  }
+
+  void TestReadShuffled() {
+    LayerParameter param;
+    param.set_phase(TEST);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_shuffle(true);
+    data_param->set_key_index(*filename_ + ".keys");
+
+    // The first reader writes the key index, the second one reads it: both
+    // read the same permutations, one epoch per batch.
+    vector<Dtype> labels[2];
+    for (int run = 0; run < 2; ++run) {
+      DataLayer<Dtype> layer(param);
+      layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+      for (int iter = 0; iter < 4; ++iter) {
+        layer.Forward(blob_bottom_vec_, blob_top_vec_);
+        const Dtype* label = blob_top_label_->cpu_data();
+        vector<int> seen(5, 0);
+        for (int i = 0; i < 5; ++i) {
+          ASSERT_GE(label[i], 0);
+          ASSERT_LT(label[i], 5);
+          ++seen[static_cast<int>(label[i])];
+          EXPECT_EQ(label[i], blob_top_data_->cpu_data()[i * 24]);
+          labels[run].push_back(label[i]);
+        }
+        for (int l = 0; l < 5; ++l) {
+          EXPECT_EQ(1, seen[l]);
+        }
+      }
+    }
+    for (int i = 0; i < labels[0].size(); ++i) {
+      EXPECT_EQ(labels[0][i], labels[1][i]);
+    }
+  }
+
+  // Writes a key index as DataReader lays it out, with any count.
+  void WriteKeyIndex(const string& filename, uint32_t count,
+      const vector<string>& keys) {
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    const uint32_t magic = 0x5844494b;
+    file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    vector<string> strings(1, keys.front());
+    strings.push_back(keys.back());
+    strings.insert(strings.end(), keys.begin(), keys.end());
+    for (int i = 0; i < strings.size(); ++i) {
+      const uint32_t size = strings[i].size();
+      file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+      file.write(strings[i].data(), size);
+    }
+  }
+
+  void TestReadShuffledBadIndex() {
+    LayerParameter param;
+    param.set_phase(TEST);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_shuffle(true);
+    data_param->set_key_index(*filename_ + ".keys");
+
+    // An index of another database with as many records, and a corrupt one
+    // claiming billions of keys: both are rebuilt instead of being used.
+    vector<string> other_keys;
+    for (int i = 0; i < 5; ++i) {
+      other_keys.push_back(string("other") + static_cast<char>('0' + i));
+    }
+    const uint32_t counts[2] = {5, 0xffffffff};
+    for (int run = 0; run < 2; ++run) {
+      WriteKeyIndex(data_param->key_index(), counts[run], other_keys);
+      DataLayer<Dtype> layer(param);
+      layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+      for (int iter = 0; iter < 2; ++iter) {
+        layer.Forward(blob_bottom_vec_, blob_top_vec_);
+        const Dtype* label = blob_top_label_->cpu_data();
+        vector<int> seen(5, 0);
+        for (int i = 0; i < 5; ++i) {
+          ASSERT_GE(label[i], 0);
+          ASSERT_LT(label[i], 5);
+          ++seen[static_cast<int>(label[i])];
+          EXPECT_EQ(label[i], blob_top_data_->cpu_data()[i * 24]);
+        }
+        for (int l = 0; l < 5; ++l) {
+          EXPECT_EQ(1, seen[l]);
+        }
+      }
+    }
+  }
+
+  // Fill the DB with 5 png encoded 3x4 color images, image i holding
+  // 10 * i + j in its value j.
+  void FillEncoded(DataParameter_DB backend) {
+    backend_ = backend;
+    scoped_ptr<db::DB> db(db::GetDB(backend));
+    db->Open(*filename_, db::NEW);
+    scoped_ptr<db::Transaction> txn(db->NewTransaction());
+    for (int i = 0; i < 5; ++i) {
+      cv::Mat img(3, 4, CV_8UC3);
+      for (int j = 0; j < 36; ++j) {
+        img.data[j] = static_cast<uchar>(10 * i + j);
+      }
+      Datum datum;
+      EncodeCVMatToDatum(img, "png", &datum);
+      datum.set_label(i);
+      string out;
+      CHECK(datum.SerializeToString(&out));
+      txn->Put(string(1, '0' + i), out);
+    }
+    txn->Commit();
+    db->Close();
+  }
+
+  // Reads batches of 3 records, over several epochs, and checks that with a
+  // cache, which decodes the records it can, they are transformed as
+  // without.
+  void TestReadCachedEncoded() {
+    LayerParameter param;
+    param.set_phase(TEST);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(3);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    TransformationParameter* transform_param =
+        param.mutable_transform_param();
+    transform_param->set_scale(0.5);
+    // Decoded records, then records kept encoded for force_gray.
+    for (int gray = 0; gray < 2; ++gray) {
+      transform_param->set_force_gray(gray);
+      vector<vector<Dtype> > uncached;
+      for (int cache_mb = 0; cache_mb < 2; ++cache_mb) {
+        data_param->set_cache_mb(cache_mb);
+        DataLayer<Dtype> layer(param);
+        layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+        EXPECT_EQ(gray ? 1 : 3, blob_top_data_->channels());
+        for (int iter = 0; iter < 6; ++iter) {
+          layer.Forward(blob_bottom_vec_, blob_top_vec_);
+          for (int i = 0; i < 3; ++i) {
+            EXPECT_EQ((iter * 3 + i) % 5, blob_top_label_->cpu_data()[i]);
+          }
+          const Dtype* data = blob_top_data_->cpu_data();
+          vector<Dtype> batch(data, data + blob_top_data_->count());
+          if (!cache_mb) {
+            uncached.push_back(batch);
+            continue;
+          }
+          for (int j = 0; j < batch.size(); ++j) {
+            EXPECT_EQ(uncached[iter][j], batch[j])
+                << "debug: gray " << gray << " iter " << iter << " j " << j;
+          }
+        }
+      }
+    }
+  }
+
+  void TestReadCached() {
+    LayerParameter param;
+    param.set_phase(TEST);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(3);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_cache_mb(1);
+
+    // Batches straddle the epochs, the records after the first epoch come
+    // from the cache.
+    DataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int iter = 0; iter < 10; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      for (int i = 0; i < 3; ++i) {
+        const int record = (iter * 3 + i) % 5;
+        EXPECT_EQ(record, blob_top_label_->cpu_data()[i]);
+        for (int j = 0; j < 24; ++j) {
+          EXPECT_EQ(record, blob_top_data_->cpu_data()[i * 24 + j])
+              << "debug: iter " << iter << " i " << i << " j " << j;
+        }
+      }
+    }
+  }
+
   void TestReshape(DataParameter_DB backend) {
     const int num_inputs = 5;
     // Save data of varying shapes.
@@ -358,6 +599,41 @@ TYPED_TEST(DataLayerTest, TestReadLevelDB) {
   this->TestRead();
 }
 
+TYPED_TEST(DataLayerTest, TestReadShardLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadShard();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffledShardLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadShuffledShard();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffledLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadShuffled();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffledBadIndexLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadShuffledBadIndex();
+}
+
+TYPED_TEST(DataLayerTest, TestReadCachedEncodedLevelDB) {
+  this->FillEncoded(DataParameter_DB_LEVELDB);
+  this->TestReadCachedEncoded();
+}
+
+TYPED_TEST(DataLayerTest, TestReadCachedLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadCached();
+}
+
 TYPED_TEST(DataLayerTest, TestReshapeLevelDB) {
   this->TestReshape(DataParameter_DB_LEVELDB);
 }
@@ -398,6 +674,41 @@ TYPED_TEST(DataLayerTest, TestReadLMDB) {
   this->TestRead();
 }
 
+TYPED_TEST(DataLayerTest, TestReadShardLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadShard();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffledShardLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadShuffledShard();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffledLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadShuffled();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffledBadIndexLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadShuffledBadIndex();
+}
+
+TYPED_TEST(DataLayerTest, TestReadCachedEncodedLMDB) {
+  this->FillEncoded(DataParameter_DB_LMDB);
+  this->TestReadCachedEncoded();
+}
+
+TYPED_TEST(DataLayerTest, TestReadCachedLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadCached();
+}
+
 TYPED_TEST(DataLayerTest, TestReshapeLMDB) {
   this->TestReshape(DataParameter_DB_LMDB);
 }
@@ -346,6 +346,33 @@ TYPED_TEST(DataTransformTest, TestMeanFile) {
   }
 }
 
+#ifdef USE_SNAPPY
+TYPED_TEST(DataTransformTest, TestCompressed) {
+  TransformationParameter transform_param;
+  const bool unique_pixels = true;  // pixels are consecutive ints [0,size]
+  const int label = 0;
+  transform_param.set_scale(0.5);
+  transform_param.add_mean_value(3);
+  Datum datum;
+  this->FillDatum(label, unique_pixels, &datum);
+  Datum compressed_datum(datum);
+  ASSERT_TRUE(CompressDatum(&compressed_datum));
+  EXPECT_TRUE(compressed_datum.compressed());
+  Blob<TypeParam> blob(1, this->channels_, this->height_, this->width_);
+  Blob<TypeParam> compressed_blob(blob.shape());
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.InitRand();
+  transformer.Transform(datum, &blob);
+  transformer.Transform(compressed_datum, &compressed_blob);
+  for (int j = 0; j < blob.count(); ++j) {
+    EXPECT_EQ(blob.cpu_data()[j], compressed_blob.cpu_data()[j]);
+    EXPECT_EQ(blob.cpu_data()[j], (j - 3) * TypeParam(0.5));
+  }
+  ASSERT_TRUE(DecompressDatum(&compressed_datum));
+  EXPECT_EQ(datum.data(), compressed_datum.data());
+}
+#endif  // USE_SNAPPY
+
 TYPED_TEST(DataTransformTest, TestRichLabel) {
   TransformationParameter transform_param;
   const bool unique_pixels = false;  // all pixels the same equal to label
@@ -175,4 +175,54 @@ TYPED_TEST(EmbedLayerTest, TestGradientWithBias) {
       this->blob_top_vec_, -2);
 }
 
+TYPED_TEST(EmbedLayerTest, TestSparseGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) { return; }
+  LayerParameter layer_param;
+  EmbedParameter* embed_param = layer_param.mutable_embed_param();
+  embed_param->set_num_output(10);
+  embed_param->set_input_dim(5);
+  embed_param->set_bias_term(false);
+  embed_param->mutable_weight_filler()->set_type("uniform");
+  EmbedLayer<Dtype> dense_layer(layer_param);
+  embed_param->set_sparse_gradient(true);
+  EmbedLayer<Dtype> layer(layer_param);
+  this->blob_bottom_->mutable_cpu_data()[0] = 4;
+  this->blob_bottom_->mutable_cpu_data()[1] = 2;
+  this->blob_bottom_->mutable_cpu_data()[2] = 2;
+  this->blob_bottom_->mutable_cpu_data()[3] = 0;
+  dense_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The rows are unknown until the diff has been cleared once.
+  EXPECT_TRUE(layer.sparse_param_rows(0) == NULL);
+  layer.ClearSparseParamRows(0);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_top_);
+  caffe_copy(this->blob_top_->count(), this->blob_top_->cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  vector<bool> propagate_down(1, false);
+  dense_layer.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  const vector<int>* rows = layer.sparse_param_rows(0);
+  ASSERT_TRUE(rows != NULL);
+  ASSERT_EQ(3, rows->size());
+  EXPECT_EQ(0, (*rows)[0]);
+  EXPECT_EQ(2, (*rows)[1]);
+  EXPECT_EQ(4, (*rows)[2]);
+  const Blob<Dtype>& weights = *layer.blobs()[0];
+  for (int i = 0; i < weights.count(); ++i) {
+    EXPECT_NEAR(dense_layer.blobs()[0]->cpu_diff()[i], weights.cpu_diff()[i],
+        1e-5);
+  }
+  // A second pass (iter_size > 1) merges its rows with the previous ones.
+  this->blob_bottom_->mutable_cpu_data()[0] = 3;
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  ASSERT_EQ(4, rows->size());
+  EXPECT_EQ(3, (*rows)[2]);
+  layer.ClearSparseParamRows(0);
+  EXPECT_EQ(0, layer.sparse_param_rows(0)->size());
+}
+
 }  // namespace caffe
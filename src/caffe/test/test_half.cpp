@@ -0,0 +1,287 @@
+#include <stdint.h>
+#include <boost/thread.hpp>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/half.hpp"
+#ifdef USE_HDF5
+#include "caffe/util/hdf5.hpp"
+#endif
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class HalfTest : public CPUDeviceTest<Dtype> {
+ protected:
+  HalfTest() : blob_(2, 3, 4, 5) {
+    FillerParameter filler_param;
+    filler_param.set_std(10);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&blob_);
+  }
+
+  // The values of x once stored in precision.
+  vector<Dtype> Rounded(const int n, const Dtype* x,
+      const Precision precision) {
+    vector<uint16_t> half(n);
+    vector<Dtype> rounded(n);
+    caffe_cpu_to_half(n, x, half.data(), precision);
+    caffe_cpu_from_half(n, half.data(), rounded.data(), precision);
+    return rounded;
+  }
+
+ public:
+  // Counts the values of the blob other than expected.
+  void CountMismatches(const vector<Dtype>* expected, int* mismatches) {
+    const Dtype* data = blob_.cpu_data();
+    for (int i = 0; i < blob_.count(); ++i) {
+      *mismatches += data[i] != (*expected)[i];
+    }
+  }
+
+ protected:
+  Blob<Dtype> blob_;
+};
+
+TYPED_TEST_CASE(HalfTest, TestDtypes);
+
+TYPED_TEST(HalfTest, TestConversion) {
+  const double inf = std::numeric_limits<double>::infinity();
+  // Ties round to even, FP16 overflows to infinity at 65520 and has
+  // subnormals down to 2^-24; BF16 keeps the float exponent range.
+  const double values[] = { 0, 1, -2, 1 + 1. / 2048, 1 + 3. / 2048, 65504,
+      65519, 65520, std::ldexp(1., -24), std::ldexp(1., -26), 3e38, inf };
+  const uint16_t fp16[] = { 0x0000, 0x3c00, 0xc000, 0x3c00, 0x3c02, 0x7bff,
+      0x7bff, 0x7c00, 0x0001, 0x0000, 0x7c00, 0x7c00 };
+  const uint16_t bf16[] = { 0x0000, 0x3f80, 0xc000, 0x3f80, 0x3f80, 0x4780,
+      0x4780, 0x4780, 0x3380, 0x3280, 0x7f62, 0x7f80 };
+  const int n = sizeof(values) / sizeof(values[0]);
+  const vector<TypeParam> x(values, values + n);
+  vector<uint16_t> half(n);
+  caffe_cpu_to_half(n, x.data(), half.data(), FP16);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(fp16[i], half[i]) << "FP16 of " << x[i];
+  }
+  caffe_cpu_to_half(n, x.data(), half.data(), BF16);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(bf16[i], half[i]) << "BF16 of " << x[i];
+  }
+  // Every FP16 value converts back and forth exactly.
+  vector<uint16_t> all(1 << 16);
+  for (int i = 0; i < all.size(); ++i) { all[i] = i; }
+  vector<TypeParam> y(all.size());
+  caffe_cpu_from_half(all.size(), all.data(), y.data(), FP16);
+  EXPECT_EQ(1, y[0x3c00]);
+  EXPECT_EQ(-65504, y[0xfbff]);
+  EXPECT_EQ(std::ldexp(1., -24), y[0x0001]);
+  EXPECT_EQ(inf, y[0x7c00]);
+  EXPECT_TRUE(std::isnan(y[0x7e00]));
+  half.resize(all.size());
+  caffe_cpu_to_half(all.size(), y.data(), half.data(), FP16);
+  for (int i = 0; i < all.size(); ++i) {
+    if (!std::isnan(y[i])) {
+      EXPECT_EQ(all[i], half[i]) << "FP16 " << i;
+    }
+  }
+}
+
+TYPED_TEST(HalfTest, TestGemm) {
+  const int M = 3, N = 37, K = 29;
+  vector<TypeParam> a(M * K), b(N * K), b_t(K * N), c(M * N);
+  for (int i = 0; i < a.size(); ++i) { a[i] = (i % 13) * 0.25 - 1; }
+  for (int i = 0; i < b.size(); ++i) { b[i] = (i % 7) * 0.125 - 0.5; }
+  for (int n = 0; n < N; ++n) {
+    for (int k = 0; k < K; ++k) { b_t[k * N + n] = b[n * K + k]; }
+  }
+  // The values of b are exact in 16 bits.
+  vector<uint16_t> half(N * K);
+  for (int transposed = 0; transposed < 2; ++transposed) {
+    caffe_cpu_to_half(N * K, transposed ? b_t.data() : b.data(), half.data(),
+        BF16);
+    caffe_cpu_gemm_half<TypeParam>(transposed ? CblasNoTrans : CblasTrans,
+        M, N, K, a.data(), half.data(), BF16, c.data());
+    for (int m = 0; m < M; ++m) {
+      for (int n = 0; n < N; ++n) {
+        TypeParam expected = 0;
+        for (int k = 0; k < K; ++k) {
+          expected += a[m * K + k] * b[n * K + k];
+        }
+        EXPECT_NEAR(expected, c[m * N + n], 1e-4);
+      }
+    }
+  }
+}
+
+TYPED_TEST(HalfTest, TestProto) {
+  for (int p = FP16; p <= BF16; ++p) {
+    const Precision precision = static_cast<Precision>(p);
+    const vector<TypeParam> rounded =
+        this->Rounded(this->blob_.count(), this->blob_.cpu_data(), precision);
+    BlobProto proto;
+    this->blob_.ToProto(&proto, false, precision);
+    EXPECT_EQ(precision, proto.precision());
+    EXPECT_EQ(2 * this->blob_.count(),
+        static_cast<int>(proto.half_data().size()));
+    EXPECT_EQ(0, proto.data_size());
+    EXPECT_EQ(0, proto.double_data_size());
+    Blob<TypeParam> blob;
+    blob.FromProto(proto);
+    ASSERT_TRUE(blob.ShapeEquals(proto));
+    for (int i = 0; i < blob.count(); ++i) {
+      EXPECT_EQ(rounded[i], blob.cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(HalfTest, TestCompressData) {
+  const vector<TypeParam> rounded =
+      this->Rounded(this->blob_.count(), this->blob_.cpu_data(), FP16);
+  this->blob_.CompressData(FP16);
+  ASSERT_TRUE(this->blob_.half_data() != NULL);
+  EXPECT_EQ(FP16, this->blob_.data_precision());
+  // Writing the compressed blob, in any precision, does not convert it back.
+  BlobProto proto;
+  this->blob_.ToProto(&proto, false, FP16);
+  EXPECT_TRUE(this->blob_.half_data() != NULL);
+  BlobProto float_proto;
+  this->blob_.ToProto(&float_proto, false, FP32);
+  EXPECT_TRUE(this->blob_.half_data() != NULL);
+  Blob<TypeParam> blob;
+  blob.FromProto(float_proto);
+  for (int i = 0; i < blob.count(); ++i) {
+    EXPECT_EQ(rounded[i], blob.cpu_data()[i]);
+  }
+  BlobProto bf16_proto;
+  this->blob_.ToProto(&bf16_proto, false, BF16);
+  EXPECT_TRUE(this->blob_.half_data() != NULL);
+  // Reading the data does, and keeps the rounded values.
+  for (int i = 0; i < this->blob_.count(); ++i) {
+    EXPECT_EQ(rounded[i], this->blob_.cpu_data()[i]);
+  }
+  EXPECT_TRUE(this->blob_.half_data() == NULL);
+  EXPECT_EQ(FP32, this->blob_.data_precision());
+}
+
+TYPED_TEST(HalfTest, TestRestoreDataConcurrently) {
+  // Contexts sharing compressed params may all read them at once.
+  const vector<TypeParam> rounded =
+      this->Rounded(this->blob_.count(), this->blob_.cpu_data(), BF16);
+  for (int round = 0; round < 20; ++round) {
+    this->blob_.CompressData(BF16);
+    const int num_threads = 4;
+    vector<int> mismatches(num_threads, 0);
+    vector<shared_ptr<boost::thread> > threads;
+    for (int i = 0; i < num_threads; ++i) {
+      threads.push_back(shared_ptr<boost::thread>(new boost::thread(
+          &HalfTest<TypeParam>::CountMismatches, this, &rounded,
+          &mismatches[i])));
+    }
+    for (int i = 0; i < num_threads; ++i) {
+      threads[i]->join();
+      EXPECT_EQ(0, mismatches[i]) << "round " << round << " thread " << i;
+    }
+    EXPECT_TRUE(this->blob_.half_data() == NULL);
+  }
+}
+
+#ifdef USE_HDF5
+TYPED_TEST(HalfTest, TestHDF5) {
+  string filename;
+  MakeTempFilename(&filename);
+  const vector<TypeParam> rounded =
+      this->Rounded(this->blob_.count(), this->blob_.cpu_data(), BF16);
+  hid_t file_id = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+      H5P_DEFAULT);
+  ASSERT_GE(file_id, 0);
+  hdf5_save_nd_dataset(file_id, "data", this->blob_, false, BF16);
+  H5Fclose(file_id);
+  file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  ASSERT_GE(file_id, 0);
+  Blob<TypeParam> blob;
+  hdf5_load_nd_dataset(file_id, "data", 0, kMaxBlobAxes, &blob);
+  H5Fclose(file_id);
+  ASSERT_EQ(this->blob_.shape(), blob.shape());
+  for (int i = 0; i < blob.count(); ++i) {
+    EXPECT_EQ(rounded[i], blob.cpu_data()[i]);
+  }
+  // Saving compressed data in full precision keeps it compressed.
+  this->blob_.CompressData(BF16);
+  file_id = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+      H5P_DEFAULT);
+  ASSERT_GE(file_id, 0);
+  hdf5_save_nd_dataset(file_id, "data", this->blob_);
+  H5Fclose(file_id);
+  EXPECT_TRUE(this->blob_.half_data() != NULL);
+  file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  ASSERT_GE(file_id, 0);
+  hdf5_load_nd_dataset(file_id, "data", 0, kMaxBlobAxes, &blob);
+  H5Fclose(file_id);
+  for (int i = 0; i < blob.count(); ++i) {
+    EXPECT_EQ(rounded[i], blob.cpu_data()[i]);
+  }
+}
+#endif  // USE_HDF5
+
+TYPED_TEST(HalfTest, TestNetStorage) {
+  typedef TypeParam Dtype;
+  const string proto =
+      "name: 'HalfNet' "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 5 dim: 40 } } } "
+      "layer { name: 'ip' type: 'InnerProduct' bottom: 'data' top: 'ip' "
+      "  param { storage_precision: BF16 } "
+      "  param { storage_precision: BF16 } "
+      "  inner_product_param { num_output: 30 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(TEST);
+  Net<Dtype> float_net(param);
+  NetParameter trained;
+  float_net.ToProto(&trained);
+  // The float net computes with the weights as they are stored.
+  Blob<Dtype>* weights = float_net.params()[0].get();
+  const vector<Dtype> rounded =
+      this->Rounded(weights->count(), weights->cpu_data(), BF16);
+  caffe_copy(weights->count(), rounded.data(), weights->mutable_cpu_data());
+  Net<Dtype> net(param);
+  net.CopyTrainedLayersFrom(trained);
+  // Only the weights are read in 16 bits by InnerProduct.
+  EXPECT_EQ(BF16, net.params()[0]->data_precision());
+  EXPECT_EQ(FP32, net.params()[1]->data_precision());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(float_net.blob_by_name("data").get());
+  net.blob_by_name("data")->CopyFrom(*float_net.blob_by_name("data"));
+  const Blob<Dtype>* expected = float_net.Forward()[0];
+  const Blob<Dtype>* output = net.Forward()[0];
+  EXPECT_EQ(BF16, net.params()[0]->data_precision());
+  for (int i = 0; i < output->count(); ++i) {
+    EXPECT_NEAR(expected->cpu_data()[i], output->cpu_data()[i], 1e-4);
+  }
+  // The 16 bit weights are saved as they are.
+  NetParameter saved;
+  net.ToProto(&saved, false, BF16);
+  EXPECT_EQ(BF16, net.params()[0]->data_precision());
+  Blob<Dtype> saved_weights;
+  saved_weights.FromProto(saved.layer(1).blobs(0));
+  for (int i = 0; i < saved_weights.count(); ++i) {
+    EXPECT_EQ(rounded[i], saved_weights.cpu_data()[i]);
+  }
+}
+
+}  // namespace caffe
@@ -215,5 +215,39 @@ TYPED_TEST(ImageDataLayerTest, TestSpace) {
   EXPECT_EQ(this->blob_top_label_->cpu_data()[0], 1);
 }
 
+TYPED_TEST(ImageDataLayerTest, TestCache) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  ImageDataParameter* image_data_param = param.mutable_image_data_param();
+  image_data_param->set_batch_size(1);
+  image_data_param->set_source(this->filename_space_.c_str());
+  image_data_param->set_new_height(32);
+  image_data_param->set_new_width(32);
+  image_data_param->set_shuffle(false);
+  // Two epochs of two distinct images, without then with the cache: the
+  // second epoch of the cached layer comes from the cache.
+  vector<vector<Dtype> > uncached;
+  for (int cache_mb = 0; cache_mb < 2; ++cache_mb) {
+    image_data_param->set_cache_mb(cache_mb);
+    ImageDataLayer<Dtype> layer(param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int iter = 0; iter < 4; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      EXPECT_EQ(iter % 2, this->blob_top_label_->cpu_data()[0]);
+      const Dtype* data = this->blob_top_data_->cpu_data();
+      vector<Dtype> image(data, data + this->blob_top_data_->count());
+      if (!cache_mb) {
+        uncached.push_back(image);
+        continue;
+      }
+      for (int j = 0; j < image.size(); ++j) {
+        EXPECT_EQ(uncached[iter][j], image[j])
+            << "debug: iter " << iter << " j " << j;
+      }
+    }
+  }
+  EXPECT_NE(uncached[0], uncached[1]);
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -0,0 +1,137 @@
+#include <boost/thread.hpp>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_context.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class InferenceContextTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  InferenceContextTest() {
+    const string proto =
+        "name: 'TinyNet' "
+        "layer { "
+        "  name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 1 dim: 3 dim: 6 dim: 6 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'ip' type: 'InnerProduct' bottom: 'conv' top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    model_.reset(new InferenceModel<Dtype>(param));
+  }
+
+ public:
+  // Fills the input of context with batch_size copies of the sample input
+  // and returns the output.
+  const Blob<Dtype>* Run(InferenceContext<Dtype>* context, int batch_size) {
+    Blob<Dtype>* input = context->input_blobs()[0];
+    input->Reshape(batch_size, 3, 6, 6);
+    for (int n = 0; n < batch_size; ++n) {
+      caffe_copy(input->count(1), sample_.cpu_data(),
+          input->mutable_cpu_data() + input->offset(n));
+    }
+    return context->Forward()[0];
+  }
+
+  void RunRepeatedly(InferenceContext<Dtype>* context, int batch_size,
+      int* mismatches) {
+    for (int iter = 0; iter < 20; ++iter) {
+      const Blob<Dtype>* output = Run(context, batch_size);
+      for (int n = 0; n < batch_size; ++n) {
+        for (int i = 0; i < expected_.count(); ++i) {
+          const Dtype value = output->cpu_data()[output->offset(n) + i];
+          if (std::abs(value - expected_.cpu_data()[i]) > 1e-4) {
+            ++(*mismatches);
+          }
+        }
+      }
+    }
+  }
+
+ protected:
+  shared_ptr<InferenceModel<Dtype> > model_;
+  Blob<Dtype> sample_;
+  Blob<Dtype> expected_;
+};
+
+TYPED_TEST_CASE(InferenceContextTest, TestDtypesAndDevices);
+
+TYPED_TEST(InferenceContextTest, TestSharesParams) {
+  typedef typename TypeParam::Dtype Dtype;
+  InferenceContext<Dtype> context(*this->model_);
+  const vector<shared_ptr<Blob<Dtype> > >& model_params =
+      this->model_->net().params();
+  const vector<shared_ptr<Blob<Dtype> > >& context_params =
+      context.net().params();
+  ASSERT_EQ(4, model_params.size());
+  ASSERT_EQ(model_params.size(), context_params.size());
+  for (int i = 0; i < model_params.size(); ++i) {
+    EXPECT_EQ(model_params[i].get(), context_params[i].get());
+  }
+  EXPECT_EQ(TEST, context.net().phase());
+}
+
+TYPED_TEST(InferenceContextTest, TestConcurrentForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->sample_.Reshape(1, 3, 6, 6);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&this->sample_);
+  {
+    InferenceContext<Dtype> context(*this->model_);
+    this->expected_.CopyFrom(*this->Run(&context, 1), false, true);
+  }
+  const int num_threads = 4;
+  vector<shared_ptr<InferenceContext<Dtype> > > contexts;
+  for (int i = 0; i < num_threads; ++i) {
+    contexts.push_back(shared_ptr<InferenceContext<Dtype> >(
+        new InferenceContext<Dtype>(*this->model_)));
+  }
+  vector<int> mismatches(num_threads, 0);
+  vector<shared_ptr<boost::thread> > threads;
+  for (int i = 0; i < num_threads; ++i) {
+    // Each thread runs its own batch size.
+    threads.push_back(shared_ptr<boost::thread>(new boost::thread(
+        &InferenceContextTest<TypeParam>::RunRepeatedly, this,
+        contexts[i].get(), i + 1, &mismatches[i])));
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    threads[i]->join();
+    EXPECT_EQ(0, mismatches[i]) << "thread " << i;
+  }
+}
+
+}  // namespace caffe
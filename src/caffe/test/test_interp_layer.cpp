@@ -0,0 +1,108 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/interp_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class InterpLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  InterpLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~InterpLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(InterpLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(InterpLayerTest, TestForwardZoom) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_interp_param()->set_zoom_factor(2);
+  InterpLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(this->blob_top_->height(), 7);
+  ASSERT_EQ(this->blob_top_->width(), 9);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Even outputs fall on the inputs, odd ones halfway between them.
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 3; ++c) {
+      for (int h = 0; h < 7; ++h) {
+        for (int w = 0; w < 9; ++w) {
+          Dtype expected = 0;
+          for (int dh = 0; dh <= h % 2; ++dh) {
+            for (int dw = 0; dw <= w % 2; ++dw) {
+              expected += this->blob_bottom_->data_at(n, c, h / 2 + dh,
+                  w / 2 + dw) / ((1 + h % 2) * (1 + w % 2));
+            }
+          }
+          EXPECT_NEAR(expected, this->blob_top_->data_at(n, c, h, w), 1e-5);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(InterpLayerTest, TestForwardSameSize) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_interp_param()->set_height(4);
+  layer_param.mutable_interp_param()->set_width(5);
+  InterpLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i],
+        this->blob_top_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(InterpLayerTest, TestGradientResize) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_interp_param()->set_height(7);
+  layer_param.mutable_interp_param()->set_width(3);
+  InterpLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(InterpLayerTest, TestGradientCropZoom) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_interp_param()->set_zoom_factor(3);
+  layer_param.mutable_interp_param()->set_pad_beg(-1);
+  layer_param.mutable_interp_param()->set_pad_end(-1);
+  InterpLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
@@ -0,0 +1,185 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/layout_layer.hpp"
+#include "caffe/net.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class LayoutTest : public CPUDeviceTest<Dtype> {
+ protected:
+  LayoutTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~LayoutTest() { delete blob_bottom_; delete blob_top_; }
+
+  // Runs the same net in both layouts, with the same weights and input.
+  void CompareNets(const string& proto, const bool backward) {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    Net<Dtype> nchw_net(param);
+    NetParameter trained;
+    nchw_net.ToProto(&trained);
+    param.set_layout(NHWC);
+    Net<Dtype> nhwc_net(param);
+    nhwc_net.CopyTrainedLayersFrom(trained);
+    int layout_layers = 0;
+    for (int i = 0; i < nhwc_net.layers().size(); ++i) {
+      layout_layers += string("Layout") == nhwc_net.layers()[i]->type();
+    }
+    EXPECT_GT(layout_layers, 0);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(nchw_net.blob_by_name("data").get());
+    nhwc_net.blob_by_name("data")->CopyFrom(*nchw_net.blob_by_name("data"));
+    if (backward) {
+      nchw_net.ForwardBackward();
+      nhwc_net.ForwardBackward();
+    } else {
+      nchw_net.Forward();
+      nhwc_net.Forward();
+    }
+    ASSERT_EQ(nchw_net.output_blobs().size(), nhwc_net.output_blobs().size());
+    for (int i = 0; i < nchw_net.output_blobs().size(); ++i) {
+      const string& name =
+          nchw_net.blob_names()[nchw_net.output_blob_indices()[i]];
+      const Blob<Dtype>* expected = nchw_net.blob_by_name(name).get();
+      const Blob<Dtype>* output = nhwc_net.blob_by_name(name).get();
+      EXPECT_EQ(NCHW, output->layout()) << name;
+      ASSERT_EQ(expected->shape(), output->shape()) << name;
+      for (int j = 0; j < output->count(); ++j) {
+        EXPECT_NEAR(expected->cpu_data()[j], output->cpu_data()[j], 1e-4)
+            << name;
+      }
+    }
+    if (!backward) { return; }
+    ASSERT_EQ(nchw_net.params().size(), nhwc_net.params().size());
+    for (int i = 0; i < nchw_net.params().size(); ++i) {
+      const Blob<Dtype>* expected = nchw_net.params()[i].get();
+      const Blob<Dtype>* diff = nhwc_net.params()[i].get();
+      for (int j = 0; j < diff->count(); ++j) {
+        EXPECT_NEAR(expected->cpu_diff()[j], diff->cpu_diff()[j], 1e-3)
+            << "param " << i;
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(LayoutTest, TestDtypes);
+
+TYPED_TEST(LayoutTest, TestForward) {
+  LayerParameter layer_param;
+  layer_param.mutable_layout_param()->set_layout(NHWC);
+  LayoutLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_bottom_->shape(), this->blob_top_->shape());
+  EXPECT_EQ(NHWC, this->blob_top_->layout());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const TypeParam* top_data = this->blob_top_->cpu_data();
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 3; ++c) {
+      for (int h = 0; h < 4; ++h) {
+        for (int w = 0; w < 5; ++w) {
+          EXPECT_EQ(this->blob_bottom_->data_at(n, c, h, w),
+              top_data[((n * 4 + h) * 5 + w) * 3 + c]);
+        }
+      }
+    }
+  }
+  // And back.
+  Blob<TypeParam> round_trip;
+  vector<Blob<TypeParam>*> round_trip_vec(1, &round_trip);
+  layer_param.mutable_layout_param()->set_layout(NCHW);
+  LayoutLayer<TypeParam> back(layer_param);
+  back.SetUp(this->blob_top_vec_, round_trip_vec);
+  back.Forward(this->blob_top_vec_, round_trip_vec);
+  EXPECT_EQ(NCHW, round_trip.layout());
+  for (int i = 0; i < round_trip.count(); ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i], round_trip.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(LayoutTest, TestGradient) {
+  LayerParameter layer_param;
+  layer_param.mutable_layout_param()->set_layout(NHWC);
+  LayoutLayer<TypeParam> layer(layer_param);
+  GradientChecker<TypeParam> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(LayoutTest, TestNetForward) {
+  // conv1 and pool need NCHW, dw, pw1 and pw2 run in NHWC, and the ReLUs
+  // and the sum in whichever their bottoms are in.
+  const string proto =
+      "name: 'LayoutNet' "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 9 dim: 7 } } } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+      "  convolution_param { num_output: 8 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' } } } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+      "layer { name: 'dw' type: 'ConvolutionDepthwise' bottom: 'conv1' "
+      "  top: 'dw' convolution_param { num_output: 8 kernel_size: 3 pad: 1 "
+      "    stride: 2 weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' } } } "
+      "layer { name: 'relu2' type: 'ReLU' bottom: 'dw' top: 'dw' } "
+      "layer { name: 'pw1' type: 'Convolution' bottom: 'dw' top: 'pw1' "
+      "  convolution_param { num_output: 5 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' } } } "
+      "layer { name: 'pw2' type: 'Convolution' bottom: 'dw' top: 'pw2' "
+      "  convolution_param { num_output: 5 kernel_size: 1 bias_term: false "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'sum' type: 'Eltwise' bottom: 'pw1' bottom: 'pw2' "
+      "  top: 'sum' } "
+      "layer { name: 'pool' type: 'Pooling' bottom: 'pw1' top: 'pool' "
+      "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } } ";
+  this->CompareNets(proto, false);
+}
+
+TYPED_TEST(LayoutTest, TestNetBackward) {
+  const string proto =
+      "name: 'LayoutNet' "
+      "force_backward: true "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 6 dim: 5 dim: 4 } } } "
+      "layer { name: 'dw' type: 'ConvolutionDepthwise' bottom: 'data' "
+      "  top: 'dw' convolution_param { num_output: 6 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' } } } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'dw' top: 'dw' } "
+      "layer { name: 'pw' type: 'Convolution' bottom: 'dw' top: 'pw' "
+      "  convolution_param { num_output: 4 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' } } } "
+      "layer { name: 'loss' type: 'Reduction' bottom: 'pw' top: 'loss' "
+      "  reduction_param { operation: SUMSQ } loss_weight: 1 } ";
+  this->CompareNets(proto, true);
+}
+
+}  // namespace caffe
@@ -121,6 +121,22 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestPermuteStridedBatch) {
+  // Transposed 3 x 4 matrices whose batch stride leaves a gap in x.
+  const int y_shape[] = { 2, 3, 4 };
+  const int x_strides[] = { 20, 1, 3 };
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  TypeParam* y = this->blob_top_->mutable_cpu_data();
+  caffe_cpu_permute(3, y_shape, x_strides, x, y);
+  for (int b = 0; b < 2; ++b) {
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        EXPECT_EQ(x[b * 20 + i + j * 3], y[(b * 3 + i) * 4 + j]);
+      }
+    }
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
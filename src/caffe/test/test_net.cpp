@@ -783,6 +783,80 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
+  // Slices, transforms and concatenates along the batch, so that Slice and
+  // Concat may alias their blobs. With in_place, two leaky ReLUs then
+  // overwrite such blobs.
+  virtual void InitViewsNet(bool in_place) {
+    const string relu_s2_top = in_place ? "s2" : "s2_relu";
+    const string relu_c_top = in_place ? "c" : "c_relu";
+    const string proto =
+      "name: 'ViewsNetwork' "
+      "force_backward: true "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 4 dim: 3 dim: 2 dim: 2 } } "
+      "} "
+      "layer { "
+      "  name: 't' "
+      "  type: 'TanH' "
+      "  bottom: 'data' "
+      "  top: 't' "
+      "} "
+      "layer { "
+      "  name: 'slice' "
+      "  type: 'Slice' "
+      "  slice_param { axis: 0 } "
+      "  bottom: 't' "
+      "  top: 's1' "
+      "  top: 's2' "
+      "} "
+      "layer { "
+      "  name: 'relu_s2' "
+      "  type: 'ReLU' "
+      "  relu_param { negative_slope: 0.5 } "
+      "  bottom: 's2' "
+      "  top: '" + relu_s2_top + "' "
+      "} "
+      "layer { "
+      "  name: 'a' "
+      "  type: 'Sigmoid' "
+      "  bottom: 's1' "
+      "  top: 'a' "
+      "} "
+      "layer { "
+      "  name: 'b' "
+      "  type: 'TanH' "
+      "  bottom: '" + relu_s2_top + "' "
+      "  top: 'b' "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  concat_param { axis: 0 } "
+      "  bottom: 'a' "
+      "  bottom: 'b' "
+      "  top: 'c' "
+      "} "
+      "layer { "
+      "  name: 'relu_c' "
+      "  type: 'ReLU' "
+      "  relu_param { negative_slope: 0.5 } "
+      "  bottom: 'c' "
+      "  top: '" + relu_c_top + "' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'Reduction' "
+      "  reduction_param { operation: SUMSQ } "
+      "  bottom: '" + relu_c_top + "' "
+      "  top: 'loss' "
+      "  loss_weight: 1 "
+      "} ";
+    InitNetFromProtoString(proto);
+  }
+
   virtual void InitAllInOneNet(Phase phase = caffe::TRAIN,
       const int level = 0, const vector<string>* stages = NULL) {
     string proto =
@@ -2446,6 +2520,38 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestBlobViewsInPlace) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Slice and Concat alias their blobs unless a later layer computes in
+  // place on them: the TanH layers would then read the ReLU outputs back in
+  // Backward. Either way the gradients are those of the plain net.
+  Blob<Dtype> data(4, 3, 2, 2);
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&data);
+  Dtype loss[2];
+  Blob<Dtype> data_diff[2];
+  for (int in_place = 0; in_place < 2; ++in_place) {
+    this->InitViewsNet(in_place);
+    this->net_->blob_by_name("data")->CopyFrom(data);
+    // Concat moves its bottoms into the top on the first pass.
+    for (int pass = 0; pass < 2; ++pass) {
+      loss[in_place] = this->net_->ForwardBackward();
+    }
+    data_diff[in_place].CopyFrom(*this->net_->blob_by_name("data"), true,
+        true);
+    EXPECT_EQ(!in_place, this->net_->blob_by_name("s1")->IsViewOf(
+        *this->net_->blob_by_name("t"), 0));
+    EXPECT_EQ(!in_place, this->net_->blob_by_name("a")->IsViewOf(
+        *this->net_->blob_by_name("c"), 0));
+  }
+  EXPECT_NEAR(loss[0], loss[1], 1e-5);
+  for (int i = 0; i < data.count(); ++i) {
+    EXPECT_NEAR(data_diff[0].cpu_diff()[i], data_diff[1].cpu_diff()[i], 1e-5);
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
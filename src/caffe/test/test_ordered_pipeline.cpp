@@ -0,0 +1,56 @@
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/ordered_pipeline.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class OrderedPipelineTest : public ::testing::Test {};
+
+TEST_F(OrderedPipelineTest, TestConsumesInOrder) {
+  for (int window = 1; window < 9; window += 3) {
+    OrderedPipeline pipeline(4, window);
+    EXPECT_EQ(window, pipeline.window());
+    const int n = 200;
+    vector<int> slots(window, -1);
+    vector<int> consumed;
+    pipeline.Run(n, [&](int i, int slot) {
+      ASSERT_LT(slot, window);
+      // Uneven work, so that items finish out of order.
+      volatile int spin = (i * 7919) % 5000;
+      while (spin > 0) { --spin; }
+      slots[slot] = i * i;
+    }, [&](int i, int slot) {
+      EXPECT_EQ(i * i, slots[slot]);
+      consumed.push_back(i);
+    });
+    ASSERT_EQ(n, consumed.size());
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(i, consumed[i]);
+    }
+  }
+}
+
+TEST_F(OrderedPipelineTest, TestRethrow) {
+  OrderedPipeline pipeline(3, 0);
+  EXPECT_GT(pipeline.window(), 0);
+  int consumed = 0;
+  EXPECT_THROW(pipeline.Run(100, [](int i, int slot) {
+    if (i == 42) {
+      throw std::runtime_error("item failed");
+    }
+  }, [&](int i, int slot) { ++consumed; }), std::runtime_error);
+  EXPECT_LE(consumed, 42);
+  EXPECT_THROW(pipeline.Run(10, [](int i, int slot) {}, [](int i, int slot) {
+    if (i == 5) {
+      throw std::runtime_error("write failed");
+    }
+  }), std::runtime_error);
+}
+
+}  // namespace caffe
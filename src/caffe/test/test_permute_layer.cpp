@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -242,6 +243,53 @@ TYPED_TEST(PermuteLayerTest, TestTwoPermute) {
   }
 }
 
+TYPED_TEST(PermuteLayerTest, TestAllOrders) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Every order of four axes, with and without a unit axis to merge away.
+  for (int unit = 0; unit < 2; ++unit) {
+    vector<int> shape(4);
+    shape[0] = 2;
+    shape[1] = unit ? 1 : 3;
+    shape[2] = 4;
+    shape[3] = 5;
+    this->blob_bottom_->Reshape(shape);
+    const int count = this->blob_bottom_->count();
+    for (int i = 0; i < count; ++i) {
+      this->blob_bottom_->mutable_cpu_data()[i] = i;
+    }
+    vector<int> order(4);
+    for (int i = 0; i < 4; ++i) { order[i] = i; }
+    do {
+      LayerParameter layer_param;
+      PermuteParameter* permute_param = layer_param.mutable_permute_param();
+      for (int i = 0; i < 4; ++i) { permute_param->add_order(order[i]); }
+      PermuteLayer<Dtype> layer(layer_param);
+      // The identity shares the bottom data with its top: a top per order.
+      Blob<Dtype> top;
+      vector<Blob<Dtype>*> top_vec(1, &top);
+      layer.SetUp(this->blob_bottom_vec_, top_vec);
+      layer.Forward(this->blob_bottom_vec_, top_vec);
+      vector<int> index(4);
+      for (int i = 0; i < count; ++i) {
+        // Walk the top in order and find the bottom element it holds.
+        for (int j = 3, r = i; j >= 0; --j) {
+          index[order[j]] = r % shape[order[j]];
+          r /= shape[order[j]];
+        }
+        ASSERT_EQ(this->blob_bottom_->data_at(index), top.cpu_data()[i])
+            << "order " << order[0] << order[1] << order[2] << order[3];
+      }
+      // Backward is the inverse permutation.
+      caffe_copy(count, top.cpu_data(), top.mutable_cpu_diff());
+      layer.Backward(top_vec, vector<bool>(1, true), this->blob_bottom_vec_);
+      for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(i, this->blob_bottom_->cpu_diff()[i])
+            << "order " << order[0] << order[1] << order[2] << order[3];
+      }
+    } while (std::next_permutation(order.begin(), order.end()));
+  }
+}
+
 TYPED_TEST(PermuteLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
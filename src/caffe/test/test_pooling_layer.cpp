@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cfloat>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -609,6 +611,103 @@ TYPED_TEST(PoolingLayerTest, TestGradientAvePadded) {
   }
 }
 
+TYPED_TEST(PoolingLayerTest, TestForwardSpecialized) {
+  typedef typename TypeParam::Dtype Dtype;
+  // 2x2 and 3x3 windows of stride 2, and global pooling, have their own
+  // kernels: compare them with the definition.
+  const int kernels[] = { 2, 2, 3, 3, 0 };
+  const int pads[] = { 0, 1, 0, 1, 0 };
+  for (int method = 0; method < 2; ++method) {
+    for (int k = 0; k < 5; ++k) {
+      LayerParameter layer_param;
+      PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+      if (kernels[k]) {
+        pooling_param->set_kernel_size(kernels[k]);
+        pooling_param->set_stride(2);
+        pooling_param->set_pad(pads[k]);
+      } else {
+        pooling_param->set_global_pooling(true);
+      }
+      pooling_param->set_pool(method ? PoolingParameter_PoolMethod_MAX :
+          PoolingParameter_PoolMethod_AVE);
+      PoolingLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      const int kernel_h = kernels[k] ? kernels[k] : 6;
+      const int kernel_w = kernels[k] ? kernels[k] : 5;
+      const int stride = kernels[k] ? 2 : 1;
+      const Blob<Dtype>& bottom = *this->blob_bottom_;
+      const Blob<Dtype>& top = *this->blob_top_;
+      for (int n = 0; n < top.num(); ++n) {
+        for (int c = 0; c < top.channels(); ++c) {
+          for (int ph = 0; ph < top.height(); ++ph) {
+            for (int pw = 0; pw < top.width(); ++pw) {
+              const int hstart = ph * stride - pads[k];
+              const int wstart = pw * stride - pads[k];
+              const int hend = std::min(hstart + kernel_h, 6 + pads[k]);
+              const int wend = std::min(wstart + kernel_w, 5 + pads[k]);
+              Dtype expected = method ? -FLT_MAX : 0;
+              for (int h = std::max(hstart, 0); h < std::min(hend, 6); ++h) {
+                for (int w = std::max(wstart, 0); w < std::min(wend, 5);
+                     ++w) {
+                  const Dtype value = bottom.data_at(n, c, h, w);
+                  expected = method ? std::max(expected, value) :
+                      expected + value;
+                }
+              }
+              if (!method) {
+                expected /= (hend - hstart) * (wend - wstart);
+              }
+              EXPECT_NEAR(expected, top.data_at(n, c, ph, pw), 1e-5)
+                  << "kernel " << kernels[k] << " pad " << pads[k];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(PoolingLayerTest, TestMaxTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Outside training, Forward keeps no mask, and Backward finds it again.
+  LayerParameter layer_param;
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->set_kernel_size(3);
+  pooling_param->set_stride(2);
+  pooling_param->set_pad(1);
+  pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+  PoolingLayer<Dtype> train_layer(layer_param);
+  layer_param.set_phase(TEST);
+  PoolingLayer<Dtype> test_layer(layer_param);
+  Blob<Dtype> test_top;
+  vector<Blob<Dtype>*> test_top_vec(1, &test_top);
+  train_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  test_layer.SetUp(this->blob_bottom_vec_, test_top_vec);
+  train_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  test_layer.Forward(this->blob_bottom_vec_, test_top_vec);
+  ASSERT_EQ(this->blob_top_->count(), test_top.count());
+  for (int i = 0; i < test_top.count(); ++i) {
+    EXPECT_EQ(this->blob_top_->cpu_data()[i], test_top.cpu_data()[i]);
+  }
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_top_);
+  caffe_copy(test_top.count(), this->blob_top_->cpu_data(),
+      test_top.mutable_cpu_diff());
+  caffe_copy(test_top.count(), this->blob_top_->cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  const vector<bool> propagate_down(1, true);
+  Blob<Dtype> train_diff;
+  train_layer.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  train_diff.CopyFrom(*this->blob_bottom_, true, true);
+  test_layer.Backward(test_top_vec, propagate_down, this->blob_bottom_vec_);
+  for (int i = 0; i < train_diff.count(); ++i) {
+    EXPECT_EQ(train_diff.cpu_diff()[i], this->blob_bottom_->cpu_diff()[i]);
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNPoolingLayerTest : public GPUDeviceTest<Dtype> {
@@ -0,0 +1,142 @@
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/simd_math.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class SimdMathTest : public ::testing::Test {
+ protected:
+  SimdMathTest() {
+    // Every 4093rd bit pattern: ~1M values covering all exponents, signs,
+    // denormals, infinities and NaNs.
+    for (uint64_t bits = 0; bits < (uint64_t(1) << 32); bits += 4093) {
+      const uint32_t pattern = bits;
+      float value;
+      memcpy(&value, &pattern, sizeof(value));
+      inputs_.push_back(value);
+    }
+    const float specials[] = { 0.f, -0.f, 1.f, -1.f, 0.5f, 88.7f, -88.7f,
+        -103.f, std::numeric_limits<float>::min(),
+        std::numeric_limits<float>::denorm_min(),
+        std::numeric_limits<float>::max(),
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::quiet_NaN() };
+    inputs_.insert(inputs_.end(), specials,
+        specials + sizeof(specials) / sizeof(specials[0]));
+    outputs_.resize(inputs_.size());
+  }
+
+  // Distance in units in the last place; NaN only matches NaN.
+  static double UlpDistance(float a, float b) {
+    if (std::isnan(a) || std::isnan(b)) {
+      return std::isnan(a) && std::isnan(b) ? 0 : 1e30;
+    }
+    return std::fabs(double(Ordered(a)) - double(Ordered(b)));
+  }
+
+  static int64_t Ordered(float value) {
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits < 0 ? int64_t(std::numeric_limits<int32_t>::min()) - bits
+        : bits;
+  }
+
+  vector<float> inputs_;
+  vector<float> outputs_;
+};
+
+TEST_F(SimdMathTest, TestExp) {
+  simd_exp(inputs_.size(), &inputs_[0], &outputs_[0]);
+  for (int i = 0; i < inputs_.size(); ++i) {
+    const float expected = std::exp(double(inputs_[i]));
+    EXPECT_LE(UlpDistance(outputs_[i], expected), 2) << "x=" << inputs_[i];
+  }
+}
+
+TEST_F(SimdMathTest, TestLog) {
+  simd_log(inputs_.size(), &inputs_[0], &outputs_[0]);
+  for (int i = 0; i < inputs_.size(); ++i) {
+    const float expected = std::log(double(inputs_[i]));
+    EXPECT_LE(UlpDistance(outputs_[i], expected), 2) << "x=" << inputs_[i];
+  }
+}
+
+TEST_F(SimdMathTest, TestTanh) {
+  simd_tanh(inputs_.size(), &inputs_[0], &outputs_[0]);
+  for (int i = 0; i < inputs_.size(); ++i) {
+    const float expected = std::tanh(double(inputs_[i]));
+    EXPECT_LE(UlpDistance(outputs_[i], expected), 2) << "x=" << inputs_[i];
+  }
+}
+
+TEST_F(SimdMathTest, TestSigmoid) {
+  simd_sigmoid(inputs_.size(), &inputs_[0], &outputs_[0]);
+  for (int i = 0; i < inputs_.size(); ++i) {
+    const float expected = 1. / (1. + std::exp(-double(inputs_[i])));
+    EXPECT_LE(UlpDistance(outputs_[i], expected), 3) << "x=" << inputs_[i];
+  }
+}
+
+TEST_F(SimdMathTest, TestPowx) {
+  const float powers[] = { 0.75f, -0.75f, 3.f, -2.f, 2.5f, 0.f, 1.f, 2.f,
+      -1.f, 0.5f };
+  for (int p = 0; p < sizeof(powers) / sizeof(powers[0]); ++p) {
+    const float b = powers[p];
+    simd_powx(inputs_.size(), &inputs_[0], b, &outputs_[0]);
+    for (int i = 0; i < inputs_.size(); ++i) {
+      const double a = inputs_[i];
+      const float expected = std::pow(a, double(b));
+      double scale = std::fabs(b * std::log(std::fabs(a)));
+      if (!std::isfinite(scale)) { scale = 0; }
+      EXPECT_LE(UlpDistance(outputs_[i], expected), 2 * (1 + scale))
+          << "a=" << a << " b=" << b;
+    }
+  }
+}
+
+TEST_F(SimdMathTest, TestTails) {
+  // Results must not depend on where an element falls in the vector loop.
+  vector<float> reference(37);
+  simd_exp(reference.size(), &inputs_[1000], &reference[0]);
+  for (int n = 1; n <= reference.size(); ++n) {
+    simd_exp(n, &inputs_[1000], &outputs_[0]);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(reference[i], outputs_[i]);
+    }
+  }
+}
+
+template <typename Dtype>
+class TanhSigmoidTest : public ::testing::Test {};
+
+TYPED_TEST_CASE(TanhSigmoidTest, TestDtypes);
+
+TYPED_TEST(TanhSigmoidTest, TestCaffeTanhSigmoid) {
+  const int n = 1000;
+  vector<TypeParam> x(n);
+  vector<TypeParam> y(n);
+  for (int i = 0; i < n; ++i) {
+    x[i] = (i - n / 2) / TypeParam(25);
+  }
+  caffe_tanh(n, &x[0], &y[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(std::tanh(x[i]), y[i], 1e-6);
+  }
+  caffe_sigmoid(n, &x[0], &y[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(1. / (1. + std::exp(-x[i])), y[i], 1e-6);
+  }
+}
+
+}  // namespace caffe
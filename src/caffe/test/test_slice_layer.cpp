@@ -132,6 +132,28 @@ TYPED_TEST(SliceLayerTest, TestSliceAcrossNum) {
   }
 }
 
+TYPED_TEST(SliceLayerTest, TestSliceAcrossNumViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_slice_param()->set_axis(0);
+  SliceLayer<Dtype> layer(layer_param);
+  layer.SetShareViews(true);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_1_);
+  const int top_count = this->blob_top_0_->count();
+  EXPECT_TRUE(this->blob_top_0_->IsViewOf(*this->blob_bottom_, 0));
+  EXPECT_TRUE(this->blob_top_2_->IsViewOf(*this->blob_bottom_,
+      2 * top_count));
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_1_);
+  this->blob_bottom_->mutable_cpu_data()[top_count + 3] = 7;
+  EXPECT_EQ(7, this->blob_top_1_->cpu_data()[3]);
+  // The tops' diffs are the bottom's.
+  this->blob_top_2_->mutable_cpu_diff()[4] = 8;
+  vector<bool> propagate_down(1, true);
+  layer.Backward(this->blob_top_vec_1_, propagate_down,
+      this->blob_bottom_vec_);
+  EXPECT_EQ(8, this->blob_bottom_->cpu_diff()[2 * top_count + 4]);
+}
+
 TYPED_TEST(SliceLayerTest, TestSliceAcrossChannels) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
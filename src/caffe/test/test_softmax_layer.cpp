@@ -83,6 +83,54 @@ TYPED_TEST(SoftmaxLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardTemperatureLargeInner) {
+  typedef typename TypeParam::Dtype Dtype;
+  // More inner positions than one block of the CPU kernel, with a tail.
+  this->blob_bottom_->Reshape(2, 5, 31, 20);
+  FillerParameter filler_param;
+  filler_param.set_std(4);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.mutable_softmax_param()->set_scaling_temperature(2);
+  SoftmaxLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_bottom_->num(); ++i) {
+    for (int k = 0; k < this->blob_bottom_->height(); ++k) {
+      for (int l = 0; l < this->blob_bottom_->width(); ++l) {
+        Dtype scale = 0;
+        for (int j = 0; j < this->blob_bottom_->channels(); ++j) {
+          scale += exp(this->blob_bottom_->data_at(i, j, k, l) / 2);
+        }
+        for (int j = 0; j < this->blob_bottom_->channels(); ++j) {
+          EXPECT_NEAR(this->blob_top_->data_at(i, j, k, l),
+              exp(this->blob_bottom_->data_at(i, j, k, l) / 2) / scale, 1e-5)
+              << "debug: " << i << " " << j << " " << k << " " << l;
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(SoftmaxLayerTest, TestGradientLargeInner) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_->Reshape(1, 3, 1, 600);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  SoftmaxLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  // Check against a few outputs spread over both blocks.
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int top_ids[] = { 0, 511, 512, 1799 };
+  for (int i = 0; i < 4; ++i) {
+    checker.CheckGradientSingle(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_, 0, 0, top_ids[i]);
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNSoftmaxLayerTest : public GPUDeviceTest<Dtype> {
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
 #include <vector>
 
@@ -105,4 +107,95 @@ TYPED_TEST(SoftmaxWithLossLayerTest, TestGradientUnnormalized) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardLeavesBottomDiff) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_phase(TRAIN);
+  SoftmaxWithLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype kDiff = 42;
+  caffe_set(this->blob_bottom_data_->count(), kDiff,
+      this->blob_bottom_data_->mutable_cpu_diff());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_bottom_data_->count(); ++i) {
+    EXPECT_EQ(kDiff, this->blob_bottom_data_->cpu_diff()[i]);
+  }
+}
+
+TYPED_TEST(SoftmaxWithLossLayerTest, TestNormalizationModes) {
+  typedef typename TypeParam::Dtype Dtype;
+  const LossParameter_NormalizationMode kModes[] = {
+    LossParameter_NormalizationMode_FULL,
+    LossParameter_NormalizationMode_VALID,
+    LossParameter_NormalizationMode_BATCH_SIZE,
+    LossParameter_NormalizationMode_NONE
+  };
+  const int kIgnoreLabel = 0;
+  const int num = 10, channels = 5, spatial_dim = 6;
+  const Dtype* data = this->blob_bottom_data_->cpu_data();
+  const Dtype* label = this->blob_bottom_label_->cpu_data();
+  // Reference probabilities, loss and count of the non-ignored labels.
+  vector<Dtype> prob(this->blob_bottom_data_->count());
+  Dtype loss = 0;
+  int valid = 0;
+  for (int i = 0; i < num; ++i) {
+    for (int k = 0; k < spatial_dim; ++k) {
+      Dtype max = data[i * channels * spatial_dim + k];
+      for (int c = 1; c < channels; ++c) {
+        max = std::max(max, data[(i * channels + c) * spatial_dim + k]);
+      }
+      Dtype sum = 0;
+      for (int c = 0; c < channels; ++c) {
+        const int index = (i * channels + c) * spatial_dim + k;
+        prob[index] = std::exp(data[index] - max);
+        sum += prob[index];
+      }
+      for (int c = 0; c < channels; ++c) {
+        prob[(i * channels + c) * spatial_dim + k] /= sum;
+      }
+      const int label_value = static_cast<int>(label[i * spatial_dim + k]);
+      if (label_value != kIgnoreLabel) {
+        loss -= std::log(std::max(
+            prob[(i * channels + label_value) * spatial_dim + k],
+            Dtype(FLT_MIN)));
+        ++valid;
+      }
+    }
+  }
+  const Dtype normalizers[] = { Dtype(num * spatial_dim), Dtype(valid),
+      Dtype(num), Dtype(1) };
+  const Dtype kLossWeight = 2;
+  for (int m = 0; m < 4; ++m) {
+    LayerParameter layer_param;
+    layer_param.set_phase(TRAIN);
+    layer_param.mutable_loss_param()->set_ignore_label(kIgnoreLabel);
+    layer_param.mutable_loss_param()->set_normalization(kModes[m]);
+    SoftmaxWithLossLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_NEAR(loss / normalizers[m], this->blob_top_loss_->cpu_data()[0],
+        1e-4 * std::max(Dtype(1), loss / normalizers[m]));
+    this->blob_top_loss_->mutable_cpu_diff()[0] = kLossWeight;
+    vector<bool> propagate_down(2, false);
+    propagate_down[0] = true;
+    layer.Backward(this->blob_top_vec_, propagate_down,
+        this->blob_bottom_vec_);
+    const Dtype scale = kLossWeight / normalizers[m];
+    const Dtype* diff = this->blob_bottom_data_->cpu_diff();
+    for (int i = 0; i < num; ++i) {
+      for (int c = 0; c < channels; ++c) {
+        for (int k = 0; k < spatial_dim; ++k) {
+          const int index = (i * channels + c) * spatial_dim + k;
+          const int label_value = static_cast<int>(label[i * spatial_dim + k]);
+          Dtype expected = 0;
+          if (label_value != kIgnoreLabel) {
+            expected = scale * (prob[index] - (c == label_value ? 1 : 0));
+          }
+          EXPECT_NEAR(expected, diff[index], 1e-5);
+        }
+      }
+    }
+  }
+}
+
 }  // namespace caffe
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <string>
 #include <utility>
 #include <vector>
@@ -38,6 +39,69 @@ class SolverTest : public MultiDeviceTest<TypeParam> {
     solver_.reset(new SGDSolver<Dtype>(param));
   }
 
+  // Trains an Embed -> EuclideanLoss net with the given solver settings for
+  // num_iters iterations on each set of embedding rows in turn, and returns
+  // the embedding weights after each round.
+  vector<vector<Dtype> > TrainEmbedding(const string& solver_settings,
+      bool sparse_gradient, const vector<vector<int> >& indices,
+      int num_iters) {
+    ostringstream proto;
+    proto <<
+       "random_seed: 1701 "
+       "lr_policy: 'fixed' "
+       "display: 0 " << solver_settings <<
+       "net_param { "
+       "  name: 'TestEmbedding' "
+       "  layer { "
+       "    name: 'input' "
+       "    type: 'Input' "
+       "    input_param { "
+       "      shape { dim: 4 } "
+       "      shape { dim: 4 dim: 3 } "
+       "    } "
+       "    top: 'index' "
+       "    top: 'target' "
+       "  } "
+       "  layer { "
+       "    name: 'embed' "
+       "    type: 'Embed' "
+       "    embed_param { "
+       "      num_output: 3 "
+       "      input_dim: 6 "
+       "      bias_term: false "
+       "      sparse_gradient: " << (sparse_gradient ? "true" : "false") <<
+       "      weight_filler { type: 'gaussian' } "
+       "    } "
+       "    bottom: 'index' "
+       "    top: 'embed' "
+       "  } "
+       "  layer { "
+       "    name: 'loss' "
+       "    type: 'EuclideanLoss' "
+       "    bottom: 'embed' "
+       "    bottom: 'target' "
+       "  } "
+       "} ";
+    InitSolverFromProtoString(proto.str());
+    Net<Dtype>& net = *solver_->net();
+    Blob<Dtype>* target = net.blob_by_name("target").get();
+    for (int i = 0; i < target->count(); ++i) {
+      target->mutable_cpu_data()[i] = Dtype(i % 5) - 2;
+    }
+    const Blob<Dtype>& weights = *net.layer_by_name("embed")->blobs()[0];
+    vector<vector<Dtype> > result;
+    for (int r = 0; r < indices.size(); ++r) {
+      Blob<Dtype>* index = net.blob_by_name("index").get();
+      for (int i = 0; i < index->count(); ++i) {
+        index->mutable_cpu_data()[i] = indices[r][i];
+      }
+      solver_->Step(num_iters);
+      result.push_back(vector<Dtype>(weights.cpu_data(),
+          weights.cpu_data() + weights.count()));
+    }
+    return result;
+  }
+
   shared_ptr<Solver<Dtype> > solver_;
 };
 
@@ -106,4 +170,59 @@ TYPED_TEST(SolverTest, TestInitTrainTestNets) {
   EXPECT_TRUE(this->solver_->test_nets()[1]->has_layer("accuracy"));
 }
 
+TYPED_TEST(SolverTest, TestEmbedSparseGradientMatchesDense) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Without momentum nor weight decay a lazy update is exact, also when the
+  // rows change between iterations; the clipping norm only sees the rows.
+  const string settings = "base_lr: 0.1 clip_gradients: 0.5 iter_size: 2 ";
+  vector<vector<int> > indices;
+  const int kRows0[] = {1, 3, 3, 5};
+  const int kRows1[] = {0, 3, 4, 4};
+  indices.push_back(vector<int>(kRows0, kRows0 + 4));
+  indices.push_back(vector<int>(kRows1, kRows1 + 4));
+  const vector<vector<Dtype> > dense =
+      this->TrainEmbedding(settings, false, indices, 3);
+  const vector<vector<Dtype> > sparse =
+      this->TrainEmbedding(settings, true, indices, 3);
+  for (int r = 0; r < indices.size(); ++r) {
+    ASSERT_EQ(dense[r].size(), sparse[r].size());
+    for (int i = 0; i < dense[r].size(); ++i) {
+      EXPECT_NEAR(dense[r][i], sparse[r][i], 1e-5);
+    }
+  }
+}
+
+TYPED_TEST(SolverTest, TestEmbedSparseGradientMomentum) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) { return; }
+  const string settings = "base_lr: 0.1 momentum: 0.9 clip_gradients: 0.5 ";
+  vector<vector<int> > indices;
+  const int kRows0[] = {1, 3, 3, 5};
+  const int kRows1[] = {0, 2, 4, 4};
+  indices.push_back(vector<int>(kRows0, kRows0 + 4));
+  indices.push_back(vector<int>(kRows1, kRows1 + 4));
+  const vector<vector<Dtype> > dense =
+      this->TrainEmbedding(settings, false, indices, 3);
+  const vector<vector<Dtype> > sparse =
+      this->TrainEmbedding(settings, true, indices, 3);
+  const int kWidth = 3;
+  // While the same rows are seen the momentum updates agree.
+  for (int i = 0; i < dense[0].size(); ++i) {
+    EXPECT_NEAR(dense[0][i], sparse[0][i], 1e-5);
+  }
+  // Then the rows seen so far keep their momentum in the dense update, but
+  // are left alone by the lazy one; the new rows agree again.
+  for (int row = 0; row < 6; ++row) {
+    const bool seen = row % 2 == 0;
+    for (int k = row * kWidth; k < (row + 1) * kWidth; ++k) {
+      if (seen) {
+        EXPECT_NEAR(dense[1][k], sparse[1][k], 1e-5);
+      } else {
+        EXPECT_EQ(sparse[0][k], sparse[1][k]);
+        EXPECT_GT(std::fabs(dense[1][k] - dense[0][k]), 1e-6);
+      }
+    }
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,257 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/sparse_gemm.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class SparseGemmTest : public CPUDeviceTest<Dtype> {
+ protected:
+  SparseGemmTest()
+      : blob_bottom_(new Blob<Dtype>(2, 6, 9, 7)),
+        blob_top_(new Blob<Dtype>()),
+        blob_top_sparse_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    blob_top_sparse_vec_.push_back(blob_top_sparse_);
+  }
+  virtual ~SparseGemmTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+    delete blob_top_sparse_;
+  }
+
+  // Keeps every period-th weight of blob, starting at phase.
+  static void Prune(Blob<Dtype>* blob, const int period, const int phase) {
+    for (int i = 0; i < blob->count(); ++i) {
+      if ((i + phase) % period) { blob->mutable_cpu_data()[i] = 0; }
+    }
+  }
+
+  // Runs the pruned layer dense and sparse with the same weights.
+  void CompareToDense(LayerParameter layer_param) {
+    layer_param.set_phase(TEST);
+    shared_ptr<Layer<Dtype> > dense_layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param);
+    dense_layer->SetUp(blob_bottom_vec_, blob_top_vec_);
+    Prune(dense_layer->blobs()[0].get(), 5, 0);
+    dense_layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    layer_param.mutable_sparse_param();
+    shared_ptr<Layer<Dtype> > sparse_layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param);
+    sparse_layer->blobs() = dense_layer->blobs();
+    sparse_layer->SetUp(blob_bottom_vec_, blob_top_sparse_vec_);
+    sparse_layer->PrepareParams(NULL);
+    // NaN left in the top must not survive.
+    caffe_set(blob_top_sparse_->count(), Dtype(NAN),
+        blob_top_sparse_->mutable_cpu_data());
+    sparse_layer->Forward(blob_bottom_vec_, blob_top_sparse_vec_);
+    ExpectNear(*blob_top_, *blob_top_sparse_);
+  }
+
+  static void ExpectNear(const Blob<Dtype>& expected,
+      const Blob<Dtype>& actual) {
+    ASSERT_EQ(expected.shape(), actual.shape());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], 1e-4);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const blob_top_sparse_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  vector<Blob<Dtype>*> blob_top_sparse_vec_;
+};
+
+TYPED_TEST_CASE(SparseGemmTest, TestDtypes);
+
+TYPED_TEST(SparseGemmTest, TestForward) {
+  // Rows 1 to 6 of a matrix with empty rows, plain and transposed.
+  const int rows = 7, cols = 37, n = 45;
+  vector<TypeParam> w(rows * cols, 0), x(cols * n), y(rows * n);
+  for (int m = 0; m < rows; ++m) {
+    for (int k = m % 3; k < cols && m != 4; k += 6) {
+      w[m * cols + k] = (m * 31 + k * 17) % 19 - 9;
+    }
+  }
+  for (int i = 0; i < x.size(); ++i) {
+    x[i] = (i * 13) % 11 - 5;
+  }
+  LayerParameter param;
+  param.set_phase(TEST);
+  param.mutable_sparse_param();
+  SparseGemm<TypeParam> gemm;
+  ASSERT_TRUE(gemm.SetUp(param));
+  EXPECT_TRUE(gemm.Build(rows, cols, &w[0], false));
+  EXPECT_LT(gemm.density(), 0.25);
+  for (int transposed = 0; transposed < 2; ++transposed) {
+    gemm.Forward(1, rows - 1, n, &x[0], transposed, &y[0]);
+    for (int m = 1; m < rows; ++m) {
+      for (int j = 0; j < n; ++j) {
+        TypeParam expected = 0;
+        for (int k = 0; k < cols; ++k) {
+          expected += w[m * cols + k] *
+              (transposed ? x[j * cols + k] : x[k * n + j]);
+        }
+        EXPECT_EQ(expected,
+            transposed ? y[j * (rows - 1) + m - 1] : y[(m - 1) * n + j])
+            << "transposed " << transposed << " row " << m << " col " << j;
+      }
+    }
+  }
+}
+
+TYPED_TEST(SparseGemmTest, TestBuildTransposed) {
+  // The CSR of transposed weights holds the same rows as the CSR of the
+  // weights laid out by row.
+  const int rows = 5, cols = 8, n = 3;
+  vector<TypeParam> w(rows * cols, 0), w_t(rows * cols), x(cols * n);
+  for (int m = 0; m < rows; ++m) {
+    w[m * cols + (m * 3) % cols] = m + 1;
+  }
+  for (int m = 0; m < rows; ++m) {
+    for (int k = 0; k < cols; ++k) {
+      w_t[k * rows + m] = w[m * cols + k];
+    }
+  }
+  for (int i = 0; i < x.size(); ++i) {
+    x[i] = i % 7 - 3;
+  }
+  LayerParameter param;
+  param.set_phase(TEST);
+  param.mutable_sparse_param();
+  SparseGemm<TypeParam> gemm, gemm_t;
+  ASSERT_TRUE(gemm.SetUp(param));
+  ASSERT_TRUE(gemm_t.SetUp(param));
+  ASSERT_TRUE(gemm.Build(rows, cols, &w[0], false));
+  ASSERT_TRUE(gemm_t.Build(rows, cols, &w_t[0], true));
+  EXPECT_EQ(gemm.density(), gemm_t.density());
+  vector<TypeParam> y(rows * n), y_t(rows * n);
+  gemm.Forward(0, rows, n, &x[0], false, &y[0]);
+  gemm_t.Forward(0, rows, n, &x[0], false, &y_t[0]);
+  for (int i = 0; i < y.size(); ++i) {
+    EXPECT_EQ(y[i], y_t[i]);
+  }
+}
+
+TYPED_TEST(SparseGemmTest, TestDensityThreshold) {
+  // Three nonzeros out of twelve.
+  vector<TypeParam> w(12, 0);
+  w[1] = w[6] = w[11] = 1;
+  LayerParameter param;
+  param.set_phase(TEST);
+  param.mutable_sparse_param()->set_density_threshold(0.25);
+  SparseGemm<TypeParam> gemm;
+  ASSERT_TRUE(gemm.SetUp(param));
+  EXPECT_FALSE(gemm.has_weights());
+  // At the threshold the weights still run sparse, just above they do not.
+  EXPECT_TRUE(gemm.Build(3, 4, &w[0], false));
+  EXPECT_EQ(0.25, gemm.density());
+  w[0] = 1;
+  EXPECT_FALSE(gemm.Build(3, 4, &w[0], false));
+  EXPECT_TRUE(gemm.has_weights());
+  EXPECT_FALSE(gemm.sparse());
+  // Setting up again drops the CSR; training never runs sparse.
+  ASSERT_TRUE(gemm.SetUp(param));
+  EXPECT_FALSE(gemm.has_weights());
+  param.set_phase(TRAIN);
+  EXPECT_FALSE(gemm.SetUp(param));
+}
+
+TYPED_TEST(SparseGemmTest, TestConvolutionGroups) {
+  // Each group multiplies its own block of CSR rows.
+  LayerParameter layer_param;
+  layer_param.set_type("Convolution");
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(3);
+  conv_param->add_pad(1);
+  conv_param->add_stride(2);
+  conv_param->set_num_output(9);
+  conv_param->set_group(3);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  conv_param->mutable_bias_filler()->set_type("gaussian");
+  this->CompareToDense(layer_param);
+}
+
+TYPED_TEST(SparseGemmTest, TestInnerProductTransposed) {
+  LayerParameter layer_param;
+  layer_param.set_type("InnerProduct");
+  InnerProductParameter* ip_param = layer_param.mutable_inner_product_param();
+  ip_param->set_num_output(10);
+  ip_param->set_transpose(true);
+  ip_param->mutable_weight_filler()->set_type("gaussian");
+  ip_param->mutable_bias_filler()->set_type("gaussian");
+  this->CompareToDense(layer_param);
+}
+
+TYPED_TEST(SparseGemmTest, TestReloadWeights) {
+  typedef TypeParam Dtype;
+  // The CSR follows the weights of the net whenever they are loaded or
+  // shared: another pruning, then weights too dense to run sparse.
+  NetParameter param;
+  param.mutable_state()->set_phase(TEST);
+  LayerParameter* input_param = param.add_layer();
+  input_param->set_name("data");
+  input_param->set_type("Input");
+  input_param->add_top("data");
+  BlobShape* shape = input_param->mutable_input_param()->add_shape();
+  for (int i = 0; i < this->blob_bottom_->num_axes(); ++i) {
+    shape->add_dim(this->blob_bottom_->shape(i));
+  }
+  LayerParameter* conv_param = param.add_layer();
+  conv_param->set_name("conv");
+  conv_param->set_type("Convolution");
+  conv_param->add_bottom("data");
+  conv_param->add_top("conv");
+  conv_param->mutable_convolution_param()->add_kernel_size(3);
+  conv_param->mutable_convolution_param()->set_num_output(4);
+  conv_param->mutable_convolution_param()->mutable_weight_filler()->set_type(
+      "gaussian");
+  Net<Dtype> dense_net(param);
+  conv_param->mutable_sparse_param();
+  Net<Dtype> sparse_net(param);
+  Net<Dtype> shared_net(param);
+  Net<Dtype>* nets[] = { &dense_net, &sparse_net, &shared_net };
+  for (int i = 0; i < 3; ++i) {
+    nets[i]->blob_by_name("data")->CopyFrom(*this->blob_bottom_);
+  }
+  Blob<Dtype>* weights = dense_net.layer_by_name("conv")->blobs()[0].get();
+  Blob<Dtype> original;
+  original.CopyFrom(*weights, false, true);
+  for (int round = 0; round < 3; ++round) {
+    weights->CopyFrom(original);
+    if (round < 2) {
+      this->Prune(weights, 5, round);
+    }
+    NetParameter trained;
+    dense_net.ToProto(&trained);
+    sparse_net.CopyTrainedLayersFrom(trained);
+    shared_net.ShareTrainedLayersWith(&dense_net);
+    for (int i = 0; i < 3; ++i) {
+      nets[i]->Forward();
+    }
+    this->ExpectNear(*dense_net.blob_by_name("conv"),
+        *sparse_net.blob_by_name("conv"));
+    this->ExpectNear(*dense_net.blob_by_name("conv"),
+        *shared_net.blob_by_name("conv"));
+  }
+}
+
+}  // namespace caffe
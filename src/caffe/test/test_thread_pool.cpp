@@ -0,0 +1,82 @@
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {};
+
+TEST_F(ThreadPoolTest, TestCoversRangeOnce) {
+  ThreadPool pool(4);
+  for (int n = 0; n < 100; n += 7) {
+    for (int grain = 1; grain < 10; grain += 4) {
+      vector<int> hits(n, 0);
+      pool.ParallelFor(n, grain, [&](int begin, int end) {
+        EXPECT_LE(0, begin);
+        EXPECT_LT(begin, end);
+        EXPECT_LE(end, n);
+        for (int i = begin; i < end; ++i) {
+          ++hits[i];
+        }
+      });
+      for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(1, hits[i]);
+      }
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestNested) {
+  ThreadPool pool(3);
+  const int n = 16;
+  vector<int> hits(n * n, 0);
+  pool.ParallelFor(n, 1, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      pool.ParallelFor(n, 1, [&](int inner_begin, int inner_end) {
+        for (int j = inner_begin; j < inner_end; ++j) {
+          ++hits[i * n + j];
+        }
+      });
+    }
+  });
+  for (int i = 0; i < n * n; ++i) {
+    EXPECT_EQ(1, hits[i]);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestRethrow) {
+  ThreadPool pool(4);
+  EXPECT_THROW(pool.ParallelFor(64, 1, [](int begin, int end) {
+    if (begin <= 42 && 42 < end) {
+      throw std::runtime_error("chunk failed");
+    }
+  }), std::runtime_error);
+  // The pool stays usable after a failed loop.
+  vector<int> hits(64, 0);
+  pool.ParallelFor(64, 1, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      ++hits[i];
+    }
+  });
+  for (int i = 0; i < 64; ++i) {
+    EXPECT_EQ(1, hits[i]);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestSetCpuThreads) {
+  const int default_threads = Caffe::cpu_threads();
+  EXPECT_GE(default_threads, 1);
+  Caffe::set_cpu_threads(2);
+  EXPECT_EQ(2, Caffe::cpu_threads());
+  EXPECT_EQ(2, Caffe::thread_pool().num_threads());
+  Caffe::set_cpu_threads(0);
+  EXPECT_EQ(default_threads, Caffe::cpu_threads());
+}
+
+}  // namespace caffe
@@ -0,0 +1,62 @@
+#ifdef USE_OPENCV
+#include <fcntl.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "caffe/util/async_image_reader.hpp"
+#include "caffe/util/io.hpp"
+
+namespace caffe {
+
+AsyncImageReader::AsyncImageReader(int num_threads)
+    : pipeline_(num_threads, 0) {
+}
+
+void AsyncImageReader::ReadAhead(const string& filename) {
+#ifdef POSIX_FADV_WILLNEED
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+  }
+#endif  // POSIX_FADV_WILLNEED
+}
+
+void AsyncImageReader::Read(const vector<Request>& requests,
+    const boost::function<void(int, const cv::Mat&)>& consume) {
+  const int n = requests.size();
+  // One read ahead per worker covers the files the workers take next.
+  const int distance = pipeline_.num_workers();
+  for (int i = 0; i < std::min(distance, n); ++i) {
+    ReadAhead(requests[i].filename);
+  }
+  vector<cv::Mat> slots(pipeline_.window());
+  pipeline_.Run(n, [&](int i, int slot) {
+    if (i + distance < n) {
+      ReadAhead(requests[i + distance].filename);
+    }
+    const Request& request = requests[i];
+    slots[slot] = ReadImageToCVMat(request.filename, request.height,
+        request.width, request.is_color, request.nearest_neighbour_interp);
+  }, [&](int i, int slot) {
+    consume(i, slots[slot]);
+    slots[slot].release();
+  });
+}
+
+void AsyncImageReader::Read(const vector<Request>& requests,
+    vector<cv::Mat>* images) {
+  images->resize(requests.size());
+  Read(requests, [images](int i, const cv::Mat& image) {
+    (*images)[i] = image;
+  });
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
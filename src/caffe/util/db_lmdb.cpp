@@ -1,7 +1,9 @@
 #ifdef USE_LMDB
 #include "caffe/util/db_lmdb.hpp"
 
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <string>
 #include <iostream>
@@ -20,6 +22,9 @@ void LMDB::Open(const string& source, Mode mode) {
   int flags = 0;
   if (mode == READ) {
     flags = MDB_RDONLY | MDB_NOTLS;
+  } else if (mode == READ_RANDOM) {
+    // No readahead: the pages around a record are unlikely to be read next.
+    flags = MDB_RDONLY | MDB_NOTLS | MDB_NORDAHEAD;
   }
   int rc = mdb_env_open(mdb_env_, source.c_str(), flags, 0664);
 #ifndef ALLOW_LMDB_NOLOCK
@@ -40,6 +45,18 @@ void LMDB::Open(const string& source, Mode mode) {
   LOG(INFO) << "Opened lmdb " << source;
 }
 
+void LMDBCursor::WillNeed() {
+  if (!valid_ || mdb_value_.mv_size == 0) {
+    return;
+  }
+  // The value points into the read-only map: ask for its pages.
+  static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(mdb_value_.mv_data);
+  const uintptr_t first = begin & ~(page_size - 1);
+  madvise(reinterpret_cast<void*>(first),
+      begin + mdb_value_.mv_size - first, MADV_WILLNEED);
+}
+
 LMDBCursor* LMDB::NewCursor() {
   MDB_txn* mdb_txn;
   MDB_cursor* mdb_cursor;
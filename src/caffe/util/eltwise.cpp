@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/eltwise.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Values per block: the running result of a block stays in L1 while the
+// inputs stream through it.
+const int kBlock = 2048;
+
+// Runs body(offset, size, acc) over the blocks of [0, count) in parallel,
+// with acc a block sized scratch buffer private to the calling thread.
+template <typename Dtype, typename Body>
+void ForEachBlock(const int count, const int n, const Body& body) {
+  const int blocks = (count + kBlock - 1) / kBlock;
+  parallel_for(blocks, [&](int begin, int end) {
+    vector<Dtype> acc(std::min(count, kBlock));
+    for (int b = begin; b < end; ++b) {
+      const int offset = b * kBlock;
+      body(offset, std::min(kBlock, count - offset), &acc[0]);
+    }
+  }, parallel_grain(n * kBlock));
+}
+
+// y = s * x + b + addend over a contiguous row.
+template <typename Dtype>
+void AxpbyRow(const int n, const Dtype s, const Dtype* x, const Dtype b,
+    const Dtype* addend, Dtype* y) {
+  if (addend) {
+    for (int k = 0; k < n; ++k) {
+      y[k] = s * x[k] + b + addend[k];
+    }
+  } else {
+    for (int k = 0; k < n; ++k) {
+      y[k] = s * x[k] + b;
+    }
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void eltwise_sum_cpu(const int count, const int n, const Dtype* const* x,
+    const Dtype* coeff, Dtype* y) {
+  if (count == 0) { return; }
+  if (n == 0) {
+    caffe_set(count, Dtype(0), y);
+    return;
+  }
+  ForEachBlock<Dtype>(count, n, [&](int offset, int size, Dtype* acc) {
+    const Dtype c0 = coeff ? coeff[0] : Dtype(1);
+    const Dtype* x0 = x[0] + offset;
+    for (int k = 0; k < size; ++k) {
+      acc[k] = c0 * x0[k];
+    }
+    for (int j = 1; j < n; ++j) {
+      const Dtype* xj = x[j] + offset;
+      const Dtype cj = coeff ? coeff[j] : Dtype(1);
+      if (cj == Dtype(1)) {
+        for (int k = 0; k < size; ++k) {
+          acc[k] += xj[k];
+        }
+      } else {
+        for (int k = 0; k < size; ++k) {
+          acc[k] += cj * xj[k];
+        }
+      }
+    }
+    caffe_copy(size, acc, y + offset);
+  });
+}
+
+template void eltwise_sum_cpu<float>(const int count, const int n,
+    const float* const* x, const float* coeff, float* y);
+template void eltwise_sum_cpu<double>(const int count, const int n,
+    const double* const* x, const double* coeff, double* y);
+
+template <typename Dtype>
+void eltwise_prod_cpu(const int count, const int n, const Dtype* const* x,
+    Dtype* y) {
+  if (count == 0) { return; }
+  if (n == 0) {
+    caffe_set(count, Dtype(1), y);
+    return;
+  }
+  ForEachBlock<Dtype>(count, n, [&](int offset, int size, Dtype* acc) {
+    caffe_copy(size, x[0] + offset, acc);
+    for (int j = 1; j < n; ++j) {
+      const Dtype* xj = x[j] + offset;
+      for (int k = 0; k < size; ++k) {
+        acc[k] *= xj[k];
+      }
+    }
+    caffe_copy(size, acc, y + offset);
+  });
+}
+
+template void eltwise_prod_cpu<float>(const int count, const int n,
+    const float* const* x, float* y);
+template void eltwise_prod_cpu<double>(const int count, const int n,
+    const double* const* x, double* y);
+
+template <typename Dtype>
+void eltwise_max_cpu(const int count, const int n, const Dtype* const* x,
+    Dtype* y, int* mask) {
+  CHECK_GT(n, 0);
+  if (count == 0) { return; }
+  ForEachBlock<Dtype>(count, n, [&](int offset, int size, Dtype* acc) {
+    caffe_copy(size, x[0] + offset, acc);
+    int* mask_block = mask ? mask + offset : NULL;
+    if (mask_block) {
+      caffe_memset(size * sizeof(int), 0, mask_block);
+    }
+    for (int j = 1; j < n; ++j) {
+      const Dtype* xj = x[j] + offset;
+      // Only the second input wins ties.
+      const bool ties = (j == 1);
+      for (int k = 0; k < size; ++k) {
+        if (xj[k] > acc[k] || (ties && !(acc[k] > xj[k]))) {
+          acc[k] = xj[k];
+          if (mask_block) { mask_block[k] = j; }
+        }
+      }
+    }
+    caffe_copy(size, acc, y + offset);
+  });
+}
+
+template void eltwise_max_cpu<float>(const int count, const int n,
+    const float* const* x, float* y, int* mask);
+template void eltwise_max_cpu<double>(const int count, const int n,
+    const double* const* x, double* y, int* mask);
+
+template <typename Dtype>
+void broadcast_axpby_cpu(const int outer_num, const int dim,
+    const int inner_num, const Dtype* scale, const Dtype* x,
+    const Dtype* bias, const Dtype* addend, Dtype* y) {
+  if (outer_num == 0 || dim == 0 || inner_num == 0) { return; }
+  if (inner_num == 1) {
+    // Rows of dim values, each against the whole of scale and bias.
+    parallel_for(outer_num, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        const int offset = i * dim;
+        const Dtype* x_row = x + offset;
+        const Dtype* addend_row = addend ? addend + offset : NULL;
+        Dtype* y_row = y + offset;
+        for (int d = 0; d < dim; ++d) {
+          y_row[d] = (scale ? scale[d] * x_row[d] : x_row[d]) +
+              (bias ? bias[d] : Dtype(0)) +
+              (addend_row ? addend_row[d] : Dtype(0));
+        }
+      }
+    }, parallel_grain(dim));
+    return;
+  }
+  // Rows of inner_num values, each against one scale and bias.
+  parallel_for(outer_num * dim, [&](int begin, int end) {
+    for (int r = begin; r < end; ++r) {
+      const int d = r % dim;
+      const int offset = r * inner_num;
+      AxpbyRow(inner_num, scale ? scale[d] : Dtype(1), x + offset,
+          bias ? bias[d] : Dtype(0), addend ? addend + offset : NULL,
+          y + offset);
+    }
+  }, parallel_grain(inner_num));
+}
+
+template void broadcast_axpby_cpu<float>(const int outer_num, const int dim,
+    const int inner_num, const float* scale, const float* x,
+    const float* bias, const float* addend, float* y);
+template void broadcast_axpby_cpu<double>(const int outer_num,
+    const int dim, const int inner_num, const double* scale, const double* x,
+    const double* bias, const double* addend, double* y);
+
+template <typename Dtype>
+void broadcast_reduce_cpu(const int outer_num, const int dim,
+    const int inner_num, const Dtype* x, const Dtype* w, const Dtype beta,
+    Dtype* y) {
+  if (dim == 0) { return; }
+  // Each y[d] gathers outer_num rows of inner_num values.
+  const int work = std::max(outer_num * inner_num, 1);
+  parallel_for(dim, [&](int begin, int end) {
+    for (int d = begin; d < end; ++d) {
+      Dtype sum = 0;
+      for (int i = 0; i < outer_num; ++i) {
+        const int offset = (i * dim + d) * inner_num;
+        const Dtype* x_row = x + offset;
+        if (w) {
+          const Dtype* w_row = w + offset;
+          for (int k = 0; k < inner_num; ++k) {
+            sum += x_row[k] * w_row[k];
+          }
+        } else {
+          for (int k = 0; k < inner_num; ++k) {
+            sum += x_row[k];
+          }
+        }
+      }
+      // beta == 0 overwrites, even a NaN.
+      y[d] = (beta == Dtype(0)) ? sum : beta * y[d] + sum;
+    }
+  }, parallel_grain(work));
+}
+
+template void broadcast_reduce_cpu<float>(const int outer_num, const int dim,
+    const int inner_num, const float* x, const float* w, const float beta,
+    float* y);
+template void broadcast_reduce_cpu<double>(const int outer_num,
+    const int dim, const int inner_num, const double* x, const double* w,
+    const double beta, double* y);
+
+}  // namespace caffe
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CAFFE_HALF_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Values per parallel chunk of a conversion.
+const int kConvertGrain = 1 << 16;
+// Dtype values per converted panel of the GEMM weights: a few hundred KB,
+// which stays in cache while the GEMM reads it.
+const int kPanelSize = 1 << 16;
+
+inline uint32_t FloatBits(const float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  return x;
+}
+
+inline float BitsFloat(const uint32_t x) {
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+inline uint16_t FloatToFp16(const float f) {
+  uint32_t x = FloatBits(f);
+  const uint16_t sign = (x >> 16) & 0x8000;
+  x &= 0x7fffffff;
+  if (x >= 0x7f800000) {
+    // Infinity, or a quiet NaN.
+    return sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0);
+  }
+  if (x >= 0x477ff000) {
+    // At least 65520, which rounds past the largest half, 65504.
+    return sign | 0x7c00;
+  }
+  if (x < 0x38800000) {
+    // Below 2^-14, the half subnormals are multiples of 2^-24: adding 0.5
+    // lets the float addition do the rounding.
+    return sign | (FloatBits(BitsFloat(x) + 0.5f) - 0x3f000000);
+  }
+  // Rebias the exponent, and round the 13 dropped mantissa bits to even; a
+  // carry correctly moves on into the exponent.
+  x += 0xc8000fff + ((x >> 13) & 1);
+  return sign | (x >> 13);
+}
+
+inline float Fp16ToFloat(const uint16_t h) {
+  const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+  const uint32_t exponent = (h >> 10) & 0x1f;
+  const uint32_t mantissa = h & 0x3ff;
+  if (exponent == 0x1f) {
+    return BitsFloat(sign | 0x7f800000 | (mantissa << 13));
+  }
+  if (exponent == 0) {
+    const float value = mantissa * (1.f / (1 << 24));
+    return sign ? -value : value;
+  }
+  return BitsFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+inline uint16_t FloatToBf16(const float f) {
+  const uint32_t x = FloatBits(f);
+  if ((x & 0x7fffffff) > 0x7f800000) {
+    return (x >> 16) | 0x40;
+  }
+  return (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+}
+
+inline float Bf16ToFloat(const uint16_t h) {
+  return BitsFloat(static_cast<uint32_t>(h) << 16);
+}
+
+typedef void (*ToHalfFunction)(const int n, const float* x, uint16_t* y);
+typedef void (*FromHalfFunction)(const int n, const uint16_t* x, float* y);
+
+void ToFp16Generic(const int n, const float* x, uint16_t* y) {
+  for (int i = 0; i < n; ++i) { y[i] = FloatToFp16(x[i]); }
+}
+
+void FromFp16Generic(const int n, const uint16_t* x, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = Fp16ToFloat(x[i]); }
+}
+
+inline __attribute__((always_inline))
+void ToBf16Loop(const int n, const float* x, uint16_t* y) {
+  for (int i = 0; i < n; ++i) { y[i] = FloatToBf16(x[i]); }
+}
+
+inline __attribute__((always_inline))
+void FromBf16Loop(const int n, const uint16_t* x, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = Bf16ToFloat(x[i]); }
+}
+
+void ToBf16Generic(const int n, const float* x, uint16_t* y) {
+  ToBf16Loop(n, x, y);
+}
+
+void FromBf16Generic(const int n, const uint16_t* x, float* y) {
+  FromBf16Loop(n, x, y);
+}
+
+#ifdef CAFFE_HALF_X86
+__attribute__((target("avx,f16c")))
+void ToFp16F16c(const int n, const float* x, uint16_t* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i),
+        _mm256_cvtps_ph(_mm256_loadu_ps(x + i), _MM_FROUND_TO_NEAREST_INT));
+  }
+  for (; i < n; ++i) { y[i] = FloatToFp16(x[i]); }
+}
+
+__attribute__((target("avx,f16c")))
+void FromFp16F16c(const int n, const uint16_t* x, float* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_cvtph_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i))));
+  }
+  for (; i < n; ++i) { y[i] = Fp16ToFloat(x[i]); }
+}
+
+__attribute__((target("avx2")))
+void ToBf16Avx2(const int n, const float* x, uint16_t* y) {
+  ToBf16Loop(n, x, y);
+}
+
+__attribute__((target("avx2")))
+void FromBf16Avx2(const int n, const uint16_t* x, float* y) {
+  FromBf16Loop(n, x, y);
+}
+#endif
+
+struct HalfKernels {
+  const char* isa;
+  ToHalfFunction to_fp16;
+  FromHalfFunction from_fp16;
+  ToHalfFunction to_bf16;
+  FromHalfFunction from_bf16;
+};
+
+HalfKernels DetectKernels() {
+  HalfKernels kernels;
+  kernels.isa = "generic";
+  kernels.to_fp16 = &ToFp16Generic;
+  kernels.from_fp16 = &FromFp16Generic;
+  kernels.to_bf16 = &ToBf16Generic;
+  kernels.from_bf16 = &FromBf16Generic;
+#ifdef CAFFE_HALF_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.to_bf16 = &ToBf16Avx2;
+    kernels.from_bf16 = &FromBf16Avx2;
+  }
+  // __builtin_cpu_supports does not know F16C, which also needs AVX.
+  unsigned int eax, ebx, ecx, edx;
+  if (__builtin_cpu_supports("avx") && __get_cpuid(1, &eax, &ebx, &ecx, &edx)
+      && (ecx & bit_F16C)) {
+    kernels.isa = "f16c";
+    kernels.to_fp16 = &ToFp16F16c;
+    kernels.from_fp16 = &FromFp16F16c;
+  }
+#endif
+  return kernels;
+}
+
+const HalfKernels& GetKernels() {
+  static const HalfKernels kernels = DetectKernels();
+  return kernels;
+}
+
+void CheckPrecision(const Precision precision) {
+  CHECK(precision == FP16 || precision == BF16)
+      << "Not a 16 bit precision: " << Precision_Name(precision);
+}
+
+// float reaches the kernels directly; double goes through a float buffer.
+void ToHalf(const int n, const float* x, uint16_t* y, ToHalfFunction f) {
+  f(n, x, y);
+}
+
+void ToHalf(const int n, const double* x, uint16_t* y, ToHalfFunction f) {
+  float buffer[256];
+  for (int i = 0; i < n; i += 256) {
+    const int m = std::min(256, n - i);
+    for (int j = 0; j < m; ++j) { buffer[j] = x[i + j]; }
+    f(m, buffer, y + i);
+  }
+}
+
+void FromHalf(const int n, const uint16_t* x, float* y, FromHalfFunction f) {
+  f(n, x, y);
+}
+
+void FromHalf(const int n, const uint16_t* x, double* y, FromHalfFunction f) {
+  float buffer[256];
+  for (int i = 0; i < n; i += 256) {
+    const int m = std::min(256, n - i);
+    f(m, x + i, buffer);
+    for (int j = 0; j < m; ++j) { y[i + j] = buffer[j]; }
+  }
+}
+
+inline void GemmPanel(const CBLAS_TRANSPOSE TransB, const int M, const int N,
+    const int K, const float* A, const float* B, const int ldb, float* C,
+    const int ldc) {
+  cblas_sgemm(CblasRowMajor, CblasNoTrans, TransB, M, N, K, 1.f, A, K, B,
+      ldb, 0.f, C, ldc);
+}
+
+inline void GemmPanel(const CBLAS_TRANSPOSE TransB, const int M, const int N,
+    const int K, const double* A, const double* B, const int ldb, double* C,
+    const int ldc) {
+  cblas_dgemm(CblasRowMajor, CblasNoTrans, TransB, M, N, K, 1., A, K, B,
+      ldb, 0., C, ldc);
+}
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_cpu_to_half(const int n, const Dtype* x, uint16_t* y,
+    const Precision precision) {
+  CheckPrecision(precision);
+  const ToHalfFunction f = precision == FP16 ?
+      GetKernels().to_fp16 : GetKernels().to_bf16;
+  parallel_for(n, [&](int begin, int end) {
+    ToHalf(end - begin, x + begin, y + begin, f);
+  }, kConvertGrain);
+}
+
+template void caffe_cpu_to_half<float>(const int n, const float* x,
+    uint16_t* y, const Precision precision);
+template void caffe_cpu_to_half<double>(const int n, const double* x,
+    uint16_t* y, const Precision precision);
+
+template <typename Dtype>
+void caffe_cpu_from_half(const int n, const uint16_t* x, Dtype* y,
+    const Precision precision) {
+  CheckPrecision(precision);
+  const FromHalfFunction f = precision == FP16 ?
+      GetKernels().from_fp16 : GetKernels().from_bf16;
+  parallel_for(n, [&](int begin, int end) {
+    FromHalf(end - begin, x + begin, y + begin, f);
+  }, kConvertGrain);
+}
+
+template void caffe_cpu_from_half<float>(const int n, const uint16_t* x,
+    float* y, const Precision precision);
+template void caffe_cpu_from_half<double>(const int n, const uint16_t* x,
+    double* y, const Precision precision);
+
+template <typename Dtype>
+void caffe_cpu_gemm_half(const CBLAS_TRANSPOSE TransB, const int M,
+    const int N, const int K, const Dtype* A, const uint16_t* B,
+    const Precision precision, Dtype* C) {
+  const int columns = std::min(N, std::max(8, kPanelSize / std::max(K, 1)));
+  std::vector<Dtype> panel(columns * K);
+  for (int j = 0; j < N; j += columns) {
+    const int width = std::min(columns, N - j);
+    if (TransB == CblasTrans) {
+      // Rows j to j + width of B are contiguous.
+      caffe_cpu_from_half(width * K, B + j * K, &panel[0], precision);
+      GemmPanel(CblasTrans, M, width, K, A, &panel[0], K, C + j, N);
+    } else {
+      for (int k = 0; k < K; ++k) {
+        caffe_cpu_from_half(width, B + k * N + j, &panel[k * width],
+            precision);
+      }
+      GemmPanel(CblasNoTrans, M, width, K, A, &panel[0], width, C + j, N);
+    }
+  }
+}
+
+template void caffe_cpu_gemm_half<float>(const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const float* A, const uint16_t* B,
+    const Precision precision, float* C);
+template void caffe_cpu_gemm_half<double>(const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const double* A,
+    const uint16_t* B, const Precision precision, double* C);
+
+const char* half_isa() {
+  return GetKernels().isa;
+}
+
+}  // namespace caffe
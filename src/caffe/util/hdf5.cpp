@@ -4,8 +4,51 @@
 #include <string>
 #include <vector>
 
+#include "caffe/util/half.hpp"
+
 namespace caffe {
 
+// The HDF5 type of FP16 or BF16 values.
+static hid_t hdf5_half_type(const Precision precision) {
+  hid_t type = H5Tcopy(H5T_IEEE_F32LE);
+  if (precision == FP16) {
+    H5Tset_fields(type, 15, 10, 5, 0, 10);
+    H5Tset_size(type, 2);
+    H5Tset_ebias(type, 15);
+  } else {
+    H5Tset_fields(type, 15, 7, 8, 0, 7);
+    H5Tset_size(type, 2);
+  }
+  return type;
+}
+
+template <typename Dtype>
+static void hdf5_save_half_dataset(
+    const hid_t file_id, const string& dataset_name, const Blob<Dtype>& blob,
+    bool write_diff, const Precision precision) {
+  vector<hsize_t> dims(blob.shape().begin(), blob.shape().end());
+  const uint16_t* half_data = blob.half_data();
+  vector<uint16_t> buffer;
+  if (write_diff || blob.data_precision() != precision) {
+    vector<Dtype> data;
+    buffer.resize(blob.count());
+    caffe_cpu_to_half(blob.count(), write_diff ? blob.cpu_diff() :
+        blob.cpu_data_uncompressed(&data), buffer.data(), precision);
+    half_data = buffer.data();
+  }
+  hid_t type = hdf5_half_type(precision);
+  hid_t space = H5Screate_simple(dims.size(), dims.data(), NULL);
+  hid_t dataset = H5Dcreate2(file_id, dataset_name.c_str(), type, space,
+      H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to make 16 bit dataset " << dataset_name;
+  herr_t status = H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+      half_data);
+  CHECK_GE(status, 0) << "Failed to write 16 bit dataset " << dataset_name;
+  H5Dclose(dataset);
+  H5Sclose(space);
+  H5Tclose(type);
+}
+
 // Verifies format of data stored in HDF5 file and reshapes blob accordingly.
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(
@@ -85,17 +128,23 @@ void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
 template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
-    bool write_diff) {
+    bool write_diff, const Precision precision) {
+  if (precision != FP32) {
+    hdf5_save_half_dataset(file_id, dataset_name, blob, write_diff,
+        precision);
+    return;
+  }
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
     dims[i] = blob.shape(i);
   }
   const float* data;
+  vector<float> buffer;
   if (write_diff) {
     data = blob.cpu_diff();
   } else {
-    data = blob.cpu_data();
+    data = blob.cpu_data_uncompressed(&buffer);
   }
   herr_t status = H5LTmake_dataset_float(
       file_id, dataset_name.c_str(), num_axes, dims, data);
@@ -106,17 +155,23 @@ void hdf5_save_nd_dataset<float>(
 template <>
 void hdf5_save_nd_dataset<double>(
     hid_t file_id, const string& dataset_name, const Blob<double>& blob,
-    bool write_diff) {
+    bool write_diff, const Precision precision) {
+  if (precision != FP32) {
+    hdf5_save_half_dataset(file_id, dataset_name, blob, write_diff,
+        precision);
+    return;
+  }
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
     dims[i] = blob.shape(i);
   }
   const double* data;
+  vector<double> buffer;
   if (write_diff) {
     data = blob.cpu_diff();
   } else {
-    data = blob.cpu_data();
+    data = blob.cpu_data_uncompressed(&buffer);
   }
   herr_t status = H5LTmake_dataset_double(
       file_id, dataset_name.c_str(), num_axes, dims, data);
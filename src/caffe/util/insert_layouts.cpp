@@ -0,0 +1,197 @@
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/insert_layouts.hpp"
+
+namespace caffe {
+
+namespace {
+
+enum LayerLayout { NEEDS_NCHW, CHANNELS_LAST, ANY_LAYOUT };
+
+// Layers computing each value from the values at the same place only.
+const char* const kAnyLayoutTypes[] = { "AbsVal", "BNLL", "Clip", "Dropout",
+    "ELU", "Eltwise", "Exp", "Log", "Power", "ReLU", "SeLu", "Sigmoid",
+    "Silence", "Swish", "TanH", "Threshold" };
+
+bool AllEqual(
+    const google::protobuf::RepeatedField<google::protobuf::uint32>& values,
+    const google::protobuf::uint32 value) {
+  for (int i = 0; i < values.size(); ++i) {
+    if (values.Get(i) != value) { return false; }
+  }
+  return true;
+}
+
+// Whether the convolution is a GEMM over the pixels of NHWC blobs.
+bool IsPointwise(const ConvolutionParameter& conv) {
+  if (conv.group() != 1 || conv.axis() != 1 || conv.force_nd_im2col()) {
+    return false;
+  }
+  if (conv.has_kernel_h() || conv.has_kernel_w()) {
+    if (conv.kernel_h() != 1 || conv.kernel_w() != 1) { return false; }
+  } else if (conv.kernel_size_size() == 0 || !AllEqual(conv.kernel_size(), 1)) {
+    return false;
+  }
+  if (conv.has_stride_h() || conv.has_stride_w()) {
+    if (conv.stride_h() != 1 || conv.stride_w() != 1) { return false; }
+  } else if (!AllEqual(conv.stride(), 1)) {
+    return false;
+  }
+  if (conv.has_pad_h() || conv.has_pad_w()) {
+    return conv.pad_h() == 0 && conv.pad_w() == 0;
+  }
+  return AllEqual(conv.pad(), 0);
+}
+
+LayerLayout LayerLayoutOf(const LayerParameter& layer) {
+  const string& type = layer.type();
+  // The int8 kernels read NCHW.
+  if (layer.has_quantization_param()) { return NEEDS_NCHW; }
+  if (type == "ConvolutionDepthwise") { return CHANNELS_LAST; }
+  if (type == "Convolution") {
+    return IsPointwise(layer.convolution_param()) ? CHANNELS_LAST : NEEDS_NCHW;
+  }
+  for (int i = 0; i < sizeof(kAnyLayoutTypes) / sizeof(kAnyLayoutTypes[0]);
+       ++i) {
+    if (type == kAnyLayoutTypes[i]) { return ANY_LAYOUT; }
+  }
+  return NEEDS_NCHW;
+}
+
+// The names holding the current value of a blob in each layout, or empty
+// where it is not up to date.
+struct BlobVersions {
+  string nchw;
+  string nhwc;
+  string& in(const Layout layout) { return layout == NHWC ? nhwc : nchw; }
+};
+
+class LayoutRewriter {
+ public:
+  LayoutRewriter(const NetParameter& param, NetParameter* param_layout)
+      : param_layout_(param_layout) {
+    for (int i = 0; i < param.layer_size(); ++i) {
+      for (int j = 0; j < param.layer(i).top_size(); ++j) {
+        reserved_.insert(param.layer(i).top(j));
+      }
+    }
+  }
+
+  void AddLayer(const LayerParameter& layer) {
+    const LayerLayout kind = LayerLayoutOf(layer);
+    Layout layout = kind == CHANNELS_LAST ? NHWC : NCHW;
+    if (kind == ANY_LAYOUT && layer.bottom_size() > 0) {
+      // Stay in NHWC when no conversion is needed.
+      layout = NHWC;
+      for (int j = 0; j < layer.bottom_size(); ++j) {
+        const map<string, BlobVersions>::const_iterator versions =
+            versions_.find(layer.bottom(j));
+        if (versions == versions_.end() || versions->second.nhwc.empty()) {
+          layout = NCHW;
+        }
+      }
+    }
+    vector<string> bottoms(layer.bottom_size());
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      bottoms[j] = Version(layer.bottom(j), layout);
+      consumed_[layer.bottom(j)] = true;
+    }
+    LayerParameter* layer_layout = param_layout_->add_layer();
+    layer_layout->CopyFrom(layer);
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      layer_layout->set_bottom(j, bottoms[j]);
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      const string& blob = layer.top(j);
+      string name;
+      for (int k = 0; k < layer.bottom_size(); ++k) {
+        if (layer.bottom(k) == blob) { name = bottoms[k]; }
+      }
+      if (name.empty()) {
+        name = NewName(blob, layout);
+      }
+      Produce(blob, layout, name);
+      layer_layout->set_top(j, name);
+    }
+  }
+
+  // Converts the outputs of the net left in NHWC back to NCHW.
+  void Finish() {
+    for (int i = 0; i < blobs_.size(); ++i) {
+      if (!consumed_[blobs_[i]] && versions_[blobs_[i]].nchw.empty()) {
+        Version(blobs_[i], NCHW);
+      }
+    }
+  }
+
+ protected:
+  // The name of blob in layout, converting it there first if needed.
+  string Version(const string& blob, const Layout layout) {
+    if (!versions_.count(blob)) {
+      // Not produced by any layer: Net::Init reports it.
+      versions_[blob].nchw = blob;
+    }
+    BlobVersions& versions = versions_[blob];
+    if (versions.in(layout).empty()) {
+      const string name = NewName(blob, layout);
+      LayerParameter* layer = param_layout_->add_layer();
+      layer->set_name(name + "_layout");
+      layer->set_type("Layout");
+      layer->add_bottom(versions.in(layout == NHWC ? NCHW : NHWC));
+      layer->add_top(name);
+      layer->mutable_layout_param()->set_layout(layout);
+      produced_.insert(name);
+      versions.in(layout) = name;
+    }
+    return versions.in(layout);
+  }
+
+  // A name for a new version of blob: its own for the first NCHW one.
+  string NewName(const string& blob, const Layout layout) {
+    if (layout == NCHW && !produced_.count(blob)) { return blob; }
+    const string base = blob + (layout == NHWC ? "_nhwc" : "_nchw");
+    string name = base;
+    for (int i = 1; produced_.count(name) || reserved_.count(name); ++i) {
+      name = base + "_" + format_int(i);
+    }
+    return name;
+  }
+
+  void Produce(const string& blob, const Layout layout, const string& name) {
+    if (!versions_.count(blob)) { blobs_.push_back(blob); }
+    versions_[blob] = BlobVersions();
+    versions_[blob].in(layout) = name;
+    consumed_[blob] = false;
+    produced_.insert(name);
+  }
+
+  NetParameter* param_layout_;
+  // The original blob names, in the order they are first produced.
+  vector<string> blobs_;
+  map<string, BlobVersions> versions_;
+  // Whether the current value of a blob has been used by a layer.
+  map<string, bool> consumed_;
+  // The names given to tops so far, and the original ones.
+  set<string> produced_;
+  set<string> reserved_;
+};
+
+}  // namespace
+
+void InsertLayoutTransforms(const NetParameter& param,
+    NetParameter* param_layout) {
+  param_layout->CopyFrom(param);
+  param_layout->clear_layer();
+  LayoutRewriter rewriter(param, param_layout);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    rewriter.AddLayer(param.layer(i));
+  }
+  rewriter.Finish();
+}
+
+}  // namespace caffe
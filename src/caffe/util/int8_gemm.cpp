@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CAFFE_INT8_X86
+#include <immintrin.h>
+#endif
+
+#include "caffe/common.hpp"
+#include "caffe/util/int8_gemm.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Columns of x per parallel chunk of the GEMM.
+const int kColumnBlock = 64;
+
+// c (rows x n, ldc apart) = a (rows x 4 * k4, lda apart) times b, where b
+// holds groups of four consecutive k for each column, ldb bytes per group.
+typedef void (*GemmFunction)(const int rows, const int n, const int k4,
+    const int8_t* a, const int lda, const uint8_t* b, const int ldb,
+    int32_t* c, const int ldc);
+
+inline __attribute__((always_inline))
+void GemmLoop(const int rows, const int n, const int k4, const int8_t* a,
+    const int lda, const uint8_t* b, const int ldb, int32_t* c,
+    const int ldc) {
+  for (int m = 0; m < rows; ++m) {
+    const int8_t* a_row = a + m * lda;
+    int32_t* c_row = c + m * ldc;
+    std::fill(c_row, c_row + n, 0);
+    for (int kg = 0; kg < k4; ++kg) {
+      const int32_t a0 = a_row[4 * kg];
+      const int32_t a1 = a_row[4 * kg + 1];
+      const int32_t a2 = a_row[4 * kg + 2];
+      const int32_t a3 = a_row[4 * kg + 3];
+      const uint8_t* b_group = b + kg * ldb;
+      for (int j = 0; j < n; ++j) {
+        c_row[j] += a0 * b_group[4 * j] + a1 * b_group[4 * j + 1] +
+            a2 * b_group[4 * j + 2] + a3 * b_group[4 * j + 3];
+      }
+    }
+  }
+}
+
+void GemmGeneric(const int rows, const int n, const int k4, const int8_t* a,
+    const int lda, const uint8_t* b, const int ldb, int32_t* c,
+    const int ldc) {
+  GemmLoop(rows, n, k4, a, lda, b, ldb, c, ldc);
+}
+
+#ifdef CAFFE_INT8_X86
+// Four rows by eight columns per block. Without VNNI there is no u8 s8 dot
+// product free of 16 bit saturation (vpmaddubsw), so b and a are widened to
+// 16 bits and vpmaddwd sums their products in pairs, exactly, into int32.
+// The remaining columns go to the plain loop.
+__attribute__((target("avx2")))
+void GemmAvx2(const int rows, const int n, const int k4, const int8_t* a,
+    const int lda, const uint8_t* b, const int ldb, int32_t* c,
+    const int ldc) {
+  const int n8 = n / 8 * 8;
+  for (int j = 0; j < n8; j += 8) {
+    for (int m = 0; m < rows; m += 4) {
+      // Rows past the end repeat the last one and are not stored.
+      const int8_t* a_rows[4];
+      // Pair sums of columns j to j + 3, and of j + 4 to j + 7.
+      __m256i lo[4], hi[4];
+      for (int r = 0; r < 4; ++r) {
+        a_rows[r] = a + std::min(m + r, rows - 1) * lda;
+        lo[r] = _mm256_setzero_si256();
+        hi[r] = _mm256_setzero_si256();
+      }
+      const uint8_t* b_block = b + 4 * j;
+      for (int kg = 0; kg < k4; ++kg) {
+        const __m256i bv = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(b_block + kg * ldb));
+        const __m256i b_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bv));
+        const __m256i b_hi =
+            _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bv, 1));
+        for (int r = 0; r < 4; ++r) {
+          int32_t w;
+          memcpy(&w, a_rows[r] + 4 * kg, sizeof(w));
+          // The four weights, as 16 bits, repeated for each column.
+          const __m256i wv = _mm256_broadcastq_epi64(
+              _mm_cvtepi8_epi16(_mm_cvtsi32_si128(w)));
+          lo[r] = _mm256_add_epi32(lo[r], _mm256_madd_epi16(b_lo, wv));
+          hi[r] = _mm256_add_epi32(hi[r], _mm256_madd_epi16(b_hi, wv));
+        }
+      }
+      for (int r = 0; r < 4 && m + r < rows; ++r) {
+        // hadd yields columns j, j + 1, j + 4, j + 5, j + 2, j + 3, j + 6,
+        // j + 7: swap the middle 64 bit lanes.
+        const __m256i sums = _mm256_permute4x64_epi64(
+            _mm256_hadd_epi32(lo[r], hi[r]), 0xd8);
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>(c + (m + r) * ldc + j), sums);
+      }
+    }
+  }
+  if (n8 < n) {
+    GemmLoop(rows, n - n8, k4, a, lda, b + 4 * n8, ldb, c + n8, ldc);
+  }
+}
+
+// Four rows by sixteen columns per block: each load of b feeds four
+// vpdpbusd, and the column strip of b stays in cache across the rows.
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+void GemmVnni(const int rows, const int n, const int k4, const int8_t* a,
+    const int lda, const uint8_t* b, const int ldb, int32_t* c,
+    const int ldc) {
+  for (int j = 0; j < n; j += 16) {
+    const __mmask16 mask = n - j >= 16 ? 0xffff : (1u << (n - j)) - 1;
+    for (int m = 0; m < rows; m += 4) {
+      // Rows past the end repeat the last one and are not stored.
+      const int8_t* a0 = a + m * lda;
+      const int8_t* a1 = a + std::min(m + 1, rows - 1) * lda;
+      const int8_t* a2 = a + std::min(m + 2, rows - 1) * lda;
+      const int8_t* a3 = a + std::min(m + 3, rows - 1) * lda;
+      __m512i c0 = _mm512_setzero_si512();
+      __m512i c1 = _mm512_setzero_si512();
+      __m512i c2 = _mm512_setzero_si512();
+      __m512i c3 = _mm512_setzero_si512();
+      const uint8_t* b_block = b + 4 * j;
+      for (int kg = 0; kg < k4; ++kg) {
+        const __m512i bv =
+            _mm512_maskz_loadu_epi32(mask, b_block + kg * ldb);
+        int32_t w0, w1, w2, w3;
+        memcpy(&w0, a0 + 4 * kg, sizeof(w0));
+        memcpy(&w1, a1 + 4 * kg, sizeof(w1));
+        memcpy(&w2, a2 + 4 * kg, sizeof(w2));
+        memcpy(&w3, a3 + 4 * kg, sizeof(w3));
+        c0 = _mm512_dpbusd_epi32(c0, bv, _mm512_set1_epi32(w0));
+        c1 = _mm512_dpbusd_epi32(c1, bv, _mm512_set1_epi32(w1));
+        c2 = _mm512_dpbusd_epi32(c2, bv, _mm512_set1_epi32(w2));
+        c3 = _mm512_dpbusd_epi32(c3, bv, _mm512_set1_epi32(w3));
+      }
+      int32_t* c_block = c + m * ldc + j;
+      _mm512_mask_storeu_epi32(c_block, mask, c0);
+      if (m + 1 < rows) { _mm512_mask_storeu_epi32(c_block + ldc, mask, c1); }
+      if (m + 2 < rows) {
+        _mm512_mask_storeu_epi32(c_block + 2 * ldc, mask, c2);
+      }
+      if (m + 3 < rows) {
+        _mm512_mask_storeu_epi32(c_block + 3 * ldc, mask, c3);
+      }
+    }
+  }
+}
+#endif
+
+struct GemmKernel {
+  const char* isa;
+  GemmFunction gemm;
+};
+
+GemmKernel DetectKernel() {
+  GemmKernel kernel;
+#ifdef CAFFE_INT8_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512vnni") &&
+      __builtin_cpu_supports("avx512bw")) {
+    kernel.isa = "avx512vnni";
+    kernel.gemm = &GemmVnni;
+    return kernel;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernel.isa = "avx2";
+    kernel.gemm = &GemmAvx2;
+    return kernel;
+  }
+#endif
+  kernel.isa = "generic";
+  kernel.gemm = &GemmGeneric;
+  return kernel;
+}
+
+const GemmKernel& GetKernel() {
+  static const GemmKernel kernel = DetectKernel();
+  return kernel;
+}
+
+}  // namespace
+
+template <typename Dtype>
+QuantizedGemm<Dtype>::QuantizedGemm()
+    : input_scale_(1), zero_point_(0) {}
+
+template <typename Dtype>
+bool QuantizedGemm<Dtype>::SetUp(const LayerParameter& param) {
+  const QuantizationParameter& quant_param = param.quantization_param();
+  if (param.phase() != TEST || !param.has_quantization_param() ||
+      !quant_param.enabled()) {
+    return false;
+  }
+  SetInputRange(quant_param.input_min(), quant_param.input_max());
+  // The weights are quantized once the net has them (Layer::PrepareParams).
+  weights_.reset();
+  return true;
+}
+
+template <typename Dtype>
+void QuantizedGemm<Dtype>::SetInputRange(const float input_min,
+    const float input_max) {
+  CHECK_LT(input_min, input_max) << "Empty int8 calibration range.";
+  if (input_min >= 0) {
+    input_scale_ = 255.f / input_max;
+    zero_point_ = 0;
+  } else {
+    input_scale_ = 127.f / std::max(-input_min, input_max);
+    zero_point_ = 128;
+  }
+}
+
+template <typename Dtype>
+void QuantizedGemm<Dtype>::QuantizeWeights(const int rows, const int cols,
+    const Dtype* weights, const bool transposed) {
+  shared_ptr<Weights> quantized(new Weights());
+  quantized->rows = rows;
+  quantized->cols = cols;
+  const int padded_cols = (cols + 3) / 4 * 4;
+  quantized->padded_cols = padded_cols;
+  quantized->values.assign(rows * padded_cols, 0);
+  quantized->scale.resize(rows);
+  quantized->row_sum.resize(rows);
+  for (int m = 0; m < rows; ++m) {
+    Dtype max_abs = 0;
+    for (int k = 0; k < cols; ++k) {
+      const Dtype w =
+          transposed ? weights[k * rows + m] : weights[m * cols + k];
+      max_abs = std::max(max_abs, std::fabs(w));
+    }
+    const float scale = max_abs > 0 ? 127.f / max_abs : 1.f;
+    int32_t sum = 0;
+    for (int k = 0; k < cols; ++k) {
+      const Dtype w =
+          transposed ? weights[k * rows + m] : weights[m * cols + k];
+      const int q = static_cast<int>(std::floor(w * scale + 0.5f));
+      quantized->values[m * padded_cols + k] =
+          std::max(-127, std::min(127, q));
+      sum += quantized->values[m * padded_cols + k];
+    }
+    quantized->scale[m] = scale;
+    quantized->row_sum[m] = sum;
+  }
+  weights_ = quantized;
+}
+
+template <typename Dtype>
+void QuantizedGemm<Dtype>::PackInput(const int n, const Dtype* x,
+    const bool x_transposed) {
+  const int padded_cols = weights_->padded_cols;
+  packed_x_.resize(padded_cols * n);
+  const float scale = input_scale_;
+  const float zero_point = zero_point_;
+  uint8_t* packed = &packed_x_[0];
+  const int cols = weights_->cols;
+  parallel_for(padded_cols / 4, [&](int begin, int end) {
+    for (int kg = begin; kg < end; ++kg) {
+      uint8_t* group = packed + kg * n * 4;
+      for (int r = 0; r < 4; ++r) {
+        const int k = 4 * kg + r;
+        if (k >= cols) {
+          // Padding meets zero weights.
+          for (int j = 0; j < n; ++j) { group[4 * j + r] = 0; }
+          continue;
+        }
+        const Dtype* x_k = x_transposed ? x + k : x + k * n;
+        const int stride = x_transposed ? cols : 1;
+        for (int j = 0; j < n; ++j) {
+          float v = x_k[j * stride] * scale + zero_point;
+          v = std::min(std::max(v, 0.f), 255.f);
+          group[4 * j + r] = static_cast<uint8_t>(v + 0.5f);
+        }
+      }
+    }
+  }, parallel_grain(4 * n));
+}
+
+template <typename Dtype>
+void QuantizedGemm<Dtype>::Forward(const int row_begin, const int rows,
+    const int n, const Dtype* x, const bool x_transposed, const Dtype* bias,
+    Dtype* y, const int y_row_stride, const int y_col_stride) {
+  CHECK(has_weights()) << "QuantizeWeights must come before Forward.";
+  const Weights& weights = *weights_;
+  CHECK_LE(row_begin + rows, weights.rows);
+  if (rows == 0 || n == 0) { return; }
+  PackInput(n, x, x_transposed);
+  acc_.resize(rows * n);
+  const GemmFunction gemm = GetKernel().gemm;
+  const int k4 = weights.padded_cols / 4;
+  const int8_t* a = &weights.values[row_begin * weights.padded_cols];
+  const uint8_t* b = &packed_x_[0];
+  int32_t* c = &acc_[0];
+  const int lda = weights.padded_cols;
+  const int blocks = (n + kColumnBlock - 1) / kColumnBlock;
+  const int block_work = rows * weights.padded_cols * kColumnBlock;
+  parallel_for(blocks, [&](int begin, int end) {
+    const int j = begin * kColumnBlock;
+    const int columns = std::min(end * kColumnBlock, n) - j;
+    gemm(rows, columns, k4, a, lda, b + 4 * j, 4 * n, c + j, n);
+  }, parallel_grain(block_work));
+  // Undo the zero point and the scales, and add the bias.
+  const int32_t zero_point = zero_point_;
+  const float input_scale = input_scale_;
+  parallel_for(rows, [&](int begin, int end) {
+    for (int m = begin; m < end; ++m) {
+      const int row = row_begin + m;
+      const int32_t offset = zero_point * weights.row_sum[row];
+      const Dtype scale = 1. / (input_scale * weights.scale[row]);
+      const Dtype shift = bias ? bias[m] : Dtype(0);
+      const int32_t* c_row = c + m * n;
+      Dtype* y_row = y + m * y_row_stride;
+      for (int j = 0; j < n; ++j) {
+        y_row[j * y_col_stride] = (c_row[j] - offset) * scale + shift;
+      }
+    }
+  }, parallel_grain(n));
+}
+
+const char* int8_gemm_isa() {
+  return GetKernel().isa;
+}
+
+INSTANTIATE_CLASS(QuantizedGemm);
+
+}  // namespace caffe
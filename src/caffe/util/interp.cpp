@@ -1,15 +1,74 @@
 // Copyright 2014 George Papandreou
 
-#include "caffe/common.hpp"
-#include "caffe/util/interp.hpp"
 #include <algorithm>
 #include <cmath>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/interp.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// The source sample, the step to the next one (0 at the border) and the two
+// weights of each output position along one axis. Built once per call and
+// shared by every channel and every row.
+template <typename Dtype>
+struct InterpAxis {
+  InterpAxis(const int size1, const int size2)
+      : index(size2), step(size2), lambda0(size2), lambda1(size2) {
+    const float r = (size2 > 1) ?
+        static_cast<float>(size1 - 1) / (size2 - 1) : 0.f;
+    for (int i2 = 0; i2 < size2; ++i2) {
+      const float i1r = r * i2;
+      const int i1 = i1r;
+      index[i2] = i1;
+      step[i2] = (i1 < size1 - 1) ? 1 : 0;
+      lambda1[i2] = i1r - i1;
+      lambda0[i2] = Dtype(1.) - lambda1[i2];
+    }
+  }
+  std::vector<int> index;
+  std::vector<int> step;
+  std::vector<Dtype> lambda0;
+  std::vector<Dtype> lambda1;
+};
+
+// Horizontal pass of one source row into width2 values.
+template <typename Dtype>
+void InterpRow(const InterpAxis<Dtype>& cols, const Dtype* row, Dtype* out) {
+  const int width2 = cols.index.size();
+  for (int w2 = 0; w2 < width2; ++w2) {
+    const Dtype* pos = row + cols.index[w2];
+    out[w2] = cols.lambda0[w2] * pos[0] + cols.lambda1[w2] * pos[cols.step[w2]];
+  }
+}
+
+// Its adjoint: scatters width2 values back onto one source row.
+template <typename Dtype>
+void InterpRowBackward(const InterpAxis<Dtype>& cols, const Dtype* in,
+    Dtype* row) {
+  const int width2 = cols.index.size();
+  for (int w2 = 0; w2 < width2; ++w2) {
+    Dtype* pos = row + cols.index[w2];
+    pos[0] += cols.lambda0[w2] * in[w2];
+    pos[cols.step[w2]] += cols.lambda1[w2] * in[w2];
+  }
+}
+
+}  // namespace
+
 // Bi-linear interpolation
 // IN : [channels height1 width1] cropped from a bigger [Height1 Width1] image
 // OUT: [channels height2 width2] cropped from a bigger [Height2 Width2] image
+//
+// Planar data is resized a channel at a time, in parallel: each source row is
+// interpolated horizontally once, and the two rows around each output row
+// are blended vertically, so the weights and the row buffers are reused
+// across output rows and channels. Packed data is resized in parallel over
+// output rows, all channels of a pixel at once.
 template <typename Dtype, bool packed>
 void caffe_cpu_interp2(const int channels,
     const Dtype *data1, const int x1, const int y1, const int height1, const int width1, const int Height1, const int Width1,
@@ -18,74 +77,89 @@ void caffe_cpu_interp2(const int channels,
   CHECK(Width1 >= width1 + x1 && Height1 >= height1 + y1 && Width2 >= width2 + x2 && Height2 >= height2 + y2);
   // special case: just copy
   if (height1 == height2 && width1 == width2) {
-    for (int h2 = 0; h2 < height2; ++h2) {
-      const int h1 = h2;
-      for (int w2 = 0; w2 < width2; ++w2) {
-	const int w1 = w2;
-	if (packed) {
-	  const Dtype* pos1 = &data1[channels * ((y1 + h1) * Width1 + (x1 + w1))];
-	  Dtype* pos2 = &data2[channels * ((y2 + h2) * Width2 + (x2 + w2))];
-	  for (int c = 0; c < channels; ++c) {
-	    pos2[0] = pos1[0];
-	    pos1++;
-	    pos2++;
-	  }
-	}
-	else {
-	  const Dtype* pos1 = &data1[(y1 + h1) * Width1 + (x1 + w1)];
-	  Dtype* pos2 = &data2[(y2 + h2) * Width2 + (x2 + w2)];
-	  for (int c = 0; c < channels; ++c) {
-	    pos2[0] = pos1[0];
-	    pos1 += Width1 * Height1;
-	    pos2 += Width2 * Height2;
-	  }
-	}
+    const int planes = packed ? 1 : channels;
+    const int row = packed ? channels * width2 : width2;
+    parallel_for(planes * height2, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        const int c = i / height2, h = i % height2;
+        const int step = packed ? channels : 1;
+        const Dtype* pos1 = &data1[c * Height1 * Width1 + step * ((y1 + h) * Width1 + x1)];
+        Dtype* pos2 = &data2[c * Height2 * Width2 + step * ((y2 + h) * Width2 + x2)];
+        std::copy(pos1, pos1 + row, pos2);
       }
-    }
+    }, parallel_grain(row));
     return;
   }
-  const float rheight = (height2 > 1) ? static_cast<float>(height1 - 1) / (height2 - 1) : 0.f;
-  const float rwidth = (width2 > 1) ? static_cast<float>(width1 - 1) / (width2 - 1) : 0.f;
-  for (int h2 = 0; h2 < height2; ++h2) {
-    const float h1r = rheight * h2;
-    const int h1 = h1r;
-    const int h1p = (h1 < height1 - 1) ? 1 : 0;
-    const Dtype h1lambda = h1r - h1;
-    const Dtype h0lambda = Dtype(1.) - h1lambda;
-    for (int w2 = 0; w2 < width2; ++w2) {
-      const float w1r = rwidth * w2;
-      const int w1 = w1r;
-      const int w1p = (w1 < width1 - 1) ? 1 : 0;
-      const Dtype w1lambda = w1r - w1;
-      const Dtype w0lambda = Dtype(1.) - w1lambda;
-      if (packed) {
-	const Dtype* pos1 = &data1[channels * ((y1 + h1) * Width1 + (x1 + w1))];
-	Dtype* pos2 = &data2[channels * ((y2 + h2) * Width2 + (x2 + w2))];
-	for (int c = 0; c < channels; ++c) {
-	  pos2[0] =
-	    h0lambda * (w0lambda * pos1[0]            + w1lambda * pos1[channels * w1p]) + 
-	    h1lambda * (w0lambda * pos1[channels * h1p * Width1] + w1lambda * pos1[channels * (h1p * Width1 + w1p)]);
-	  pos1++;
-	  pos2++;
-	}
+  const InterpAxis<Dtype> rows(height1, height2);
+  const InterpAxis<Dtype> cols(width1, width2);
+  if (packed) {
+    parallel_for(height2, [&](int begin, int end) {
+      for (int h2 = begin; h2 < end; ++h2) {
+        const int h1 = rows.index[h2];
+        const int h1p = rows.step[h2];
+        const Dtype h0lambda = rows.lambda0[h2];
+        const Dtype h1lambda = rows.lambda1[h2];
+        for (int w2 = 0; w2 < width2; ++w2) {
+          const int w1 = cols.index[w2];
+          const int w1p = cols.step[w2];
+          const Dtype w0lambda = cols.lambda0[w2];
+          const Dtype w1lambda = cols.lambda1[w2];
+          const Dtype* pos1 = &data1[channels * ((y1 + h1) * Width1 + (x1 + w1))];
+          Dtype* pos2 = &data2[channels * ((y2 + h2) * Width2 + (x2 + w2))];
+          for (int c = 0; c < channels; ++c) {
+            pos2[c] =
+              h0lambda * (w0lambda * pos1[c]            + w1lambda * pos1[c + channels * w1p]) +
+              h1lambda * (w0lambda * pos1[c + channels * h1p * Width1] + w1lambda * pos1[c + channels * (h1p * Width1 + w1p)]);
+          }
+        }
       }
-      else {
-	const Dtype* pos1 = &data1[(y1 + h1) * Width1 + (x1 + w1)];
-	Dtype* pos2 = &data2[(y2 + h2) * Width2 + (x2 + w2)];
-	for (int c = 0; c < channels; ++c) {
-	  pos2[0] =
-	    h0lambda * (w0lambda * pos1[0]            + w1lambda * pos1[w1p]) + 
-	    h1lambda * (w0lambda * pos1[h1p * Width1] + w1lambda * pos1[h1p * Width1 + w1p]);
-	  pos1 += Width1 * Height1;
-	  pos2 += Width2 * Height2;
-	}
+    }, parallel_grain(channels * width2));
+    return;
+  }
+  parallel_for(channels, [&](int begin, int end) {
+    // Horizontally interpolated source rows row_a and row_b.
+    std::vector<Dtype> buffer(2 * width2);
+    for (int c = begin; c < end; ++c) {
+      const Dtype* plane1 = &data1[c * Height1 * Width1 + y1 * Width1 + x1];
+      Dtype* plane2 = &data2[c * Height2 * Width2 + y2 * Width2 + x2];
+      Dtype* buffer_a = &buffer[0];
+      Dtype* buffer_b = &buffer[width2];
+      int row_a = -1, row_b = -1;
+      for (int h2 = 0; h2 < height2; ++h2) {
+        const int a = rows.index[h2];
+        const int b = a + rows.step[h2];
+        if (a != row_a) {
+          if (a == row_b) {
+            std::swap(buffer_a, buffer_b);
+            std::swap(row_a, row_b);
+          } else {
+            InterpRow(cols, plane1 + a * Width1, buffer_a);
+            row_a = a;
+          }
+        }
+        if (b != row_a && b != row_b) {
+          InterpRow(cols, plane1 + b * Width1, buffer_b);
+          row_b = b;
+        }
+        const Dtype* top = buffer_a;
+        const Dtype* bottom = (b == row_a) ? buffer_a : buffer_b;
+        const Dtype h0lambda = rows.lambda0[h2];
+        const Dtype h1lambda = rows.lambda1[h2];
+        Dtype* pos2 = plane2 + h2 * Width2;
+        for (int w2 = 0; w2 < width2; ++w2) {
+          pos2[w2] = h0lambda * top[w2] + h1lambda * bottom[w2];
+        }
       }
     }
-  }
+  }, parallel_grain(height2 * width2));
 }
 
 
 // Backward (adjoint) operation 1 <- 2 (accumulates)
+//
+// Planar data runs the forward passes in reverse, in parallel over channels:
+// the gradient rows are first split vertically onto rows of width2 values,
+// one per source row, then each of those is scattered horizontally once.
 template <typename Dtype, bool packed>
 void caffe_cpu_interp2_backward(const int channels,
     Dtype *data1, const int x1, const int y1, const int height1, const int width1, const int Height1, const int Width1,
@@ -94,72 +168,72 @@ void caffe_cpu_interp2_backward(const int channels,
   CHECK(Width1 >= width1 + x1 && Height1 >= height1 + y1 && Width2 >= width2 + x2 && Height2 >= height2 + y2);
   // special case: same-size matching grids
   if (height1 == height2 && width1 == width2) {
+    const int planes = packed ? 1 : channels;
+    const int row = packed ? channels * width2 : width2;
+    parallel_for(planes * height2, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        const int c = i / height2, h = i % height2;
+        const int step = packed ? channels : 1;
+        Dtype* pos1 = &data1[c * Height1 * Width1 + step * ((y1 + h) * Width1 + x1)];
+        const Dtype* pos2 = &data2[c * Height2 * Width2 + step * ((y2 + h) * Width2 + x2)];
+        for (int k = 0; k < row; ++k) {
+          pos1[k] += pos2[k];
+        }
+      }
+    }, parallel_grain(row));
+    return;
+  }
+  const InterpAxis<Dtype> rows(height1, height2);
+  const InterpAxis<Dtype> cols(width1, width2);
+  if (packed) {
+    // Neighbouring output rows scatter onto the same source rows: serial.
     for (int h2 = 0; h2 < height2; ++h2) {
-      const int h1 = h2;
+      const int h1 = rows.index[h2];
+      const int h1p = rows.step[h2];
+      const Dtype h0lambda = rows.lambda0[h2];
+      const Dtype h1lambda = rows.lambda1[h2];
       for (int w2 = 0; w2 < width2; ++w2) {
-	const int w1 = w2;
-	if (packed) {
-	  Dtype* pos1 = &data1[channels * ((y1 + h1) * Width1 + (x1 + w1))];
-	  const Dtype* pos2 = &data2[channels * ((y2 + h2) * Width2 + (x2 + w2))];
-	  for (int c = 0; c < channels; ++c) {
-	    pos1[0] += pos2[0];
-	    pos1++;
-	    pos2++;
-	  }
-	}
-	else {
-	  Dtype* pos1 = &data1[(y1 + h1) * Width1 + (x1 + w1)];
-	  const Dtype* pos2 = &data2[(y2 + h2) * Width2 + (x2 + w2)];
-	  for (int c = 0; c < channels; ++c) {
-	    pos1[0] += pos2[0];
-	    pos1 += Width1 * Height1;
-	    pos2 += Width2 * Height2;
-	  }
-	}
+        const int w1 = cols.index[w2];
+        const int w1p = cols.step[w2];
+        const Dtype w0lambda = cols.lambda0[w2];
+        const Dtype w1lambda = cols.lambda1[w2];
+        Dtype* pos1 = &data1[channels * ((y1 + h1) * Width1 + (x1 + w1))];
+        const Dtype* pos2 = &data2[channels * ((y2 + h2) * Width2 + (x2 + w2))];
+        for (int c = 0; c < channels; ++c) {
+          pos1[c] += h0lambda * w0lambda * pos2[c];
+          pos1[c + channels * w1p] += h0lambda * w1lambda * pos2[c];
+          pos1[c + channels * h1p * Width1] += h1lambda * w0lambda * pos2[c];
+          pos1[c + channels * (h1p * Width1 + w1p)] += h1lambda * w1lambda * pos2[c];
+        }
       }
     }
     return;
   }
-  const float rheight = (height2 > 1) ? static_cast<float>(height1 - 1) / (height2 - 1) : 0.f;
-  const float rwidth = (width2 > 1) ? static_cast<float>(width1 - 1) / (width2 - 1) : 0.f;
-  for (int h2 = 0; h2 < height2; ++h2) {
-    const float h1r = rheight * h2;
-    const int h1 = h1r;
-    const int h1p = (h1 < height1 - 1) ? 1 : 0;
-    const Dtype h1lambda = h1r - h1;
-    const Dtype h0lambda = Dtype(1.) - h1lambda;
-    for (int w2 = 0; w2 < width2; ++w2) {
-      const float w1r = rwidth * w2;
-      const int w1 = w1r;
-      const int w1p = (w1 < width1 - 1) ? 1 : 0;
-      const Dtype w1lambda = w1r - w1;
-      const Dtype w0lambda = Dtype(1.) - w1lambda;
-      if (packed) {
-	Dtype* pos1 = &data1[channels * ((y1 + h1) * Width1 + (x1 + w1))];
-	const Dtype* pos2 = &data2[channels * ((y2 + h2) * Width2 + (x2 + w2))];
-	for (int c = 0; c < channels; ++c) {
-	  pos1[0] += h0lambda * w0lambda * pos2[0];
-	  pos1[channels * w1p] += h0lambda * w1lambda * pos2[0];
-	  pos1[channels * h1p * Width1] += h1lambda * w0lambda * pos2[0];
-	  pos1[channels * (h1p * Width1 + w1p)] += h1lambda * w1lambda * pos2[0];
-	  pos1++;
-	  pos2++;
-	}
+  parallel_for(channels, [&](int begin, int end) {
+    // The vertically split gradient, a row of width2 values per source row.
+    std::vector<Dtype> split(height1 * width2);
+    for (int c = begin; c < end; ++c) {
+      Dtype* plane1 = &data1[c * Height1 * Width1 + y1 * Width1 + x1];
+      const Dtype* plane2 = &data2[c * Height2 * Width2 + y2 * Width2 + x2];
+      std::fill(split.begin(), split.end(), Dtype(0));
+      for (int h2 = 0; h2 < height2; ++h2) {
+        const Dtype* pos2 = plane2 + h2 * Width2;
+        Dtype* top = &split[rows.index[h2] * width2];
+        Dtype* bottom = top + rows.step[h2] * width2;
+        const Dtype h0lambda = rows.lambda0[h2];
+        const Dtype h1lambda = rows.lambda1[h2];
+        for (int w2 = 0; w2 < width2; ++w2) {
+          top[w2] += h0lambda * pos2[w2];
+        }
+        for (int w2 = 0; w2 < width2; ++w2) {
+          bottom[w2] += h1lambda * pos2[w2];
+        }
       }
-      else {
-	Dtype* pos1 = &data1[(y1 + h1) * Width1 + (x1 + w1)];
-	const Dtype* pos2 = &data2[(y2 + h2) * Width2 + (x2 + w2)];
-	for (int c = 0; c < channels; ++c) {
-	  pos1[0] += h0lambda * w0lambda * pos2[0];
-	  pos1[w1p] += h0lambda * w1lambda * pos2[0];
-	  pos1[h1p * Width1] += h1lambda * w0lambda * pos2[0];
-	  pos1[h1p * Width1 + w1p] += h1lambda * w1lambda * pos2[0];
-	  pos1 += Width1 * Height1;
-	  pos2 += Width2 * Height2;
-	}
+      for (int h1 = 0; h1 < height1; ++h1) {
+        InterpRowBackward(cols, &split[h1 * width2], plane1 + h1 * Width1);
       }
     }
-  }
+  }, parallel_grain(height2 * width2));
 }
 
 // Create Gaussian pyramid of an image. Assume output space is pre-allocated.
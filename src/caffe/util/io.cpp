@@ -16,6 +16,9 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #endif  // USE_OPENCV
 #include <stdint.h>
+#ifdef USE_SNAPPY
+#include <snappy.h>
+#endif  // USE_SNAPPY
 
 #include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
@@ -668,6 +671,39 @@ bool MapLabelToDisplayName(const LabelMap& map, const bool strict_check,
   return true;
 }
 
+bool CompressDatum(Datum* datum) {
+#ifdef USE_SNAPPY
+  if (datum->encoded() || datum->compressed() || datum->data().empty()) {
+    return false;
+  }
+  string compressed;
+  snappy::Compress(datum->data().data(), datum->data().size(), &compressed);
+  datum->mutable_data()->swap(compressed);
+  datum->set_compressed(true);
+  return true;
+#else
+  return false;
+#endif  // USE_SNAPPY
+}
+
+bool DecompressDatum(Datum* datum) {
+  if (!datum->compressed()) {
+    return false;
+  }
+#ifdef USE_SNAPPY
+  string data;
+  CHECK(snappy::Uncompress(datum->data().data(), datum->data().size(), &data))
+      << "Could not decompress datum";
+  datum->mutable_data()->swap(data);
+  datum->set_compressed(false);
+  return true;
+#else
+  LOG(ERROR) << "Compressed datum requires snappy; compile with USE_LEVELDB.";
+  LOG(FATAL) << "fatal error";
+  return false;
+#endif  // USE_SNAPPY
+}
+
 #ifdef USE_OPENCV
 cv::Mat DecodeDatumToCVMatNative(const Datum& datum) {
   cv::Mat cv_img;
@@ -750,8 +786,12 @@ std::vector<cv::Mat> DecodeBlobToCVMats(const Blob<Dtype>& blob, float scale)
 }
 
 // If Datum is encoded will decoded using DecodeDatumToCVMat and CVMatToDatum
+// If Datum is compressed will decompress it
 // If Datum is not encoded will do nothing
 bool DecodeDatumNative(Datum* datum) {
+  if (DecompressDatum(datum)) {
+    return true;
+  }
   if (datum->encoded()) {
     cv::Mat cv_img = DecodeDatumToCVMatNative((*datum));
     CVMatToDatum(cv_img, datum);
@@ -761,6 +801,9 @@ bool DecodeDatumNative(Datum* datum) {
   }
 }
 bool DecodeDatum(Datum* datum, bool is_color) {
+  if (DecompressDatum(datum)) {
+    return true;
+  }
   if (datum->encoded()) {
     cv::Mat cv_img = DecodeDatumToCVMat((*datum), is_color);
     CVMatToDatum(cv_img, datum);
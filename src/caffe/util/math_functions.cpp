@@ -1,12 +1,17 @@
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
+#include <vector>
 
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/simd_math.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -32,6 +37,106 @@ void caffe_cpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
       ldb, beta, C, N);
 }
 
+template <typename Dtype>
+void caffe_cpu_transpose(const int batch, const int rows, const int cols,
+    const Dtype* x, Dtype* y) {
+  // A tile of both matrices stays in L1 while it is read and written.
+  const int kTile = 32;
+  const int row_tiles = (rows + kTile - 1) / kTile;
+  const int col_tiles = (cols + kTile - 1) / kTile;
+  const int tiles = row_tiles * col_tiles;
+  parallel_for(batch * tiles, [&](int begin, int end) {
+    for (int t = begin; t < end; ++t) {
+      const int b = t / tiles;
+      const int r0 = (t % tiles) / col_tiles * kTile;
+      const int c0 = (t % col_tiles) * kTile;
+      const int r1 = std::min(rows, r0 + kTile);
+      const int c1 = std::min(cols, c0 + kTile);
+      const Dtype* x_b = x + static_cast<size_t>(b) * rows * cols;
+      Dtype* y_b = y + static_cast<size_t>(b) * rows * cols;
+      for (int c = c0; c < c1; ++c) {
+        for (int r = r0; r < r1; ++r) {
+          y_b[c * rows + r] = x_b[r * cols + c];
+        }
+      }
+    }
+  }, parallel_grain(kTile * kTile));
+}
+
+template void caffe_cpu_transpose<float>(const int batch, const int rows,
+    const int cols, const float* x, float* y);
+template void caffe_cpu_transpose<double>(const int batch, const int rows,
+    const int cols, const double* x, double* y);
+
+template <typename Dtype>
+void caffe_cpu_permute(const int num_axes, const int* y_shape,
+    const int* x_strides, const Dtype* x, Dtype* y) {
+  // Axes that stay adjacent in x are merged, and unit axes dropped, so that
+  // most permutations come down to a copy, a transpose, or few, long rows.
+  vector<int> shape, strides;
+  int count = 1;
+  for (int j = 0; j < num_axes; ++j) {
+    count *= y_shape[j];
+    if (y_shape[j] == 1) { continue; }
+    if (!shape.empty() && strides.back() == x_strides[j] * y_shape[j]) {
+      shape.back() *= y_shape[j];
+      strides.back() = x_strides[j];
+    } else {
+      shape.push_back(y_shape[j]);
+      strides.push_back(x_strides[j]);
+    }
+  }
+  if (count == 0) { return; }
+  const int axes = shape.size();
+  if (axes <= 1) {
+    caffe_copy(count, x, y);
+    return;
+  }
+  // A batch of dense transposes: y[b, r, c] = x[b, c, r].
+  if (axes <= 3 && strides[axes - 2] == 1 &&
+      strides[axes - 1] == shape[axes - 2] &&
+      (axes == 2 || strides[0] == shape[1] * shape[2])) {
+    caffe_cpu_transpose(axes == 3 ? shape[0] : 1, shape[axes - 1],
+        shape[axes - 2], x, y);
+    return;
+  }
+  // Otherwise y is written a row at a time, the offset of each row in x
+  // stepped from the previous one.
+  const int inner = shape[axes - 1];
+  const int inner_stride = strides[axes - 1];
+  parallel_for(count / inner, [&](int begin, int end) {
+    vector<int> index(axes - 1);
+    int offset = 0;
+    for (int j = axes - 2, r = begin; j >= 0; --j) {
+      index[j] = r % shape[j];
+      r /= shape[j];
+      offset += index[j] * strides[j];
+    }
+    for (int r = begin; r < end; ++r) {
+      const Dtype* x_row = x + offset;
+      Dtype* y_row = y + static_cast<size_t>(r) * inner;
+      if (inner_stride == 1) {
+        caffe_copy(inner, x_row, y_row);
+      } else {
+        for (int k = 0; k < inner; ++k) {
+          y_row[k] = x_row[k * inner_stride];
+        }
+      }
+      for (int j = axes - 2; j >= 0; --j) {
+        offset += strides[j];
+        if (++index[j] < shape[j]) { break; }
+        offset -= strides[j] * shape[j];
+        index[j] = 0;
+      }
+    }
+  }, parallel_grain(inner));
+}
+
+template void caffe_cpu_permute<float>(const int num_axes,
+    const int* y_shape, const int* x_strides, const float* x, float* y);
+template void caffe_cpu_permute<double>(const int num_axes,
+    const int* y_shape, const int* x_strides, const double* x, double* y);
+
   /*template<typename Dtype>
 void caffe_cpu_csr_gemm(const CBLAS_TRANSPOSE TransA,
                         const CBLAS_TRANSPOSE TransB, const int M, const int N,
@@ -367,10 +472,46 @@ void caffe_abs<double>(const int n, const double* a, double* y) {
     vdAbs(n, a, y);
 }
 
+template <>
+void caffe_tanh<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
+  vsTanh(n, a, y);
+#else
+  simd_tanh(n, a, y);
+#endif
+}
+
+template <>
+void caffe_tanh<double>(const int n, const double* a, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = tanh(a[i]);
+  }
+}
+
+template <>
+void caffe_sigmoid<float>(const int n, const float* a, float* y) {
+  simd_sigmoid(n, a, y);
+}
+
+template <>
+void caffe_sigmoid<double>(const int n, const double* a, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = 0.5 * tanh(0.5 * a[i]) + 0.5;
+  }
+}
+
 unsigned int caffe_rng_rand() {
   return (*caffe_rng())();
 }
 
+void caffe_set_blas_threads(const int num_threads) {
+#if defined(USE_MKL)
+  mkl_set_num_threads(num_threads);
+#elif defined(USE_OPENBLAS)
+  openblas_set_num_threads(num_threads);
+#endif
+}
+
 template <typename Dtype>
 Dtype caffe_nextafter(const Dtype b) {
   return boost::math::nextafter<Dtype>(
@@ -0,0 +1,149 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <exception>
+#include <vector>
+
+#include "caffe/util/ordered_pipeline.hpp"
+
+namespace caffe {
+
+class OrderedPipeline::sync {
+ public:
+  boost::mutex mutex_;
+  // signaled when an item can be handed out or the workers must exit
+  boost::condition_variable work_;
+  // signaled when an item is processed or the run stops
+  boost::condition_variable done_;
+  std::vector<shared_ptr<boost::thread> > workers_;
+  // The current run, if running.
+  const boost::function<void(int, int)>* process_;
+  bool running_;
+  int n_;
+  int next_;      // first item not handed out yet
+  int consumed_;  // items consumed so far
+  int busy_;      // items being processed
+  std::vector<char> ready_;  // per slot: processed, not consumed yet
+  bool stop_;     // the run failed: hand out no more items
+  std::exception_ptr error_;
+  bool exit_;
+};
+
+OrderedPipeline::OrderedPipeline(int num_workers, int window)
+    : sync_(new sync()) {
+  if (num_workers <= 0) {
+    num_workers = boost::thread::hardware_concurrency();
+  }
+  num_workers_ = std::max(num_workers, 1);
+  window_ = window > 0 ? window : 8 * num_workers_;
+  sync_->process_ = NULL;
+  sync_->running_ = false;
+  sync_->busy_ = 0;
+  sync_->exit_ = false;
+  for (int w = 0; w < num_workers_; ++w) {
+    sync_->workers_.push_back(shared_ptr<boost::thread>(
+        new boost::thread(&OrderedPipeline::WorkerEntry, this)));
+  }
+}
+
+OrderedPipeline::~OrderedPipeline() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->exit_ = true;
+  }
+  sync_->work_.notify_all();
+  for (int w = 0; w < sync_->workers_.size(); ++w) {
+    sync_->workers_[w]->join();
+  }
+}
+
+void OrderedPipeline::WorkerEntry() {
+  sync* s = sync_.get();
+  boost::mutex::scoped_lock lock(s->mutex_);
+  while (true) {
+    while (!s->exit_ && !(s->running_ && !s->stop_ && s->next_ < s->n_ &&
+           s->next_ < s->consumed_ + window_)) {
+      s->work_.wait(lock);
+    }
+    if (s->exit_) { return; }
+    const int i = s->next_++;
+    const int slot = i % window_;
+    const boost::function<void(int, int)>& process = *s->process_;
+    ++s->busy_;
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      process(i, slot);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    --s->busy_;
+    if (error) {
+      if (!s->error_) { s->error_ = error; }
+      s->stop_ = true;
+    }
+    s->ready_[slot] = 1;
+    s->done_.notify_all();
+  }
+}
+
+void OrderedPipeline::Run(int n, const boost::function<void(int, int)>& process,
+    const boost::function<void(int, int)>& consume) {
+  if (n <= 0) { return; }
+  sync* s = sync_.get();
+  {
+    boost::mutex::scoped_lock lock(s->mutex_);
+    CHECK(!s->running_) << "OrderedPipeline::Run is not reentrant";
+    s->process_ = &process;
+    s->n_ = n;
+    s->next_ = 0;
+    s->consumed_ = 0;
+    s->ready_.assign(window_, 0);
+    s->stop_ = false;
+    s->error_ = std::exception_ptr();
+    s->running_ = true;
+  }
+  s->work_.notify_all();
+  for (int i = 0; i < n; ++i) {
+    const int slot = i % window_;
+    {
+      boost::mutex::scoped_lock lock(s->mutex_);
+      while (!s->stop_ && !s->ready_[slot]) {
+        s->done_.wait(lock);
+      }
+      if (s->stop_) { break; }
+    }
+    std::exception_ptr error;
+    try {
+      consume(i, slot);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    boost::mutex::scoped_lock lock(s->mutex_);
+    if (error) {
+      s->error_ = error;
+      s->stop_ = true;
+      break;
+    }
+    s->ready_[slot] = 0;
+    s->consumed_ = i + 1;
+    s->work_.notify_all();
+  }
+  std::exception_ptr error;
+  {
+    // process references the caller's state: wait for the items in flight.
+    boost::mutex::scoped_lock lock(s->mutex_);
+    s->running_ = false;
+    while (s->busy_ > 0) {
+      s->done_.wait(lock);
+    }
+    s->process_ = NULL;
+    error = s->error_;
+    s->error_ = std::exception_ptr();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,80 @@
+#include <boost/thread.hpp>
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
+#include <sstream>
+#include <string>
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/sample_cache.hpp"
+
+namespace caffe {
+
+template <typename T>
+class SampleCache<T>::sync {
+ public:
+  mutable boost::mutex mutex_;
+};
+
+template <typename T>
+SampleCache<T>::SampleCache(size_t capacity_bytes)
+    : capacity_bytes_(capacity_bytes), bytes_(0), hits_(0), lookups_(0),
+      sync_(new sync()) {
+}
+
+template <typename T>
+bool SampleCache<T>::Get(const string& key, T* value) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  ++lookups_;
+  typename std::map<string, T>::const_iterator it = samples_.find(key);
+  if (it == samples_.end()) {
+    return false;
+  }
+  ++hits_;
+  *value = it->second;
+  return true;
+}
+
+template <typename T>
+void SampleCache<T>::Put(const string& key, const T& value, size_t bytes) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  if (bytes_ + bytes > capacity_bytes_ || samples_.count(key)) {
+    return;
+  }
+  samples_[key] = value;
+  bytes_ += bytes;
+}
+
+template <typename T>
+size_t SampleCache<T>::size() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return samples_.size();
+}
+
+template <typename T>
+size_t SampleCache<T>::bytes() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return bytes_;
+}
+
+template <typename T>
+string SampleCache<T>::Stats() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  std::ostringstream stats;
+  stats << samples_.size() << " samples, " << (bytes_ >> 20) << " of "
+        << (capacity_bytes_ >> 20) << " MB, hit rate "
+        << (lookups_ ? 100. * hits_ / lookups_ : 0.) << "% of " << lookups_
+        << " lookups";
+  hits_ = 0;
+  lookups_ = 0;
+  return stats.str();
+}
+
+template class SampleCache<Datum>;
+template class SampleCache<AnnotatedDatum>;
+template class SampleCache<SparseDatum>;
+#ifdef USE_OPENCV
+template class SampleCache<cv::Mat>;
+#endif  // USE_OPENCV
+
+}  // namespace caffe
@@ -0,0 +1,305 @@
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "caffe/util/simd_math.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+// The kernels below are built on GCC vector extensions and instantiated once
+// per vector width. Every helper is force-inlined into the loop compiled for
+// its instruction set, so the ABI for returning wide vectors, which GCC warns
+// about, never comes into play.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CAFFE_SIMD_X86
+#endif
+
+#define SIMD_INLINE inline __attribute__((always_inline))
+
+namespace caffe {
+
+namespace {
+
+typedef float float4v __attribute__((vector_size(16)));
+typedef int32_t int4v __attribute__((vector_size(16)));
+typedef float float8v __attribute__((vector_size(32)));
+typedef int32_t int8v __attribute__((vector_size(32)));
+typedef float float16v __attribute__((vector_size(64)));
+typedef int32_t int16v __attribute__((vector_size(64)));
+
+const int32_t kSignMask = std::numeric_limits<int32_t>::min();
+// 1.5 * 2^23: adding it rounds a float of magnitude < 2^22 to an integer,
+// which then sits in the low mantissa bits.
+const float kRoundMagic = 12582912.f;
+const int32_t kRoundMagicBits = 0x4B400000;
+
+enum Op { kExp, kLog, kTanh, kSigmoid, kPowx, kNumOps };
+
+struct PowParam {
+  float b;
+  bool integer;
+  bool odd;
+};
+
+template <typename VF>
+SIMD_INLINE VF splat(const float value) {
+  return VF() + value;
+}
+
+template <typename VF, typename VI>
+SIMD_INLINE VF select(const VI& mask, const VF& a, const VF& b) {
+  return (VF)(((VI)a & mask) | ((VI)b & ~mask));
+}
+
+// Cephes expf: exp(x) = 2^n * exp(r) with |r| <= ln(2) / 2. 2^n is applied
+// in two halves so that denormal results and overflow come out right.
+template <typename VF, typename VI>
+SIMD_INLINE VF vexp(const VF& x) {
+  VF t = select<VF, VI>(x > -104.f, x, splat<VF>(-104.f));
+  t = select<VF, VI>(t < 89.f, t, splat<VF>(89.f));
+  VF fn = t * 1.44269504088896341f + kRoundMagic;
+  const VI n = (VI)fn - kRoundMagicBits;
+  fn = fn - kRoundMagic;
+  VF r = t - fn * 0.693359375f;
+  r = r + fn * 2.12194440e-4f;
+  VF p = splat<VF>(1.9875691500e-4f);
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * (r * r) + r + 1.f;
+  const VI n1 = n >> 1;
+  const VI n2 = n - n1;
+  const VF y = p * (VF)((n1 + 127) << 23) * (VF)((n2 + 127) << 23);
+  return select<VF, VI>(x == x, y, x);
+}
+
+// Cephes logf: log(x) = e * ln(2) + log(m) with sqrt(1/2) <= m < sqrt(2).
+template <typename VF, typename VI>
+SIMD_INLINE VF vlog(const VF& x) {
+  const VI denormal = x < std::numeric_limits<float>::min();
+  const VF xs = select<VF, VI>(denormal, x * 8388608.f, x);
+  const VI bits = (VI)xs;
+  VI e = ((bits >> 23) & 0xff) - 126 - (denormal & 23);
+  VF m = (VF)((bits & 0x007fffff) | 0x3f000000);
+  const VI small = m < 0.707106781186547524f;
+  e = e + small;
+  m = m + (VF)((VI)m & small) - 1.f;
+  const VF fe = (VF)(e + kRoundMagicBits) - kRoundMagic;
+  const VF z = m * m;
+  VF p = splat<VF>(7.0376836292e-2f);
+  p = p * m - 1.1514610310e-1f;
+  p = p * m + 1.1676998740e-1f;
+  p = p * m - 1.2420140846e-1f;
+  p = p * m + 1.4249322787e-1f;
+  p = p * m - 1.6668057665e-1f;
+  p = p * m + 2.0000714765e-1f;
+  p = p * m - 2.4999993993e-1f;
+  p = p * m + 3.3333331174e-1f;
+  VF y = p * m * z;
+  y = y - fe * 2.12194440e-4f;
+  y = y - 0.5f * z;
+  VF r = m + y + fe * 0.693359375f;
+  r = select<VF, VI>(x > 0.f, r, select<VF, VI>(x == 0.f,
+      splat<VF>(-std::numeric_limits<float>::infinity()),
+      splat<VF>(std::numeric_limits<float>::quiet_NaN())));
+  return select<VF, VI>(x == std::numeric_limits<float>::infinity(), x, r);
+}
+
+template <typename VF, typename VI>
+SIMD_INLINE VF vtanh(const VF& x) {
+  const VI sign = (VI)x & kSignMask;
+  const VF ax = (VF)((VI)x ^ sign);
+  // 1 - 2 / (exp(2|x|) + 1) cancels near 0, where Cephes' series is used.
+  const VF large = 1.f - 2.f / (vexp<VF, VI>(ax + ax) + 1.f);
+  const VF z = x * x;
+  VF p = splat<VF>(-5.70498872745e-3f);
+  p = p * z + 2.06390887954e-2f;
+  p = p * z - 5.37397155531e-2f;
+  p = p * z + 1.33314422036e-1f;
+  p = p * z - 3.33332819422e-1f;
+  const VF small = p * z * x + x;
+  return select<VF, VI>(ax < 0.625f, small, (VF)((VI)large | sign));
+}
+
+template <typename VF, typename VI>
+SIMD_INLINE VF vsigmoid(const VF& x) {
+  // exp(-|x|) never overflows, and e / (1 + e) keeps tiny results exact.
+  const VF e = vexp<VF, VI>((VF)((VI)x | kSignMask));
+  const VF s = 1.f / (1.f + e);
+  return select<VF, VI>(x < 0.f, e * s, s);
+}
+
+template <typename VF, typename VI>
+SIMD_INLINE VF vpowx(const VF& x, const PowParam& param) {
+  const VI sign = (VI)x & kSignMask;
+  const VF ax = (VF)((VI)x ^ sign);
+  VF y = vexp<VF, VI>(vlog<VF, VI>(ax) * param.b);
+  if (param.odd) {
+    y = (VF)((VI)y | sign);
+  } else if (!param.integer) {
+    // pow() of a finite negative base is only defined for integer powers.
+    const VI negative =
+        (x < 0.f) & (ax < std::numeric_limits<float>::infinity());
+    y = select<VF, VI>(negative,
+        splat<VF>(std::numeric_limits<float>::quiet_NaN()), y);
+  }
+  return y;
+}
+
+template <typename VF, typename VI, int op>
+SIMD_INLINE VF Apply(const VF& x, const PowParam& param) {
+  switch (op) {
+  case kExp: return vexp<VF, VI>(x);
+  case kLog: return vlog<VF, VI>(x);
+  case kTanh: return vtanh<VF, VI>(x);
+  case kSigmoid: return vsigmoid<VF, VI>(x);
+  default: return vpowx<VF, VI>(x, param);
+  }
+}
+
+template <typename VF, typename VI, int op>
+SIMD_INLINE void Map(const int n, const float* a, float* y,
+    const PowParam& param) {
+  const int width = sizeof(VF) / sizeof(float);
+  int i = 0;
+  for (; i + width <= n; i += width) {
+    VF x;
+    memcpy(&x, a + i, sizeof(x));
+    x = Apply<VF, VI, op>(x, param);
+    memcpy(y + i, &x, sizeof(x));
+  }
+  if (i < n) {
+    // The tail goes through the same code, so results do not depend on n.
+    VF x = VF();
+    memcpy(&x, a + i, (n - i) * sizeof(float));
+    x = Apply<VF, VI, op>(x, param);
+    memcpy(y + i, &x, (n - i) * sizeof(float));
+  }
+}
+
+typedef void (*MapFunction)(const int n, const float* a, float* y,
+    const PowParam& param);
+
+template <int op>
+void Map128(const int n, const float* a, float* y, const PowParam& param) {
+  Map<float4v, int4v, op>(n, a, y, param);
+}
+
+#ifdef CAFFE_SIMD_X86
+template <int op> __attribute__((target("avx2,fma")))
+void Map256(const int n, const float* a, float* y, const PowParam& param) {
+  Map<float8v, int8v, op>(n, a, y, param);
+}
+
+template <int op> __attribute__((target("avx512f")))
+void Map512(const int n, const float* a, float* y, const PowParam& param) {
+  Map<float16v, int16v, op>(n, a, y, param);
+}
+#endif
+
+struct Kernels {
+  const char* isa;
+  MapFunction map[kNumOps];
+};
+
+Kernels DetectKernels() {
+  Kernels kernels;
+#ifdef CAFFE_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    kernels.isa = "avx512f";
+    kernels.map[kExp] = &Map512<kExp>;
+    kernels.map[kLog] = &Map512<kLog>;
+    kernels.map[kTanh] = &Map512<kTanh>;
+    kernels.map[kSigmoid] = &Map512<kSigmoid>;
+    kernels.map[kPowx] = &Map512<kPowx>;
+    return kernels;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    kernels.isa = "avx2";
+    kernels.map[kExp] = &Map256<kExp>;
+    kernels.map[kLog] = &Map256<kLog>;
+    kernels.map[kTanh] = &Map256<kTanh>;
+    kernels.map[kSigmoid] = &Map256<kSigmoid>;
+    kernels.map[kPowx] = &Map256<kPowx>;
+    return kernels;
+  }
+  kernels.isa = "sse2";
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  kernels.isa = "neon";
+#else
+  kernels.isa = "generic";
+#endif
+  kernels.map[kExp] = &Map128<kExp>;
+  kernels.map[kLog] = &Map128<kLog>;
+  kernels.map[kTanh] = &Map128<kTanh>;
+  kernels.map[kSigmoid] = &Map128<kSigmoid>;
+  kernels.map[kPowx] = &Map128<kPowx>;
+  return kernels;
+}
+
+const Kernels& GetKernels() {
+  static const Kernels kernels = DetectKernels();
+  return kernels;
+}
+
+void Run(const Op op, const int n, const float* a, float* y,
+    const PowParam& param = PowParam()) {
+  const MapFunction map = GetKernels().map[op];
+  if (n <= kParallelGrain) {
+    map(n, a, y, param);
+    return;
+  }
+  parallel_for(n, [&](int begin, int end) {
+    map(end - begin, a + begin, y + begin, param);
+  }, kParallelGrain);
+}
+
+}  // namespace
+
+void simd_exp(const int n, const float* a, float* y) {
+  Run(kExp, n, a, y);
+}
+
+void simd_log(const int n, const float* a, float* y) {
+  Run(kLog, n, a, y);
+}
+
+void simd_tanh(const int n, const float* a, float* y) {
+  Run(kTanh, n, a, y);
+}
+
+void simd_sigmoid(const int n, const float* a, float* y) {
+  Run(kSigmoid, n, a, y);
+}
+
+void simd_powx(const int n, const float* a, const float b, float* y) {
+  // Common powers get exact arithmetic.
+  if (b == 0.f) {
+    for (int i = 0; i < n; ++i) { y[i] = 1.f; }
+  } else if (b == 1.f) {
+    if (a != y) { memcpy(y, a, n * sizeof(float)); }
+  } else if (b == 2.f) {
+    for (int i = 0; i < n; ++i) { y[i] = a[i] * a[i]; }
+  } else if (b == -1.f) {
+    for (int i = 0; i < n; ++i) { y[i] = 1.f / a[i]; }
+  } else {
+    PowParam param;
+    param.b = b;
+    param.integer = std::floor(b) == b;
+    param.odd = param.integer && std::fabs(std::fmod(b, 2.f)) == 1.f;
+    Run(kPowx, n, a, y, param);
+  }
+}
+
+const char* simd_math_isa() {
+  return GetKernels().isa;
+}
+
+}  // namespace caffe
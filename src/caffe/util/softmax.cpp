@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/softmax.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Inner positions per block: with up to a few hundred channels a block of
+// rows stays in L2 across the three passes.
+const int kBlockInner = 512;
+
+// Softmax of a (channels, n) block whose rows are stride apart.
+template <typename Dtype>
+void SoftmaxBlock(const int channels, const int n, const int stride,
+    const Dtype scale, const Dtype* x, Dtype* y, Dtype* log_norm, Dtype* max,
+    Dtype* sum) {
+  for (int k = 0; k < n; ++k) {
+    max[k] = scale * x[k];
+  }
+  for (int c = 1; c < channels; ++c) {
+    const Dtype* x_row = x + c * stride;
+    for (int k = 0; k < n; ++k) {
+      max[k] = std::max(max[k], scale * x_row[k]);
+    }
+  }
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* x_row = x + c * stride;
+    Dtype* y_row = y + c * stride;
+    for (int k = 0; k < n; ++k) {
+      y_row[k] = scale * x_row[k] - max[k];
+    }
+    if (n != stride) {
+      caffe_exp(n, y_row, y_row);
+    }
+  }
+  if (n == stride) {
+    // The rows are contiguous: one call keeps the exp kernel's vectors full.
+    caffe_exp(channels * n, y, y);
+  }
+  caffe_set(n, Dtype(0), sum);
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* y_row = y + c * stride;
+    for (int k = 0; k < n; ++k) {
+      sum[k] += y_row[k];
+    }
+  }
+  if (log_norm) {
+    for (int k = 0; k < n; ++k) {
+      log_norm[k] = max[k] + std::log(sum[k]);
+    }
+  }
+  for (int k = 0; k < n; ++k) {
+    sum[k] = Dtype(1) / sum[k];
+  }
+  for (int c = 0; c < channels; ++c) {
+    Dtype* y_row = y + c * stride;
+    for (int k = 0; k < n; ++k) {
+      y_row[k] *= sum[k];
+    }
+  }
+}
+
+template <typename Dtype>
+void SoftmaxBackwardBlock(const int channels, const int n, const int stride,
+    const Dtype* y, const Dtype* top_diff, Dtype* bottom_diff, Dtype* dot) {
+  caffe_set(n, Dtype(0), dot);
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* y_row = y + c * stride;
+    const Dtype* top_row = top_diff + c * stride;
+    for (int k = 0; k < n; ++k) {
+      dot[k] += y_row[k] * top_row[k];
+    }
+  }
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* y_row = y + c * stride;
+    const Dtype* top_row = top_diff + c * stride;
+    Dtype* bottom_row = bottom_diff + c * stride;
+    for (int k = 0; k < n; ++k) {
+      bottom_row[k] = y_row[k] * (top_row[k] - dot[k]);
+    }
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void softmax_cpu(const int outer_num, const int channels, const int inner_num,
+    const Dtype scale, const Dtype* x, Dtype* y, Dtype* log_norm) {
+  if (outer_num == 0 || channels == 0 || inner_num == 0) { return; }
+  const int block = std::min(inner_num, kBlockInner);
+  const int blocks = (inner_num + block - 1) / block;
+  const int dim = channels * inner_num;
+  parallel_for(outer_num * blocks, [&](int begin, int end) {
+    vector<Dtype> max(block);
+    vector<Dtype> sum(block);
+    for (int w = begin; w < end; ++w) {
+      const int i = w / blocks;
+      const int k = (w % blocks) * block;
+      const int offset = i * dim + k;
+      SoftmaxBlock(channels, std::min(block, inner_num - k), inner_num, scale,
+          x + offset, y + offset,
+          log_norm ? log_norm + i * inner_num + k : NULL, &max[0], &sum[0]);
+    }
+  }, parallel_grain(channels * block));
+}
+
+template void softmax_cpu<float>(const int outer_num, const int channels,
+    const int inner_num, const float scale, const float* x, float* y,
+    float* log_norm);
+template void softmax_cpu<double>(const int outer_num, const int channels,
+    const int inner_num, const double scale, const double* x, double* y,
+    double* log_norm);
+
+template <typename Dtype>
+void softmax_backward_cpu(const int outer_num, const int channels,
+    const int inner_num, const Dtype* y, const Dtype* top_diff,
+    Dtype* bottom_diff) {
+  if (outer_num == 0 || channels == 0 || inner_num == 0) { return; }
+  const int block = std::min(inner_num, kBlockInner);
+  const int blocks = (inner_num + block - 1) / block;
+  const int dim = channels * inner_num;
+  parallel_for(outer_num * blocks, [&](int begin, int end) {
+    vector<Dtype> dot(block);
+    for (int w = begin; w < end; ++w) {
+      const int k = (w % blocks) * block;
+      const int offset = (w / blocks) * dim + k;
+      SoftmaxBackwardBlock(channels, std::min(block, inner_num - k),
+          inner_num, y + offset, top_diff + offset, bottom_diff + offset,
+          &dot[0]);
+    }
+  }, parallel_grain(channels * block));
+}
+
+template void softmax_backward_cpu<float>(const int outer_num,
+    const int channels, const int inner_num, const float* y,
+    const float* top_diff, float* bottom_diff);
+template void softmax_backward_cpu<double>(const int outer_num,
+    const int channels, const int inner_num, const double* y,
+    const double* top_diff, double* bottom_diff);
+
+}  // namespace caffe
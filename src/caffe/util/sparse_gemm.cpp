@@ -0,0 +1,100 @@
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/sparse_gemm.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+SparseGemm<Dtype>::SparseGemm() : density_threshold_(0) {}
+
+template <typename Dtype>
+bool SparseGemm<Dtype>::SetUp(const LayerParameter& param) {
+  const SparseParameter& sparse_param = param.sparse_param();
+  if (param.phase() != TEST || !param.has_sparse_param() ||
+      !sparse_param.enabled()) {
+    return false;
+  }
+  CHECK_GE(sparse_param.density_threshold(), 0);
+  CHECK_LE(sparse_param.density_threshold(), 1);
+  name_ = param.name();
+  density_threshold_ = sparse_param.density_threshold();
+  // The CSR is built once the net has the weights (Layer::PrepareParams).
+  csr_.reset();
+  return true;
+}
+
+template <typename Dtype>
+bool SparseGemm<Dtype>::Build(const int rows, const int cols,
+    const Dtype* weights, const bool transposed) {
+  shared_ptr<Csr> csr(new Csr());
+  csr->rows = rows;
+  csr->cols = cols;
+  csr->ptr.assign(1, 0);
+  csr->ptr.reserve(rows + 1);
+  for (int m = 0; m < rows; ++m) {
+    for (int k = 0; k < cols; ++k) {
+      const Dtype w =
+          transposed ? weights[k * rows + m] : weights[m * cols + k];
+      if (w != 0) {
+        csr->values.push_back(w);
+        csr->indices.push_back(k);
+      }
+    }
+    csr->ptr.push_back(csr->values.size());
+  }
+  const int count = rows * cols;
+  csr->density =
+      count > 0 ? static_cast<float>(csr->values.size()) / count : 1.f;
+  csr->sparse = csr->density <= density_threshold_;
+  LOG_IF(INFO, Caffe::root_solver()) << name_ << " weights are "
+      << 100 * csr->density << "% nonzero: running "
+      << (csr->sparse ? "sparse" : "dense");
+  if (!csr->sparse) {
+    std::vector<Dtype>().swap(csr->values);
+    std::vector<int>().swap(csr->indices);
+    std::vector<int>().swap(csr->ptr);
+  }
+  csr_ = csr;
+  return csr->sparse;
+}
+
+template <typename Dtype>
+void SparseGemm<Dtype>::Forward(const int row_begin, const int rows,
+    const int n, const Dtype* x, const bool transposed, Dtype* y) const {
+  CHECK(sparse()) << "Build must find sparse weights before Forward.";
+  const Csr& csr = *csr_;
+  CHECK_LE(row_begin + rows, csr.rows);
+  if (rows == 0 || n == 0) { return; }
+  const Dtype* values = csr.values.data();
+  const int* indices = csr.indices.data();
+  const int* ptr = &csr.ptr[row_begin];
+  const int nnz = ptr[rows] - ptr[0];
+  const int cols = csr.cols;
+  // caffe_cpu_csr_gemm scales y by beta = 0 first, which keeps any NaN left
+  // in it: y is zeroed beforehand.
+  if (!transposed) {
+    // Blocks of rows of y are independent.
+    const int row_work = (nnz / rows + 1) * n;
+    parallel_for(rows, [&](int begin, int end) {
+      caffe_set((end - begin) * n, Dtype(0), y + begin * n);
+      caffe_cpu_csr_gemm<Dtype>(CblasNoTrans, CblasNoTrans, end - begin, n,
+          cols, Dtype(1), ptr[end] - ptr[begin], values, indices,
+          ptr + begin, x, Dtype(0), y + begin * n, CblasRowMajor);
+    }, parallel_grain(row_work));
+  } else {
+    // So are the rows of x and y, one per sample.
+    parallel_for(n, [&](int begin, int end) {
+      caffe_set((end - begin) * rows, Dtype(0), y + begin * rows);
+      caffe_cpu_csr_gemm<Dtype>(CblasNoTrans, CblasTrans, rows, end - begin,
+          cols, Dtype(1), nnz, values, indices, ptr, x + begin * cols,
+          Dtype(0), y + begin * rows, CblasColMajor);
+    }, parallel_grain(nnz));
+  }
+}
+
+INSTANTIATE_CLASS(SparseGemm);
+
+}  // namespace caffe
@@ -0,0 +1,163 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <deque>
+#include <exception>
+
+#include "caffe/util/thread_pool.hpp"
+
+#ifdef USE_MKL
+#include <mkl.h>
+#endif
+
+#if defined(USE_OPENBLAS) && defined(__GNUC__)
+// OpenBLAS 0.3.27 and later can set the threads of the calling thread only;
+// weak, so that older versions link and fall back to the global setting.
+extern "C" int openblas_set_num_threads_local(int num_threads)
+    __attribute__((weak));
+#endif
+
+namespace caffe {
+
+// Set on the pool workers, so that nested loops run serially instead of
+// waiting on workers that are all busy with the outer loop.
+static boost::thread_specific_ptr<bool> in_worker_;
+
+struct ThreadPool::Job {
+  const boost::function<void(int, int)>* body;
+  int n;
+  int chunk;
+  int next;       // start of the first unclaimed chunk
+  int remaining;  // chunks not finished yet
+  std::exception_ptr error;
+};
+
+class ThreadPool::sync {
+ public:
+  boost::mutex mutex_;
+  // signaled when a job is queued or the workers must stop
+  boost::condition_variable work_;
+  // signaled when the last chunk of a job is done
+  boost::condition_variable done_;
+  std::deque<Job*> jobs_;
+  vector<shared_ptr<boost::thread> > workers_;
+  bool stop_;
+};
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_threads_(std::max(num_threads, 1)), sync_(new sync()) {
+  sync_->stop_ = false;
+  StartWorkers();
+}
+
+ThreadPool::~ThreadPool() {
+  StopWorkers();
+}
+
+void ThreadPool::Resize(int num_threads) {
+  num_threads = std::max(num_threads, 1);
+  if (num_threads == num_threads_) { return; }
+  StopWorkers();
+  num_threads_ = num_threads;
+  StartWorkers();
+}
+
+void ThreadPool::StartWorkers() {
+  sync_->stop_ = false;
+  // The thread calling ParallelFor takes part in the work.
+  for (int i = 1; i < num_threads_; ++i) {
+    sync_->workers_.push_back(shared_ptr<boost::thread>(
+        new boost::thread(&ThreadPool::WorkerEntry, this)));
+  }
+}
+
+void ThreadPool::StopWorkers() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->work_.notify_all();
+  for (int i = 0; i < sync_->workers_.size(); ++i) {
+    sync_->workers_[i]->join();
+  }
+  sync_->workers_.clear();
+}
+
+void ThreadPool::WorkerEntry() {
+  in_worker_.reset(new bool(true));
+  // BLAS calls made from loop bodies must not spawn threads of their own.
+#ifdef USE_MKL
+  mkl_set_num_threads_local(1);
+#endif
+#if defined(USE_OPENBLAS) && defined(__GNUC__)
+  if (openblas_set_num_threads_local) {
+    openblas_set_num_threads_local(1);
+  }
+#endif
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (true) {
+    while (!sync_->stop_ && sync_->jobs_.empty()) {
+      sync_->work_.wait(lock);
+    }
+    if (sync_->stop_) { return; }
+    RunChunks(sync_->jobs_.front(), &lock);
+  }
+}
+
+void ThreadPool::RunChunks(Job* job, boost::mutex::scoped_lock* lock) {
+  while (job->next < job->n) {
+    const int begin = job->next;
+    const int end = std::min(begin + job->chunk, job->n);
+    job->next = end;
+    if (end == job->n) {
+      // Fully claimed: no other thread needs to pick it up.
+      sync_->jobs_.erase(
+          std::find(sync_->jobs_.begin(), sync_->jobs_.end(), job));
+    }
+    lock->unlock();
+    std::exception_ptr error;
+    try {
+      (*job->body)(begin, end);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock->lock();
+    if (error && !job->error) {
+      job->error = error;
+    }
+    if (--job->remaining == 0) {
+      sync_->done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::ParallelFor(int n, int grain,
+    const boost::function<void(int, int)>& body) {
+  if (n <= 0) { return; }
+  grain = std::max(grain, 1);
+  if (num_threads_ == 1 || n <= grain || in_worker_.get()) {
+    body(0, n);
+    return;
+  }
+  // A few chunks per thread to even out unequal chunk costs.
+  const int num_chunks = std::min((n + grain - 1) / grain, 4 * num_threads_);
+  Job job;
+  job.body = &body;
+  job.n = n;
+  job.chunk = (n + num_chunks - 1) / num_chunks;
+  job.next = 0;
+  job.remaining = (n + job.chunk - 1) / job.chunk;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->jobs_.push_back(&job);
+    sync_->work_.notify_all();
+    RunChunks(&job, &lock);
+    while (job.remaining > 0) {
+      sync_->done_.wait(lock);
+    }
+  }
+  if (job.error) {
+    std::rethrow_exception(job.error);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,245 @@
+// Calibrates a trained net for int8 CPU inference. The net runs in float
+// over --iterations batches of its own data layers while the input range of
+// every Convolution and InnerProduct layer is recorded, and a copy of the
+// model with those ranges as quantization_param is written to --output. The
+// float and int8 nets then run side by side on --eval_iterations more
+// batches, reporting how far each quantized layer's output and each net
+// output drift from float, and how often the arg max of each output agrees.
+//
+// Usage:
+//    calibrate_int8 --model=train_val.prototxt --weights=net.caffemodel
+//        --output=int8.prototxt [--iterations=50] [--eval_iterations=50]
+//        [--skip=conv1,fc8] [--cpu_threads=0]
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/int8_gemm.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(model, "",
+    "The net definition; its TEST phase data layers supply the samples.");
+DEFINE_string(weights, "", "The trained weights.");
+DEFINE_string(output, "", "Where to write the calibrated net definition.");
+DEFINE_int32(iterations, 50, "The number of batches to calibrate on.");
+DEFINE_int32(eval_iterations, 50,
+    "The number of further batches comparing int8 with float; 0 skips it.");
+DEFINE_string(skip, "",
+    "Optional; comma-separated names of layers to keep in float.");
+DEFINE_int32(cpu_threads, 0,
+    "Optional; the threads of the shared CPU pool (0 keeps the default).");
+
+static bool IsQuantizable(const string& type) {
+  return type == "Convolution" || type == "InnerProduct";
+}
+
+// Accumulates the squared distance of an int8 result from the float one.
+struct Drift {
+  Drift() : error(0), norm(0) {}
+  void Add(const Blob<float>& reference, const Blob<float>& value) {
+    const float* a = reference.cpu_data();
+    const float* b = value.cpu_data();
+    for (int i = 0; i < reference.count(); ++i) {
+      error += double(a[i] - b[i]) * (a[i] - b[i]);
+      norm += double(a[i]) * a[i];
+    }
+  }
+  double relative() const { return norm > 0 ? std::sqrt(error / norm) : 0; }
+  double error;
+  double norm;
+};
+
+// The number of rows of blob whose arg max over the non-batch axes agrees.
+static int CountAgreement(const Blob<float>& reference,
+    const Blob<float>& value) {
+  const int rows = reference.shape(0);
+  const int dim = reference.count() / rows;
+  int agree = 0;
+  for (int i = 0; i < rows; ++i) {
+    const float* a = reference.cpu_data() + i * dim;
+    const float* b = value.cpu_data() + i * dim;
+    agree += std::max_element(a, a + dim) - a ==
+        std::max_element(b, b + dim) - b;
+  }
+  return agree;
+}
+
+// The index of the first layer with inputs; the layers before it produce the
+// data, which the int8 net takes over from the float net.
+static int FirstComputeLayer(const Net<float>& net) {
+  for (int i = 0; i < net.layers().size(); ++i) {
+    if (net.bottom_vecs()[i].size() > 0) { return i; }
+  }
+  return net.layers().size();
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Calibrate a net for int8 CPU inference\n"
+        "Usage:\n"
+        "    calibrate_int8 --model=net.prototxt --weights=net.caffemodel "
+        "--output=int8.prototxt [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition.";
+  CHECK_GT(FLAGS_weights.size(), 0) << "Need trained weights.";
+  CHECK_GT(FLAGS_output.size(), 0) << "Need an output file.";
+  CHECK_GT(FLAGS_iterations, 0);
+
+  Caffe::set_mode(Caffe::CPU);
+  if (FLAGS_cpu_threads > 0) {
+    Caffe::set_cpu_threads(FLAGS_cpu_threads);
+  }
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  param.mutable_state()->set_phase(TEST);
+  Net<float> float_net(param);
+  float_net.CopyTrainedLayersFrom(FLAGS_weights);
+  const int start = FirstComputeLayer(float_net);
+  CHECK_GT(start, 0) << "The net needs data layers to calibrate on.";
+
+  vector<string> skipped;
+  boost::split(skipped, FLAGS_skip, boost::is_any_of(","));
+  const std::set<string> skip(skipped.begin(), skipped.end());
+  vector<int> layer_ids;
+  for (int i = start; i < float_net.layers().size(); ++i) {
+    if (IsQuantizable(float_net.layers()[i]->type()) &&
+        !skip.count(float_net.layer_names()[i])) {
+      layer_ids.push_back(i);
+    }
+  }
+  CHECK_GT(layer_ids.size(), 0) << "No layers to quantize.";
+
+  // Calibration: the range of every quantized layer's input.
+  vector<float> input_min(layer_ids.size(), FLT_MAX);
+  vector<float> input_max(layer_ids.size(), -FLT_MAX);
+  for (int iter = 0; iter < FLAGS_iterations; ++iter) {
+    float_net.Forward();
+    for (int l = 0; l < layer_ids.size(); ++l) {
+      const Blob<float>* input = float_net.bottom_vecs()[layer_ids[l]][0];
+      const float* data = input->cpu_data();
+      input_min[l] = std::min(input_min[l],
+          *std::min_element(data, data + input->count()));
+      input_max[l] = std::max(input_max[l],
+          *std::max_element(data, data + input->count()));
+    }
+  }
+  std::map<string, int> calibrated;
+  for (int l = 0; l < layer_ids.size(); ++l) {
+    const string& name = float_net.layer_names()[layer_ids[l]];
+    if (input_min[l] >= input_max[l]) {
+      LOG(WARNING) << name << ": constant input, kept in float";
+      continue;
+    }
+    LOG(INFO) << name << ": input range [" << input_min[l] << ", "
+              << input_max[l] << "]";
+    calibrated[name] = l;
+  }
+  for (int i = 0; i < param.layer_size(); ++i) {
+    LayerParameter* layer_param = param.mutable_layer(i);
+    std::map<string, int>::const_iterator it =
+        calibrated.find(layer_param->name());
+    if (it == calibrated.end()) { continue; }
+    QuantizationParameter* quant_param =
+        layer_param->mutable_quantization_param();
+    quant_param->set_input_min(input_min[it->second]);
+    quant_param->set_input_max(input_max[it->second]);
+  }
+  WriteProtoToTextFile(param, FLAGS_output);
+  LOG(INFO) << "Wrote " << calibrated.size() << " calibrated layers to "
+            << FLAGS_output;
+  if (FLAGS_eval_iterations <= 0) {
+    return 0;
+  }
+
+  // Evaluation: the same batches through both nets, sharing the weights.
+  LOG(INFO) << "Comparing int8 (" << int8_gemm_isa() << ") with float over "
+            << FLAGS_eval_iterations << " batches";
+  Net<float> int8_net(param, float_net);
+  const vector<int>& outputs = float_net.output_blob_indices();
+  vector<Drift> layer_drift(layer_ids.size());
+  vector<Drift> output_drift(outputs.size());
+  vector<double> float_mean(outputs.size(), 0);
+  vector<double> int8_mean(outputs.size(), 0);
+  vector<int> agree(outputs.size(), 0);
+  double float_ms = 0;
+  double int8_ms = 0;
+  CPUTimer timer;
+  for (int iter = 0; iter < FLAGS_eval_iterations; ++iter) {
+    float_net.ForwardTo(start - 1);
+    for (int i = 0; i < start; ++i) {
+      for (int j = 0; j < float_net.top_vecs()[i].size(); ++j) {
+        Blob<float>* data = int8_net.top_vecs()[i][j];
+        data->ReshapeLike(*float_net.top_vecs()[i][j]);
+        data->CopyFrom(*float_net.top_vecs()[i][j]);
+      }
+    }
+    timer.Start();
+    float_net.ForwardFrom(start);
+    timer.Stop();
+    float_ms += timer.MilliSeconds();
+    timer.Start();
+    int8_net.ForwardFrom(start);
+    timer.Stop();
+    int8_ms += timer.MilliSeconds();
+    for (int l = 0; l < layer_ids.size(); ++l) {
+      layer_drift[l].Add(*float_net.top_vecs()[layer_ids[l]][0],
+          *int8_net.top_vecs()[layer_ids[l]][0]);
+    }
+    for (int o = 0; o < outputs.size(); ++o) {
+      const Blob<float>& reference = *float_net.blobs()[outputs[o]];
+      const Blob<float>& value = *int8_net.blobs()[outputs[o]];
+      if (reference.count() == 1) {
+        float_mean[o] += reference.cpu_data()[0] / FLAGS_eval_iterations;
+        int8_mean[o] += value.cpu_data()[0] / FLAGS_eval_iterations;
+      } else {
+        output_drift[o].Add(reference, value);
+        agree[o] += CountAgreement(reference, value);
+      }
+    }
+  }
+  // Outputs of in-place layers that follow a quantized layer are included.
+  for (int l = 0; l < layer_ids.size(); ++l) {
+    const string& name = float_net.layer_names()[layer_ids[l]];
+    LOG(INFO) << name << (calibrated.count(name) ? "" : " (float)")
+              << ": relative error " << layer_drift[l].relative();
+  }
+  for (int o = 0; o < outputs.size(); ++o) {
+    const string& name = float_net.blob_names()[outputs[o]];
+    if (float_net.blobs()[outputs[o]]->count() == 1) {
+      LOG(INFO) << "Output " << name << ": float " << float_mean[o]
+                << ", int8 " << int8_mean[o];
+    } else {
+      const int total = float_net.blobs()[outputs[o]]->shape(0) *
+          FLAGS_eval_iterations;
+      LOG(INFO) << "Output " << name << ": relative error "
+                << output_drift[o].relative() << ", arg max agrees on "
+                << agree[o] << " of " << total;
+    }
+  }
+  LOG(INFO) << "Forward past the data layers: float "
+            << float_ms / FLAGS_eval_iterations << " ms, int8 "
+            << int8_ms / FLAGS_eval_iterations << " ms";
+  return 0;
+}
@@ -1,5 +1,16 @@
+// This program computes the mean image of a leveldb/lmdb of Datum (or
+// AnnotatedDatum) and, optionally, the per-channel standard deviation.
+// Usage:
+//   compute_image_mean [FLAGS] INPUT_DB [OUTPUT_FILE]
+//
+// The main thread reads the records in chunks of --chunk_size; each chunk is
+// parsed, decoded and summed in parallel into one accumulator per partition,
+// which are reduced once at the end. 8-bit data is summed into integers, so
+// the result does not depend on the number of threads.
+
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
 #include <string>
 #include <utility>
 #include <vector>
@@ -8,9 +19,11 @@
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
+#include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
 
@@ -21,6 +34,107 @@ using boost::scoped_ptr;
 DEFINE_string(backend, "lmdb",
         "The backend {leveldb, lmdb} containing the images");
 DEFINE_bool(annotated, false, "whether parsing AnnotatedDatum");
+DEFINE_int32(threads, 0,
+    "Optional: threads parsing and summing the records; 0 for one per core.");
+DEFINE_int32(chunk_size, 1024,
+    "Optional: the number of records read before they are summed.");
+DEFINE_int32(sample_stride, 1,
+    "Optional: only use every sample_stride-th record of the DB.");
+DEFINE_int32(max_images, 0,
+    "Optional: stop after this many images; 0 for all of them.");
+DEFINE_bool(channel_std, false,
+    "Optional: also compute the standard deviation of each channel.");
+
+// Sums of the records of one partition. Bytes are summed into 32-bit
+// integers, flushed into doubles before they can overflow.
+struct MeanAccumulator {
+  std::vector<uint32_t> byte_sum;
+  int byte_count;  // records in byte_sum
+  std::vector<double> sum;
+  std::vector<double> channel_sum;
+  std::vector<double> channel_sqsum;
+  int count;
+};
+
+static const int kFlushEvery = (1 << 24);  // 255 * kFlushEvery < 2^32
+
+static void FlushBytes(MeanAccumulator* acc) {
+  for (int i = 0; i < acc->byte_sum.size(); ++i) {
+    acc->sum[i] += acc->byte_sum[i];
+    acc->byte_sum[i] = 0;
+  }
+  acc->byte_count = 0;
+}
+
+static void ParseDatum(const std::string& value, Datum* datum) {
+  if (!FLAGS_annotated) {
+    datum->ParseFromString(value);
+  } else {
+    AnnotatedDatum adatum;
+    adatum.ParseFromString(value);
+    datum->Swap(adatum.mutable_datum());
+  }
+}
+
+// Adds one record to acc, whose vectors are sized for data_size values in
+// channels planes.
+static void Accumulate(const std::string& value, const int data_size,
+    const int channels, const bool channel_std, MeanAccumulator* acc) {
+  Datum datum;
+  ParseDatum(value, &datum);
+  DecodeDatumNative(&datum);
+  const std::string& data = datum.data();
+  const int size_in_datum = std::max<int>(datum.data().size(),
+      datum.float_data_size());
+  CHECK_EQ(size_in_datum, data_size) << "Incorrect data field size " <<
+      size_in_datum;
+  const int dim = data_size / channels;
+  if (data.size() != 0) {
+    CHECK_EQ(data.size(), size_in_datum);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    uint32_t* byte_sum = &acc->byte_sum[0];
+    for (int i = 0; i < size_in_datum; ++i) {
+      byte_sum[i] += bytes[i];
+    }
+    if (channel_std) {
+      for (int c = 0; c < channels; ++c) {
+        const uint8_t* plane = bytes + c * dim;
+        uint64_t plane_sum = 0;
+        uint64_t plane_sqsum = 0;
+        for (int i = 0; i < dim; ++i) {
+          plane_sum += plane[i];
+          plane_sqsum += plane[i] * plane[i];
+        }
+        acc->channel_sum[c] += plane_sum;
+        acc->channel_sqsum[c] += plane_sqsum;
+      }
+    }
+    if (++acc->byte_count == kFlushEvery) {
+      FlushBytes(acc);
+    }
+  } else {
+    CHECK_EQ(datum.float_data_size(), size_in_datum);
+    const float* floats = datum.float_data().data();
+    double* sum = &acc->sum[0];
+    for (int i = 0; i < size_in_datum; ++i) {
+      sum[i] += floats[i];
+    }
+    if (channel_std) {
+      for (int c = 0; c < channels; ++c) {
+        const float* plane = floats + c * dim;
+        double plane_sum = 0;
+        double plane_sqsum = 0;
+        for (int i = 0; i < dim; ++i) {
+          plane_sum += plane[i];
+          plane_sqsum += static_cast<double>(plane[i]) * plane[i];
+        }
+        acc->channel_sum[c] += plane_sum;
+        acc->channel_sqsum[c] += plane_sqsum;
+      }
+    }
+  }
+  ++acc->count;
+}
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -44,6 +158,12 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  Caffe::set_cpu_threads(FLAGS_threads);
+  const int num_partitions = Caffe::cpu_threads();
+  const int chunk_size = std::max(1, FLAGS_chunk_size);
+  const int sample_stride = std::max(1, FLAGS_sample_stride);
+  const bool channel_std = FLAGS_channel_std;
+
   scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
   db->Open(argv[1], db::READ);
   scoped_ptr<db::Cursor> cursor(db->NewCursor());
@@ -52,15 +172,8 @@ int main(int argc, char** argv) {
   int count = 0;
   // load first datum
   Datum datum;
-  if (!FLAGS_annotated)
-    datum.ParseFromString(cursor->value());
-  else
-    {
-      AnnotatedDatum adatum;
-      adatum.ParseFromString(cursor->value());
-      datum = adatum.datum();
-    }
-  
+  ParseDatum(cursor->value(), &datum);
+
   if (DecodeDatumNative(&datum)) {
     LOG(INFO) << "Decoding Datum";
   }
@@ -70,61 +183,80 @@ int main(int argc, char** argv) {
   std::cerr << "datum width=" << datum.width() << " / datum height=" << datum.height() << std::endl;
   sum_blob.set_height(datum.height());
   sum_blob.set_width(datum.width());
+  const int channels = datum.channels();
   const int data_size = datum.channels() * datum.height() * datum.width();
-  int size_in_datum = std::max<int>(datum.data().size(),
-                                    datum.float_data_size());
-  for (int i = 0; i < size_in_datum; ++i) {
-    sum_blob.add_data(0.);
+  const int size_in_datum = std::max<int>(datum.data().size(),
+                                          datum.float_data_size());
+  std::vector<MeanAccumulator> accs(num_partitions);
+  for (int k = 0; k < num_partitions; ++k) {
+    accs[k].byte_sum.assign(size_in_datum, 0);
+    accs[k].byte_count = 0;
+    accs[k].sum.assign(size_in_datum, 0.);
+    accs[k].channel_sum.assign(channels, 0.);
+    accs[k].channel_sqsum.assign(channels, 0.);
+    accs[k].count = 0;
   }
-  LOG(INFO) << "Starting iteration";
+  LOG(INFO) << "Starting iteration on " << num_partitions << " threads";
+  std::vector<std::string> chunk;
+  chunk.reserve(chunk_size);
+  int record = 0;
   while (cursor->valid()) {
-    Datum datum;
-    if (!FLAGS_annotated)
-      datum.ParseFromString(cursor->value());
-    else
-      {
-	AnnotatedDatum adatum;
-	adatum.ParseFromString(cursor->value());
-	datum = adatum.datum();
-      }
-    DecodeDatumNative(&datum);
-
-    const std::string& data = datum.data();
-    size_in_datum = std::max<int>(datum.data().size(),
-        datum.float_data_size());
-    CHECK_EQ(size_in_datum, data_size) << "Incorrect data field size " <<
-        size_in_datum;
-    if (data.size() != 0) {
-      CHECK_EQ(data.size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) + (uint8_t)data[i]);
-      }
-    } else {
-      CHECK_EQ(datum.float_data_size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) +
-            static_cast<float>(datum.float_data(i)));
+    chunk.clear();
+    while (cursor->valid() && chunk.size() < chunk_size &&
+           (FLAGS_max_images <= 0 ||
+            count + static_cast<int>(chunk.size()) < FLAGS_max_images)) {
+      if (record++ % sample_stride == 0) {
+        chunk.push_back(cursor->value());
       }
+      cursor->Next();
     }
-    ++count;
-    if (count % 10000 == 0) {
+    // Partition k sums a contiguous share of the chunk, always into accs[k].
+    const int chunk_count = chunk.size();
+    parallel_for(num_partitions, [&](int begin, int end) {
+      for (int k = begin; k < end; ++k) {
+        const int first = chunk_count * k / num_partitions;
+        const int last = chunk_count * (k + 1) / num_partitions;
+        for (int r = first; r < last; ++r) {
+          Accumulate(chunk[r], data_size, channels, channel_std, &accs[k]);
+        }
+      }
+    });
+    const int previous = count;
+    count += chunk_count;
+    if (count / 10000 != previous / 10000) {
       LOG(INFO) << "Processed " << count << " files.";
     }
-    cursor->Next();
+    if (FLAGS_max_images > 0 && count >= FLAGS_max_images) {
+      break;
+    }
   }
 
   if (count % 10000 != 0) {
     LOG(INFO) << "Processed " << count << " files.";
   }
-  for (int i = 0; i < sum_blob.data_size(); ++i) {
-    sum_blob.set_data(i, sum_blob.data(i) / count);
+  CHECK_GT(count, 0) << "No images were read.";
+  // Reduce the partitions in a fixed order.
+  std::vector<double> sum(size_in_datum, 0.);
+  std::vector<double> channel_sum(channels, 0.);
+  std::vector<double> channel_sqsum(channels, 0.);
+  for (int k = 0; k < num_partitions; ++k) {
+    FlushBytes(&accs[k]);
+    for (int i = 0; i < size_in_datum; ++i) {
+      sum[i] += accs[k].sum[i];
+    }
+    for (int c = 0; c < channels; ++c) {
+      channel_sum[c] += accs[k].channel_sum[c];
+      channel_sqsum[c] += accs[k].channel_sqsum[c];
+    }
+  }
+  for (int i = 0; i < size_in_datum; ++i) {
+    sum_blob.add_data(sum[i] / count);
   }
   // Write to disk
   if (argc == 3) {
     LOG(INFO) << "Write to " << argv[2];
     WriteProtoToBinaryFile(sum_blob, argv[2]);
   }
-  const int channels = sum_blob.channels();
   const int dim = sum_blob.height() * sum_blob.width();
   std::vector<float> mean_values(channels, 0.0);
   LOG(INFO) << "Number of channels: " << channels;
@@ -134,6 +266,15 @@ int main(int argc, char** argv) {
     }
     LOG(INFO) << "mean_value channel [" << c << "]: " << mean_values[c] / dim;
   }
+  if (channel_std) {
+    const double values = static_cast<double>(count) * dim;
+    for (int c = 0; c < channels; ++c) {
+      const double channel_mean = channel_sum[c] / values;
+      const double variance = std::max(0.,
+          channel_sqsum[c] / values - channel_mean * channel_mean);
+      LOG(INFO) << "std_value channel [" << c << "]: " << std::sqrt(variance);
+    }
+  }
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
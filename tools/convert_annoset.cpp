@@ -12,6 +12,10 @@
 // For detection task, the file should be in the format as
 //   imgfolder1/img1.JPEG annofolder1/anno1.xml
 //   ....
+//
+// Images and annotations are read on --threads worker threads, and written in
+// list order by the main thread, --batch_size per transaction: the keys,
+// records and mean values are the same as with a single thread.
 
 #include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
@@ -20,6 +24,7 @@
 #include <utility>
 #include <vector>
 
+#include "boost/date_time/posix_time/posix_time.hpp"
 #include "boost/scoped_ptr.hpp"
 #include "boost/variant.hpp"
 #include "gflags/gflags.h"
@@ -29,6 +34,7 @@
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/ordered_pipeline.hpp"
 #include "caffe/util/rng.hpp"
 
 #include <opencv2/core/core.hpp>
@@ -37,6 +43,8 @@
 using namespace caffe;  // NOLINT(build/namespaces)
 using std::pair;
 using boost::scoped_ptr;
+using boost::posix_time::microsec_clock;
+using boost::posix_time::ptime;
 
 DEFINE_bool(gray, false,
     "When this option is on, treat images as grayscale ones");
@@ -66,6 +74,24 @@ DEFINE_string(encode_type, "",
     "Optional: What type should we encode the image as ('png','jpg',...).");
 DEFINE_bool(mean, true,
 	    "Whether to compute the mean values and write them into mean_values.txt");
+DEFINE_int32(threads, 0,
+    "Optional: threads reading images and annotations; 0 for one per core.");
+DEFINE_int32(batch_size, 1000,
+    "Optional: the number of records written per DB transaction.");
+
+static double Seconds(const ptime& start) {
+  return (microsec_clock::local_time() - start).total_microseconds() / 1e6;
+}
+
+// An image and its annotations converted by a worker, waiting to be written.
+struct ConvertedAnno {
+  bool status;
+  int channels;
+  int shape_size;  // channels * height * width
+  int data_size;   // size of the data field
+  std::vector<float> means;  // per channel, when --mean
+  std::string value;
+};
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -143,14 +169,17 @@ int main(int argc, char** argv) {
 
   // Storing to db
   std::string root_folder(argv[1]);
-  AnnotatedDatum anno_datum;
-  Datum* datum = anno_datum.mutable_datum();
+  const int batch_size = std::max(1, FLAGS_batch_size);
   int count = 0;
   int data_size = 0;
   bool data_size_initialized = false;
+  OrderedPipeline pipeline(FLAGS_threads, 0);
+  std::vector<ConvertedAnno> converted(pipeline.window());
+  LOG(INFO) << "Converting on " << pipeline.num_workers() << " threads.";
+  const ptime start = microsec_clock::local_time();
 
-  for (int line_id = 0; line_id < lines.size(); ++line_id) {
-    bool status = true;
+  pipeline.Run(lines.size(), [&](int line_id, int slot) {
+    ConvertedAnno* anno = &converted[slot];
     std::string enc = encode_type;
     if (encoded && !enc.size()) {
       // Guess the encoding type from the file name
@@ -161,67 +190,83 @@ int main(int argc, char** argv) {
       enc = fn.substr(p);
       std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
     }
-    filename = root_folder + lines[line_id].first;
+    AnnotatedDatum anno_datum;
+    Datum* datum = anno_datum.mutable_datum();
+    std::string filename = root_folder + lines[line_id].first;
+    anno->status = true;
     if (anno_type == "classification") {
-      label = boost::get<int>(lines[line_id].second);
-      status = ReadImageToDatum(filename, label, resize_height, resize_width,
-          min_dim, max_dim, is_color, enc, datum);
+      int label = boost::get<int>(lines[line_id].second);
+      anno->status = ReadImageToDatum(filename, label, resize_height,
+          resize_width, min_dim, max_dim, is_color, enc, datum);
     } else if (anno_type == "detection") {
-      labelname = root_folder + boost::get<std::string>(lines[line_id].second);
-      status = ReadRichImageToAnnotatedDatum(filename, labelname, resize_height,
-          resize_width, min_dim, max_dim, is_color, enc, type, label_type,
-          name_to_label, &anno_datum);
+      std::string labelname =
+          root_folder + boost::get<std::string>(lines[line_id].second);
+      anno->status = ReadRichImageToAnnotatedDatum(filename, labelname,
+          resize_height, resize_width, min_dim, max_dim, is_color, enc, type,
+          label_type, name_to_label, &anno_datum);
       anno_datum.set_type(AnnotatedDatum_AnnotationType_BBOX);
     }
-    if (status == false) {
+    if (anno->status == false) return;
+    anno->channels = datum->channels();
+    anno->shape_size = datum->channels() * datum->height() * datum->width();
+    anno->data_size = datum->data().size();
+    if (mean) {
+      anno->means.assign(datum->channels(), 0.0);
+      std::vector<cv::Mat> channels;
+      cv::Mat img = cv::imread(lines[line_id].first);
+      cv::split(img, channels);
+      for (int d = 0; d < datum->channels(); d++) {
+        anno->means[d] = cv::mean(channels[d])[0];
+      }
+    }
+    CHECK(anno_datum.SerializeToString(&anno->value));
+  }, [&](int line_id, int slot) {
+    ConvertedAnno* anno = &converted[slot];
+    if (anno->status == false) {
       LOG(WARNING) << "Failed to read " << lines[line_id].first;
-      continue;
+      return;
     }
     if (check_size) {
       if (!data_size_initialized) {
-        data_size = datum->channels() * datum->height() * datum->width();
+        data_size = anno->shape_size;
         data_size_initialized = true;
       } else {
-        const std::string& data = datum->data();
-        CHECK_EQ(data.size(), data_size) << "Incorrect data field size "
-            << data.size();
+        CHECK_EQ(anno->data_size, data_size) << "Incorrect data field size "
+            << anno->data_size;
       }
     }
     if (mean) {
+      // Accumulated in list order, so that the sums do not depend on which
+      // worker finished first.
       if (meanv.empty()) {
-	  meanv = std::vector<float>(datum->channels(),0.0);
-	}
-      std::vector<float> lmeanv(datum->channels(),0.0);
-      std::vector<cv::Mat> channels;
-      cv::Mat img = cv::imread(lines[line_id].first);
-      cv::split(img, channels);
-      for (int d=0;d<datum->channels();d++) {
-	  lmeanv[d] = cv::mean(channels[d])[0];
-	  meanv[d] += lmeanv[d];
-	  //std::cerr << meanv[d] / count << std::endl;
-	}
+        meanv = std::vector<float>(anno->channels, 0.0);
+      }
+      for (int d = 0; d < anno->channels; d++) {
+        meanv[d] += anno->means[d];
+      }
     }
-    
+
     // sequential
     string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
 
     // Put in db
-    string out;
-    CHECK(anno_datum.SerializeToString(&out));
-    txn->Put(key_str, out);
+    txn->Put(key_str, anno->value);
 
-    if (++count % 1000 == 0) {
+    if (++count % batch_size == 0) {
       // Commit db
       txn->Commit();
       txn.reset(db->NewTransaction());
-      LOG(INFO) << "Processed " << count << " files.";
+      LOG(INFO) << "Processed " << count << " files, "
+                << count / Seconds(start) << " files/s.";
     }
-  }
+  });
   // write the last batch
-  if (count % 1000 != 0) {
+  if (count % batch_size != 0) {
     txn->Commit();
-    LOG(INFO) << "Processed " << count << " files.";
   }
+  const double seconds = Seconds(start);
+  LOG(INFO) << "Processed " << count << " files in " << seconds << " s, "
+            << count / seconds << " files/s.";
   if (mean)
     {
       std::ofstream fout_mean("mean_values.txt");
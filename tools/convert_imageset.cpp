@@ -7,6 +7,12 @@
 // should be a list of files as well as their labels, in the format as
 //   subfolder1/file1.JPEG 7
 //   ....
+//
+// Images are stored raw, encoded (--encoded) or raw and compressed with snappy
+// (--compress), which is faster to read back than an encoded image.
+// Images are read, resized and encoded on --threads worker threads, and
+// written in list order by the main thread, --batch_size per transaction:
+// the keys and records are the same as with a single thread.
 
 #include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
@@ -14,6 +20,7 @@
 #include <utility>
 #include <vector>
 
+#include "boost/date_time/posix_time/posix_time.hpp"
 #include "boost/scoped_ptr.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
@@ -22,11 +29,14 @@
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/ordered_pipeline.hpp"
 #include "caffe/util/rng.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
 using std::pair;
 using boost::scoped_ptr;
+using boost::posix_time::microsec_clock;
+using boost::posix_time::ptime;
 
 DEFINE_bool(gray, false,
     "When this option is on, treat images as grayscale ones");
@@ -42,6 +52,24 @@ DEFINE_bool(encoded, false,
     "When this option is on, the encoded image will be save in datum");
 DEFINE_string(encode_type, "",
     "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_bool(compress, false,
+    "When this option is on, the raw image is compressed in the datum");
+DEFINE_int32(threads, 0,
+    "Optional: threads reading and encoding images; 0 for one per core.");
+DEFINE_int32(batch_size, 1000,
+    "Optional: the number of records written per DB transaction.");
+
+static double Seconds(const ptime& start) {
+  return (microsec_clock::local_time() - start).total_microseconds() / 1e6;
+}
+
+// An image converted by a worker, waiting to be written.
+struct ConvertedImage {
+  bool status;
+  int shape_size;  // channels * height * width
+  int data_size;   // size of the data field
+  std::string value;
+};
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -70,6 +98,9 @@ int main(int argc, char** argv) {
   const bool check_size = FLAGS_check_size;
   const bool encoded = FLAGS_encoded;
   const string encode_type = FLAGS_encode_type;
+  const bool compress = FLAGS_compress;
+  CHECK(!compress || (!encoded && encode_type.empty()))
+      << "--compress stores raw images, it excludes --encoded";
 
   std::ifstream infile(argv[2]);
   std::vector<std::pair<std::string, int> > lines;
@@ -101,13 +132,17 @@ int main(int argc, char** argv) {
 
   // Storing to db
   std::string root_folder(argv[1]);
-  Datum datum;
+  const int batch_size = std::max(1, FLAGS_batch_size);
   int count = 0;
   int data_size = 0;
   bool data_size_initialized = false;
+  OrderedPipeline pipeline(FLAGS_threads, 0);
+  std::vector<ConvertedImage> converted(pipeline.window());
+  LOG(INFO) << "Converting on " << pipeline.num_workers() << " threads.";
+  const ptime start = microsec_clock::local_time();
 
-  for (int line_id = 0; line_id < lines.size(); ++line_id) {
-    bool status;
+  pipeline.Run(lines.size(), [&](int line_id, int slot) {
+    ConvertedImage* image = &converted[slot];
     std::string enc = encode_type;
     if (encoded && !enc.size()) {
       // Guess the encoding type from the file name
@@ -118,40 +153,51 @@ int main(int argc, char** argv) {
       enc = fn.substr(p);
       std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
     }
-    status = ReadImageToDatum(root_folder + lines[line_id].first,
+    Datum datum;
+    image->status = ReadImageToDatum(root_folder + lines[line_id].first,
         lines[line_id].second, resize_height, resize_width, is_color,
         enc, &datum);
-    if (status == false) continue;
+    if (image->status == false) return;
+    image->shape_size = datum.channels() * datum.height() * datum.width();
+    image->data_size = datum.data().size();
+    if (compress) {
+      CHECK(CompressDatum(&datum)) << "Failed to compress "
+          << lines[line_id].first;
+    }
+    CHECK(datum.SerializeToString(&image->value));
+  }, [&](int line_id, int slot) {
+    ConvertedImage* image = &converted[slot];
+    if (image->status == false) return;
     if (check_size) {
       if (!data_size_initialized) {
-        data_size = datum.channels() * datum.height() * datum.width();
+        data_size = image->shape_size;
         data_size_initialized = true;
       } else {
-        const std::string& data = datum.data();
-        CHECK_EQ(data.size(), data_size) << "Incorrect data field size "
-            << data.size();
+        CHECK_EQ(image->data_size, data_size) << "Incorrect data field size "
+            << image->data_size;
       }
     }
     // sequential
     string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
 
     // Put in db
-    string out;
-    CHECK(datum.SerializeToString(&out));
-    txn->Put(key_str, out);
+    txn->Put(key_str, image->value);
 
-    if (++count % 1000 == 0) {
+    if (++count % batch_size == 0) {
       // Commit db
       txn->Commit();
       txn.reset(db->NewTransaction());
-      LOG(INFO) << "Processed " << count << " files.";
+      LOG(INFO) << "Processed " << count << " files, "
+                << count / Seconds(start) << " files/s.";
     }
-  }
+  });
   // write the last batch
-  if (count % 1000 != 0) {
+  if (count % batch_size != 0) {
     txn->Commit();
-    LOG(INFO) << "Processed " << count << " files.";
   }
+  const double seconds = Seconds(start);
+  LOG(INFO) << "Processed " << count << " files in " << seconds << " s, "
+            << count / seconds << " files/s.";
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
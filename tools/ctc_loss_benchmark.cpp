@@ -0,0 +1,117 @@
+// Times the CPU forward/backward of CtcLossLayer over a grid of sequence
+// lengths, alphabet sizes and worker thread counts.
+//
+// Usage:
+//    ctc_loss_benchmark [--time_steps=25,50,100] [--alphabet_sizes=11,37,100]
+//        [--threads=1,2,4,0] [--batch_size=64] [--label_length=8]
+//        [--iterations=20]
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/ctc_loss_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(time_steps, "25,50,100",
+    "Comma-separated sequence lengths (T) to time.");
+DEFINE_string(alphabet_sizes, "11,37,100",
+    "Comma-separated alphabet sizes (including the blank) to time.");
+DEFINE_string(threads, "1,2,4,0",
+    "Comma-separated ctc_loss_param.num_threads values; 0 is Caffe::cpu_threads().");
+DEFINE_int32(batch_size, 64, "The number of sequences per minibatch.");
+DEFINE_int32(label_length, 8, "The number of labels per sequence.");
+DEFINE_int32(iterations, 20, "The number of timed iterations per setting.");
+
+static vector<int> ParseList(const string& list) {
+  vector<string> items;
+  boost::split(items, list, boost::is_any_of(","));
+  vector<int> values;
+  for (int i = 0; i < items.size(); ++i) {
+    values.push_back(atoi(items[i].c_str()));
+  }
+  return values;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Time the CPU CTC loss\n"
+        "Usage:\n"
+        "    ctc_loss_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  Caffe::set_mode(Caffe::CPU);
+
+  const vector<int> time_steps = ParseList(FLAGS_time_steps);
+  const vector<int> alphabet_sizes = ParseList(FLAGS_alphabet_sizes);
+  const vector<int> threads = ParseList(FLAGS_threads);
+  const int N = FLAGS_batch_size;
+  const int L = FLAGS_label_length;
+
+  for (int t = 0; t < time_steps.size(); ++t) {
+    for (int a = 0; a < alphabet_sizes.size(); ++a) {
+      const int T = time_steps[t];
+      const int C = alphabet_sizes[a];
+      CHECK_GT(C, 1) << "alphabet size must leave room for the blank label";
+      CHECK_GE(T, 2 * L + 1) << "time_steps too short for label_length";
+      vector<int> data_shape(3);
+      data_shape[0] = T;
+      data_shape[1] = N;
+      data_shape[2] = C;
+      vector<int> label_shape(2);
+      label_shape[0] = N;
+      label_shape[1] = L;
+      Blob<float> data(data_shape);
+      Blob<float> label(label_shape);
+      Blob<float> loss;
+      caffe_rng_gaussian<float>(data.count(), 0.f, 1.f,
+          data.mutable_cpu_data());
+      for (int i = 0; i < label.count(); ++i) {
+        label.mutable_cpu_data()[i] = 1 + caffe_rng_rand() % (C - 1);
+      }
+      vector<Blob<float>*> bottom;
+      bottom.push_back(&data);
+      bottom.push_back(&label);
+      vector<Blob<float>*> top(1, &loss);
+      vector<bool> propagate_down(2, false);
+      propagate_down[0] = true;
+
+      for (int n = 0; n < threads.size(); ++n) {
+        LayerParameter param;
+        param.set_type("CtcLoss");
+        CtcLossParameter* ctc_param = param.mutable_ctc_loss_param();
+        ctc_param->set_alphabet_size(C);
+        ctc_param->set_time_step(T);
+        ctc_param->set_blank_label(0);
+        ctc_param->set_num_threads(threads[n]);
+        CtcLossLayer<float> layer(param);
+        layer.SetUp(bottom, top);
+        // warm up the workspace
+        layer.Forward(bottom, top);
+        CPUTimer timer;
+        timer.Start();
+        for (int i = 0; i < FLAGS_iterations; ++i) {
+          layer.Forward(bottom, top);
+          layer.Backward(top, propagate_down, bottom);
+        }
+        timer.Stop();
+        LOG(INFO) << "T=" << T << " alphabet=" << C << " threads="
+                  << threads[n] << ": "
+                  << timer.MilliSeconds() / FLAGS_iterations << " ms/iter";
+      }
+    }
+  }
+  return 0;
+}
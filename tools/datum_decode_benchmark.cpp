@@ -0,0 +1,159 @@
+// Compares how fast the records of a leveldb/lmdb of Datum are turned into
+// blobs when they hold an encoded image, the raw bytes, or the raw bytes
+// compressed with snappy: parse, decode or decompress, then transform.
+//
+// Usage:
+//    datum_decode_benchmark [--backend=lmdb] [--num_records=256]
+//        [--iterations=5] [--encode_type=jpg] INPUT_DB
+#include <string>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/db.hpp"
+#include "caffe/util/io.hpp"
+
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using boost::scoped_ptr;
+
+DEFINE_string(backend, "lmdb",
+    "The backend {leveldb, lmdb} containing the images");
+DEFINE_int32(num_records, 256, "The number of records of INPUT_DB to time.");
+DEFINE_int32(iterations, 5, "The number of timed passes over the records.");
+DEFINE_string(encode_type, "jpg",
+    "The encoding of the encoded records ('png','jpg',...).");
+
+#ifdef USE_OPENCV
+// Stores the image of a raw datum encoded.
+static void EncodeRawDatum(const Datum& raw, const string& encoding,
+    Datum* encoded) {
+  const int channels = raw.channels();
+  const int height = raw.height();
+  const int width = raw.width();
+  const string& data = raw.data();
+  cv::Mat img(height, width, CV_8UC(channels));
+  for (int h = 0; h < height; ++h) {
+    uchar* row = img.ptr<uchar>(h);
+    for (int w = 0; w < width; ++w) {
+      for (int c = 0; c < channels; ++c) {
+        row[w * channels + c] = data[(c * height + h) * width + w];
+      }
+    }
+  }
+  EncodeCVMatToDatum(img, encoding, encoded);
+  encoded->set_label(raw.label());
+}
+
+static double MillisecondsPerRecord(const vector<string>& records,
+    DataTransformer<float>* transformer, Blob<float>* blob) {
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    for (int r = 0; r < records.size(); ++r) {
+      Datum datum;
+      datum.ParseFromString(records[r]);
+      DecodeDatumNative(&datum);
+      transformer->Transform(datum, blob);
+    }
+  }
+  timer.Stop();
+  return timer.MilliSeconds() / (FLAGS_iterations * records.size());
+}
+
+static void Report(const string& format, const vector<string>& records,
+    DataTransformer<float>* transformer, Blob<float>* blob) {
+  size_t bytes = 0;
+  for (int r = 0; r < records.size(); ++r) {
+    bytes += records[r].size();
+  }
+  // warm up caches
+  MillisecondsPerRecord(records, transformer, blob);
+  const double ms = MillisecondsPerRecord(records, transformer, blob);
+  LOG(INFO) << format << ": " << bytes / records.size() << " bytes/record, "
+            << ms << " ms/record, " << 1000. / ms << " records/s";
+}
+#endif  // USE_OPENCV
+
+int main(int argc, char** argv) {
+#ifdef USE_OPENCV
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Time the decoding of Datum formats\n"
+        "Usage:\n"
+        "    datum_decode_benchmark [FLAGS] INPUT_DB\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc != 2) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0],
+        "tools/datum_decode_benchmark");
+    return 1;
+  }
+  CHECK_GT(FLAGS_num_records, 0);
+  CHECK_GT(FLAGS_iterations, 0);
+
+  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+  db->Open(argv[1], db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  vector<string> raw_records, encoded_records, compressed_records;
+  Datum first;
+  for (; cursor->valid() && raw_records.size() < FLAGS_num_records;
+       cursor->Next()) {
+    Datum raw;
+    raw.ParseFromString(cursor->value());
+    DecodeDatumNative(&raw);
+    CHECK(!raw.data().empty()) << "Only 8-bit images can be timed";
+    if (raw_records.empty()) {
+      first = raw;
+    }
+    CHECK(raw.channels() == first.channels() &&
+          raw.height() == first.height() && raw.width() == first.width())
+        << "All the records must have the same shape";
+    string out;
+    CHECK(raw.SerializeToString(&out));
+    raw_records.push_back(out);
+    Datum encoded;
+    EncodeRawDatum(raw, FLAGS_encode_type, &encoded);
+    CHECK(encoded.SerializeToString(&out));
+    encoded_records.push_back(out);
+    if (CompressDatum(&raw)) {
+      CHECK(raw.SerializeToString(&out));
+      compressed_records.push_back(out);
+    }
+  }
+  CHECK(!raw_records.empty()) << "No records in " << argv[1];
+  LOG(INFO) << "Timing " << raw_records.size() << " records of "
+            << first.channels() << "x" << first.height() << "x"
+            << first.width();
+
+  TransformationParameter transform_param;
+  DataTransformer<float> transformer(transform_param, TEST);
+  transformer.InitRand();
+  Blob<float> blob(1, first.channels(), first.height(), first.width());
+  Report("encoded (" + FLAGS_encode_type + ")", encoded_records,
+      &transformer, &blob);
+  Report("raw", raw_records, &transformer, &blob);
+  if (!compressed_records.empty()) {
+    Report("compressed", compressed_records, &transformer, &blob);
+  } else {
+    LOG(INFO) << "compressed: unavailable, build with snappy";
+  }
+#else
+  LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  return 0;
+}
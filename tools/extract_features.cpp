@@ -1,7 +1,24 @@
+// This program extracts the features of one or more blobs of a net over
+// num_mini_batches batches of its data layer, and saves them to leveldb/lmdb
+// (one Datum per item, as float_data) or to a .npy file (one float32/float64
+// array of shape (items, ...), which numpy can load with mmap_mode='r').
+//
+// Each net runs Forward on its own thread while a writer thread serializes
+// and stores the features of the previous batch. With --shards=N, N nets
+// run in parallel, net k reading only the k-th of N contiguous ranges of its
+// input databases (see DataParameter num_shards), and writing to datasets
+// named <name>_k.
+#include <stdint.h>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
+#include "boost/thread.hpp"
+#include "gflags/gflags.h"
 #include "google/protobuf/text_format.h"
 
 #include "caffe/blob.hpp"
@@ -11,18 +28,336 @@
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
 
 using caffe::Blob;
 using caffe::Caffe;
 using caffe::Datum;
 using caffe::Net;
+using caffe::NetParameter;
 using std::string;
 namespace db = caffe::db;
 
+DEFINE_int32(shards, 1,
+    "Optional: the number of nets extracting in parallel, each from its own "
+    "shard of the input databases.");
+
+// Stores the features of one blob, item after item.
+template <typename Dtype>
+class FeatureSink {
+ public:
+  virtual ~FeatureSink() {}
+  // Appends num items of blob's shape past the first axis.
+  virtual void Write(const Dtype* data, int num) = 0;
+  virtual void Close() = 0;
+};
+
+// One Datum per item, keyed by the item index.
+template <typename Dtype>
+class DBFeatureSink : public FeatureSink<Dtype> {
+ public:
+  DBFeatureSink(const string& db_type, const string& name,
+      const string& blob_name, const Blob<Dtype>& blob)
+      : blob_name_(blob_name), db_(db::GetDB(db_type)), count_(0) {
+    db_->Open(name, db::NEW);
+    txn_.reset(db_->NewTransaction());
+    datum_.set_height(blob.height());
+    datum_.set_width(blob.width());
+    datum_.set_channels(blob.channels());
+    dim_ = blob.count() / blob.num();
+  }
+
+  virtual void Write(const Dtype* data, int num) {
+    for (int n = 0; n < num; ++n) {
+      datum_.clear_float_data();
+      const Dtype* item = data + n * dim_;
+      for (int d = 0; d < dim_; ++d) {
+        datum_.add_float_data(item[d]);
+      }
+      string out;
+      CHECK(datum_.SerializeToString(&out));
+      txn_->Put(caffe::format_int(count_, 10), out);
+      if (++count_ % 1000 == 0) {
+        txn_->Commit();
+        txn_.reset(db_->NewTransaction());
+        LOG(ERROR)<< "Extracted features of " << count_ <<
+            " query images for feature blob " << blob_name_;
+      }
+    }
+  }
+
+  virtual void Close() {
+    if (count_ % 1000 != 0) {
+      txn_->Commit();
+    }
+    LOG(ERROR)<< "Extracted features of " << count_ <<
+        " query images for feature blob " << blob_name_;
+    db_->Close();
+  }
+
+ protected:
+  string blob_name_;
+  boost::shared_ptr<db::DB> db_;
+  boost::shared_ptr<db::Transaction> txn_;
+  Datum datum_;
+  int dim_;
+  int count_;
+};
+
+// A version 1.0 .npy file holding a (num_items, ...) little endian array.
+template <typename Dtype>
+class NpyFeatureSink : public FeatureSink<Dtype> {
+ public:
+  NpyFeatureSink(const string& name, const string& blob_name,
+      const Blob<Dtype>& blob, int num_items)
+      : blob_name_(blob_name), num_items_(num_items), count_(0) {
+    dim_ = blob.count() / blob.num();
+    std::ostringstream header;
+    header << "{'descr': '<f" << sizeof(Dtype)
+           << "', 'fortran_order': False, 'shape': (" << num_items;
+    for (int i = 1; i < blob.num_axes(); ++i) {
+      header << ", " << blob.shape(i);
+    }
+    header << (blob.num_axes() == 1 ? ",), }" : "), }");
+    // Pad so that the data starts 64 byte aligned, as numpy does.
+    string dict = header.str();
+    const int prefix = 10;  // magic, version and header length
+    dict.append(63 - (prefix + dict.size()) % 64, ' ');
+    dict.push_back('\n');
+    file_ = fopen(name.c_str(), "wb");
+    CHECK(file_) << "Failed to open " << name;
+    const uint16_t size = dict.size();
+    const char magic[8] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+    const unsigned char size_le[2] = {
+        static_cast<unsigned char>(size & 0xff),
+        static_cast<unsigned char>(size >> 8)};
+    CHECK_EQ(fwrite(magic, 1, 8, file_), 8);
+    CHECK_EQ(fwrite(size_le, 1, 2, file_), 2);
+    CHECK_EQ(fwrite(dict.data(), 1, dict.size(), file_), dict.size());
+  }
+
+  virtual void Write(const Dtype* data, int num) {
+    CHECK_LE(count_ + num, num_items_) << "More items than in the header";
+    const size_t size = static_cast<size_t>(num) * dim_;
+    CHECK_EQ(fwrite(data, sizeof(Dtype), size, file_), size)
+        << "Failed to write the features of " << blob_name_;
+    count_ += num;
+  }
+
+  virtual void Close() {
+    CHECK_EQ(count_, num_items_);
+    CHECK_EQ(fclose(file_), 0) << "Failed to write the features of "
+        << blob_name_;
+    LOG(ERROR)<< "Extracted features of " << count_ <<
+        " query images for feature blob " << blob_name_;
+  }
+
+ protected:
+  string blob_name_;
+  FILE* file_;
+  int dim_;
+  int num_items_;
+  int count_;
+};
+
+// Hands the features of a batch to a writer thread, so that the next Forward
+// overlaps their serialization and storage. Two buffers: Push only waits
+// when the writer is still busy with the batch before the previous one.
+template <typename Dtype>
+class AsyncFeatureWriter {
+ public:
+  explicit AsyncFeatureWriter(
+      const std::vector<boost::shared_ptr<FeatureSink<Dtype> > >& sinks)
+      : sinks_(sinks), buffers_(2), closing_(false) {
+    for (int i = 0; i < buffers_.size(); ++i) {
+      buffers_[i].data.resize(sinks_.size());
+      buffers_[i].num.resize(sinks_.size());
+      free_.push_back(&buffers_[i]);
+    }
+    thread_.reset(new boost::thread(&AsyncFeatureWriter::Entry, this));
+  }
+
+  ~AsyncFeatureWriter() {
+    if (thread_) {
+      Stop();
+    }
+  }
+
+  // Copies the features of blobs[i] for sinks[i] and queues them.
+  void Push(const std::vector<Blob<Dtype>*>& blobs) {
+    Buffer* buffer;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while (free_.empty() && !error_) {
+        cond_.wait(lock);
+      }
+      if (error_) {
+        std::rethrow_exception(error_);
+      }
+      buffer = free_.front();
+      free_.pop_front();
+    }
+    for (int i = 0; i < blobs.size(); ++i) {
+      const Dtype* data = blobs[i]->cpu_data();
+      buffer->data[i].assign(data, data + blobs[i]->count());
+      buffer->num[i] = blobs[i]->num();
+    }
+    boost::mutex::scoped_lock lock(mutex_);
+    full_.push_back(buffer);
+    cond_.notify_all();
+  }
+
+  // Writes the queued features and closes the sinks.
+  void Close() {
+    Stop();
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    for (int i = 0; i < sinks_.size(); ++i) {
+      sinks_[i]->Close();
+    }
+  }
+
+ protected:
+  struct Buffer {
+    std::vector<std::vector<Dtype> > data;
+    std::vector<int> num;
+  };
+
+  void Stop() {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      closing_ = true;
+      cond_.notify_all();
+    }
+    thread_->join();
+    thread_.reset();
+  }
+
+  void Entry() {
+    try {
+      while (true) {
+        Buffer* buffer;
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          while (full_.empty() && !closing_) {
+            cond_.wait(lock);
+          }
+          if (full_.empty()) {
+            return;
+          }
+          buffer = full_.front();
+          full_.pop_front();
+        }
+        for (int i = 0; i < sinks_.size(); ++i) {
+          sinks_[i]->Write(&buffer->data[i][0], buffer->num[i]);
+        }
+        boost::mutex::scoped_lock lock(mutex_);
+        free_.push_back(buffer);
+        cond_.notify_all();
+      }
+    } catch (...) {
+      boost::mutex::scoped_lock lock(mutex_);
+      error_ = std::current_exception();
+      cond_.notify_all();
+    }
+  }
+
+  std::vector<boost::shared_ptr<FeatureSink<Dtype> > > sinks_;
+  std::vector<Buffer> buffers_;
+  std::deque<Buffer*> free_;
+  std::deque<Buffer*> full_;
+  bool closing_;
+  std::exception_ptr error_;
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  boost::shared_ptr<boost::thread> thread_;
+};
+
+// What a net needs to extract the features of its shard.
+struct ExtractionJob {
+  NetParameter net_param;
+  string pretrained_binary_proto;
+  std::vector<string> blob_names;
+  std::vector<string> dataset_names;
+  string db_type;
+  int num_mini_batches;
+  bool gpu;
+  int device_id;
+};
+
+template<typename Dtype>
+void extract_shard(const ExtractionJob* job, int shard,
+    std::exception_ptr* error) {
+  try {
+    // Caffe's mode and device are per thread.
+    if (job->gpu) {
+      Caffe::SetDevice(job->device_id);
+      Caffe::set_mode(Caffe::GPU);
+    } else {
+      Caffe::set_mode(Caffe::CPU);
+    }
+    NetParameter net_param(job->net_param);
+    if (FLAGS_shards > 1) {
+      for (int i = 0; i < net_param.layer_size(); ++i) {
+        if (net_param.layer(i).has_data_param()) {
+          caffe::DataParameter* data_param =
+              net_param.mutable_layer(i)->mutable_data_param();
+          data_param->set_num_shards(FLAGS_shards);
+          data_param->set_shard_index(shard);
+        }
+      }
+    }
+    Net<Dtype> feature_extraction_net(net_param);
+    feature_extraction_net.CopyTrainedLayersFrom(job->pretrained_binary_proto);
+
+    const size_t num_features = job->blob_names.size();
+    std::vector<Blob<Dtype>*> feature_blobs;
+    std::vector<boost::shared_ptr<FeatureSink<Dtype> > > sinks;
+    for (size_t i = 0; i < num_features; ++i) {
+      CHECK(feature_extraction_net.has_blob(job->blob_names[i]))
+          << "Unknown feature blob name " << job->blob_names[i]
+          << " in the network";
+      Blob<Dtype>* blob =
+          feature_extraction_net.blob_by_name(job->blob_names[i]).get();
+      feature_blobs.push_back(blob);
+      string name = job->dataset_names[i];
+      if (FLAGS_shards > 1) {
+        name += "_" + caffe::format_int(shard);
+      }
+      LOG(INFO)<< "Opening dataset " << name;
+      if (job->db_type == "npy") {
+        sinks.push_back(boost::shared_ptr<FeatureSink<Dtype> >(
+            new NpyFeatureSink<Dtype>(name, job->blob_names[i], *blob,
+                job->num_mini_batches * blob->num())));
+      } else {
+        sinks.push_back(boost::shared_ptr<FeatureSink<Dtype> >(
+            new DBFeatureSink<Dtype>(job->db_type, name, job->blob_names[i],
+                *blob)));
+      }
+    }
+
+    LOG(ERROR)<< "Extracting Features";
+    AsyncFeatureWriter<Dtype> writer(sinks);
+    for (int batch_index = 0; batch_index < job->num_mini_batches;
+         ++batch_index) {
+      feature_extraction_net.Forward();
+      writer.Push(feature_blobs);
+    }
+    writer.Close();
+  } catch (...) {
+    *error = std::current_exception();
+  }
+}
+
 template<typename Dtype>
 int feature_extraction_pipeline(int argc, char** argv);
 
 int main(int argc, char** argv) {
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
   return feature_extraction_pipeline<float>(argc, argv);
 //  return feature_extraction_pipeline<double>(argc, argv);
 }
@@ -35,36 +370,39 @@ int feature_extraction_pipeline(int argc, char** argv) {
     LOG(ERROR)<<
     "This program takes in a trained network and an input data layer, and then"
     " extract features of the input data produced by the net.\n"
-    "Usage: extract_features  pretrained_net_param"
+    "Usage: extract_features [--shards=N] pretrained_net_param"
     "  feature_extraction_proto_file  extract_feature_blob_name1[,name2,...]"
-    "  save_feature_dataset_name1[,name2,...]  num_mini_batches  db_type"
-    "  [CPU/GPU] [DEVICE_ID=0]\n"
+    "  save_feature_dataset_name1[,name2,...]  num_mini_batches"
+    "  db_type{lmdb,leveldb,npy}  [CPU/GPU] [DEVICE_ID=0]\n"
     "Note: you can extract multiple features in one pass by specifying"
     " multiple feature blob names and dataset names separated by ','."
     " The names cannot contain white space characters and the number of blobs"
-    " and datasets must be equal.";
+    " and datasets must be equal. With --shards=N, N nets each extract"
+    " num_mini_batches batches of their own shard of the input, into"
+    " datasets suffixed with _0 to _N-1.";
     return 1;
   }
+  CHECK_GT(FLAGS_shards, 0);
+  ExtractionJob job;
   int arg_pos = num_required_args;
 
   arg_pos = num_required_args;
+  job.gpu = false;
+  job.device_id = 0;
   if (argc > arg_pos && strcmp(argv[arg_pos], "GPU") == 0) {
     LOG(ERROR)<< "Using GPU";
-    int device_id = 0;
     if (argc > arg_pos + 1) {
-      device_id = atoi(argv[arg_pos + 1]);
-      CHECK_GE(device_id, 0);
+      job.device_id = atoi(argv[arg_pos + 1]);
+      CHECK_GE(job.device_id, 0);
     }
-    LOG(ERROR) << "Using Device_id=" << device_id;
-    Caffe::SetDevice(device_id);
-    Caffe::set_mode(Caffe::GPU);
+    LOG(ERROR) << "Using Device_id=" << job.device_id;
+    job.gpu = true;
   } else {
     LOG(ERROR) << "Using CPU";
-    Caffe::set_mode(Caffe::CPU);
   }
 
   arg_pos = 0;  // the name of the executable
-  std::string pretrained_binary_proto(argv[++arg_pos]);
+  job.pretrained_binary_proto = argv[++arg_pos];
 
   // Expected prototxt contains at least one data layer such as
   //  the layer data_layer_name and one feature blob such as the
@@ -94,88 +432,40 @@ int feature_extraction_pipeline(int argc, char** argv) {
    }
    */
   std::string feature_extraction_proto(argv[++arg_pos]);
-  boost::shared_ptr<Net<Dtype> > feature_extraction_net(
-      new Net<Dtype>(feature_extraction_proto, caffe::TEST));
-  feature_extraction_net->CopyTrainedLayersFrom(pretrained_binary_proto);
+  caffe::ReadNetParamsFromTextFileOrDie(feature_extraction_proto,
+      &job.net_param);
+  job.net_param.mutable_state()->set_phase(caffe::TEST);
 
   std::string extract_feature_blob_names(argv[++arg_pos]);
-  std::vector<std::string> blob_names;
-  boost::split(blob_names, extract_feature_blob_names, boost::is_any_of(","));
+  boost::split(job.blob_names, extract_feature_blob_names,
+               boost::is_any_of(","));
 
   std::string save_feature_dataset_names(argv[++arg_pos]);
-  std::vector<std::string> dataset_names;
-  boost::split(dataset_names, save_feature_dataset_names,
+  boost::split(job.dataset_names, save_feature_dataset_names,
                boost::is_any_of(","));
-  CHECK_EQ(blob_names.size(), dataset_names.size()) <<
+  CHECK_EQ(job.blob_names.size(), job.dataset_names.size()) <<
       " the number of blob names and dataset names must be equal";
-  size_t num_features = blob_names.size();
-
-  for (size_t i = 0; i < num_features; i++) {
-    CHECK(feature_extraction_net->has_blob(blob_names[i]))
-        << "Unknown feature blob name " << blob_names[i]
-        << " in the network " << feature_extraction_proto;
-  }
-
-  int num_mini_batches = atoi(argv[++arg_pos]);
-
-  std::vector<boost::shared_ptr<db::DB> > feature_dbs;
-  std::vector<boost::shared_ptr<db::Transaction> > txns;
-  const char* db_type = argv[++arg_pos];
-  for (size_t i = 0; i < num_features; ++i) {
-    LOG(INFO)<< "Opening dataset " << dataset_names[i];
-    boost::shared_ptr<db::DB> db(db::GetDB(db_type));
-    db->Open(dataset_names.at(i), db::NEW);
-    feature_dbs.push_back(db);
-    boost::shared_ptr<db::Transaction> txn(db->NewTransaction());
-    txns.push_back(txn);
-  }
-
-  LOG(ERROR)<< "Extracting Features";
-
-  Datum datum;
-  std::vector<int> image_indices(num_features, 0);
-  for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index) {
-    feature_extraction_net->Forward();
-    for (int i = 0; i < num_features; ++i) {
-      const boost::shared_ptr<Blob<Dtype> > feature_blob =
-        feature_extraction_net->blob_by_name(blob_names[i]);
-      int batch_size = feature_blob->num();
-      int dim_features = feature_blob->count() / batch_size;
-      const Dtype* feature_blob_data;
-      for (int n = 0; n < batch_size; ++n) {
-        datum.set_height(feature_blob->height());
-        datum.set_width(feature_blob->width());
-        datum.set_channels(feature_blob->channels());
-        datum.clear_data();
-        datum.clear_float_data();
-        feature_blob_data = feature_blob->cpu_data() +
-            feature_blob->offset(n);
-        for (int d = 0; d < dim_features; ++d) {
-          datum.add_float_data(feature_blob_data[d]);
-        }
-        string key_str = caffe::format_int(image_indices[i], 10);
-
-        string out;
-        CHECK(datum.SerializeToString(&out));
-        txns.at(i)->Put(key_str, out);
-        ++image_indices[i];
-        if (image_indices[i] % 1000 == 0) {
-          txns.at(i)->Commit();
-          txns.at(i).reset(feature_dbs.at(i)->NewTransaction());
-          LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-              " query images for feature blob " << blob_names[i];
-        }
-      }  // for (int n = 0; n < batch_size; ++n)
-    }  // for (int i = 0; i < num_features; ++i)
-  }  // for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index)
-  // write the last batch
-  for (int i = 0; i < num_features; ++i) {
-    if (image_indices[i] % 1000 != 0) {
-      txns.at(i)->Commit();
-    }
-    LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-        " query images for feature blob " << blob_names[i];
-    feature_dbs.at(i)->Close();
+
+  job.num_mini_batches = atoi(argv[++arg_pos]);
+  job.db_type = argv[++arg_pos];
+
+  std::vector<std::exception_ptr> errors(FLAGS_shards);
+  if (FLAGS_shards == 1) {
+    extract_shard<Dtype>(&job, 0, &errors[0]);
+  } else {
+    std::vector<boost::shared_ptr<boost::thread> > shards;
+    for (int shard = 0; shard < FLAGS_shards; ++shard) {
+      shards.push_back(boost::shared_ptr<boost::thread>(new boost::thread(
+          &extract_shard<Dtype>, &job, shard, &errors[shard])));
+    }
+    for (int shard = 0; shard < FLAGS_shards; ++shard) {
+      shards[shard]->join();
+    }
+  }
+  for (int shard = 0; shard < FLAGS_shards; ++shard) {
+    if (errors[shard]) {
+      std::rethrow_exception(errors[shard]);
+    }
   }
 
   LOG(ERROR)<< "Successfully extracted the features!";
@@ -0,0 +1,129 @@
+// Measures the inference throughput of one trained net shared by several
+// threads, each running its own InferenceContext.
+//
+// Usage:
+//    inference_benchmark --model=deploy.prototxt [--weights=net.caffemodel]
+//        [--threads=1,2,4,8] [--batch_size=1] [--iterations=50] [--gpu=-1]
+//        [--cpu_threads=0]
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/inference_context.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(model, "", "The deploy net definition prototxt.");
+DEFINE_string(weights, "",
+    "Optional; the trained weights. Random weights are used if unset.");
+DEFINE_string(threads, "1,2,4,8",
+    "Comma-separated numbers of concurrent inference threads to time.");
+DEFINE_int32(batch_size, 1, "The batch size of every Forward call.");
+DEFINE_int32(iterations, 50, "The number of timed Forward calls per thread.");
+DEFINE_int32(gpu, -1, "Optional; run in GPU mode on the given device.");
+DEFINE_int32(cpu_threads, 0,
+    "Optional; the threads of the shared CPU pool (0 keeps the default).");
+
+static vector<int> ParseList(const string& list) {
+  vector<string> items;
+  boost::split(items, list, boost::is_any_of(","));
+  vector<int> values;
+  for (int i = 0; i < items.size(); ++i) {
+    values.push_back(atoi(items[i].c_str()));
+  }
+  return values;
+}
+
+static void RunContext(InferenceContext<float>* context,
+    boost::barrier* start) {
+  // One untimed call allocates the activations.
+  context->Forward();
+  start->wait();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    context->Forward();
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Time concurrent inference on a shared net\n"
+        "Usage:\n"
+        "    inference_benchmark --model=deploy.prototxt [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to time.";
+
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+  if (FLAGS_cpu_threads > 0) {
+    Caffe::set_cpu_threads(FLAGS_cpu_threads);
+  }
+  shared_ptr<InferenceModel<float> > model;
+  if (FLAGS_weights.size()) {
+    model.reset(new InferenceModel<float>(FLAGS_model, FLAGS_weights));
+  } else {
+    NetParameter param;
+    ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+    model.reset(new InferenceModel<float>(param));
+  }
+
+  const vector<int> threads = ParseList(FLAGS_threads);
+  for (int t = 0; t < threads.size(); ++t) {
+    const int num_threads = threads[t];
+    CHECK_GT(num_threads, 0);
+    vector<shared_ptr<InferenceContext<float> > > contexts;
+    for (int i = 0; i < num_threads; ++i) {
+      contexts.push_back(shared_ptr<InferenceContext<float> >(
+          new InferenceContext<float>(*model)));
+      const vector<Blob<float>*>& inputs = contexts[i]->input_blobs();
+      for (int j = 0; j < inputs.size(); ++j) {
+        vector<int> shape = inputs[j]->shape();
+        if (shape.size() > 0) {
+          shape[0] = FLAGS_batch_size;
+        }
+        inputs[j]->Reshape(shape);
+        caffe_rng_uniform<float>(inputs[j]->count(), 0.f, 1.f,
+            inputs[j]->mutable_cpu_data());
+      }
+    }
+    boost::barrier start(num_threads + 1);
+    vector<shared_ptr<boost::thread> > workers;
+    for (int i = 0; i < num_threads; ++i) {
+      workers.push_back(shared_ptr<boost::thread>(new boost::thread(
+          &RunContext, contexts[i].get(), &start)));
+    }
+    start.wait();
+    CPUTimer timer;
+    timer.Start();
+    for (int i = 0; i < num_threads; ++i) {
+      workers[i]->join();
+    }
+    timer.Stop();
+    const double seconds = timer.Seconds();
+    const double samples =
+        double(num_threads) * FLAGS_iterations * FLAGS_batch_size;
+    LOG(INFO) << "threads=" << num_threads << " batch=" << FLAGS_batch_size
+              << ": " << samples / seconds << " samples/s, "
+              << 1000. * seconds * num_threads / (samples / FLAGS_batch_size)
+              << " ms/call";
+  }
+  return 0;
+}
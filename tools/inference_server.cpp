@@ -0,0 +1,339 @@
+// Serves a trained net over a Unix domain socket, gathering the requests of
+// all connected clients into micro-batches.
+//
+// Usage:
+//    inference_server --model=deploy.prototxt --weights=net.caffemodel
+//        [--socket=/tmp/caffe.sock] [--max_batch=32] [--max_latency_us=2000]
+//        [--workers=1] [--gpu=-1] [--cpu_threads=0] [--report_interval=10]
+//
+// Protocol: every message, in either direction, is a header of two native
+// uint32 values (request id, number of floats) followed by that many native
+// floats. A request holds one sample, i.e. input_blobs()[0]->count(1) values;
+// its reply, tagged with the same id, holds the matching sample of every
+// net output, concatenated in output order. Replies may come back out of
+// order when several workers run. A malformed request closes the connection.
+//
+// A worker takes the oldest pending request and waits for more until either
+// max_batch requests are gathered or the oldest has waited max_latency_us,
+// then runs them as one batch. Each worker owns an InferenceContext on the
+// shared weights, so --workers batches can run at once.
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+#include <stdint.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/inference_context.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using boost::posix_time::ptime;
+using boost::posix_time::microsec_clock;
+
+DEFINE_string(model, "", "The deploy net definition prototxt.");
+DEFINE_string(weights, "", "The trained weights.");
+DEFINE_string(socket, "/tmp/caffe.sock", "The Unix socket path to listen on.");
+DEFINE_int32(max_batch, 32, "The largest number of requests per Forward.");
+DEFINE_int32(max_latency_us, 2000,
+    "How long the oldest request may wait for a batch to fill up.");
+DEFINE_int32(workers, 1, "The number of concurrently running batches.");
+DEFINE_int32(gpu, -1, "Optional; run in GPU mode on the given device.");
+DEFINE_int32(cpu_threads, 0,
+    "Optional; the threads of the shared CPU pool (0 keeps the default).");
+DEFINE_int32(report_interval, 10,
+    "Seconds between latency and throughput reports; 0 disables them.");
+
+// A client connection; replies from several workers are serialized.
+class Connection {
+ public:
+  explicit Connection(int fd) : fd_(fd) {}
+  ~Connection() { close(fd_); }
+
+  bool Read(void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+      const ssize_t n = read(fd_, p, size);
+      if (n < 0 && errno == EINTR) { continue; }
+      if (n <= 0) { return false; }
+      p += n;
+      size -= n;
+    }
+    return true;
+  }
+
+  bool Reply(uint32_t id, const vector<float>& values) {
+    vector<char> message(2 * sizeof(uint32_t) + values.size() * sizeof(float));
+    const uint32_t header[2] = { id, static_cast<uint32_t>(values.size()) };
+    memcpy(&message[0], header, sizeof(header));
+    if (!values.empty()) {
+      memcpy(&message[sizeof(header)], &values[0],
+          values.size() * sizeof(float));
+    }
+    boost::mutex::scoped_lock lock(write_mutex_);
+    const char* p = &message[0];
+    size_t size = message.size();
+    while (size > 0) {
+      const ssize_t n = write(fd_, p, size);
+      if (n < 0 && errno == EINTR) { continue; }
+      if (n <= 0) { return false; }
+      p += n;
+      size -= n;
+    }
+    return true;
+  }
+
+ private:
+  int fd_;
+  boost::mutex write_mutex_;
+};
+
+struct Request {
+  uint32_t id;
+  vector<float> input;
+  shared_ptr<Connection> connection;
+  ptime arrival;
+};
+
+// Pending requests of all connections, handed out in micro-batches.
+class MicroBatcher {
+ public:
+  MicroBatcher(int max_batch, int max_latency_us)
+      : max_batch_(max_batch),
+        max_latency_(boost::posix_time::microseconds(max_latency_us)) {}
+
+  void Push(const shared_ptr<Request>& request) {
+    boost::mutex::scoped_lock lock(mutex_);
+    pending_.push_back(request);
+    lock.unlock();
+    condition_.notify_all();
+  }
+
+  // Blocks for the oldest request, then until max_batch requests are
+  // pending or the oldest one is due.
+  void NextBatch(vector<shared_ptr<Request> >* batch) {
+    boost::mutex::scoped_lock lock(mutex_);
+    do {
+      while (pending_.empty()) {
+        condition_.wait(lock);
+      }
+      const ptime deadline = pending_.front()->arrival + max_latency_;
+      while (!pending_.empty() && pending_.size() < max_batch_ &&
+          condition_.timed_wait(lock, deadline)) {
+      }
+      // Another worker may have taken everything in the meantime.
+    } while (pending_.empty());
+    const int size = std::min<int>(pending_.size(), max_batch_);
+    batch->assign(pending_.begin(), pending_.begin() + size);
+    pending_.erase(pending_.begin(), pending_.begin() + size);
+  }
+
+ private:
+  const size_t max_batch_;
+  const boost::posix_time::time_duration max_latency_;
+  std::deque<shared_ptr<Request> > pending_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+};
+
+// Latency and throughput counters over the current report interval.
+class ServerStats {
+ public:
+  ServerStats() : batches_(0), start_(microsec_clock::universal_time()) {}
+
+  void Record(const vector<double>& latencies_ms) {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++batches_;
+    latencies_ms_.insert(latencies_ms_.end(), latencies_ms.begin(),
+        latencies_ms.end());
+  }
+
+  void Report() {
+    boost::mutex::scoped_lock lock(mutex_);
+    const ptime now = microsec_clock::universal_time();
+    const double seconds = (now - start_).total_microseconds() / 1e6;
+    const int requests = latencies_ms_.size();
+    if (requests > 0) {
+      std::sort(latencies_ms_.begin(), latencies_ms_.end());
+      LOG(INFO) << requests / seconds << " requests/s, "
+                << double(requests) / batches_ << " requests/batch, "
+                << "latency p50 " << Percentile(0.5) << " ms, "
+                << "p99 " << Percentile(0.99) << " ms";
+    }
+    latencies_ms_.clear();
+    batches_ = 0;
+    start_ = now;
+  }
+
+ private:
+  // latencies_ms_ must be sorted.
+  double Percentile(double p) const {
+    const int i = std::min<int>(p * latencies_ms_.size(),
+        latencies_ms_.size() - 1);
+    return latencies_ms_[i];
+  }
+
+  vector<double> latencies_ms_;
+  int batches_;
+  ptime start_;
+  boost::mutex mutex_;
+};
+
+static void ServeConnection(shared_ptr<Connection> connection,
+    int sample_count, MicroBatcher* batcher) {
+  while (true) {
+    uint32_t header[2];
+    if (!connection->Read(header, sizeof(header))) { return; }
+    if (header[1] != static_cast<uint32_t>(sample_count)) {
+      LOG(WARNING) << "Closing connection: request " << header[0] << " has "
+                   << header[1] << " values instead of " << sample_count;
+      return;
+    }
+    shared_ptr<Request> request(new Request());
+    request->id = header[0];
+    request->input.resize(sample_count);
+    if (!connection->Read(&request->input[0],
+        sample_count * sizeof(float))) {
+      return;
+    }
+    request->connection = connection;
+    request->arrival = microsec_clock::universal_time();
+    batcher->Push(request);
+  }
+}
+
+static void RunWorker(const InferenceModel<float>* model,
+    MicroBatcher* batcher, ServerStats* stats) {
+  InferenceContext<float> context(*model);
+  Blob<float>* input = context.input_blobs()[0];
+  vector<int> input_shape = input->shape();
+  vector<shared_ptr<Request> > batch;
+  vector<float> output;
+  vector<double> latencies_ms;
+  while (true) {
+    batcher->NextBatch(&batch);
+    const int num = batch.size();
+    input_shape[0] = num;
+    input->Reshape(input_shape);
+    const int sample_count = input->count(1);
+    for (int i = 0; i < num; ++i) {
+      caffe_copy(sample_count, &batch[i]->input[0],
+          input->mutable_cpu_data() + i * sample_count);
+    }
+    const vector<Blob<float>*>& outputs = context.Forward();
+    latencies_ms.clear();
+    for (int i = 0; i < num; ++i) {
+      output.clear();
+      for (int j = 0; j < outputs.size(); ++j) {
+        CHECK_EQ(outputs[j]->shape(0), num)
+            << "Outputs must keep the batch as their first axis";
+        const float* data = outputs[j]->cpu_data() + outputs[j]->offset(i);
+        output.insert(output.end(), data, data + outputs[j]->count(1));
+      }
+      // A failed reply means the client went away; nothing else to do.
+      batch[i]->connection->Reply(batch[i]->id, output);
+      latencies_ms.push_back((microsec_clock::universal_time()
+          - batch[i]->arrival).total_microseconds() / 1e3);
+    }
+    batch.clear();
+    stats->Record(latencies_ms);
+  }
+}
+
+static void ReportStats(ServerStats* stats) {
+  while (true) {
+    boost::this_thread::sleep(boost::posix_time::seconds(
+        FLAGS_report_interval));
+    stats->Report();
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Serve a net with dynamic micro-batching\n"
+        "Usage:\n"
+        "    inference_server --model=deploy.prototxt "
+        "--weights=net.caffemodel [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to serve.";
+  CHECK_GT(FLAGS_weights.size(), 0) << "Need trained weights to serve.";
+  CHECK_GT(FLAGS_max_batch, 0);
+  CHECK_GE(FLAGS_max_latency_us, 0);
+  CHECK_GT(FLAGS_workers, 0);
+
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+  if (FLAGS_cpu_threads > 0) {
+    Caffe::set_cpu_threads(FLAGS_cpu_threads);
+  }
+  InferenceModel<float> model(FLAGS_model, FLAGS_weights);
+  CHECK_EQ(model.net().input_blobs().size(), 1)
+      << "The served net must have exactly one input";
+  const int sample_count = model.net().input_blobs()[0]->count(1);
+
+  // Clients that disconnect early must not kill the server.
+  signal(SIGPIPE, SIG_IGN);
+  const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(listener, 0) << "socket: " << strerror(errno);
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  CHECK_LT(FLAGS_socket.size(), sizeof(address.sun_path))
+      << "Socket path too long";
+  strncpy(address.sun_path, FLAGS_socket.c_str(),
+      sizeof(address.sun_path) - 1);
+  unlink(FLAGS_socket.c_str());
+  if (bind(listener, reinterpret_cast<struct sockaddr*>(&address),
+      sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+    LOG(FATAL) << "Cannot listen on " << FLAGS_socket << ": "
+               << strerror(errno);
+  }
+
+  MicroBatcher batcher(FLAGS_max_batch, FLAGS_max_latency_us);
+  ServerStats stats;
+  boost::thread_group threads;
+  for (int i = 0; i < FLAGS_workers; ++i) {
+    threads.create_thread(boost::bind(&RunWorker, &model, &batcher, &stats));
+  }
+  if (FLAGS_report_interval > 0) {
+    threads.create_thread(boost::bind(&ReportStats, &stats));
+  }
+  LOG(INFO) << "Serving " << FLAGS_model << " on " << FLAGS_socket
+            << " (" << sample_count << " values per request)";
+  while (true) {
+    const int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+      if (errno != EINTR) {
+        LOG(WARNING) << "accept: " << strerror(errno);
+      }
+      continue;
+    }
+    boost::thread(boost::bind(&ServeConnection,
+        shared_ptr<Connection>(new Connection(fd)), sample_count, &batcher))
+        .detach();
+  }
+  return 0;
+}
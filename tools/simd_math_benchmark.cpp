@@ -0,0 +1,102 @@
+// Compares the throughput of the vectorized transcendentals of simd_math.hpp
+// with plain libm loops.
+//
+// Usage:
+//    simd_math_benchmark [--count=1048576] [--iterations=50]
+//        [--cpu_threads=1]
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/simd_math.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_int32(count, 1 << 20, "The number of elements per call.");
+DEFINE_int32(iterations, 50, "The number of timed calls per function.");
+DEFINE_int32(cpu_threads, 1,
+    "The threads large calls are split over; 1 times a single core.");
+
+static void LibmExp(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::exp(a[i]); }
+}
+
+static void LibmLog(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::log(a[i]); }
+}
+
+static void LibmTanh(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::tanh(a[i]); }
+}
+
+static void LibmSigmoid(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = 0.5f * std::tanh(0.5f * a[i]) + 0.5f; }
+}
+
+static void LibmPow(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::pow(a[i], 0.75f); }
+}
+
+static void SimdPow(const int n, const float* a, float* y) {
+  simd_powx(n, a, 0.75f, y);
+}
+
+typedef void (*UnaryFunction)(const int n, const float* a, float* y);
+
+static double MillisecondsPerCall(UnaryFunction function,
+    const vector<float>& input, vector<float>* output) {
+  // warm up caches and the thread pool
+  function(input.size(), &input[0], &(*output)[0]);
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    function(input.size(), &input[0], &(*output)[0]);
+  }
+  timer.Stop();
+  return timer.MilliSeconds() / FLAGS_iterations;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Time the vectorized math functions\n"
+        "Usage:\n"
+        "    simd_math_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_count, 0);
+  Caffe::set_cpu_threads(FLAGS_cpu_threads);
+  LOG(INFO) << "Instruction set: " << simd_math_isa();
+
+  vector<float> input(FLAGS_count);
+  vector<float> positive(FLAGS_count);
+  vector<float> output(FLAGS_count);
+  caffe_rng_uniform<float>(FLAGS_count, -10.f, 10.f, &input[0]);
+  caffe_rng_uniform<float>(FLAGS_count, 1e-3f, 1e3f, &positive[0]);
+
+  const char* names[] = { "exp", "log", "tanh", "sigmoid", "powx(0.75)" };
+  const UnaryFunction libm[] = { LibmExp, LibmLog, LibmTanh, LibmSigmoid,
+      LibmPow };
+  const UnaryFunction simd[] = { simd_exp, simd_log, simd_tanh, simd_sigmoid,
+      SimdPow };
+  for (int f = 0; f < sizeof(names) / sizeof(names[0]); ++f) {
+    // log and pow only see positive inputs, as in LRN and the losses.
+    const vector<float>& x = (f == 1 || f == 4) ? positive : input;
+    const double libm_ms = MillisecondsPerCall(libm[f], x, &output);
+    const double simd_ms = MillisecondsPerCall(simd[f], x, &output);
+    LOG(INFO) << names[f] << ": libm " << FLAGS_count / libm_ms / 1e3
+              << " Melem/s, simd " << FLAGS_count / simd_ms / 1e3
+              << " Melem/s (" << libm_ms / simd_ms << "x)";
+  }
+  return 0;
+}